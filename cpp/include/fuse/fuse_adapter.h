@@ -12,11 +12,15 @@
 #define FUSE_USE_VERSION 26
 #include <fuse.h>
 
+#include <stdint.h>
+
 #include <boost/scoped_ptr.hpp>
 #include <list>
 #include <string>
 
 #include "libxtreemfs/system_user_mapping_unix.h"
+#include "pbrpc/RPC.pb.h"
+#include "util/ttl_cache.h"
 #include "xtfsutil/xtfsutil_server.h"
 #include "xtreemfs/GlobalTypes.pb.h"
 
@@ -138,12 +142,38 @@ class FuseAdapter {
            struct flock* flock);
 
  private:
+  /** Identifies the process on whose behalf a request is executed. The start
+   *  time distinguishes processes which got the same pid. */
+  struct ProcessCredentialsKey {
+    uid_t uid;
+    gid_t gid;
+    pid_t pid;
+    uint64_t start_time;
+
+    bool operator<(const ProcessCredentialsKey& other) const {
+      if (pid != other.pid) {
+        return pid < other.pid;
+      }
+      if (start_time != other.start_time) {
+        return start_time < other.start_time;
+      }
+      if (uid != other.uid) {
+        return uid < other.uid;
+      }
+      return gid < other.gid;
+    }
+  };
+
   /** Contains all needed options to mount the requested volume. */
   FuseOptions* options_;
 
   /** Translates between local and remote usernames and groups. */
   SystemUserMappingUnix system_user_mapping_;
 
+  /** UserCredentials generated for processes, see GenerateUserCredentials(). */
+  util::TTLCache<ProcessCredentialsKey, xtreemfs::pbrpc::UserCredentials>
+      user_credentials_cache_;
+
   /** Created libxtreemfs Client. */
   boost::scoped_ptr<Client> client_;
 
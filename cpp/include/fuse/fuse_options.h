@@ -48,6 +48,14 @@ class FuseOptions : public Options {
   bool foreground;
   /** Fuse options specified by -o. */
   std::vector<std::string> fuse_options;
+  /** Maximum number of cached UserCredentials of processes and of cached
+   *  user and group names. */
+  int credentials_cache_size;
+  /** Time in seconds after which cached UserCredentials and user and group
+   *  names are looked up again (0, the default, disables the caches).
+   *  Changes of the supplementary groups of a process are only seen after
+   *  this time. */
+  int credentials_cache_ttl_s;
 #ifdef __APPLE__
   /** Assumed (or if specified the set) timeout of a blocked operation after
    *  which MacFuse will on a) Tiger show a dialog if the user will still wait
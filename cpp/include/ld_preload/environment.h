@@ -15,6 +15,7 @@
 #include "libxtreemfs/system_user_mapping_unix.h"
 #include "libxtreemfs/volume_implementation.h"
 
+#include "ld_preload/memory_mappings.h"
 #include "ld_preload/open_file_table.h"
 #include "ld_preload/path.h"
 #include "ld_preload/preload_options.h"
@@ -42,6 +43,7 @@ class Environment {
   xtreemfs::SystemUserMappingUnix system_user_mapping_;
   xtreemfs::pbrpc::UserCredentials user_creds_;
   OpenFileTable open_file_table_;
+  MemoryMappings memory_mappings_;
 };
 
 #endif  // PRELOAD_ENVIRONMENT_H_
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef PRELOAD_MEMORY_MAPPINGS_H_
+#define PRELOAD_MEMORY_MAPPINGS_H_
+
+#include <stdint.h>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace xtreemfs {
+class FileHandle;
+}
+
+/** Write-back state of a shared writable mapping, shared by its parts if it
+ *  is partially unmapped. */
+struct MappedFile {
+  /** "address" is the start of the whole mapping, "file_length" the number of
+   *  bytes of it which are backed by the file. */
+  MappedFile(xtreemfs::FileHandle* fh,
+             const char* address,
+             size_t file_length);
+
+  /** Closes fh if it is still set. Errors are ignored. */
+  ~MappedFile();
+
+  /** Own handle of the mapping, which stays valid after close(fd). */
+  xtreemfs::FileHandle* fh;
+  /** Start of the whole mapping. */
+  const char* address;
+  /** Content of the file backed part of the mapping at mmap() time or the
+   *  last write back. Pages which differ were written by the application. */
+  std::vector<char> original;
+  /** Serializes write backs. */
+  boost::mutex mutex;
+};
+
+/** A region returned by mmap() for an XtreemFS file, or the part of it which
+ *  was not unmapped yet. */
+struct MemoryMapping {
+  MemoryMapping() : address(NULL), length(0), offset(0), file_length(0) {}
+
+  char* address;
+  size_t length;
+  /** File offset of the first byte of the region. */
+  int64_t offset;
+  /** Number of bytes of the region which were backed by the file at mmap()
+   *  time. Only these are written back. */
+  size_t file_length;
+  /** Only set for shared writable mappings which are written back on
+   *  msync() and munmap(). */
+  boost::shared_ptr<MappedFile> file;
+
+  /** Appends the ranges (offset relative to address, length) of the pages in
+   *  [start, start + length) which were modified since mmap() or the last
+   *  write back. Ranges are clipped to file_length. */
+  void GetModifiedRanges(
+      size_t start,
+      size_t length,
+      size_t page_size,
+      std::vector<std::pair<size_t, size_t> >* ranges) const;
+
+  /** Marks the range (relative to address) as written back. */
+  void SetWrittenBack(size_t start, size_t length) const;
+};
+
+/**
+ * Keeps track of the mmap()ed regions of XtreemFS files.
+ *
+ * The methods do not call into libxtreemfs, so the mutex is never held while
+ * munmap() might be called recursively.
+ */
+class MemoryMappings {
+ public:
+  MemoryMappings();
+
+  void Add(const MemoryMapping& mapping);
+
+  /** Removes [address, address + length) from all mappings. Mappings which
+   *  are only partially covered keep their remaining parts. The removed
+   *  parts are appended to "removed". */
+  void Remove(void* address,
+              size_t length,
+              std::vector<MemoryMapping>* removed);
+
+  /** Appends the parts of all mappings within [address, address + length) to
+   *  "found". */
+  void Find(void* address, size_t length, std::vector<MemoryMapping>* found);
+
+  /** Returns true if a mapping overlaps [address, address + length). */
+  bool Overlaps(void* address, size_t length);
+
+  /** Returns true if there is no mapping. Does not lock, so munmap() and
+   *  msync() of other memory skip the lookup. */
+  bool Empty() const;
+
+ private:
+  /** Returns the part of "mapping" within [start, end). */
+  static MemoryMapping Part(const MemoryMapping& mapping,
+                            char* start,
+                            char* end);
+
+  /** First mapping which may overlap "address". Requires mutex_. */
+  std::map<char*, MemoryMapping>::iterator FirstCandidate(char* address);
+
+  boost::mutex mutex_;
+  typedef std::map<char*, MemoryMapping> MappingMap;
+  MappingMap mappings_;
+  /** Number of entries in mappings_. */
+  boost::atomic<size_t> count_;
+};
+
+#endif  // PRELOAD_MEMORY_MAPPINGS_H_
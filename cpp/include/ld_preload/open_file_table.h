@@ -8,11 +8,13 @@
 #ifndef PRELOAD_OPEN_FILE_TABLE_H_
 #define PRELOAD_OPEN_FILE_TABLE_H_
 
-#include <map>
 #include <pthread.h>
 #include <cstdio>
 #include <stdint.h>
+#include <string>
+#include <vector>
 
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include "libxtreemfs/file_handle.h"
 
@@ -21,41 +23,229 @@ class Client;
 class VolumeHandle;
 }
 
+/** Access pattern hints given by posix_fadvise(). */
+enum ReadAheadMode {
+  kReadAheadNormal,
+  kReadAheadSequential,
+  kReadAheadRandom
+};
+
+/**
+ * State of a file opened through the preload library.
+ *
+ * Small reads are served from a read-ahead buffer and small consecutive writes
+ * are collected in a write-behind buffer, so that applications issuing many
+ * small I/Os do not pay one synchronous RPC per call. All members are guarded
+ * by mutex_, which is only contended if several threads share one fd.
+ *
+ * OpenFileTable hands out shared references. Like a kernel file, the file
+ * handle is closed when the last reference is released, i.e. a close() does
+ * not pull the file away from calls of other threads which are still using it.
+ */
 class OpenFile {
  public:
-  OpenFile(xtreemfs::FileHandle* fh);
+  /** "path" is the local path used to open the file. If "fh" is NULL, the
+   *  fd refers to the directory "path". "flags" are those of open(). */
+  OpenFile(xtreemfs::FileHandle* fh,
+           const std::string& path,
+           int flags,
+           size_t read_ahead_size,
+           size_t write_behind_size);
+
+  /** Closes the file handle if Close() was not called. Errors are ignored. */
+  ~OpenFile();
+
+  const std::string& path() const {
+    return path_;
+  }
+
+  bool IsDirectory() const {
+    return fh_ == NULL;
+  }
+
+  int flags() const {
+    return flags_;
+  }
+
+  /** Reads at "offset" without changing the file offset.
+   *
+   * @throws XtreemFSException */
+  int Read(char* buf, size_t count, int64_t offset);
 
-  void Initialise();
-  void Deinitialise();
-  int GetFileDescriptor();
+  /** Reads at the current file offset and advances it.
+   *
+   * @throws XtreemFSException */
+  int Read(char* buf, size_t count);
+
+  /** Writes at "offset" without changing the file offset.
+   *
+   * @throws XtreemFSException */
+  int Write(const char* buf, size_t count, int64_t offset);
+
+  /** Writes at the current file offset and advances it.
+   *
+   * @throws XtreemFSException */
+  int Write(const char* buf, size_t count);
+
+  /** Truncates the file after writing pending data.
+   *
+   * @throws XtreemFSException */
+  void Truncate(const xtreemfs::pbrpc::UserCredentials& user_credentials,
+                int64_t new_file_size);
+
+  /** Writes pending data and flushes the file handle (fsync()).
+   *
+   * @throws XtreemFSException */
+  void Sync();
+
+  /** Sets the file offset. SEEK_END requires the file size and therefore
+   *  flushes pending writes first.
+   *
+   * @returns The new offset or -1 if "whence" is invalid.
+   * @throws XtreemFSException */
+  int64_t Seek(int64_t offset,
+               int whence,
+               const xtreemfs::pbrpc::UserCredentials& user_credentials);
+
+  /** Sends the content of the write-behind buffer to the file handle. If the
+   *  write fails, the data is kept and sent again by the next flush.
+   *
+   * @throws XtreemFSException */
+  void FlushWriteBehind();
+
+  /** Writes pending data and discards the read-ahead buffer, so that fh_ can
+   *  be used directly, e.g. by a FileCopier.
+   *
+   * @throws XtreemFSException */
+  void DropBuffers();
+
+  /** Writes pending data and closes the file handle. Must only be called by
+   *  the holder of the last reference, i.e. after the last fd was closed.
+   *
+   * @throws XtreemFSException */
+  void Close();
+
+  /** Applies a posix_fadvise() hint to the read-ahead behavior.
+   *
+   * @throws XtreemFSException */
+  void Advise(int64_t offset, int64_t length, int advice);
 
   xtreemfs::FileHandle* fh_;
-  uint64_t offset_;
 
-private:
-  FILE * tmp_file_;
-  int tmp_file_fd_;
+ private:
+  /** Same as FlushWriteBehind(), requires mutex_ to be locked. */
+  void FlushWriteBehindLocked();
+
+  /** Same as DropBuffers(), requires mutex_ to be locked. */
+  void DropBuffersLocked();
+
+  /** Same as Read(buf, count, offset), requires mutex_ to be locked. */
+  int ReadLocked(char* buf, size_t count, int64_t offset);
+
+  /** Same as Write(buf, count, offset), requires mutex_ to be locked. */
+  int WriteLocked(const char* buf, size_t count, int64_t offset);
+
+  /** Fills the read-ahead buffer with up to "size" bytes starting at "offset".
+   *  Requires mutex_ to be locked. */
+  void FillReadAheadBuffer(int64_t offset, size_t size);
+
+  /** Current read-ahead size according to read_ahead_mode_. */
+  size_t GetReadAheadSize() const;
+
+  boost::mutex mutex_;
+
+  std::string path_;
+  int flags_;
+
+  /** True after Close() was called. */
+  bool closed_;
+
+  /** File offset, or number of returned entries for directories. */
+  int64_t offset_;
+
+  /** Configured read-ahead size, adjusted by read_ahead_mode_. */
+  size_t read_ahead_size_;
+  ReadAheadMode read_ahead_mode_;
+  /** Data of [read_ahead_offset_, read_ahead_offset_ + read_ahead_length_). */
+  std::vector<char> read_ahead_buffer_;
+  int64_t read_ahead_offset_;
+  size_t read_ahead_length_;
+  /** True if the last fill of the buffer was shorter than requested. */
+  bool read_ahead_eof_;
+
+  /** Maximum number of bytes collected before they are written. */
+  size_t write_behind_size_;
+  /** Data of [write_behind_offset_, write_behind_offset_ + size()). */
+  std::vector<char> write_behind_buffer_;
+  int64_t write_behind_offset_;
 };
 
+/**
+ * Maps file descriptors to OpenFile objects.
+ *
+ * The file descriptors are duplicates of a temporary file, which reserves
+ * their numbers, and therefore small and dense. The table is a flat array
+ * indexed by fd so that the lookups on every intercepted call (Has(), Get())
+ * are an atomic load of a shared_ptr. Only the modifying methods take the
+ * mutex.
+ *
+ * Like dup() of a kernel fd, Duplicate() registers the same OpenFile under
+ * another fd, so both share the file offset and the file handle.
+ */
 class OpenFileTable {
  public:
   OpenFileTable();
   ~OpenFileTable();
 
-  int Register(xtreemfs::FileHandle* handle);
-  void Unregister(int fd);
-  OpenFile Get(int fd);
-  int Set(int fd, xtreemfs::FileHandle* handle);
-  void SetOffset(int fd, uint64_t offset);
+  /** Sets the buffer sizes of files registered afterwards. */
+  void SetBufferSizes(size_t read_ahead_size, size_t write_behind_size);
+
+  /** Registers an opened file, or the directory "path" if handle is NULL.
+   *  "flags" are those of open().
+   *
+   * @returns The new fd or -1 if no fd is available. */
+  int Register(xtreemfs::FileHandle* handle,
+               const std::string& path,
+               int flags);
+  /** Registers the OpenFile of "fd" under a new fd (dup()).
+   *
+   * @returns The new fd or -1 if fd is not an XtreemFS file (EBADF) or no fd
+   *          is available (EMFILE). */
+  int Duplicate(int fd);
+  /** Registers the OpenFile of "fd" under "new_fd" (dup2()). A file which was
+   *  registered under "new_fd" is closed as soon as no other fd or thread
+   *  uses it, a non-XtreemFS file is closed by the kernel.
+   *
+   * @returns new_fd or -1 if fd is not an XtreemFS file or new_fd is out of
+   *          range (EBADF). */
+  int Duplicate(int fd, int new_fd);
+  /** Removes the fd from the table and returns the table's reference to its
+   *  OpenFile, or NULL if fd is not an XtreemFS file. */
+  boost::shared_ptr<OpenFile> Unregister(int fd);
+  /** @returns NULL if fd is not an XtreemFS file. */
+  boost::shared_ptr<OpenFile> Get(int fd);
   bool Has(int fd);
+  /** Unregisters all fds. Their file handles are closed as soon as no other
+   *  thread uses them. */
+  void Clear();
 
  private:
+  /** Registers "open_file" under a new fd. Requires mutex_.
+   *
+   * @returns The new fd or -1 if no fd is available (EMFILE). */
+  int AddUnmutexed(const boost::shared_ptr<OpenFile>& open_file);
+
+  /** Guards Register(), Duplicate() and Unregister(). */
   boost::mutex mutex_;
-  typedef std::map<int, OpenFile> FileTable;
-  FileTable open_files_;// GUARDED_BY(mutex_);
+  /** Flat table of max_fds_ entries, NULL if the fd is not registered.
+   *  Accessed with boost::atomic_load() and boost::atomic_exchange(). */
+  boost::shared_ptr<OpenFile>* open_files_;
+  int max_fds_;
+  size_t read_ahead_size_;
+  size_t write_behind_size_;
+  /** The fds of the table are duplicates of this file. */
   FILE * tmp_file_;
   int tmp_file_fd_;
-  int next_fd_;
 };
 
 #endif  // PRELOAD_OPEN_FILE_TABLE_H_
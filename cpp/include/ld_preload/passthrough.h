@@ -10,18 +10,34 @@
 
 #include <stdio.h>
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 typedef int (*funcptr_open)(const char*, int, int);
+typedef int (*funcptr_openat)(int, const char*, int, int);
 typedef int (*funcptr_close)(int);
 
 typedef ssize_t (*funcptr_read)(int, void*, size_t);
 typedef ssize_t (*funcptr_write)(int, const void*, size_t);
 typedef ssize_t (*funcptr_pread)(int, void*, size_t, off_t);
 typedef ssize_t (*funcptr_pwrite)(int, const void*, size_t, off_t);
+typedef ssize_t (*funcptr_readv)(int, const struct iovec*, int);
+typedef ssize_t (*funcptr_writev)(int, const struct iovec*, int);
+typedef ssize_t (*funcptr_sendfile)(int, int, off_t*, size_t);
+typedef ssize_t (*funcptr_copy_file_range)(int, off64_t*, int, off64_t*, size_t, unsigned int);
+typedef int (*funcptr_fsync)(int);
+typedef int (*funcptr_fdatasync)(int);
+
+typedef void* (*funcptr_mmap)(void*, size_t, int, int, int, off_t);
+typedef int (*funcptr_munmap)(void*, size_t);
+typedef int (*funcptr_msync)(void*, size_t, int);
+
+typedef ssize_t (*funcptr_getdents64)(int, void*, size_t);
 
 typedef int (*funcptr_dup)(int);
 typedef int (*funcptr_dup2)(int, int);
 typedef off_t (*funcptr_lseek)(int, off_t, int);
+typedef int (*funcptr_posix_fadvise)(int, off_t, off_t, int);
 
 typedef int (*funcptr_stat)(const char*, struct stat*);
 typedef int (*funcptr_fstat)(int, struct stat*);
@@ -31,6 +47,9 @@ typedef int (*funcptr___fxstat)(int, int, struct stat*);
 typedef int (*funcptr___fxstat64)(int, int, struct stat64*);
 typedef int (*funcptr___lxstat)(int, const char*, struct stat*);
 typedef int (*funcptr___lxstat64)(int, const char*, struct stat64*);
+typedef int (*funcptr_fstatat)(int, const char*, struct stat*, int);
+typedef int (*funcptr___fxstatat)(int, int, const char*, struct stat*, int);
+typedef int (*funcptr___fxstatat64)(int, int, const char*, struct stat64*, int);
 
 typedef FILE* (*funcptr_fopen)(const char*, const char*);
 typedef int (*funcptr_truncate)(const char*, off_t);
@@ -41,14 +60,27 @@ typedef int (*funcptr_fsetxattr)(int, const char*, const void*, size_t, int);
 
 
 extern void* libc_open;
+extern void* libc_openat;
 extern void* libc_close;
 extern void* libc___close;
 extern void* libc_pread;
 extern void* libc_read;
 extern void* libc_write;
+extern void* libc_pwrite;
+extern void* libc_readv;
+extern void* libc_writev;
+extern void* libc_sendfile;
+extern void* libc_copy_file_range;
+extern void* libc_fsync;
+extern void* libc_fdatasync;
+extern void* libc_mmap;
+extern void* libc_munmap;
+extern void* libc_msync;
+extern void* libc_getdents64;
 extern void* libc_dup;
 extern void* libc_dup2;
 extern void* libc_lseek;
+extern void* libc_posix_fadvise;
 
 extern void* libc_stat;
 extern void* libc_fstat;
@@ -58,6 +90,9 @@ extern void* libc___fxstat;
 extern void* libc___fxstat64;
 extern void* libc___lxstat;
 extern void* libc___lxstat64;
+extern void* libc_fstatat;
+extern void* libc___fxstatat;
+extern void* libc___fxstatat64;
 
 extern void* libc_fopen;
 extern void* libc_truncate;
@@ -9,7 +9,9 @@
 #define PRELOAD_PRELOAD_H_
 
 #include <stdint.h>
+#include <string>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include "ld_preload/environment.h"
 
@@ -18,15 +20,38 @@ Environment* get_env();
 
 bool is_xtreemfs_fd(int fd);
 bool is_xtreemfs_path(const char *path);
+/** Returns true if "path" relative to "dirfd" (see openat()) is an XtreemFS
+ *  path and stores the resulting absolute local path in "full_path". */
+bool is_xtreemfs_at_path(int dirfd, const char* path, std::string* full_path);
+/** Returns true if [addr, addr + length) overlaps a shared writable mapping
+ *  of an XtreemFS file. */
+bool is_xtreemfs_mapping(void* addr, size_t length);
 
 int xtreemfs_open(const char* pathname, int flags, int mode);
 int xtreemfs_close(int fd);
 uint64_t xtreemfs_pread(int fd, void* buf, uint64_t nbyte, uint64_t offset);
 uint64_t xtreemfs_read(int fd, void* buf, uint64_t nbyte);
 uint64_t xtreemfs_write(int fd, const void* buf, uint64_t nbyte);
+uint64_t xtreemfs_pwrite(int fd, const void* buf, uint64_t nbyte, uint64_t offset);
+ssize_t xtreemfs_readv(int fd, const struct iovec* iov, int iovcnt);
+ssize_t xtreemfs_writev(int fd, const struct iovec* iov, int iovcnt);
+/** Copies up to "count" bytes between two fds of which at least one is an
+ *  XtreemFS fd (sendfile(), copy_file_range()). NULL offsets use and advance
+ *  the file offset. */
+ssize_t xtreemfs_copy(int in_fd, off64_t* in_offset,
+                      int out_fd, off64_t* out_offset,
+                      size_t count);
+int xtreemfs_fsync(int fd);
+int xtreemfs_ftruncate(int fd, off_t length);
+int xtreemfs_truncate(const char* pathname, off_t length);
+void* xtreemfs_mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset);
+int xtreemfs_munmap(void* addr, size_t length);
+int xtreemfs_msync(void* addr, size_t length, int flags);
+ssize_t xtreemfs_getdents64(int fd, void* dirp, size_t count);
 int xtreemfs_dup2(int oldfd, int newfd);
 int xtreemfs_dup(int fd);
 off_t xtreemfs_lseek(int fd, off_t offset, int mode);
+int xtreemfs_posix_fadvise(int fd, off_t offset, off_t len, int advice);
 int xtreemfs_stat(const char *path, struct stat *buf);
 int xtreemfs_stat64(const char *pathname, struct stat64 *buf);
 int xtreemfs_fstat(int fd, struct stat *buf);
@@ -33,7 +33,16 @@ class PreloadOptions : public Options {
   /** Outputs usage of the command line parameters. */
   virtual std::string ShowCommandLineHelp();
 
-  // TODO: add preload-specific options here
+  /** Size of the per-fd read-ahead buffer in kB (0, the default, disables
+   *  it). */
+  int read_ahead_kb;
+  /** Size of the per-fd buffer collecting consecutive small writes in kB
+   *  (0, the default, disables it). Errors of buffered writes are deferred. */
+  int write_behind_kb;
+  /** Largest mmap() of an XtreemFS file in MB (0 means no limit). The mapped
+   *  range is read at mmap() time and shared writable mappings keep a copy
+   *  of it, i.e. a mapping takes up to twice its size in memory. */
+  int mmap_max_mb;
 
  private:
   /** Contains all available preload options and its descriptions. */
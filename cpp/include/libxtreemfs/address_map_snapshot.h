@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_LIBXTREEMFS_ADDRESS_MAP_SNAPSHOT_H_
+#define CPP_INCLUDE_LIBXTREEMFS_ADDRESS_MAP_SNAPSHOT_H_
+
+#include <time.h>
+
+#include <string>
+
+#include "xtreemfs/DIR.pb.h"
+
+namespace xtreemfs {
+
+/** Copy of what a client learned from the DIR: the address mappings of all
+ *  services, the services of the opened volumes and the OSDs including their
+ *  vivaldi coordinates.
+ *
+ * It is stored on disk so that the next client on this host does not have to
+ * query the DIR before it can start. The file contains the messages in
+ * length-delimited protobuf encoding after a short header.
+ *
+ * Not thread-safe.
+ */
+class AddressMapSnapshot {
+ public:
+  AddressMapSnapshot();
+
+  /** Replaces the content with the one of "path".
+   *
+   * @returns false if the file does not exist or is invalid. The snapshot is
+   *          empty then. */
+  bool Load(const std::string& path);
+
+  /** Writes the snapshot to "path". A temporary file is renamed, so that
+   *  clients which load the snapshot at the same time never see a partial
+   *  file.
+   *
+   * @returns false if the file could not be written. */
+  bool Save(const std::string& path);
+
+  void Clear();
+
+  /** Point in time when the snapshot was saved, 0 for an unsaved one. */
+  time_t write_time() const {
+    return write_time_;
+  }
+
+  const pbrpc::AddressMappingSet& address_mappings() const {
+    return address_mappings_;
+  }
+
+  pbrpc::AddressMappingSet* mutable_address_mappings() {
+    return &address_mappings_;
+  }
+
+  const pbrpc::ServiceSet& osd_services() const {
+    return osd_services_;
+  }
+
+  pbrpc::ServiceSet* mutable_osd_services() {
+    return &osd_services_;
+  }
+
+  const pbrpc::ServiceSet& named_services() const {
+    return named_services_;
+  }
+
+  /** Copies the services named "name" into "services".
+   *
+   * @returns false if there are none. */
+  bool GetServicesByName(const std::string& name,
+                         pbrpc::ServiceSet* services) const;
+
+  /** Replaces the services named "name" with the ones in "services". An
+   *  empty set removes them. */
+  void SetServicesByName(const std::string& name,
+                         const pbrpc::ServiceSet& services);
+
+ private:
+  time_t write_time_;
+  pbrpc::AddressMappingSet address_mappings_;
+  /** Results of service lookups by name, e.g., of volumes. */
+  pbrpc::ServiceSet named_services_;
+  pbrpc::ServiceSet osd_services_;
+};
+
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_LIBXTREEMFS_ADDRESS_MAP_SNAPSHOT_H_
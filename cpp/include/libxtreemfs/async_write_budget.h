@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_LIBXTREEMFS_ASYNC_WRITE_BUDGET_H_
+#define CPP_INCLUDE_LIBXTREEMFS_ASYNC_WRITE_BUDGET_H_
+
+#include <stdint.h>
+
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <map>
+
+namespace xtreemfs {
+
+/** Limits the bytes of all pending async writes of a client.
+ *
+ * Every AsyncWriteHandler (the "owner") acquires the size of a write before
+ * it is sent and releases it once the write is done. If the budget is
+ * exhausted, Acquire() blocks. Waiting owners which hold fewer bytes are
+ * served first, i.e., a few files which are written fast cannot starve the
+ * others.
+ */
+class AsyncWriteBudget {
+ public:
+  /** Current state and counters of the budget. */
+  struct Statistics {
+    Statistics();
+
+    /** Maximum number of bytes, 0 if unlimited. */
+    uint64_t size;
+    uint64_t used_bytes;
+    uint64_t peak_used_bytes;
+    /** Number of owners which hold bytes. */
+    int owners;
+    /** Number of threads blocked in Acquire(). */
+    int waiting_threads;
+    /** Number of Acquire() calls which had to wait. */
+    uint64_t blocked_acquires;
+    /** Sum of the time Acquire() calls did wait. */
+    uint64_t blocked_time_ms;
+  };
+
+  /** "size" is the maximum number of bytes, 0 disables the limit. */
+  explicit AsyncWriteBudget(uint64_t size);
+
+  /** Blocks until "bytes" are available for "owner". If nothing is used, a
+   *  request is always granted, even if it is larger than the budget. */
+  void Acquire(const void* owner, uint64_t bytes);
+
+  /** Returns "bytes" which were acquired by "owner". */
+  void Release(const void* owner, uint64_t bytes);
+
+  void GetStatistics(Statistics* statistics);
+
+ private:
+  /** Returns true if "bytes" fit into the budget and no other waiting owner
+   *  holds fewer bytes than "owner".
+   *
+   * @remark Requires a lock on mutex_. */
+  bool MayAcquireUnmutexed(const void* owner, uint64_t bytes);
+
+  /** @remark Requires a lock on mutex_. */
+  uint64_t HeldBytesUnmutexed(const void* owner);
+
+  const uint64_t size_;
+
+  boost::mutex mutex_;
+
+  /** Notified if bytes were released or waiting owners may fit. */
+  boost::condition budget_changed_;
+
+  uint64_t used_bytes_;
+
+  uint64_t peak_used_bytes_;
+
+  /** Bytes held per owner. Owners without bytes are removed. */
+  std::map<const void*, uint64_t> held_bytes_;
+
+  /** Owner of every thread blocked in Acquire(). */
+  std::list<const void*> waiting_owners_;
+
+  uint64_t blocked_acquires_;
+
+  uint64_t blocked_time_ms_;
+};
+
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_LIBXTREEMFS_ASYNC_WRITE_BUDGET_H_
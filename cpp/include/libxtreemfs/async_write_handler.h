@@ -15,10 +15,11 @@
 #include "libxtreemfs/execute_sync_request.h"
 #include "libxtreemfs/options.h"
 #include "rpc/callback_interface.h"
-#include "util/synchronized_queue.h"
+#include "util/sharded_queue.h"
 
 namespace xtreemfs {
 
+class AsyncWriteBudget;
 struct AsyncWriteBuffer;
 class FileInfo;
 class UUIDResolver;
@@ -34,6 +35,14 @@ class AsyncWriteHandler
           xtreemfs::pbrpc::OSDWriteResponse> {
  public:
   struct CallbackEntry {
+    CallbackEntry()
+        : handler_(NULL),
+          response_message_(NULL),
+          data_(NULL),
+          data_length_(0),
+          error_(NULL),
+          context_(NULL) {}
+
     /**
      * @remark Ownerships of response_message, data and error are transferred.
      */
@@ -66,7 +75,8 @@ class AsyncWriteHandler
       const xtreemfs::pbrpc::Auth& auth_bogus,
       const xtreemfs::pbrpc::UserCredentials& user_credentials_bogus,
       const Options& volume_options,
-      util::SynchronizedQueue<CallbackEntry>& callback_queue_);
+      util::ShardedQueue<CallbackEntry>& callback_queue_,
+      AsyncWriteBudget* write_budget);
 
   ~AsyncWriteHandler();
 
@@ -74,8 +84,9 @@ class AsyncWriteHandler
    *  specified by write_buffer->uuid_iterator (or write_buffer->osd_uuid if
    *  write_buffer->use_uuid_iterator is false).
    *
-   *  Blocks if the number of pending bytes exceeds the maximum write-ahead
-   *  or WaitForPendingWrites{NonBlocking}() was called beforehand.
+   *  Blocks if the number of pending bytes exceeds the maximum write-ahead,
+   *  the client-wide write_budget_ is exhausted or
+   *  WaitForPendingWrites{NonBlocking}() was called beforehand.
    */
   void Write(AsyncWriteBuffer* write_buffer);
 
@@ -90,9 +101,11 @@ class AsyncWriteHandler
                                        bool* wait_completed,
                                        boost::mutex* wait_completed_mutex);
 
-  /** This static method runs in its own thread and does the real callback
-   *  handling to avoid load and blocking on the RPC thread. */
-  static void ProcessCallbacks(util::SynchronizedQueue<CallbackEntry>& callback_queue);
+  /** This static method runs in its own thread for every shard of
+   *  callback_queue and does the real callback handling to avoid load and
+   *  blocking on the RPC thread. */
+  static void ProcessCallbacks(util::ShardedQueue<CallbackEntry>& callback_queue,
+                               size_t shard);
 
  private:
   /** Possible states of this object. */
@@ -292,7 +305,11 @@ class AsyncWriteHandler
   AsyncWriteBuffer* worst_write_buffer_;
 
   /** Used by CallFinished (enqueue) */
-  util::SynchronizedQueue<CallbackEntry>& callback_queue_;
+  util::ShardedQueue<CallbackEntry>& callback_queue_;
+
+  /** Bytes of all pending async writes of the client. Every buffer in
+   *  writes_in_flight_ holds its data_length. */
+  AsyncWriteBudget* write_budget_;
 };
 
 }  // namespace xtreemfs
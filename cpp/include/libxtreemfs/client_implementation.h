@@ -8,19 +8,26 @@
 #ifndef CPP_INCLUDE_LIBXTREEMFS_CLIENT_IMPLEMENTATION_H_
 #define CPP_INCLUDE_LIBXTREEMFS_CLIENT_IMPLEMENTATION_H_
 
+#include <time.h>
+
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/unordered_set.hpp>
 #include <gtest/gtest_prod.h>
 #include <list>
+#include <set>
 #include <string>
 
+#include "libxtreemfs/address_map_snapshot.h"
+#include "libxtreemfs/async_write_budget.h"
 #include "libxtreemfs/client.h"
 #include "libxtreemfs/uuid_cache.h"
 #include "libxtreemfs/simple_uuid_iterator.h"
 #include "libxtreemfs/typedefs.h"
 #include "libxtreemfs/uuid_resolver.h"
-#include "util/synchronized_queue.h"
 #include "libxtreemfs/async_write_handler.h"
+#include "util/bounded_queue.h"
 
 #include "xtreemfs/DIR.pb.h"
 
@@ -55,8 +62,36 @@ class DIRUUIDResolver : public UUIDResolver {
       const pbrpc::UserCredentials& user_credentials,
       const Options& options);
 
+  /** Creates the DIRServiceClient and starts the refresh thread. */
   void Initialize(rpc::Client* network_client);
 
+  /** Stops the refresh thread. */
+  void Shutdown();
+
+  /** Lets the refresh thread cache the address mappings of all services
+   *  registered at the DIR, e.g., the OSDs of a volume, with a single
+   *  request. Does not block; the mappings are looked up on demand until the
+   *  prefetch is done. */
+  void PrefetchAddressMappings();
+
+  /** Fills the cache with the address mappings of the snapshot "path" and
+   *  uses its services instead of asking the DIR, until they were looked up
+   *  at the DIR once or the snapshot becomes older than "max_age_s".
+   *  Older snapshots are ignored. The refresh thread revalidates everything
+   *  with the DIR in the background.
+   *
+   * @returns false if there was no usable snapshot. */
+  bool LoadSnapshot(const std::string& path, int max_age_s);
+
+  /** Writes everything learned from the DIR so far to "path". */
+  void SaveSnapshot(const std::string& path);
+
+  /** Copies the OSDs of the snapshot, e.g., to initialize Vivaldi. */
+  void GetSnapshotOSDServices(pbrpc::ServiceSet* services);
+
+  /** Replaces the OSDs which will be written to the snapshot. */
+  void SetSnapshotOSDServices(const pbrpc::ServiceSet& services);
+
   virtual void UUIDToAddress(const std::string& uuid, std::string* address);
   virtual void UUIDToAddressWithOptions(const std::string& uuid,
                                         std::string* address,
@@ -68,6 +103,33 @@ class DIRUUIDResolver : public UUIDResolver {
   virtual std::vector<std::string> VolumeNameToMRCUUIDs(const std::string& volume_name);
 
  private:
+  /** Queries the DIR for "uuid", updates the cache and returns the address.
+   *
+   * @throws AddressToUUIDNotFoundException
+   * @throws UnknownAddressSchemeException */
+  std::string LookupAddressMapping(const std::string& uuid,
+                                   const RPCOptions& options);
+
+  /** Does the work of PrefetchAddressMappings(). Errors are only logged. */
+  void FetchAddressMappings();
+
+  /** Refreshes the cache entries queued in refresh_queue_, runs in
+   *  refresh_thread_. An empty UUID refreshes all mappings and the services
+   *  taken from the snapshot. */
+  void RefreshAddressMappings();
+
+  /** Asks the DIR for the services of "volume_name" and adds them to the
+   *  snapshot. Afterwards, the services of the loaded snapshot are no longer
+   *  used for "volume_name".
+   *
+   * @remark Ownership of the return value is transferred to the caller. */
+  pbrpc::ServiceSet* LookupServicesByName(const std::string& volume_name,
+                                          const RPCOptions& options);
+
+  /** Returns the networks of the local interfaces. The result is cached for
+   *  a minute as it requires to walk all interfaces. */
+  boost::unordered_set<std::string> GetLocalNetworks();
+
   SimpleUUIDIterator& dir_uuid_iterator_;
   /** The auth_type of this object will always be set to AUTH_NONE. */
 
@@ -83,6 +145,36 @@ class DIRUUIDResolver : public UUIDResolver {
   /** Caches service UUIDs -> (address, port, TTL). */
   UUIDCache uuid_cache_;
 
+  /** UUIDs whose cache entries are about to expire. */
+  util::BoundedQueue<std::string> refresh_queue_;
+
+  /** Guards snapshot_, snapshot_service_names_ and
+   *  snapshot_expiration_time_. */
+  boost::mutex snapshot_mutex_;
+
+  /** What was learned from the DIR, see LoadSnapshot(). */
+  AddressMapSnapshot snapshot_;
+
+  /** Names of the services which were loaded from the snapshot and not yet
+   *  revalidated. */
+  std::set<std::string> snapshot_service_names_;
+
+  /** Point in time after which the loaded snapshot is too old to be used. */
+  time_t snapshot_expiration_time_;
+
+  /** Refreshes cache entries in the background, so that requests can use the
+   *  old entry meanwhile and do not wait for the DIR. */
+  boost::scoped_ptr<boost::thread> refresh_thread_;
+
+  /** Guards local_networks_ and local_networks_expiration_time_. */
+  boost::mutex local_networks_mutex_;
+
+  /** Cached result of GetNetworks(). */
+  boost::unordered_set<std::string> local_networks_;
+
+  /** Point in time after which local_networks_ is retrieved again. */
+  time_t local_networks_expiration_time_;
+
   /** Options class which contains the log_level string and logfile path. */
   const Options& options_;
 
@@ -197,12 +289,21 @@ class ClientImplementation : public Client {
 
   const pbrpc::VivaldiCoordinates& GetVivaldiCoordinates() const;
 
-  util::SynchronizedQueue<AsyncWriteHandler::CallbackEntry>& GetAsyncWriteCallbackQueue();
+  util::ShardedQueue<AsyncWriteHandler::CallbackEntry>& GetAsyncWriteCallbackQueue();
+
+  /** Returns the budget shared by the AsyncWriteHandlers of all files. */
+  AsyncWriteBudget* GetAsyncWriteBudget();
 
  private:
+  /** The address map snapshot is stored next to the vivaldi coordinates. */
+  std::string GetAddressMapSnapshotPath() const;
+
   /** True if Shutdown() was executed. */
   bool was_shutdown_;
 
+  /** True if Start() loaded the address map snapshot. */
+  bool address_map_snapshot_loaded_;
+
   /** Auth of type AUTH_NONE which is required for most operations which do not
    *  check the authentication data (except Create, Delete, ListVolume(s)). */
   xtreemfs::pbrpc::Auth auth_bogus_;
@@ -242,11 +343,16 @@ class ClientImplementation : public Client {
   boost::scoped_ptr<Vivaldi> vivaldi_;
   boost::scoped_ptr<pbrpc::OSDServiceClient> osd_service_client_;
 
-  /** Thread that handles the callbacks for asynchronous writes. */
-  boost::scoped_ptr<boost::thread> async_write_callback_thread_;
+  /** Threads that handle the callbacks for asynchronous writes, one per shard
+   *  of async_write_callback_queue_. */
+  boost::thread_group async_write_callback_threads_;
   /** Holds the Callbacks enqueued be CallFinished() (producer). They are
-   *  processed by ProcessCallbacks(consumer), running in its own thread. */
-  util::SynchronizedQueue<AsyncWriteHandler::CallbackEntry> async_write_callback_queue_;
+   *  processed by ProcessCallbacks(consumer), running in its own thread for
+   *  every shard. */
+  util::ShardedQueue<AsyncWriteHandler::CallbackEntry> async_write_callback_queue_;
+
+  /** Limits the memory of the pending async writes of all files. */
+  AsyncWriteBudget async_write_budget_;
 
   FRIEND_TEST(rpc::ClientTestFastLingerTimeout, LingerTests);
   FRIEND_TEST(rpc::ClientTestFastLingerTimeoutConnectTimeout, LingerTests);
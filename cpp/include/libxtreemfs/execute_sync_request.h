@@ -8,6 +8,7 @@
 #ifndef CPP_INCLUDE_LIBXTREEMFS_CALLBACK_EXECUTE_SYNC_REQUEST_H_
 #define CPP_INCLUDE_LIBXTREEMFS_CALLBACK_EXECUTE_SYNC_REQUEST_H_
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/function.hpp>
 #include <string>
 
@@ -38,7 +39,8 @@ class RPCOptions {
      : max_retries_(max_retries),
        retry_delay_s_(retry_delay_s),
        delay_last_attempt_(delay_last_attempt),
-       was_interrupted_cb_(was_interrupted_cb) {}
+       was_interrupted_cb_(was_interrupted_cb),
+       deadline_(boost::posix_time::not_a_date_time) {}
 
   RPCOptions(int max_retries,
              int retry_delay_s,
@@ -46,7 +48,8 @@ class RPCOptions {
      : max_retries_(max_retries),
        retry_delay_s_(retry_delay_s),
        delay_last_attempt_(false),
-       was_interrupted_cb_(was_interrupted_cb) {}
+       was_interrupted_cb_(was_interrupted_cb),
+       deadline_(boost::posix_time::not_a_date_time) {}
 
   int max_retries() const {
     return max_retries_;
@@ -64,11 +67,29 @@ class RPCOptions {
     return was_interrupted_cb_;
   }
 
+  /** Point in time after which no further attempt is started. Every request
+   *  sent by an attempt times out at this point at the latest.
+   *  Not set (not_a_date_time) by default. */
+  void set_deadline(const boost::posix_time::ptime& deadline) {
+    deadline_ = deadline;
+  }
+
+  const boost::posix_time::ptime& deadline() const {
+    return deadline_;
+  }
+
+  /** Returns true if the deadline is set and over. */
+  bool DeadlinePassed() const {
+    return !deadline_.is_not_a_date_time()
+        && boost::posix_time::microsec_clock::local_time() >= deadline_;
+  }
+
  private:
   int max_retries_;
   int retry_delay_s_;
   bool delay_last_attempt_;
   WasInterruptedCallback was_interrupted_cb_;
+  boost::posix_time::ptime deadline_;
 };
 
 /** Retries to execute the synchronous request "sync_function" up to "options.
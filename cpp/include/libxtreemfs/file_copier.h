@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_LIBXTREEMFS_FILE_COPIER_H_
+#define CPP_INCLUDE_LIBXTREEMFS_FILE_COPIER_H_
+
+#include <stdint.h>
+
+#include <boost/thread/mutex.hpp>
+#include <string>
+
+#include "pbrpc/RPC.pb.h"
+
+namespace xtreemfs {
+
+class FileHandle;
+
+/** Copies data between two FileHandles with several chunks in flight.
+ *
+ * The range is split into chunks (usually the object size) which are
+ * processed by "parallelism" workers. Each worker reads one chunk from the
+ * source and writes it to the destination, so consecutive objects located on
+ * different stripe OSDs are transferred at the same time while at most
+ * parallelism * chunk_size bytes are buffered.
+ */
+class FileCopier {
+ public:
+  FileCopier(FileHandle* source,
+             FileHandle* destination,
+             size_t chunk_size,
+             int parallelism);
+
+  /** Copies "length" bytes from "source_offset" to "destination_offset".
+   *  The copy ends early at the end of the source file.
+   *
+   * @returns Number of bytes copied.
+   *
+   * @throws AddressToUUIDNotFoundException
+   * @throws IOException
+   * @throws PosixErrorException
+   * @throws UnknownAddressSchemeException
+   */
+  int64_t Copy(int64_t source_offset,
+               int64_t destination_offset,
+               int64_t length);
+
+ private:
+  /** Processes chunks until all are done or a worker failed. */
+  void CopyChunks();
+
+  FileHandle* source_;
+  FileHandle* destination_;
+  const size_t chunk_size_;
+  const int parallelism_;
+
+  /** Guards all following members. */
+  boost::mutex mutex_;
+  int64_t source_offset_;
+  int64_t destination_offset_;
+  int64_t length_;
+  /** Index of the next chunk which is not yet processed by a worker. */
+  int64_t next_chunk_;
+  int64_t bytes_copied_;
+  /** Set by the first failed worker, the others stop then. */
+  bool failed_;
+  bool failed_with_posix_error_;
+  xtreemfs::pbrpc::POSIXErrno posix_errno_;
+  std::string error_message_;
+};
+
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_LIBXTREEMFS_FILE_COPIER_H_
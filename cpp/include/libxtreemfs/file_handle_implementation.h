@@ -180,6 +180,10 @@ class FileHandleImplementation
   /** Also used by FileInfo object to free active locks. */
   void ReleaseLock(const pbrpc::Lock& lock);
 
+  /** Releases "lock" at the OSD, even if released locks linger. Used by the
+   *  FileInfo object to free lingering locks and by the last close. */
+  void ReleaseLockAtOSD(const pbrpc::Lock& lock);
+
   virtual void ReleaseLockOfProcess(int process_id);
 
   virtual void PingReplica(const std::string& osd_uuid);
@@ -210,8 +214,9 @@ class FileHandleImplementation
   void WriteBackFileSize(const pbrpc::OSDWriteResponse& owr,
                          bool close_file);
 
-  /** Sends osd_write_response_for_async_write_back_ asynchronously. */
-  void WriteBackFileSizeAsync(const RPCOptions& options);
+  /** Sends osd_write_response_for_async_write_back_ asynchronously. If
+   *  "close_file" is true, the update also closes the file at the MRC. */
+  void WriteBackFileSizeAsync(const RPCOptions& options, bool close_file);
 
   /** Overwrites the current osd_write_response_ with "owr". */
   void set_osd_write_response_for_async_write_back(
@@ -303,6 +308,9 @@ class FileHandleImplementation
   /** Actual implementation of ReleaseLock(). */
   void DoReleaseLock(const pbrpc::Lock& lock);
 
+  /** Actual implementation of ReleaseLockAtOSD(). */
+  void DoReleaseLockAtOSD(const pbrpc::Lock& lock);
+
   /** Actual implementation of PingReplica(). */
   void DoPingReplica(const std::string& osd_uuid);
 
@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/optional.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
@@ -19,6 +20,7 @@
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "libxtreemfs/async_write_handler.h"
 #include "libxtreemfs/client_implementation.h"
@@ -76,6 +78,10 @@ class FileInfo {
   /** Deregisters a closed FileHandle. Called by FileHandle::Close(). */
   void CloseFileHandle(FileHandleImplementation* file_handle);
 
+  uint64_t file_id() const {
+    return file_id_;
+  }
+
   /** Decreases the reference count and returns the current value. */
   int DecreaseReferenceCount();
 
@@ -88,6 +94,9 @@ class FileInfo {
   /** Changes path_ to new_path if path_ == path. */
   void RenamePath(const std::string& path, const std::string& new_path);
 
+  /** Drops the XCaps of this file which the volume cached for re-opens. */
+  void InvalidateOpenCapabilities();
+
   /** Compares "response" against the current "osd_write_response_". Returns
    *  true if response is newer and assigns "response" to "osd_write_response_".
    *
@@ -114,7 +123,8 @@ class FileInfo {
   void ReleaseLockOfProcess(FileHandleImplementation* file_handle,
                             int process_id);
 
-  /** Uses file_handle to release all known local locks. */
+  /** Uses file_handle to release all known local locks, also the lingering
+   *  ones. */
   void ReleaseAllLocks(FileHandleImplementation* file_handle);
 
   /** Blocks until all asynchronous file size updates are completed. */
@@ -154,6 +164,51 @@ class FileInfo {
   /** Remove locks equal to "lock" from list of active locks. */
   void DelLock(const xtreemfs::pbrpc::Lock& lock);
 
+  /** Returns a number which changes whenever an active lock is removed. */
+  uint64_t active_locks_version();
+
+  /** Blocks until an active lock was removed after active_locks_version()
+   *  returned "version", at most for "timeout_ms". */
+  void WaitForActiveLocksChange(uint64_t version, int timeout_ms);
+
+  /** Moves the active lock of lock.client_pid() to the lingering locks: it
+   *  was released by its process, but is still held at the OSD until
+   *  "expires_at". Returns false if the process has no active lock. */
+  bool LingerLock(const xtreemfs::pbrpc::Lock& lock,
+                  const boost::posix_time::ptime& expires_at);
+
+  /** Makes the lingering lock of lock.client_pid() active again if it is
+   *  equal to "lock". Returns false if the lock has to be acquired at the
+   *  OSD. */
+  bool ReviveLingeringLock(const xtreemfs::pbrpc::Lock& lock);
+
+  /** Uses file_handle to release the lingering locks at the OSD which are in
+   *  the way of "lock": the ones of other processes which conflict with it
+   *  and the one of its own process. Waits for their release if another
+   *  thread already releases them. */
+  void DropLingeringLocks(FileHandleImplementation* file_handle,
+                          const xtreemfs::pbrpc::Lock& lock);
+
+  /** Selects the lingering locks which expired at "now" for
+   *  ReleaseExpiredLingeringLocks() and keeps the open file handle which will
+   *  release them from being closed. Sends no requests.
+   *
+   *  Returns false if there is nothing to release. Otherwise
+   *  ReleaseExpiredLingeringLocks() or CancelExpiredLingeringLocks() has to
+   *  be called.
+   *
+   *  @remark Requires a lock on the open_file_table_mutex_ of the volume, so
+   *          the file cannot be closed meanwhile. */
+  bool CollectExpiredLingeringLocks(const boost::posix_time::ptime& now);
+
+  /** Releases the locks selected by CollectExpiredLingeringLocks() at the
+   *  OSD. Locks whose release failed are kept and retried later. */
+  void ReleaseExpiredLingeringLocks();
+
+  /** Keeps the locks selected by CollectExpiredLingeringLocks() and lets the
+   *  file be closed again. */
+  void CancelExpiredLingeringLocks();
+
   /** Flushes pending async writes and file size updates. */
   void Flush(FileHandleImplementation* file_handle);
 
@@ -227,6 +282,11 @@ class FileInfo {
   /** See WaitForPendingFileSizeUpdates(). */
   void WaitForPendingFileSizeUpdatesHelper(boost::mutex::scoped_lock* lock);
 
+  /** Waits until the write back thread did pick up the dirty
+   *  osd_write_response_ or twice the coalescing delay has passed. Requires
+   *  osd_write_response_mutex_ to be locked by "lock". */
+  void WaitForScheduledFileSizeUpdateHelper(boost::mutex::scoped_lock* lock);
+
   /** Reference to Client which did open this volume. */
   ClientImplementation* client_;
 
@@ -276,7 +336,69 @@ class FileInfo {
    *  (client UUID, PID) tuple. */
   std::map<unsigned int, xtreemfs::pbrpc::Lock*> active_locks_;
 
-  /** Use this to protect active_locks_. */
+  /** A lock released by its process which is still held at the OSD. */
+  struct LingeringLock {
+    enum State {
+      kLingering,
+      /** Selected by CollectExpiredLingeringLocks(). */
+      kExpired,
+      /** A thread releases it at the OSD. */
+      kReleasing
+    };
+
+    xtreemfs::pbrpc::Lock* lock;
+    /** The lock is released at the OSD after this point in time. */
+    boost::posix_time::ptime expires_at;
+    State state;
+  };
+
+  /** Returns true if a lingering lock for which "drop" returns true is
+   *  selected or released by another thread. Requires a lock on
+   *  active_locks_mutex_. */
+  template<class Predicate>
+  bool IsReleasingLingeringLockUnmutexed(Predicate drop);
+
+  /** Marks the lingering locks for which "drop" returns true as kReleasing
+   *  and appends copies of them to "locks". Requires a lock on
+   *  active_locks_mutex_. */
+  template<class Predicate>
+  void CollectLingeringLocksUnmutexed(Predicate drop,
+                                      std::vector<xtreemfs::pbrpc::Lock>* locks);
+
+  /** Releases the collected "locks" at the OSD with file_handle without
+   *  holding active_locks_mutex_. A lock is removed from lingering_locks_
+   *  after its release succeeded, or after it failed if "forget_failed" is
+   *  true. Otherwise it lingers again. */
+  void ReleaseLingeringLocks(FileHandleImplementation* file_handle,
+                             const std::vector<xtreemfs::pbrpc::Lock>& locks,
+                             bool forget_failed);
+
+  /** Ends the release of the kReleasing lingering lock "lock". Requires a
+   *  lock on active_locks_mutex_. */
+  void FinishLingeringLockReleaseUnmutexed(const xtreemfs::pbrpc::Lock& lock,
+                                           bool released);
+
+  /** Locks which were released by their processes, but are still held at the
+   *  OSD (at most one per process). If a process acquires the same lock
+   *  again, no request has to be sent. */
+  std::map<unsigned int, LingeringLock> lingering_locks_;
+
+  /** Incremented whenever an active lock is removed. */
+  uint64_t active_locks_version_;
+
+  /** Notified whenever active_locks_version_ changes or the release of a
+   *  lingering lock ended. */
+  boost::condition active_locks_changed_;
+
+  /** Open file handle which releases the locks selected by
+   *  CollectExpiredLingeringLocks(). It is not closed until then. NULL if
+   *  none are selected. */
+  FileHandleImplementation* expired_locks_file_handle_;
+
+  /** Use this to protect active_locks_, lingering_locks_,
+   *  active_locks_version_ and expired_locks_file_handle_. Lingering locks
+   *  are released at the OSD without holding it. Until then they are marked,
+   *  and a lock request which they are in the way of waits for them. */
   boost::mutex active_locks_mutex_;
 
   /** Random UUID of this client to distinguish them while locking. */
@@ -313,11 +435,16 @@ class FileInfo {
   /** Denotes the state of the stored osd_write_response_ object. */
   FilesizeUpdateStatus osd_write_response_status_;
 
+  /** True while a Close() waits for the write back thread to send the pending
+   *  file size update. The update then closes the file at the MRC, too. */
+  bool close_file_pending_;
+
   /** XCap required to send an OSDWriteResponse to the MRC. */
   xtreemfs::pbrpc::XCap osd_write_response_xcap_;
 
   /** Always lock to access osd_write_response_, osd_write_response_status_,
-   *  osd_write_response_xcap_ or pending_filesize_updates_. */
+   *  close_file_pending_, osd_write_response_xcap_ or
+   *  pending_filesize_updates_. */
   boost::mutex osd_write_response_mutex_;
 
   /** Used by NotifyFileSizeUpdateCompletition() to notify waiting threads. */
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_LIBXTREEMFS_FILE_SIZE_UPDATE_QUEUE_H_
+#define CPP_INCLUDE_LIBXTREEMFS_FILE_SIZE_UPDATE_QUEUE_H_
+
+#include <stdint.h>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread_time.hpp>
+#include <set>
+#include <vector>
+
+namespace xtreemfs {
+
+/** Ids of the open files of a volume whose file size was not yet written back
+ *  to the MRC.
+ *
+ * Every file id is queued at most once, no matter how many write responses
+ * changed its size meanwhile. The file size write back thread only visits the
+ * queued files instead of the whole open file table.
+ *
+ * Files of which an update was requested by Flush() or Close() are "urgent":
+ * they are sent together after a short coalescing delay instead of at the next
+ * periodic run.
+ */
+class FileSizeUpdateQueue {
+ public:
+  /** Queues "file_id" for the next periodic run.
+   *
+   * @returns false if it was already queued. */
+  bool Add(uint64_t file_id);
+
+  /** Queues "file_id" for the next urgent run and wakes up WaitForUrgent().
+   *
+   * @returns false if it was already queued as urgent. */
+  bool AddUrgent(uint64_t file_id);
+
+  /** Blocks until urgent ids are queued or "deadline" has passed.
+   *
+   * @returns true if urgent ids are queued.
+   * @remark This is a boost::thread interruption point. */
+  bool WaitForUrgent(const boost::system_time& deadline);
+
+  /** Removes the urgent ids, or all ids if "all" is true, from the queue and
+   *  appends them to "file_ids". */
+  void Take(bool all, std::vector<uint64_t>* file_ids);
+
+  /** Returns the number of queued ids. */
+  size_t Size();
+
+ private:
+  /** Guards dirty_ and urgent_. */
+  boost::mutex mutex_;
+
+  /** Signaled if an id was added to urgent_. */
+  boost::condition_variable urgent_cond_;
+
+  /** All queued ids, including the urgent ones. */
+  std::set<uint64_t> dirty_;
+
+  /** Ids which shall be sent before the next periodic run. */
+  std::set<uint64_t> urgent_;
+};
+
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_LIBXTREEMFS_FILE_SIZE_UPDATE_QUEUE_H_
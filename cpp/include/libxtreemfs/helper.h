@@ -92,7 +92,8 @@ bool CheckIfLocksDoConflict(const xtreemfs::pbrpc::Lock& lock1,
 /** Tests if string is a numeric (positive) value. */
 bool CheckIfUnsignedInteger(const std::string& string);
 
-/** Adapter to create RPCOptions from an Options object */
+/** Adapter to create RPCOptions from an Options object. The deadline of
+ *  Options::operation_timeout_s starts now, i.e. use them for one operation. */
 RPCOptions RPCOptionsFromOptions(const Options& options);
 
 #ifdef __APPLE__
@@ -9,6 +9,7 @@
 #define CPP_INCLUDE_LIBXTREEMFS_METADATA_CACHE_H_
 
 #include <stdint.h>
+#include <time.h>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
@@ -16,6 +17,9 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/thread/mutex.hpp>
+#include <list>
+#include <map>
+#include <set>
 #include <string>
 
 #include "libxtreemfs/metadata_cache_entry.h"
@@ -27,6 +31,8 @@ namespace pbrpc {
 class OSDWriteResponse;
 }
 
+class PersistentMetadataCache;
+
 class MetadataCache {
  public:
   enum GetStatResult { kStatCached, kPathDoesntExist, kStatNotCached };
@@ -62,11 +68,41 @@ class MetadataCache {
   typedef Cache::index<IndexMap>::type by_map;
   typedef Cache::index<IndexHash>::type by_hash;
 
+  /** Returns the current time in seconds. */
+  typedef time_t (*Clock)();
+
   MetadataCache(uint64_t size, uint64_t ttl_s);
 
+  /** Additionally remembers up to "negative_size" paths which do not exist
+   *  for "negative_ttl_s" seconds. */
+  MetadataCache(uint64_t size,
+                uint64_t ttl_s,
+                uint64_t negative_size,
+                uint64_t negative_ttl_s);
+
   /** Frees all MetadataCacheEntry objects. */
   ~MetadataCache();
 
+  /** Lets the entries expire according to "clock" instead of time(). */
+  void SetClock(Clock clock);
+
+  /** Misses are looked up in "persistent_cache" and Update{Stat,DirEntries,
+   *  XAttrs}() also store the results there. Use it only for volumes whose
+   *  metadata does not change.
+   *
+   * @remark Ownership is not transferred. NULL disables it.
+   */
+  void SetPersistentCache(PersistentMetadataCache* persistent_cache);
+
+  /** Answers lookups of "security.*" and "system.posix_acl_*" attributes which
+   *  were missing in the xattr list of a path for "xattr_negative_ttl_s"
+   *  seconds after the list was fetched, even if the list itself expired.
+   *  Every "ls -l" asks for them and they rarely exist.
+   *
+   * @remark Has no effect if "xattr_negative_ttl_s" is not greater than the
+   *         TTL of the cache. */
+  void SetXAttrNegativeTtl(uint64_t xattr_negative_ttl_s);
+
   /** Removes MetadataCacheEntry for path from cache_. */
   void Invalidate(const std::string& path);
 
@@ -76,9 +112,23 @@ class MetadataCache {
   /** Renames path to new_path and any object's path matching path+"/". */
   void RenamePrefix(const std::string& path, const std::string& new_path);
 
-  /** Returns true if there is a Stat object for path in cache and fills stat.*/
+  /** Returns true if there is a Stat object for path in cache and fills stat.
+   *
+   *  kPathDoesntExist is returned for paths stored by UpdateNonExistent() or
+   *  which are missing in the cached listing of their parent directory. */
   GetStatResult GetStat(const std::string& path, xtreemfs::pbrpc::Stat* stat);
 
+  /** Remembers that "path" does not exist, e.g., after the MRC returned
+   *  ENOENT for it. */
+  void UpdateNonExistent(const std::string& path);
+
+  /** Forgets that "path" or paths below it did not exist, e.g., after "path"
+   *  was created. */
+  void InvalidateNonExistent(const std::string& path);
+
+  /** Returns the current number of paths known not to exist. */
+  uint64_t NonExistentSize();
+
   /** Stores/updates stat in cache for path. */
   void UpdateStat(const std::string& path, const xtreemfs::pbrpc::Stat& stat);
 
@@ -169,6 +219,10 @@ class MetadataCache {
   /** Removes "name" from the list of extended attributes cached for "path". */
   void InvalidateXAttr(const std::string& path, const std::string& name);
 
+  /** Returns true if the list of extended attributes of "path" is cached and
+   *  not expired. */
+  bool HasXAttrs(const std::string& path);
+
   /** Remove cached XAttrs in cache for path. */
   void InvalidateXAttrs(const std::string& path);
 
@@ -179,18 +233,144 @@ class MetadataCache {
   uint64_t Capacity() { return size_; }
 
  private:
+  static time_t SystemClock();
+
+  struct NonExistentEntry {
+    uint64_t timeout_s;
+    /** Position of the path in non_existent_order_. */
+    std::list<std::string>::iterator position;
+  };
+
+  typedef std::map<std::string, NonExistentEntry> NonExistentMap;
+
+  GetStatResult GetStatFromMemory(const std::string& path,
+                                  xtreemfs::pbrpc::Stat* stat);
+
+  xtreemfs::pbrpc::DirectoryEntries* GetDirEntriesFromMemory(
+      const std::string& path,
+      uint64_t offset,
+      uint32_t count);
+
+  bool GetXAttrFromMemory(const std::string& path,
+                          const std::string& name,
+                          std::string* value,
+                          bool* xattrs_cached);
+
+  bool GetXAttrSizeFromMemory(const std::string& path,
+                              const std::string& name,
+                              int* size,
+                              bool* xattrs_cached);
+
+  xtreemfs::pbrpc::listxattrResponse* GetXAttrsFromMemory(
+      const std::string& path);
+
+  /** Copies the xattrs of "path" from persistent_cache_ into cache_.
+   *
+   * @returns false if they are not stored there. */
+  bool LoadXAttrsFromPersistentCache(const std::string& path);
+
+  /** Returns true if the absence of the attribute "name" may be answered by
+   *  an expired xattr list, see SetXAttrNegativeTtl(). */
+  static bool IsNegativelyCachedXAttr(const std::string& name);
+
+  /** Returns true if "name" is not in the expired xattrs of "cache_entry"
+   *  and their negative TTL is not reached yet. */
+  bool IsXAttrKnownMissingUnmutexed(const MetadataCacheEntry& cache_entry,
+                                    const std::string& name,
+                                    uint64_t current_time_s);
+
+  /** Entries below "path" which are older than "generation" are invalid. */
+  struct InvalidatedPrefix {
+    std::string path;
+    uint64_t generation;
+  };
+
+  /** Returns the entry of "path" like by_hash::find(). Entries which were
+   *  invalidated lazily are removed first. */
+  by_hash::iterator FindUnmutexed(const std::string& path);
+
+  /** Returns true if "entry" is covered by an InvalidatedPrefix. Looks up
+   *  the path and its parent directories in invalidated_generations_. */
+  bool IsInvalidatedUnmutexed(const MetadataCacheEntry& entry);
+
+  /** Returns true if at most kMaxEagerlyChangedEntries paths start with
+   *  "prefix". */
+  bool IsSmallSubtreeUnmutexed(const std::string& prefix);
+
+  /** Invalidates all entries below "path" without touching them. They are
+   *  removed by FindUnmutexed(), CollectInvalidatedUnmutexed() or when they
+   *  get evicted. */
+  void InvalidateLazilyUnmutexed(const std::string& path);
+
+  /** Removes up to "n" entries of the oldest lazily invalidated prefix. */
+  void CollectInvalidatedUnmutexed(int n);
+
+  /** Returns the copy of "name" in owner_names_, which stays valid as long as
+   *  the MetadataCache exists. */
+  const std::string* InternOwnerNameUnmutexed(const std::string& name);
+
   /** Evicts first n oldest entries from cache_. */
   void EvictUnmutexed(int n);
 
+  /** Adds "path" to non_existent_ until "timeout_s". */
+  void AddNonExistentUnmutexed(const std::string& path, uint64_t timeout_s);
+
+  /** Removes "path" and all paths below it from non_existent_. */
+  void InvalidateNonExistentUnmutexed(const std::string& path);
+
+  void EraseNonExistentUnmutexed(NonExistentMap::iterator it);
+
   bool enabled;
 
   uint64_t size_;
 
   uint64_t ttl_s_;
 
+  /** True if negative_size_ and negative_ttl_s_ are greater than zero. */
+  bool negative_enabled_;
+
+  uint64_t negative_size_;
+
+  uint64_t negative_ttl_s_;
+
+  /** Time to live of missing "security.*" and "system.posix_acl_*" attributes,
+   *  counted from the fetch of the xattr list. 0 if disabled. */
+  uint64_t xattr_negative_ttl_s_;
+
+  /** Not owned, may be NULL. */
+  PersistentMetadataCache* persistent_cache_;
+
+  Clock clock_;
+
   boost::mutex mutex_;
 
   Cache cache_;
+
+  /** Incremented for every lazily invalidated prefix. New entries get the
+   *  current value. */
+  uint64_t generation_;
+
+  /** Lazily invalidated prefixes whose entries were not removed yet, oldest
+   *  first. */
+  std::list<InvalidatedPrefix> invalidated_prefixes_;
+
+  /** Newest generation of the paths in invalidated_prefixes_, so that a
+   *  lookup does not depend on the number of invalidated prefixes. */
+  std::map<std::string, uint64_t> invalidated_generations_;
+
+  /** Path at which CollectInvalidatedUnmutexed() continues below the first
+   *  element of invalidated_prefixes_. Empty at the start. */
+  std::string collect_position_;
+
+  /** User and group names of all cached stat entries. Never shrinks, the
+   *  number of different owners is small compared to the number of files. */
+  std::set<std::string> owner_names_;
+
+  /** Paths which do not exist, sorted for InvalidateNonExistent(). */
+  NonExistentMap non_existent_;
+
+  /** Paths of non_existent_, oldest first. */
+  std::list<std::string> non_existent_order_;
 };
 
 }  // namespace xtreemfs
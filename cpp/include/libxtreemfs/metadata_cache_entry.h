@@ -11,6 +11,7 @@
 #include <stdint.h>
 
 #include <string>
+#include <vector>
 
 namespace xtreemfs {
 
@@ -20,6 +21,54 @@ class Stat;
 class listxattrResponse;
 }
 
+/** Copy of a pbrpc::Stat object which does not allocate any memory.
+ *
+ * The owner names are not copied, they point to strings interned by the
+ * MetadataCache instead. */
+struct CachedStat {
+  /** Copies all attributes except for the owner names. */
+  void CopyFrom(const xtreemfs::pbrpc::Stat& stat);
+
+  void CopyTo(xtreemfs::pbrpc::Stat* stat) const;
+
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t size;
+  uint64_t atime_ns;
+  uint64_t mtime_ns;
+  uint64_t ctime_ns;
+  uint64_t etag;
+  uint32_t mode;
+  uint32_t nlink;
+  uint32_t blksize;
+  uint32_t truncate_epoch;
+  uint32_t attributes;
+  bool has_etag;
+  bool has_attributes;
+  const std::string* user_id;
+  const std::string* group_id;
+};
+
+/** Serialized pbrpc::DirectoryEntries. The wire format takes only a third of
+ *  the memory of the parsed objects.
+ *
+ * The start of every entry is recorded, so a part of the listing can be
+ * parsed without looking at the rest. */
+struct CachedDirEntries {
+  void CopyFrom(const xtreemfs::pbrpc::DirectoryEntries& dir_entries);
+
+  /** Returns the entries [begin, end) in the wire format of a
+   *  pbrpc::DirectoryEntries message. */
+  std::string Slice(int begin, int end) const;
+
+  int size() const {
+    return static_cast<int>(offsets.size());
+  }
+
+  std::string serialized;
+  std::vector<uint32_t> offsets;
+};
+
 class MetadataCacheEntry {
  public:
   MetadataCacheEntry();
@@ -27,10 +76,16 @@ class MetadataCacheEntry {
 
   std::string path;
 
-  xtreemfs::pbrpc::DirectoryEntries* dir_entries;
+  /** MetadataCache generation at the time the entry was created. */
+  uint64_t generation;
+
+  /** NULL if not cached. */
+  CachedDirEntries* dir_entries;
   uint64_t dir_entries_timeout_s;
 
-  xtreemfs::pbrpc::Stat* stat;
+  /** Only valid if has_stat is true. */
+  CachedStat stat;
+  bool has_stat;
   uint64_t stat_timeout_s;
 
   xtreemfs::pbrpc::listxattrResponse* xattrs;
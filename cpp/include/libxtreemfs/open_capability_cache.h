@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_LIBXTREEMFS_OPEN_CAPABILITY_CACHE_H_
+#define CPP_INCLUDE_LIBXTREEMFS_OPEN_CAPABILITY_CACHE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "pbrpc/RPC.pb.h"
+#include "xtreemfs/GlobalTypes.pb.h"
+
+namespace xtreemfs {
+
+/** Keeps the XCap and XLocSet returned by the MRC for an open() of a path
+ *  with specific flags and credentials, so that a re-open of the same file
+ *  does not have to ask the MRC again.
+ *
+ * Entries expire after "ttl_s", but at the latest after half of the XCap's
+ * lifetime. Thus a FileHandle created from a cached XCap is still renewed by
+ * the periodic XCap renewal in time.
+ *
+ * Opens which change the file at the MRC (O_TRUNC, O_EXCL) and files which
+ * are replicated on close are never cached. All operations which change the
+ * path, permissions or replicas of a file have to call Invalidate().
+ */
+class OpenCapabilityCache {
+ public:
+  OpenCapabilityCache(uint64_t size, uint64_t ttl_s);
+
+  /** Returns true if open()s with "flags" may be answered from the cache. */
+  static bool IsCacheable(xtreemfs::pbrpc::SYSTEM_V_FCNTL flags);
+
+  /** Stores the result of an open() at the MRC. Ignored for non-cacheable
+   *  flags or files which are replicated on close. */
+  void Put(const std::string& path,
+           xtreemfs::pbrpc::SYSTEM_V_FCNTL flags,
+           const xtreemfs::pbrpc::UserCredentials& user_credentials,
+           const xtreemfs::pbrpc::FileCredentials& file_credentials);
+
+  /** Copies the cached XCap and XLocSet into "file_credentials".
+   *
+   * @returns false if there is no valid entry. */
+  bool Get(const std::string& path,
+           xtreemfs::pbrpc::SYSTEM_V_FCNTL flags,
+           const xtreemfs::pbrpc::UserCredentials& user_credentials,
+           xtreemfs::pbrpc::FileCredentials* file_credentials);
+
+  /** Removes the entries of "path" and of all paths below it. */
+  void Invalidate(const std::string& path);
+
+  uint64_t Size();
+
+ private:
+  struct Key {
+    std::string path;
+    xtreemfs::pbrpc::SYSTEM_V_FCNTL flags;
+    std::string username;
+    std::vector<std::string> groups;
+
+    bool operator<(const Key& other) const;
+  };
+
+  struct Entry {
+    xtreemfs::pbrpc::FileCredentials file_credentials;
+    time_t expiration_time;
+    /** Position of the key in insertion_order_. */
+    std::list<Key>::iterator position;
+  };
+
+  typedef std::map<Key, Entry> EntryMap;
+
+  static Key MakeKey(const std::string& path,
+                     xtreemfs::pbrpc::SYSTEM_V_FCNTL flags,
+                     const xtreemfs::pbrpc::UserCredentials& user_credentials);
+
+  void EraseUnmutexed(EntryMap::iterator it);
+
+  const uint64_t size_;
+  const uint64_t ttl_s_;
+
+  boost::mutex mutex_;
+  /** Entries sorted by path first, so that Invalidate() finds all entries
+   *  below a directory in one range. */
+  EntryMap entries_;
+  /** Keys of entries_, oldest first. */
+  std::list<Key> insertion_order_;
+};
+
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_LIBXTREEMFS_OPEN_CAPABILITY_CACHE_H_
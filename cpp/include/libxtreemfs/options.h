@@ -23,7 +23,10 @@
 namespace xtreemfs {
 
 namespace rpc {
+class Client;
 class SSLOptions;
+struct TransportProfile;
+class TransportProfiles;
 }  // namespace rpc
 
 enum XtreemFSServiceType {
@@ -94,6 +97,21 @@ class Options {
    */
   xtreemfs::rpc::SSLOptions* GenerateSSLOptions() const;
 
+  /** Sets the request timeouts of rpc_proc_timeouts at "client".
+   *
+   * @throws InvalidCommandLineParametersException */
+  void SetRPCProcTimeouts(xtreemfs::rpc::Client* client) const;
+
+  /** Sets "profile" to the socket options of all servers without an entry in
+   *  rpc_transport_profiles. */
+  void GetDefaultTransportProfile(xtreemfs::rpc::TransportProfile* profile)
+      const;
+
+  /** Adds the entries of rpc_transport_profiles to "profiles".
+   *
+   * @throws InvalidCommandLineParametersException */
+  void SetTransportProfiles(xtreemfs::rpc::TransportProfiles* profiles) const;
+
   // Version information.
   std::string version_string;
 
@@ -136,6 +154,20 @@ class Options {
   uint64_t metadata_cache_size;
   /** Time to live for MetadataCache entries. */
   uint64_t metadata_cache_ttl_s;
+  /** Maximum number of non-existent paths remembered by the MetadataCache. */
+  uint64_t metadata_cache_negative_size;
+  /** Time to live for non-existent paths (0 disables them). */
+  uint64_t metadata_cache_negative_ttl_s;
+  /** Time to live for missing "security.*" and "system.posix_acl_*" xattrs
+   *  (0 disables them). */
+  uint64_t metadata_cache_xattr_negative_ttl_s;
+  /** Directory of the on-disk metadata caches of snapshots (empty disables
+   *  them). Has to be owned by the user and not be writable by others. */
+  std::string metadata_cache_persistent_dir;
+  /** Maximum number of XCaps kept for re-opening files. */
+  uint64_t open_capability_cache_size;
+  /** Time to live for cached XCaps (0 disables the cache). */
+  uint64_t open_capability_cache_ttl_s;
   /** Enable asynchronous writes */
   bool enable_async_writes;
   /** Maximum number of pending async write requests per file. */
@@ -143,10 +175,21 @@ class Options {
   /** Maximum write request size per async write. Should be equal to the lowest
    *  upper bound in the system (e.g. an object size, or the FUSE limit). */
   int async_writes_max_request_size_kb;
+  /** Maximum size of the pending async writes of all files in MB (0 means no
+   *  limit besides async_writes_max_requests per file). */
+  int async_writes_max_client_buffer_mb;
+  /** Number of threads which process the responses of async writes. The
+   *  responses of a file are always processed by the same thread. */
+  int async_writes_callback_threads;
   /** Number of retrieved entries per readdir request. */
   int readdir_chunk_size;
+  /** Maximum number of entries of a complete readdir whose xattrs are
+   *  fetched into the metadata cache (0 disables it). */
+  int readdir_prefetch_xattrs;
   /** True, if atime requests are enabled in Fuse/not ignored by the library. */
   bool enable_atime;
+  /** Maximum number of objects in flight while copying a file. */
+  int copy_parallel_requests;
 
   // Error Handling options.
   /** How often shall a failed operation get retried? */
@@ -163,6 +206,10 @@ class Options {
   int32_t connect_timeout_s;
   /** Maximum time until a request will be aborted and the response returned. */
   int32_t request_timeout_s;
+  /** Maximum time of a synchronous operation including all of its retries
+   *  (0 means no limit). No request of it outlives this deadline. Reads and
+   *  writes of file data are limited by max_read_tries/max_write_tries only. */
+  int32_t operation_timeout_s;
   /** The RPC Client closes connections after "linger_timeout_s" time of
    *  inactivity. */
   int32_t linger_timeout_s;
@@ -187,6 +234,10 @@ class Options {
   
   /** SSL version that this client should accept. */
   std::string ssl_method_string;
+
+  /** True if the kernel shall encrypt the data after the handshake
+   *  (Linux kernel TLS), if supported. */
+  bool ssl_kernel_tls;
 #endif  // HAS_OPENSSL
 
   // Grid Support options.
@@ -228,10 +279,52 @@ class Options {
   // Advanced XtreemFS options.
   /** Interval for periodic file size updates in seconds. */
   int periodic_file_size_updates_interval_s;
+  /** Delay in ms during which file size updates requested by Flush() and
+   *  Close() are collected and sent together (0 sends them synchronously). */
+  int file_size_update_coalescing_ms;
   /** Interval for periodic xcap renewal in seconds. */
   int periodic_xcap_renewal_interval_s;
+  /** Maximum age in seconds of the address map snapshot which is stored next
+   *  to vivaldi_filename and used at startup instead of asking the DIR
+   *  (0 disables the snapshot). */
+  int address_map_snapshot_max_age_s;
   /** Skewness of the Zipf distribution used for vivaldi OSD selection */
   double vivaldi_zipf_generator_skew;
+  /** Number of RPC events kept in the request trace (0 disables tracing). */
+  int rpc_trace_buffer_size;
+  /** Time in microseconds a small request waits for further requests to the
+   *  same server which are sent together with it (0 disables it). */
+  int rpc_write_coalescing_us;
+  /** Request timeouts of single operations as
+   *  "<interface id>:<proc id>:<timeout in ms>". */
+  std::vector<std::string> rpc_proc_timeouts;
+  /** Do not disable Nagle's algorithm on connections (TCP_NODELAY). */
+  bool rpc_disable_tcp_nodelay;
+  /** Idle time in seconds before TCP keepalive probes are sent (0 disables
+   *  keepalive). */
+  int rpc_tcp_keepalive_s;
+  /** Time in microseconds a receive busy-polls the device (0 disables it). */
+  int rpc_busy_poll_us;
+  /** Size of the socket send and receive buffers in kB (0 lets the OS size
+   *  them, unless rpc_link_bandwidth_mbit is set). */
+  int rpc_socket_buffer_kb;
+  /** Bandwidth of the links to the servers in Mbit/s. If set, the socket
+   *  buffers are sized from it and the RTT to the server. */
+  int rpc_link_bandwidth_mbit;
+  /** Socket options of single servers as
+   *  "<host>[:<port>][,<key>=<value>]...". */
+  std::vector<std::string> rpc_transport_profiles;
+  /** Connect to the OSDs of all replicas of a file when it is opened and
+   *  not open yet. */
+  bool rpc_prewarm_osd_connections;
+  /** Read and write plain TCP connections through io_uring (Linux only). */
+  bool rpc_io_uring;
+  /** First delay in ms before a blocking lock request is retried after a
+   *  conflict. The delay doubles with every conflict up to one second. */
+  int lock_wait_min_delay_ms;
+  /** Time in ms a lock released by its process is still held at the OSD, so
+   *  the process can acquire it again without a request (0 disables it). */
+  int lock_cache_lease_ms;
 
   /** May contain all previous options in key=value pair lists. */
   std::vector<std::string> alternative_options_list;
@@ -250,6 +343,22 @@ class Options {
   /** Reads password from stdin and stores it in 'password'. */
   void ReadPasswordFromStdin(const std::string& msg, std::string* password);
 
+  /** Parses an entry of rpc_proc_timeouts.
+   *
+   * @throws InvalidCommandLineParametersException */
+  static void ParseRPCProcTimeout(const std::string& entry,
+                                  uint32_t* interface_id,
+                                  uint32_t* proc_id,
+                                  int32_t* timeout_ms);
+
+  /** Parses an entry of rpc_transport_profiles with the default profile as
+   *  base.
+   *
+   * @throws InvalidCommandLineParametersException */
+  void ParseTransportProfile(const std::string& entry,
+                             std::string* address,
+                             xtreemfs::rpc::TransportProfile* profile) const;
+
   /** This functor template can be used as argument for the notifier() method
    *  of boost::options. It is specifically used to create a warning whenever
    *  a deprecated option is used, but is not limited to that purpose.
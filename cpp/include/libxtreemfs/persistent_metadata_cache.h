@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_LIBXTREEMFS_PERSISTENT_METADATA_CACHE_H_
+#define CPP_INCLUDE_LIBXTREEMFS_PERSISTENT_METADATA_CACHE_H_
+
+#include <stdint.h>
+
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "xtreemfs/MRC.pb.h"
+
+namespace google {
+namespace protobuf {
+class Message;
+}  // namespace protobuf
+}  // namespace google
+
+namespace xtreemfs {
+
+/** On-disk copy of the stat, readdir and xattr results of a volume whose
+ *  metadata never changes, i.e., of a snapshot.
+ *
+ * The file is append-only: every record holds the path, the kind of the
+ * result and the result as serialized protobuf message. At Open() the
+ * existing records are memory-mapped and indexed by path, records added
+ * later are appended to the end of the file. An existing path is never
+ * stored twice. Multiple clients may use the same file at the same time.
+ *
+ * The file header contains a validity token which identifies the state of the
+ * volume. If it differs from the one passed to Open(), the file is replaced
+ * by an empty one.
+ */
+class PersistentMetadataCache {
+ public:
+  PersistentMetadataCache();
+
+  /** Calls Close(). */
+  ~PersistentMetadataCache();
+
+  /** Opens or creates the file "path" for the volume state "validity_token".
+   *  The file is only accessible by its owner. A directory which belongs to
+   *  another user or which other users can write to is refused.
+   *
+   * @returns false if the file could not be opened or created. */
+  bool Open(const std::string& path, const std::string& validity_token);
+
+  void Close();
+
+  bool GetStat(const std::string& path, xtreemfs::pbrpc::Stat* stat);
+
+  bool GetDirEntries(const std::string& path,
+                     xtreemfs::pbrpc::DirectoryEntries* dir_entries);
+
+  bool GetXAttrs(const std::string& path,
+                 xtreemfs::pbrpc::listxattrResponse* xattrs);
+
+  void PutStat(const std::string& path, const xtreemfs::pbrpc::Stat& stat);
+
+  void PutDirEntries(const std::string& path,
+                     const xtreemfs::pbrpc::DirectoryEntries& dir_entries);
+
+  void PutXAttrs(const std::string& path,
+                 const xtreemfs::pbrpc::listxattrResponse& xattrs);
+
+  /** Returns the number of indexed records. */
+  uint64_t Size();
+
+ private:
+  enum RecordType { kStat = 1, kDirEntries = 2, kXAttrs = 3 };
+
+  /** Position of a serialized message in the file. */
+  struct Location {
+    uint64_t offset;
+    uint32_t length;
+  };
+
+  typedef std::map<std::pair<int, std::string>, Location> Index;
+
+  /** Writes an empty file with the header for "validity_token" to "path". */
+  static bool CreateFile(const std::string& path,
+                         const std::string& validity_token);
+
+  /** Reads the header and indexes all records of the mapped file.
+   *
+   * @returns false if the header does not match "validity_token". */
+  bool ReadFileUnmutexed(const std::string& validity_token,
+                         uint64_t* valid_length);
+
+  void CloseUnmutexed();
+
+  bool Get(RecordType type,
+           const std::string& path,
+           google::protobuf::Message* message);
+
+  void Put(RecordType type,
+           const std::string& path,
+           const google::protobuf::Message& message);
+
+  boost::mutex mutex_;
+
+  /** -1 if not opened. */
+  int fd_;
+
+  /** The file as it was at Open(). */
+  const char* mapped_;
+
+  uint64_t mapped_length_;
+
+  /** End of the complete records in mapped_. Records behind it were appended
+   *  after Open() and are read with pread(). */
+  uint64_t mapped_records_end_;
+
+  Index index_;
+};
+
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_LIBXTREEMFS_PERSISTENT_METADATA_CACHE_H_
@@ -10,10 +10,14 @@
 
 #ifndef WIN32
 
+#include <stdint.h>
+#include <sys/types.h>
+
 #include <list>
 #include <string>
 
 #include "libxtreemfs/system_user_mapping.h"
+#include "util/ttl_cache.h"
 
 namespace xtreemfs {
 
@@ -37,6 +41,30 @@ class SystemUserMappingUnix : public SystemUserMapping {
                              pid_t pid,
                              std::list<std::string>* groupnames);
 
+  /** Returns the start time of process "pid" (in clock ticks since boot) or 0
+   *  if it is not known. Together with the pid, it identifies a process
+   *  even if its pid was reused. */
+  static uint64_t GetProcessStartTime(pid_t pid);
+
+  /** Caches up to "max_entries" results of each of the four name lookups for
+   *  "ttl_s" seconds, so that the name service (e.g., LDAP) is not queried
+   *  for every request. 0 disables the caches (default).
+   *
+   * @attention Not thread-safe, call before the mapping is used.
+   */
+  void SetCacheLimits(size_t max_entries, int ttl_s);
+
+  /** Sum of hits of the name caches. */
+  uint64_t cache_hits();
+
+  /** Sum of misses of the name caches. */
+  uint64_t cache_misses();
+
+ private:
+  util::TTLCache<uid_t, std::string> username_cache_;
+  util::TTLCache<std::string, uid_t> uid_cache_;
+  util::TTLCache<gid_t, std::string> groupname_cache_;
+  util::TTLCache<std::string, gid_t> gid_cache_;
 };
 
 }  // namespace xtreemfs
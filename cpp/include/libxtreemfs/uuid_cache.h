@@ -8,32 +8,70 @@
 #define CPP_INCLUDE_LIBXTREEMFS_UUID_CACHE_H_
 
 #include <stdint.h>
+#include <time.h>
 
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include <map>
+#include <set>
 #include <string>
 
 namespace xtreemfs {
 
 class UUIDCache {
  public:
+  /** Returns the current time in seconds. */
+  typedef time_t (*Clock)();
+
+  UUIDCache();
+
+  /** Uses "clock" instead of time(), e.g., to let tests control expiry. */
+  explicit UUIDCache(Clock clock);
 
   void update(const std::string& uuid, const std::string& address,
       const uint32_t port, const time_t timeout);
 
   std::string get(const std::string& uuid);
 
+  /** Same as get(). Additionally, if "refresh" is not NULL, it is set to true
+   *  if the entry is about to expire and the caller has to refresh it in the
+   *  background. Only one caller is asked to refresh an entry. */
+  std::string get(const std::string& uuid, bool* refresh);
+
+  /** Allows to abort a refresh requested by get(). The next get() will
+   *  request it again. */
+  void CancelRefresh(const std::string& uuid);
+
+  /** Lets only one thread at a time look up a missing entry. Returns true if
+   *  the caller has to look up "uuid" and call EndLookup() afterwards.
+   *  Otherwise it waits until the running lookup is finished and returns
+   *  false; the caller should check the cache again then. */
+  bool BeginLookup(const std::string& uuid);
+
+  /** Wakes up the threads which wait in BeginLookup() for "uuid". */
+  void EndLookup(const std::string& uuid);
+
  private:
+  static time_t SystemClock();
+
   struct UUIDMapping {
     std::string uuid;
     std::string address;
     uint32_t port;
     time_t timeout;
+    /** After this point in time, get() requests a refresh. */
+    time_t refresh_time;
+    /** True if a refresh was requested and not yet finished. */
+    bool refresh_pending;
   };
 
   std::map<std::string, UUIDMapping > cache_;
+  /** UUIDs of running lookups, see BeginLookup(). */
+  std::set<std::string> lookups_;
+  boost::condition_variable lookup_finished_;
   boost::mutex mutex_;
+  Clock clock_;
 };
 
 }  // namespace xtreemfs
@@ -18,6 +18,7 @@
 #include "libxtreemfs/options.h"
 #include "libxtreemfs/simple_uuid_iterator.h"
 #include "libxtreemfs/vivaldi_node.h"
+#include "xtreemfs/DIR.pb.h"
 #include "xtreemfs/GlobalTypes.pb.h"
 
 namespace xtreemfs {
@@ -79,10 +80,24 @@ class Vivaldi {
 
   const xtreemfs::pbrpc::VivaldiCoordinates& GetVivaldiCoordinates() const;
 
+  /** Lets Run() use "services" as list of OSDs until it asks the DIR for the
+   *  first time, i.e., after vivaldi_max_iterations_before_updating. Has to
+   *  be called before Run(). */
+  void SetOSDServices(const pbrpc::ServiceSet& services);
+
+  /** Copies the OSDs which were received from the DIR last. */
+  void GetOSDServices(pbrpc::ServiceSet* services) const;
+
  private:
   bool UpdateKnownOSDs(std::list<KnownOSD>* updated_osds,
                        const VivaldiNode& own_node);
 
+  /** Replaces "updated_osds" by the online OSDs in "received_osds" which have
+   *  coordinates, sorted by their distance to "own_node". */
+  void FillKnownOSDs(const pbrpc::ServiceSet& received_osds,
+                     std::list<KnownOSD>* updated_osds,
+                     const VivaldiNode& own_node);
+
   boost::scoped_ptr<pbrpc::DIRServiceClient> dir_client_;
   boost::scoped_ptr<pbrpc::OSDServiceClient> osd_client_;
   SimpleUUIDIterator& dir_uuid_iterator_;
@@ -115,6 +130,12 @@ class Vivaldi {
   mutable boost::mutex coordinate_mutex_;
 
   pbrpc::VivaldiCoordinates my_vivaldi_coordinates_;
+
+  /** Guards osd_services_. */
+  mutable boost::mutex osd_services_mutex_;
+
+  /** OSDs received from the DIR last or set by SetOSDServices(). */
+  pbrpc::ServiceSet osd_services_;
 };
 
 }  // namespace xtreemfs
@@ -271,6 +271,28 @@ class Volume {
       const std::string& path,
       const std::string& new_path) = 0;
 
+  /** Copies the content of the file "path" to "new_path". "new_path" is
+   *  created with the permissions of "path" or truncated if it exists. If
+   *  both paths refer to the same file, POSIX_ERROR_EINVAL is thrown and the
+   *  file is left untouched.
+   *
+   * The objects are transferred by the client, with up to
+   * Options::copy_parallel_requests objects read and written in parallel.
+   *
+   * @param user_credentials    Name and Groups of the user.
+   * @param path                File to be copied.
+   * @param new_path            Path of the copy.
+   *
+   * @throws AddressToUUIDNotFoundException
+   * @throws IOException
+   * @throws PosixErrorException
+   * @throws UnknownAddressSchemeException
+   */
+  virtual void CopyFile(
+      const xtreemfs::pbrpc::UserCredentials& user_credentials,
+      const std::string& path,
+      const std::string& new_path) = 0;
+
   /** Creates a directory with the modes "mode".
    *
    * @param user_credentials    Name and Groups of the user.
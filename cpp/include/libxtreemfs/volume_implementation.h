@@ -18,10 +18,14 @@
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "libxtreemfs/execute_sync_request.h"
+#include "libxtreemfs/file_size_update_queue.h"
 #include "libxtreemfs/metadata_cache.h"
+#include "libxtreemfs/open_capability_cache.h"
 #include "libxtreemfs/options.h"
+#include "libxtreemfs/persistent_metadata_cache.h"
 #include "libxtreemfs/uuid_iterator.h"
 #include "rpc/sync_callback.h"
 
@@ -159,6 +163,11 @@ class VolumeImplementation : public Volume {
       const std::string& path,
       const std::string& new_path);
 
+  virtual void CopyFile(
+      const xtreemfs::pbrpc::UserCredentials& user_credentials,
+      const std::string& path,
+      const std::string& new_path);
+
   virtual void MakeDirectory(
       const xtreemfs::pbrpc::UserCredentials& user_credentials,
       const std::string& path,
@@ -276,6 +285,20 @@ class VolumeImplementation : public Volume {
     return volume_options_;
   }
 
+  /** Queues the file size update of "file_id" for the next run of the
+   *  periodic file size write back. */
+  void ScheduleFileSizeUpdate(uint64_t file_id);
+
+  /** Drops the cached XCaps of "path" and below it, e.g., because a truncate
+   *  of an open file outdated their truncate epoch. */
+  void InvalidateOpenCapabilities(const std::string& path);
+
+  /** Queues the file size update of "file_id" to be sent together with the
+   *  other urgent updates after the coalescing delay.
+   *
+   * @returns false if coalescing is disabled. */
+  bool ScheduleUrgentFileSizeUpdate(uint64_t file_id);
+
   const xtreemfs::pbrpc::Auth& auth_bogus() {
     return auth_bogus_;
   }
@@ -301,6 +324,22 @@ class VolumeImplementation : public Volume {
                      bool ignore_metadata_cache,
                      xtreemfs::pbrpc::Stat* stat_buffer);
 
+  /** Opens the persistent metadata cache of a snapshot volume in
+   *  Options::metadata_cache_persistent_dir. It is ignored for other volumes
+   *  or if the state of the snapshot cannot be retrieved from the MRC. */
+  void OpenPersistentMetadataCache();
+
+  /** Fetches the xattrs of the first Options::readdir_prefetch_xattrs entries
+   *  of the directory "path" which are not cached yet. Errors are ignored. */
+  void PrefetchXAttrs(
+      const xtreemfs::pbrpc::UserCredentials& user_credentials,
+      const std::string& path,
+      const xtreemfs::pbrpc::DirectoryEntries& dir_entries);
+
+  /** Lets network_client_ connect to the OSDs of all replicas in "xlocset"
+   *  in the background. Addresses which cannot be resolved are skipped. */
+  void PrewarmOSDConnections(const xtreemfs::pbrpc::XLocSet& xlocset);
+
   /** Obtain or create a new FileInfo object in the open_file_table_
    *
    * @remark Ownership is NOT transferred to the caller. The object will be
@@ -318,9 +357,17 @@ class VolumeImplementation : public Volume {
   /** Renew the XCap of every FileHandle before it does expire. */
   void PeriodicXCapRenewal();
 
-  /** Write back file_sizes of every FileInfo object in open_file_table_. */
+  /** Write back file_sizes of the files in file_size_update_queue_,
+   *  periodically and whenever urgent updates are queued. */
   void PeriodicFileSizeUpdate();
 
+  /** Starts the asynchronous file size write back of the given files. */
+  void WriteBackFileSizesAsync(const std::vector<uint64_t>& file_ids);
+
+  /** Releases the lingering locks of all open files at the OSDs after their
+   *  lease expired. */
+  void PeriodicLingeringLocksRelease();
+
   /** Reference to Client which did open this volume. */
   ClientImplementation* client_;
 
@@ -384,9 +431,15 @@ class VolumeImplementation : public Volume {
    */
   boost::mutex open_file_table_mutex_;
 
+  /** On-disk copy of metadata_cache_ for snapshots, may be NULL. */
+  boost::scoped_ptr<PersistentMetadataCache> persistent_metadata_cache_;
+
   /** Metadata cache (stat, dir_entries, xattrs) by path. */
   MetadataCache metadata_cache_;
 
+  /** XCaps and XLocSets of previous open()s by path, flags and user. */
+  OpenCapabilityCache open_capability_cache_;
+
   /** Available Striping policies. */
   std::map<xtreemfs::pbrpc::StripingPolicyType,
            StripeTranslator*> stripe_translators_;
@@ -397,6 +450,13 @@ class VolumeImplementation : public Volume {
   /** Periodically writes back pending file sizes updates to the MRC service. */
   boost::scoped_ptr<boost::thread> filesize_writeback_thread_;
 
+  /** Open files with a pending file size update, processed by
+   *  filesize_writeback_thread_. */
+  FileSizeUpdateQueue file_size_update_queue_;
+
+  /** Releases lingering locks, only started if lock_cache_lease_ms > 0. */
+  boost::scoped_ptr<boost::thread> lingering_locks_release_thread_;
+
   FRIEND_TEST(VolumeImplementationTest,
               StatCacheCorrectlyUpdatedAfterRenameWriteAndClose);
 };
@@ -44,6 +44,9 @@ class AbstractSocketChannel {
       ReadWriteHandler handler) = 0;
 
   virtual void close() = 0;
+
+  /** Returns the TCP socket, e.g., to set socket options. */
+  virtual boost::asio::ip::tcp::socket::lowest_layer_type& lowest_layer() = 0;
 };
 
 }  // namespace rpc
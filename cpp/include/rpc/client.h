@@ -12,18 +12,27 @@
 #include <stdint.h>
 
 #include <boost/asio.hpp>
+#include <boost/atomic.hpp>
 #include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/system/error_code.hpp>
-#include <boost/thread/mutex.hpp>
 #include <boost/version.hpp>
 #include <gtest/gtest_prod.h>
-#include <queue>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "rpc/client_connection.h"
 #include "rpc/client_request.h"
+#include "rpc/io_uring.h"
 #include "rpc/ssl_options.h"
+#include "rpc/ssl_session_cache.h"
+#include "rpc/submission_queue.h"
+#include "rpc/timer_wheel.h"
 
 #ifdef HAS_OPENSSL
 #include <boost/asio/ssl.hpp>
@@ -47,11 +56,32 @@ typedef boost::unordered_map<std::string, ClientConnection*> connection_map;
 typedef std::map<std::string, ClientConnection*> connection_map;
 #endif
 
+/** Limits the deadline of all requests which are sent by the current thread
+ *  while the object exists. Nested objects can only shorten the deadline.
+ *
+ * This way a deadline of a synchronous call (see RPCOptions) reaches the
+ * requests sent by the generated service clients. */
+class ScopedRequestDeadline : private boost::noncopyable {
+ public:
+  /** If "deadline" is not_a_date_time, the current deadline is kept. */
+  explicit ScopedRequestDeadline(const boost::posix_time::ptime& deadline);
+
+  ~ScopedRequestDeadline();
+
+  /** Returns the deadline of the current thread or not_a_date_time. */
+  static boost::posix_time::ptime Current();
+
+ private:
+  boost::posix_time::ptime previous_;
+};
+
 class Client {
  public:
   Client(int32_t connect_timeout_s,
          int32_t request_timeout_s,
          int32_t max_con_linger,
+         int32_t write_coalescing_us,
+         bool use_io_uring,
          const SSLOptions* options);
 
   virtual ~Client();
@@ -72,6 +102,21 @@ class Client {
                    void* context,
                    ClientRequestCallbackInterface *callback);
 
+  /** Sets the timeout of requests of the operation "proc_id" of the service
+   *  "interface_id" to "timeout_ms" instead of the request_timeout_s passed
+   *  to the constructor.
+   *
+   * @remarks Has to be called before requests are sent.
+   */
+  void SetRequestTimeout(uint32_t interface_id,
+                         uint32_t proc_id,
+                         int32_t timeout_ms);
+
+  /** Opens a connection to "address" (host:port) in the background, if
+   *  there is none yet, so that the first request to it does not wait for
+   *  the TCP and SSL handshake. Errors are only logged. */
+  void Prewarm(const std::string& address);
+
  private:
   /** Helper function which aborts a ClientRequest with "error".
    *
@@ -79,10 +124,28 @@ class Client {
    */
   void AbortClientRequest(ClientRequest* request, const std::string& error);
 
+  /** Closes inactive connections. */
   void handleTimeout(const boost::system::error_code& error);
 
+  /** Adds "request" to request_deadlines_ and starts request_deadline_timer_
+   *  if necessary. */
+  void ScheduleRequestDeadline(ClientRequest* request);
+
+  /** Aborts all requests whose deadline passed and resets their connections.
+   *  Runs every kRequestDeadlineTickMs as long as requests are pending. */
+  void HandleRequestDeadlines(const boost::system::error_code& error);
+
+  /** Returns the tick of request_deadlines_ which contains "time". */
+  uint64_t ToDeadlineTick(const boost::posix_time::ptime& time) const;
+
   void sendInternalRequest();
 
+  void PrewarmInternal(const std::string& address);
+
+  /** Creates a connection to "server" and "port" without connecting it. */
+  ClientConnection* CreateConnection(const std::string& server,
+                                     const std::string& port);
+
   void ShutdownHandler();
   
   FILE* create_and_open_temporary_ssl_file(std::string* filename_template,
@@ -107,25 +170,51 @@ class Client {
    *          service_ and therefore do not require further synchronization.
    */
   request_map request_table_;
-  /** Guards access to requests_ and stopped_. */
-  boost::mutex requests_mutex_;
   /** Global queue where all requests queue up before the required
    *  ClientConnection is available.
    *
    *  Once a ClientRequest was removed from this queue, it will be added to the
    *  requests_table_ and the queue ClientConnection::requests_.
    */
-  std::queue<ClientRequest*> requests_;
+  SubmissionQueue submission_queue_;
+  /** Requests taken from submission_queue_ by sendInternalRequest(). Only
+   *  accessed in the context of service_. */
+  std::vector<ClientRequest*> submitted_requests_;
   /** True when the RPC client was stopped and no new requests are accepted. */
-  bool stopped_;
+  boost::atomic<bool> stopped_;
   /** True when the RPC client was stopped, only accessed in the context of
    *  io_service::run. */
   bool stopped_ioservice_only_;
+  /** Distinguishes the call ids handed out per thread by different Client
+   *  objects, see sendRequest(). */
+  const uint32_t instance_id_;
+  /** Next call id which was not handed out to a thread yet. */
   uint32_t callid_counter_;
   boost::asio::deadline_timer rq_timeout_timer_;
   int32_t rq_timeout_s_;
+  /** Timeouts which differ from rq_timeout_s_ per (interface id, proc id). */
+  std::map<std::pair<uint32_t, uint32_t>, boost::posix_time::time_duration>
+      proc_timeouts_;
+  /** Tick 0 of request_deadlines_. */
+  const boost::posix_time::ptime request_deadlines_start_;
+  /** Expiry of all requests in request_table_. Requests are removed from it
+   *  whenever they are removed from request_table_.
+   *
+   *  @remark Only accessed in the context of service_. */
+  TimerWheel request_deadlines_;
+  boost::asio::deadline_timer request_deadline_timer_;
+  bool request_deadline_timer_running_;
   int32_t connect_timeout_s_;
   int32_t max_con_linger_;
+  /** Passed to every ClientConnection. */
+  int32_t write_coalescing_us_;
+  /** Read and write plain TCP connections through io_uring, if the kernel
+   *  supports it. */
+  bool use_io_uring_;
+#ifdef HAS_IO_URING
+  /** Created by run() if use_io_uring_ is set and supported. */
+  boost::scoped_ptr<IOUring> io_uring_;
+#endif  // HAS_IO_URING
 
 #ifdef HAS_OPENSSL
   std::string get_pem_password_callback() const;
@@ -138,11 +227,15 @@ class Client {
 #endif
 
   bool use_gridssl_;
+  /** Encrypt the records in the kernel after the handshake. */
+  bool use_kernel_tls_;
   const SSLOptions* ssl_options;
   char* pemFileName;
   char* certFileName;
   char* trustedCAsFileName;
   boost::asio::ssl::context* ssl_context_;
+  /** Last TLS session per server, used by all connections of ssl_context_. */
+  SSLSessionCache ssl_session_cache_;
 #endif  // HAS_OPENSSL
 
   FRIEND_TEST(ClientTestFastLingerTimeout, LingerTests);
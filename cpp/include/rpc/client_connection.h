@@ -13,16 +13,21 @@
 
 #include <boost/asio.hpp>
 #include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/system/error_code.hpp>
 #include <boost/version.hpp>
-#include <queue>
+#include <deque>
 #include <string>
+#include <vector>
 
 #include "pbrpc/RPC.pb.h"
 #include "rpc/abstract_socket_channel.h"
 #include "rpc/client_request.h"
+#include "rpc/io_uring.h"
 #include "rpc/record_marker.h"
 #include "rpc/ssl_options.h"
+#include "rpc/ssl_session_cache.h"
+#include "rpc/timer_wheel.h"
 
 #if (BOOST_VERSION / 100000 > 1) || (BOOST_VERSION / 100 % 1000 > 35)
 #include <boost/unordered_map.hpp>
@@ -66,11 +71,18 @@ class ClientConnection {
                    const std::string& port,
                    boost::asio::io_service& service,
                    request_map *request_table,
+                   TimerWheel* request_deadlines,
                    int32_t connect_timeout_s,
-                   int32_t max_reconnect_interval_s
+                   int32_t max_reconnect_interval_s,
+                   int32_t write_coalescing_us
+#ifdef HAS_IO_URING
+                   ,IOUring* io_uring
+#endif  // HAS_IO_URING
 #ifdef HAS_OPENSSL
                    ,bool use_gridssl,
-                   boost::asio::ssl::context* ssl_context
+                   boost::asio::ssl::context* ssl_context,
+                   SSLSessionCache* ssl_session_cache,
+                   bool use_kernel_tls
 #endif  // HAS_OPENSSL
                    );
 
@@ -106,8 +118,10 @@ class ClientConnection {
   char *receive_marker_buffer_;
 
   State connection_state_;
-  /** Queue of requests which have not been sent out yet. */
-  std::queue<PendingRequest> requests_;
+  /** Queue of requests which have not been sent out yet. The first
+   *  requests_being_sent_ ones are written right now. */
+  std::deque<PendingRequest> requests_;
+  size_t requests_being_sent_;
   ClientRequest* current_request_;
 
   const std::string server_name_;
@@ -119,17 +133,37 @@ class ClientConnection {
   boost::asio::ip::tcp::endpoint* endpoint_;
   /** Points to the Client's request_table_. */
   request_map* request_table_;
+  /** Points to the Client's request_deadlines_. A request's deadline has to be
+   *  cancelled when it is removed from request_table_. */
+  TimerWheel* request_deadlines_;
   boost::asio::deadline_timer timer_;
   const int32_t connect_timeout_s_;
   const int32_t max_reconnect_interval_s_;
+  /** Time a small request waits for further ones before it is sent. */
+  const int32_t write_coalescing_us_;
+  boost::asio::deadline_timer coalescing_timer_;
+  /** True while coalescing_timer_ delays the next SendRequest(). */
+  bool coalescing_;
   boost::posix_time::ptime next_reconnect_at_;
   boost::posix_time::ptime last_connect_was_at_;
   int32_t reconnect_interval_s_;
   boost::posix_time::ptime last_used_;
+  /** Time when the record marker of the current response was received (only
+   *  set if request tracing is enabled). */
+  int64_t receive_started_at_us_;
+
+#ifdef HAS_IO_URING
+  /** Points to the Client's io_uring, if plain TCP connections use it. */
+  IOUring* io_uring_;
+#endif  // HAS_IO_URING
 
 #ifdef HAS_OPENSSL
   bool use_gridssl_;
   boost::asio::ssl::context* ssl_context_;
+  /** Points to the Client's SSL session cache. */
+  SSLSessionCache* ssl_session_cache_;
+  /** Use a KTLSSocketChannel instead of an SSLSocketChannel. */
+  bool use_kernel_tls_;
 #endif  // HAS_OPENSSL
 
   /** Deletes "socket".
@@ -139,6 +173,10 @@ class ClientConnection {
   void static DelayedSocketDeletionHandler(AbstractSocketChannel* socket);
 
   void Connect();
+
+  /** Sends the queued requests with one write, bounded by the number of bytes
+   *  and buffers. Small requests are copied into a contiguous buffer, i.e.,
+   *  they share a TLS record on SSL connections. */
   void SendRequest();
   void ReceiveRequest();
   void PostResolve(const boost::system::error_code& err,
@@ -146,12 +184,18 @@ class ClientConnection {
   void PostConnect(const boost::system::error_code& err,
           boost::asio::ip::tcp::resolver::iterator endpoint_iterator);
   void OnConnectTimeout(const boost::system::error_code& err);
+  void OnCoalescingTimeout(const boost::system::error_code& err);
   void PostReadMessage(const boost::system::error_code& err);
   void PostReadRecordMarker(const boost::system::error_code& err);
+  /** "coalesced_requests" is only bound to keep the buffer alive until the
+   *  write is done. */
   void PostWrite(const boost::system::error_code& err,
-                 std::size_t bytes_written);
+                 std::size_t bytes_written,
+                 boost::shared_ptr<std::vector<char> > coalesced_requests);
   void DeleteInternalBuffers();
   void CreateChannel();
+  /** Returns a new channel for a plain TCP connection. */
+  AbstractSocketChannel* CreateTCPChannel();
 };
 
 }  // namespace rpc
@@ -15,6 +15,7 @@
 
 #include "include/Common.pb.h"
 #include "pbrpc/RPC.pb.h"
+#include "rpc/timer_wheel.h"
 
 namespace xtreemfs {
 namespace rpc {
@@ -134,6 +135,35 @@ class ClientRequest {
     return time_sent_;
   }
 
+  /** Maximum time between sending the request and receiving the response. */
+  void set_timeout(const boost::posix_time::time_duration& timeout) {
+    timeout_ = timeout;
+  }
+
+  /** Latest point in time for the response, regardless of timeout(). Not set
+   *  (not_a_date_time) by default. */
+  void set_deadline(const boost::posix_time::ptime& deadline) {
+    deadline_ = deadline;
+  }
+
+  /** Returns the point in time the request times out. Valid after
+   *  RequestSent(). */
+  boost::posix_time::ptime expires_at() const;
+
+  /** Link of the SubmissionQueue. */
+  ClientRequest* next_submitted() const {
+    return next_submitted_;
+  }
+
+  void set_next_submitted(ClientRequest* next_submitted) {
+    next_submitted_ = next_submitted;
+  }
+
+  /** Used by Client to track expires_at(). */
+  TimerWheel::Timer* deadline_timer() {
+    return &deadline_timer_;
+  }
+
   google::protobuf::Message* resp_message() const {
     return resp_message_;
   }
@@ -187,6 +217,11 @@ class ClientRequest {
   ClientRequestCallbackInterface *callback_;
   std::string address_;
   boost::posix_time::ptime time_sent_;
+  boost::posix_time::time_duration timeout_;
+  boost::posix_time::ptime deadline_;
+  /** Scheduled in Client::request_deadlines_ while the request is pending. */
+  TimerWheel::Timer deadline_timer_;
+  ClientRequest* next_submitted_;
   bool callback_executed_;
 
   /** Internal buffers (will be deleted with the object). */
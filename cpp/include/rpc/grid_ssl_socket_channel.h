@@ -14,10 +14,12 @@
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
+#include <string>
 #include <vector>
 
 #include "pbrpc/RPC.pb.h"
 #include "rpc/abstract_socket_channel.h"
+#include "rpc/ssl_session_cache.h"
 
 
 namespace xtreemfs {
@@ -26,9 +28,15 @@ namespace rpc {
 class GridSSLSocketChannel : public AbstractSocketChannel {
  public:
 
+  /** If "session_cache" is not NULL, the TLS session to "address" (host:port)
+   *  is resumed if possible. */
   GridSSLSocketChannel(boost::asio::io_service& service,
-                       boost::asio::ssl::context& context)
-      : ssl_stream_(service, context) {
+                       boost::asio::ssl::context& context,
+                       SSLSessionCache* session_cache,
+                       const std::string& address)
+      : ssl_stream_(service, context),
+        session_cache_(session_cache),
+        address_(address) {
   }
 
   virtual ~GridSSLSocketChannel() {
@@ -49,12 +57,26 @@ class GridSSLSocketChannel : public AbstractSocketChannel {
     if (error) {
       connect_handler_(error);
     } else {
+      if (session_cache_ == NULL) {
+        ssl_stream_.async_handshake(
+            boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::client,
+            connect_handler_);
+        return;
+      }
+      session_cache_->StartHandshake(native_ssl(), &binding_, address_);
       ssl_stream_.async_handshake(
           boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::client,
-          connect_handler_);
+          boost::bind(&GridSSLSocketChannel::internal_handshake_done,
+                      this,
+                      boost::asio::placeholders::error));
     }
   }
 
+  void internal_handshake_done(const boost::system::error_code& error) {
+    session_cache_->FinishHandshake(native_ssl(), &binding_, error);
+    connect_handler_(error);
+  }
+
   virtual void async_read(
       const std::vector<boost::asio::mutable_buffer>& buffers,
       ReadWriteHandler handler) {
@@ -83,18 +105,31 @@ class GridSSLSocketChannel : public AbstractSocketChannel {
 
     ssl_stream_.shutdown(ignored_error);
   }
+
+  virtual boost::asio::ip::tcp::socket::lowest_layer_type& lowest_layer() {
+    return ssl_stream_.lowest_layer();
+  }
   
   const char *ssl_tls_version() {
+    return SSL_get_version(native_ssl());
+  }
+
+ private:
+  SSL* native_ssl() {
 #if (BOOST_VERSION < 104700)
-    return SSL_get_version(ssl_stream_.impl()->ssl);
+    return ssl_stream_.impl()->ssl;
 #else  // BOOST_VERSION < 104700
-    return SSL_get_version(ssl_stream_.native_handle());
+    return ssl_stream_.native_handle();
 #endif  // BOOST_VERSION < 104700
   }
 
- private:
   boost::asio::ssl::stream<boost::asio::ip::tcp::socket> ssl_stream_;
   ConnectHandler connect_handler_;
+  SSLSessionCache* session_cache_;
+  const std::string address_;
+  /** Attached to the SSL object during the handshake and afterwards, as
+   *  TLS 1.3 tickets arrive with the first response. */
+  SSLSessionCache::Binding binding_;
 };
 
 }  // namespace rpc
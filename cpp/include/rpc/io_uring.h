@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_RPC_IO_URING_H_
+#define CPP_INCLUDE_RPC_IO_URING_H_
+
+#ifdef HAS_IO_URING
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/system/error_code.hpp>
+#include <set>
+#include <string>
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Linux io_uring instance of an rpc::Client, used by IOUringSocketChannel.
+ *
+ * The completions are reaped in the context of the io_service: the ring
+ * signals an eventfd which is waited for like any other descriptor. All
+ * submissions of one io_service round are passed to the kernel with a single
+ * io_uring_enter() call.
+ *
+ * Received data lands in a pool of buffers which is registered with the
+ * kernel (a provided buffer ring), so that a receive does not need to be
+ * submitted again for every read.
+ *
+ * @remarks Not thread safe, must only be used in the context of the
+ *          io_service.
+ */
+class IOUring : private boost::noncopyable {
+ public:
+  /** Receives the completions of one submission. */
+  class Operation {
+   public:
+    virtual ~Operation() {}
+
+    /** Called for every completion of the operation. "flags" are the flags
+     *  of the completion queue entry, e.g., IORING_CQE_F_MORE if more
+     *  completions follow.
+     *
+     *  Returns true if the operation was submitted again. Otherwise, it is
+     *  deleted after its last completion. */
+    virtual bool Complete(int result, uint32_t flags) = 0;
+  };
+
+  /** Returns NULL and sets "error" if the kernel does not support io_uring
+   *  or the required features. */
+  static IOUring* Create(boost::asio::io_service& service, std::string* error);
+
+  ~IOUring();
+
+  /** Returns the submission queue entry of "operation" which will be
+   *  submitted at the end of the current io_service round, or NULL if the
+   *  queue is full. */
+  io_uring_sqe* GetSQE(Operation* operation);
+
+  /** Returns a submission queue entry whose completion is ignored, e.g., to
+   *  cancel an operation. */
+  io_uring_sqe* GetSQE();
+
+  /** Passes the queued entries to the kernel right away, e.g., before their
+   *  socket is closed. */
+  void Submit();
+
+  /** Group id of the receive buffers, see IOSQE_BUFFER_SELECT. */
+  uint16_t buffer_group() const {
+    return kBufferGroup;
+  }
+
+  /** Returns the receive buffer "id" (see IORING_CQE_BUFFER_SHIFT). */
+  char* buffer(uint16_t id) {
+    return buffers_ + static_cast<size_t>(id) * kBufferSize;
+  }
+
+  /** Hands the receive buffer "id" back to the kernel. */
+  void ReturnBuffer(uint16_t id);
+
+  /** False if the kernel does not support multishot receives
+   *  (IORING_RECV_MULTISHOT, Linux 6.0). */
+  bool multishot_receive() const {
+    return multishot_receive_;
+  }
+
+  void DisableMultishotReceive() {
+    multishot_receive_ = false;
+  }
+
+ private:
+  static const uint16_t kBufferGroup = 0;
+
+  /** Size of one receive buffer. */
+  static const size_t kBufferSize = 32 * 1024;
+
+  /** Number of receive buffers, a power of 2. */
+  static const unsigned kBuffers = 128;
+
+  explicit IOUring(boost::asio::io_service& service);
+
+  /** Sets up the ring. Returns false and sets "error" on failure. */
+  bool Initialize(std::string* error);
+
+  /** Waits for the eventfd, unless no operation is pending. */
+  void WaitForCompletions();
+
+  void OnCompletions(const boost::system::error_code& error);
+
+  /** Submits the entries queued in this io_service round and handles
+   *  completions which are already available. */
+  void Flush();
+
+  /** Dispatches all completions to their operations. */
+  void Reap();
+
+  boost::asio::io_service& service_;
+
+  int ring_fd_;
+
+  /** Mapping of the submission and completion queue. */
+  void* rings_;
+  size_t rings_size_;
+  io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned* sq_flags_;
+  unsigned* sq_array_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  /** Tail of the submission queue including the entries which were not
+   *  passed to the kernel yet. */
+  unsigned sq_local_tail_;
+  /** Number of entries which were not passed to the kernel yet. */
+  unsigned sq_pending_;
+  /** True if Flush() was posted to service_. */
+  bool flush_posted_;
+
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  io_uring_cqe* cqes_;
+  unsigned cq_mask_;
+
+  /** Signalled by the kernel for every completion. */
+  boost::scoped_ptr<boost::asio::posix::stream_descriptor> event_fd_;
+  bool waiting_;
+
+  /** Operations whose last completion was not reaped yet. */
+  std::set<Operation*> operations_;
+
+  /** Registered ring of free receive buffers. Its tail overlays the "resv"
+   *  field of the first entry (see io_uring_buf_ring). */
+  io_uring_buf* buffer_ring_;
+  size_t buffer_ring_size_;
+  uint16_t buffer_ring_tail_;
+  char* buffers_;
+
+  bool multishot_receive_;
+};
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_IO_URING
+
+#endif  // CPP_INCLUDE_RPC_IO_URING_H_
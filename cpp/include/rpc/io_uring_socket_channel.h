@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_RPC_IO_URING_SOCKET_CHANNEL_H_
+#define CPP_INCLUDE_RPC_IO_URING_SOCKET_CHANNEL_H_
+
+#ifdef HAS_IO_URING
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <boost/asio.hpp>
+#include <boost/system/error_code.hpp>
+#include <deque>
+#include <vector>
+
+#include "rpc/abstract_socket_channel.h"
+#include "rpc/io_uring.h"
+
+namespace xtreemfs {
+namespace rpc {
+
+/** TCP channel which reads and writes through the io_uring of the
+ *  rpc::Client instead of one system call per read and write.
+ *
+ * After the connect, a multishot receive stays armed: the kernel puts the
+ * received data into the registered buffers of the ring and reads copy it
+ * from there. The writes of all connections are submitted together once per
+ * io_service round. Connecting is left to boost::asio.
+ */
+class IOUringSocketChannel : public AbstractSocketChannel {
+ public:
+  IOUringSocketChannel(boost::asio::io_service& service, IOUring* io_uring);
+
+  virtual ~IOUringSocketChannel();
+
+  virtual void async_connect(
+      const boost::asio::ip::tcp::endpoint& peer_endpoint,
+      ConnectHandler handler);
+
+  virtual void async_read(
+      const std::vector<boost::asio::mutable_buffer>& buffers,
+      ReadWriteHandler handler);
+
+  virtual void async_read(
+      const boost::asio::mutable_buffers_1& buffer,
+      ReadWriteHandler handler);
+
+  virtual void async_write(
+      const std::vector<boost::asio::const_buffer> & buffers,
+      ReadWriteHandler handler);
+
+  virtual void close();
+
+  virtual boost::asio::ip::tcp::socket::lowest_layer_type& lowest_layer() {
+    return socket_->lowest_layer();
+  }
+
+ private:
+  /** Multishot (or, on older kernels, single) receive into the buffers of
+   *  the ring. */
+  class ReceiveOperation : public IOUring::Operation {
+   public:
+    ReceiveOperation(IOUringSocketChannel* channel, IOUring* io_uring)
+        : channel_(channel), io_uring_(io_uring) {}
+
+    virtual bool Complete(int result, uint32_t flags);
+
+    /** Set to NULL when the channel is closed. */
+    IOUringSocketChannel* channel_;
+
+   private:
+    IOUring* io_uring_;
+  };
+
+  /** Writes all buffers of an async_write(), submitting the rest again after
+   *  a partial write. */
+  class SendOperation : public IOUring::Operation {
+   public:
+    SendOperation(IOUringSocketChannel* channel,
+                  const std::vector<boost::asio::const_buffer>& buffers,
+                  ReadWriteHandler handler);
+
+    virtual bool Complete(int result, uint32_t flags);
+
+    /** Set to NULL when the channel is closed. */
+    IOUringSocketChannel* channel_;
+
+   private:
+    friend class IOUringSocketChannel;
+
+    /** Kept until the last completion, as it may own the written data. */
+    ReadWriteHandler handler_;
+    std::vector<iovec> iovecs_;
+    /** First iovec which was not written completely. */
+    size_t first_iovec_;
+    msghdr message_;
+    size_t bytes_written_;
+  };
+
+  /** Data of a receive buffer which was not read yet. */
+  struct ReceivedData {
+    ReceivedData(uint16_t buffer_id, size_t length)
+        : buffer_id(buffer_id), offset(0), length(length) {}
+
+    uint16_t buffer_id;
+    size_t offset;
+    size_t length;
+  };
+
+  /** Submits receive_, unless it is pending. Returns false if the
+   *  submission queue is full. */
+  bool Receive();
+
+  /** Called by receive_ for every completion. */
+  void OnReceive(int result, uint32_t flags);
+
+  /** Submits send_ (again). Returns false if the submission queue is
+   *  full. */
+  bool Send();
+
+  /** Called by send_ for every completion. Returns true if send_ was
+   *  submitted again. */
+  bool OnSend(int result);
+
+  /** Copies received data into the buffers of the pending read. Completes
+   *  the read if they are full or the connection failed. Otherwise, makes
+   *  sure that more data is received. */
+  void ContinueRead(bool post_handler);
+
+  boost::asio::io_service& service_;
+  IOUring* io_uring_;
+  boost::asio::ip::tcp::socket* socket_;
+  bool closed_;
+
+  /** Pending receive, if any. */
+  ReceiveOperation* receive_;
+  /** Received data in the order of arrival. */
+  std::deque<ReceivedData> received_;
+  /** Set if the server closed the connection or it failed. */
+  boost::system::error_code receive_error_;
+
+  /** Buffers of the pending async_read(), if read_handler_ is set. */
+  std::vector<boost::asio::mutable_buffer> read_buffers_;
+  /** First buffer which is not filled yet. */
+  size_t read_buffer_;
+  size_t read_buffer_offset_;
+  size_t bytes_read_;
+  ReadWriteHandler read_handler_;
+
+  /** Pending write, if any. */
+  SendOperation* send_;
+};
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_IO_URING
+
+#endif  // CPP_INCLUDE_RPC_IO_URING_SOCKET_CHANNEL_H_
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_RPC_KTLS_SOCKET_CHANNEL_H_
+#define CPP_INCLUDE_RPC_KTLS_SOCKET_CHANNEL_H_
+
+#ifdef HAS_OPENSSL
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <string>
+#include <vector>
+
+#include "rpc/ssl_session_cache.h"
+#include "rpc/ssl_socket_channel.h"
+
+namespace xtreemfs {
+namespace rpc {
+
+/** SSL channel which hands the symmetric keys to the kernel after the
+ *  handshake (Linux kernel TLS), so that records are encrypted (and
+ *  decrypted) by plain socket writes (and reads) instead of by OpenSSL on the
+ *  network thread.
+ *
+ * Falls back to SSLSocketChannel's behaviour if the kernel or the negotiated
+ * session is not supported (other platforms, the "tls" module not loaded,
+ * ciphers other than AES-GCM, protocols other than TLS 1.2). TLS 1.3 is not
+ * offloaded because OpenSSL writes records after the handshake, e.g.
+ * KeyUpdate messages, which would corrupt the kernel's record stream.
+ */
+class KTLSSocketChannel : public SSLSocketChannel {
+ public:
+  KTLSSocketChannel(boost::asio::io_service& service,
+                    boost::asio::ssl::context& context,
+                    SSLSessionCache* session_cache,
+                    const std::string& address);
+
+  virtual ~KTLSSocketChannel();
+
+  virtual void async_read(
+      const std::vector<boost::asio::mutable_buffer>& buffers,
+      ReadWriteHandler handler);
+
+  virtual void async_read(
+      const boost::asio::mutable_buffers_1& buffer,
+      ReadWriteHandler handler);
+
+  virtual void async_write(
+      const std::vector<boost::asio::const_buffer> & buffers,
+      ReadWriteHandler handler);
+
+ protected:
+  virtual void PostHandshake();
+
+ private:
+  /** Configures the kernel for the negotiated session. Returns false and sets
+   *  "reason" if a direction cannot be offloaded. Sending is only offloaded
+   *  if receiving is, so OpenSSL never reads or writes after the handshake.
+   */
+  bool EnableKernelTLS(std::string* reason);
+
+  /** True if the kernel encrypts, respectively decrypts, the records. */
+  bool kernel_tx_;
+  bool kernel_rx_;
+};
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_OPENSSL
+
+#endif  // CPP_INCLUDE_RPC_KTLS_SOCKET_CHANNEL_H_
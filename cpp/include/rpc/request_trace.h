@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_RPC_REQUEST_TRACE_H_
+#define CPP_INCLUDE_RPC_REQUEST_TRACE_H_
+
+#include <stdint.h>
+
+#include <boost/thread/mutex.hpp>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Points in the life of a request which are recorded by RequestTrace. */
+enum RequestTraceEventType {
+  /** Request was added to rpc::Client::requests_ by an application thread. */
+  kTraceEnqueued,
+  /** Network thread moved the request to the queue of its ClientConnection. */
+  kTraceDequeued,
+  /** ClientConnection started to resolve and connect to the server. */
+  kTraceConnectStart,
+  /** ClientConnection is connected (including a possible SSL handshake). */
+  kTraceConnected,
+  /** The request is handed to the socket. */
+  kTraceWriteStart,
+  /** The request was completely written to the socket. */
+  kTraceWriteFinished,
+  /** The record marker of the response was received. */
+  kTraceFirstResponseByte,
+  /** The callback of the request is executed. */
+  kTraceCallbackDispatched,
+  /** ExecuteSyncRequest() waits before retrying a failed request. */
+  kTraceRetryDelay
+};
+
+/** A single recorded event. Connection events have the call_id 0. */
+struct RequestTraceEvent {
+  RequestTraceEvent()
+      : timestamp_us(0),
+        type(kTraceEnqueued),
+        call_id(0),
+        proc_id(0),
+        duration_us(0) {}
+
+  /** Microseconds since the epoch. */
+  int64_t timestamp_us;
+  RequestTraceEventType type;
+  uint32_t call_id;
+  uint32_t proc_id;
+  /** Only set for kTraceRetryDelay events. */
+  int64_t duration_us;
+  /** Address (host:port) and, if known, the UUID of the contacted server. */
+  std::string server;
+};
+
+/** Records the last "max_events" events of RPC requests in a ring buffer.
+ *  Thread safe.
+ *
+ *  Similar to ErrorLog, there is one global instance which is only created if
+ *  tracing was enabled (see Options::rpc_trace_buffer_size). If not enabled,
+ *  RequestTrace::request_trace is NULL and the Record*() helpers are a no-op.
+ */
+class RequestTrace {
+ public:
+  static RequestTrace* request_trace;
+
+  explicit RequestTrace(size_t max_events);
+
+  /** Records an event which happened now. */
+  void Record(RequestTraceEventType type,
+              uint32_t call_id,
+              uint32_t proc_id,
+              const std::string& server);
+
+  /** Records "event" as is, e.g. if the timestamp was taken earlier. */
+  void Record(const RequestTraceEvent& event);
+
+  /** Returns the current time in microseconds since the epoch. */
+  static int64_t Now();
+
+  /** Returns a copy of all recorded events, oldest first. */
+  std::vector<RequestTraceEvent> events();
+
+  /** Writes one JSON object per event and line. */
+  void DumpAsJSONLines(std::ostream* out);
+
+  /** Writes all events in the Chrome Trace Event Format which can be loaded
+   *  by chrome://tracing. Every call id is shown as separate track. */
+  void DumpAsChromeTrace(std::ostream* out);
+
+  static const char* EventTypeToString(RequestTraceEventType type);
+
+  void register_init() {
+    ++init_count_;
+  }
+
+  bool register_shutdown() {
+    if (init_count_ > 0) {
+      return (--init_count_ == 0);
+    }
+    return false;
+  }
+
+ private:
+  /** Contains the number of possible instances, by counting inits and
+   *  shutdowns. */
+  int init_count_;
+
+  boost::mutex events_mutex_;
+  /** Ring buffer with max_events entries. */
+  std::vector<RequestTraceEvent> events_;
+  /** Position where the next event will be written to. */
+  size_t next_;
+  /** Number of valid entries in events_. */
+  size_t count_;
+};
+
+/** Records "type" if tracing is enabled. */
+inline void TraceRequestEvent(RequestTraceEventType type,
+                              uint32_t call_id,
+                              uint32_t proc_id,
+                              const std::string& server) {
+  if (RequestTrace::request_trace) {
+    RequestTrace::request_trace->Record(type, call_id, proc_id, server);
+  }
+}
+
+void initialize_request_trace(size_t max_events);
+
+void shutdown_request_trace();
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_RPC_REQUEST_TRACE_H_
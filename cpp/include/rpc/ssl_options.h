@@ -32,7 +32,8 @@ class SSLOptions {
              const bool use_grid_ssl,
              const bool ssl_verify_certificates,
              const std::vector<int> ssl_ignore_verify_errors,
-             const std::string ssl_method_string)
+             const std::string ssl_method_string,
+             const bool use_kernel_tls = false)
      : pem_file_name_(ssl_pem_path),
        pem_file_pass_(ssl_pem_key_pass),
        pem_cert_name_(ssl_pem_cert_path),
@@ -43,7 +44,8 @@ class SSLOptions {
        use_grid_ssl_(use_grid_ssl),
        verify_certificates_(ssl_verify_certificates),
        ignore_verify_errors_(ssl_ignore_verify_errors),
-       ssl_method_string_(ssl_method_string) {}
+       ssl_method_string_(ssl_method_string),
+       use_kernel_tls_(use_kernel_tls) {}
 
   virtual ~SSLOptions() {
   }
@@ -94,6 +96,12 @@ class SSLOptions {
     return ssl_method_string_;
   }
 
+  /** True if the kernel shall encrypt the records after the handshake, if
+   *  supported (see KTLSSocketChannel). */
+  bool use_kernel_tls() const {
+    return use_kernel_tls_;
+  }
+
  private:
   std::string pem_file_name_;
   std::string pem_file_pass_;
@@ -107,6 +115,7 @@ class SSLOptions {
   bool verify_certificates_;
   std::vector<int> ignore_verify_errors_;
   std::string ssl_method_string_;
+  bool use_kernel_tls_;
 #endif  // HAS_OPENSSL
 };
 
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_RPC_SSL_SESSION_CACHE_H_
+#define CPP_INCLUDE_RPC_SSL_SESSION_CACHE_H_
+
+#ifdef HAS_OPENSSL
+
+#include <openssl/ssl.h>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Keeps the last TLS session (session ID or ticket) per server, so that
+ *  new connections to it resume the session with an abbreviated handshake
+ *  instead of a full one.
+ *
+ * One cache belongs to the SSL context of an rpc::Client. The sessions are
+ * handed over by OpenSSL's new session callback, because TLS 1.3 sends the
+ * tickets only after the handshake. Thread safe.
+ */
+class SSLSessionCache : private boost::noncopyable {
+ public:
+  /** Ties a connection to its cache and server. Owned by the socket channel
+   *  and attached to its SSL object. */
+  struct Binding {
+    Binding() : cache(NULL) {}
+
+    SSLSessionCache* cache;
+    /** host:port of the server. */
+    std::string address;
+    boost::posix_time::ptime handshake_started_at;
+  };
+
+  SSLSessionCache();
+
+  ~SSLSessionCache();
+
+  /** Lets "context" hand the sessions of all its connections to this cache.
+   *  Disables OpenSSL's own client cache which only works server side. */
+  void Attach(SSL_CTX* context);
+
+  /** Has to be called right before the handshake of "ssl" to "address" is
+   *  started. Sets the cached session of "address", if any. */
+  void StartHandshake(SSL* ssl, Binding* binding, const std::string& address);
+
+  /** Has to be called when the handshake of "ssl" is finished. Records its
+   *  duration and whether the session was resumed (see TransportProfiles) and
+   *  drops the session of the server if the handshake failed. */
+  void FinishHandshake(SSL* ssl,
+                       Binding* binding,
+                       const boost::system::error_code& error);
+
+  /** Drops the session of "address". */
+  void Remove(const std::string& address);
+
+  /** Returns the number of cached sessions. */
+  size_t size();
+
+ private:
+  /** Called by OpenSSL with every new session of a connection. Returns 1 if
+   *  the cache took over the reference to "session". */
+  static int NewSessionCallback(SSL* ssl, SSL_SESSION* session);
+
+  void Put(const std::string& address, SSL_SESSION* session);
+
+  /** Index of the Binding in the ex_data of SSL objects. */
+  static int binding_index_;
+
+  boost::mutex mutex_;
+
+  /** Last session per host:port. Holds one reference to every session. */
+  std::map<std::string, SSL_SESSION*> sessions_;
+};
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_OPENSSL
+
+#endif  // CPP_INCLUDE_RPC_SSL_SESSION_CACHE_H_
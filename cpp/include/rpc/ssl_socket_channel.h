@@ -10,23 +10,32 @@
 
 #ifdef HAS_OPENSSL
 
+#include <boost/bind.hpp>
 #include <boost/system/error_code.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
+#include <string>
 #include <vector>
 
 #include "pbrpc/RPC.pb.h"
 #include "rpc/abstract_socket_channel.h"
+#include "rpc/ssl_session_cache.h"
 
 namespace xtreemfs {
 namespace rpc {
 
 class SSLSocketChannel : public AbstractSocketChannel {
  public:
+  /** If "session_cache" is not NULL, the TLS session to "address" (host:port)
+   *  is resumed if possible. */
   SSLSocketChannel(boost::asio::io_service& service,
-                   boost::asio::ssl::context& context)
-      : ssl_stream_(service, context) {
+                   boost::asio::ssl::context& context,
+                   SSLSessionCache* session_cache,
+                   const std::string& address)
+      : ssl_stream_(service, context),
+        session_cache_(session_cache),
+        address_(address) {
   }
 
   virtual ~SSLSocketChannel() {
@@ -47,12 +56,27 @@ class SSLSocketChannel : public AbstractSocketChannel {
     if (error) {
       connect_handler_(error);
     } else {
+      if (session_cache_ != NULL) {
+        session_cache_->StartHandshake(native_ssl(), &binding_, address_);
+      }
       ssl_stream_.async_handshake(
           boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::client,
-          connect_handler_);
+          boost::bind(&SSLSocketChannel::internal_handshake_done,
+                      this,
+                      boost::asio::placeholders::error));
     }
   }
 
+  void internal_handshake_done(const boost::system::error_code& error) {
+    if (session_cache_ != NULL) {
+      session_cache_->FinishHandshake(native_ssl(), &binding_, error);
+    }
+    if (!error) {
+      PostHandshake();
+    }
+    connect_handler_(error);
+  }
+
   virtual void async_read(
       const std::vector<boost::asio::mutable_buffer>& buffers,
       ReadWriteHandler handler) {
@@ -81,18 +105,40 @@ class SSLSocketChannel : public AbstractSocketChannel {
 
     ssl_stream_.shutdown(ignored_error);
   }
+
+  virtual boost::asio::ip::tcp::socket::lowest_layer_type& lowest_layer() {
+    return ssl_stream_.lowest_layer();
+  }
   
   const char *ssl_tls_version() {
+    return SSL_get_version(native_ssl());
+  }
+
+ protected:
+  /** Called after a successful handshake, before the connect handler. */
+  virtual void PostHandshake() {}
+
+  SSL* native_ssl() {
 #if (BOOST_VERSION < 104700)
-    return SSL_get_version(ssl_stream_.impl()->ssl);
+    return ssl_stream_.impl()->ssl;
 #else  // BOOST_VERSION < 104700
-    return SSL_get_version(ssl_stream_.native_handle());
+    return ssl_stream_.native_handle();
 #endif  // BOOST_VERSION < 104700
   }
 
- private:
+  const std::string& address() const {
+    return address_;
+  }
+
   boost::asio::ssl::stream<boost::asio::ip::tcp::socket> ssl_stream_;
+
+ private:
   ConnectHandler connect_handler_;
+  SSLSessionCache* session_cache_;
+  const std::string address_;
+  /** Attached to the SSL object during the handshake and afterwards, as
+   *  TLS 1.3 tickets arrive with the first response. */
+  SSLSessionCache::Binding binding_;
 };
 
 }  // namespace rpc
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_RPC_SUBMISSION_QUEUE_H_
+#define CPP_INCLUDE_RPC_SUBMISSION_QUEUE_H_
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace xtreemfs {
+namespace rpc {
+
+class ClientRequest;
+
+/** Lock-free queue which passes ClientRequests from any number of application
+ *  threads to the network thread of a Client.
+ *
+ * Push() adds a request to an intrusive stack (linked by
+ * ClientRequest::next_submitted()) with a single compare-and-swap. The network
+ * thread takes the whole stack with one exchange and reverses it, i.e., it
+ * gets all requests in the order they were pushed. Only the Push() which finds
+ * the queue empty has to wake up the network thread, all other requests are
+ * taken along with the same PopAll().
+ *
+ * Once closed, Push() fails. This way no request gets lost when the Client is
+ * stopped.
+ */
+class SubmissionQueue : private boost::noncopyable {
+ public:
+  SubmissionQueue();
+
+  /** Adds "request" unless the queue is closed.
+   *
+   * @returns false if closed. Otherwise "was_empty" is set to true if the
+   *          queue was empty, i.e., the consumer has to be woken up. */
+  bool Push(ClientRequest* request, bool* was_empty);
+
+  /** Removes all requests and appends them to "requests" in the order they
+   *  were pushed.
+   *
+   * @remark Must not be called concurrently with itself or Close(). */
+  void PopAll(std::vector<ClientRequest*>* requests);
+
+  /** Same as PopAll(), but all following Push() calls fail. */
+  void Close(std::vector<ClientRequest*>* requests);
+
+ private:
+  /** Appends the requests of the stack "head" to "requests" in reverse
+   *  order. */
+  static void AppendReversed(ClientRequest* head,
+                             std::vector<ClientRequest*>* requests);
+
+  /** Last pushed request, NULL if empty or closed_marker() if closed. */
+  boost::atomic<ClientRequest*> head_;
+
+  static ClientRequest* closed_marker();
+};
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_RPC_SUBMISSION_QUEUE_H_
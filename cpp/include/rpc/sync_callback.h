@@ -69,6 +69,11 @@ class SyncCallbackBase : public ClientRequestCallbackInterface {
    */
   char* data();
 
+  /**
+   * Returns the call id of the request. Blocks until response is available.
+   */
+  uint32_t call_id();
+
   /**
    * Deletes the response objects (message, response, data)
    * This is not done automatically when the SyncCallback is deleted!
@@ -61,6 +61,10 @@ class TCPSocketChannel : public AbstractSocketChannel {
     socket_->close(ignored_error);
   }
 
+  virtual boost::asio::ip::tcp::socket::lowest_layer_type& lowest_layer() {
+    return socket_->lowest_layer();
+  }
+
  protected:
   boost::asio::ip::tcp::socket *socket_;
 };
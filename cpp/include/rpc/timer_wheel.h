@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_RPC_TIMER_WHEEL_H_
+#define CPP_INCLUDE_RPC_TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Hierarchical timer wheel which tracks the expiry of many timers, e.g., the
+ *  deadlines of all pending requests of a Client.
+ *
+ * Time is measured in ticks of arbitrary length. Every level has kSlots slots,
+ * a slot of level n covers kSlots^n ticks. Timers which expire in the near
+ * future are kept in the lowest level, timers far away in the upper levels and
+ * are moved down ("cascaded") when their slot comes due. Schedule() and
+ * Cancel() are O(1), Advance() is O(1) per tick plus the number of expired and
+ * cascaded timers.
+ *
+ * The timers are intrusive, i.e., they are owned by the caller and linked into
+ * the wheel. A timer has to be cancelled before it gets deleted.
+ *
+ * @remark This class is not thread-safe.
+ */
+class TimerWheel : private boost::noncopyable {
+ public:
+  class Timer : private boost::noncopyable {
+   public:
+    explicit Timer(void* context = NULL)
+        : prev_(NULL), next_(NULL), expires_at_tick_(0), context_(context) {}
+
+    bool IsScheduled() const {
+      return next_ != NULL;
+    }
+
+    uint64_t expires_at_tick() const {
+      return expires_at_tick_;
+    }
+
+    void* context() const {
+      return context_;
+    }
+
+   private:
+    friend class TimerWheel;
+
+    Timer* prev_;
+    Timer* next_;
+    uint64_t expires_at_tick_;
+    void* context_;
+  };
+
+  /** Number of slots per level. */
+  static const int kSlotBits = 6;
+  static const size_t kSlots = 1 << kSlotBits;
+  /** Number of levels, i.e., timers up to kSlots^kLevels ticks away are
+   *  placed exactly. Timers further away are placed at the end of the wheel
+   *  and rescheduled when they get there. */
+  static const int kLevels = 4;
+
+  /** "current_tick" is the tick the wheel starts at. */
+  explicit TimerWheel(uint64_t current_tick);
+
+  /** Schedules "timer" to expire at "expires_at_tick". If it is already
+   *  scheduled, it is moved. A tick in the past expires at the next
+   *  Advance(). */
+  void Schedule(Timer* timer, uint64_t expires_at_tick);
+
+  /** Removes "timer" from the wheel. Does nothing if it is not scheduled. */
+  void Cancel(Timer* timer);
+
+  /** Moves the wheel to "tick" and appends all timers which expired until
+   *  then to "expired". The returned timers are no longer scheduled. */
+  void Advance(uint64_t tick, std::vector<Timer*>* expired);
+
+  uint64_t current_tick() const {
+    return current_tick_;
+  }
+
+  /** Number of scheduled timers. */
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  /** Links "timer" into the slot which covers its expiry. Timers which expire
+   *  before "min_tick" are treated as expiring at "min_tick". */
+  void Place(Timer* timer, uint64_t min_tick);
+
+  /** Reschedules all timers of the slot "index" of "level". */
+  void Cascade(int level, size_t index);
+
+  static void Unlink(Timer* timer);
+
+  /** The last tick which was processed by Advance(). */
+  uint64_t current_tick_;
+
+  size_t size_;
+
+  /** Sentinels of the circular lists of timers per slot. */
+  Timer slots_[kLevels][kSlots];
+};
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_RPC_TIMER_WHEEL_H_
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_RPC_TRANSPORT_PROFILE_H_
+#define CPP_INCLUDE_RPC_TRANSPORT_PROFILE_H_
+
+#include <stdint.h>
+
+#include <boost/asio.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Socket options of the connections to a server. */
+struct TransportProfile {
+  TransportProfile();
+
+  /** Disables Nagle's algorithm (TCP_NODELAY). */
+  bool tcp_no_delay;
+  /** Idle time in seconds after which TCP keepalive probes are sent
+   *  (0 disables keepalive). */
+  int keep_alive_idle_s;
+  /** Time in microseconds a receive busy-polls the device queue
+   *  (SO_BUSY_POLL, Linux only, 0 disables it). */
+  int busy_poll_us;
+  /** Size of the send and receive buffer in bytes. If 0, the buffers are
+   *  sized from link_bandwidth_mbit or, if not set either, autotuned by the
+   *  operating system. */
+  int buffer_bytes;
+  /** Bandwidth of the link to the server in Mbit/s. Used to size the buffers
+   *  to twice the bandwidth-delay product once the RTT is known. */
+  int link_bandwidth_mbit;
+};
+
+/** Outcome of TransportProfiles::Apply() for the last connection to a
+ *  server. */
+struct AppliedTransportProfile {
+  AppliedTransportProfile();
+
+  /** host:port of the server. */
+  std::string address;
+  /** Profile which was requested, buffer_bytes includes the auto sizing. */
+  TransportProfile requested;
+  /** Smoothed RTT in microseconds the buffers were sized for (0 if
+   *  unknown). */
+  int64_t rtt_us;
+  /** Values read back from the socket (-1 if unknown). Linux reports twice
+   *  the requested buffer sizes. */
+  int tcp_no_delay;
+  int keep_alive;
+  int send_buffer_bytes;
+  int receive_buffer_bytes;
+  /** Options the operating system rejected, separated by spaces. */
+  std::string failed_options;
+  /** Number of connections to the server the profile was applied to. */
+  int connections;
+  /** Number of TLS handshakes with the server and how many of them resumed
+   *  a previous session. */
+  int tls_handshakes;
+  int tls_resumed_handshakes;
+  /** Duration of the last TLS handshake and of all of them in
+   *  microseconds. */
+  int64_t tls_handshake_us;
+  int64_t tls_handshake_total_us;
+  /** Whether the kernel encrypts (tx) and decrypts (rx) the records of the
+   *  last TLS connection (-1 if kernel TLS was not requested). */
+  int kernel_tls_tx;
+  int kernel_tls_rx;
+};
+
+/** Selects and applies the socket options of every connection.
+ *
+ *  Similar to RequestTrace, there is one global instance which is created by
+ *  the libxtreemfs Client. If it does not exist, the sockets keep the defaults
+ *  of the operating system. Thread safe.
+ */
+class TransportProfiles {
+ public:
+  static TransportProfiles* transport_profiles;
+
+  /** "default_profile" is used for all servers without an own profile. */
+  explicit TransportProfiles(const TransportProfile& default_profile);
+
+  /** Parses "<host>[:<port>][,<key>=<value>]..." with the keys nodelay,
+   *  keepalive-s, busy-poll-us, buffer-kb and bandwidth-mbit. Values which
+   *  are not set are taken from "base".
+   *
+   * @returns false and sets "error" if "entry" is invalid. */
+  static bool ParseProfile(const std::string& entry,
+                           const TransportProfile& base,
+                           std::string* address,
+                           TransportProfile* profile,
+                           std::string* error);
+
+  /** Sets the profile of "address" which is either host:port or only the
+   *  host for all ports. */
+  void SetProfile(const std::string& address, const TransportProfile& profile);
+
+  /** Adds an RTT sample (e.g., measured by Vivaldi) of "address" (host:port)
+   *  to its smoothed RTT. */
+  void UpdateRTT(const std::string& address, int64_t rtt_us);
+
+  /** Returns the profile for "address" (host:port) with the buffer size
+   *  computed from its RTT. Sets "rtt_us" to the smoothed RTT (0 if
+   *  unknown). */
+  TransportProfile GetProfile(const std::string& address, int64_t* rtt_us);
+
+  /** Applies the profile of "address" to the connected "socket" and records
+   *  the outcome. If no RTT of "address" is known yet, the one measured by
+   *  the TCP handshake is used (Linux only). */
+  void Apply(const std::string& address,
+             boost::asio::ip::tcp::socket::lowest_layer_type& socket);
+
+  /** Records a TLS handshake with "address" which took "duration_us" and
+   *  possibly resumed a previous session. */
+  void RecordTLSHandshake(const std::string& address,
+                          int64_t duration_us,
+                          bool resumed);
+
+  /** Records whether the kernel took over the encryption (tx) and
+   *  decryption (rx) of the last TLS connection to "address". */
+  void RecordKernelTLS(const std::string& address, bool tx, bool rx);
+
+  /** Returns the outcome of Apply() and the TLS handshakes per server,
+   *  ordered by address. */
+  std::vector<AppliedTransportProfile> applied();
+
+  void register_init() {
+    ++init_count_;
+  }
+
+  bool register_shutdown() {
+    if (init_count_ > 0) {
+      return (--init_count_ == 0);
+    }
+    return false;
+  }
+
+ private:
+  /** Returns twice the bandwidth-delay product, bounded by
+   *  kMinAutoBufferBytes and kMaxAutoBufferBytes. */
+  static int AutoBufferBytes(int link_bandwidth_mbit, int64_t rtt_us);
+
+  /** Contains the number of possible instances, by counting inits and
+   *  shutdowns. */
+  int init_count_;
+
+  /** Guards all following members. */
+  boost::mutex mutex_;
+
+  const TransportProfile default_profile_;
+
+  /** Profiles per host:port or host. */
+  std::map<std::string, TransportProfile> profiles_;
+
+  /** Smoothed RTT in microseconds per host:port. */
+  std::map<std::string, int64_t> rtts_us_;
+
+  std::map<std::string, AppliedTransportProfile> applied_;
+};
+
+void initialize_transport_profiles(const TransportProfile& default_profile);
+
+void shutdown_transport_profiles();
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_RPC_TRANSPORT_PROFILE_H_
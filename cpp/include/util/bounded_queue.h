@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_UTIL_BOUNDED_QUEUE_H_
+#define CPP_INCLUDE_UTIL_BOUNDED_QUEUE_H_
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cassert>
+#include <vector>
+
+namespace xtreemfs {
+namespace util {
+
+/** Multi producer, multi consumer queue with a fixed capacity.
+ *
+ * The elements are stored in a ring buffer whose slots carry a sequence
+ * number (see D. Vyukov's "Bounded MPMC queue"), i.e., enqueuing and dequeuing
+ * do not take a lock. Only callers which find the queue full or empty take a
+ * mutex to sleep. They optionally retry "spin_count" times before.
+ *
+ * Enqueue() blocks while the queue is full, so that a slow consumer slows
+ * down its producers.
+ *
+ * T must be default constructible and assignable.
+ */
+template <typename T>
+class BoundedQueue : private boost::noncopyable {
+ public:
+  /** "capacity" is rounded up to the next power of two. Callers which find
+   *  the queue full or empty retry "spin_count" times before they sleep. */
+  BoundedQueue(size_t capacity, int spin_count)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1),
+        cells_(new Cell[mask_ + 1]),
+        spin_count_(spin_count),
+        enqueue_position_(0),
+        dequeue_position_(0),
+        waiting_producers_(0),
+        waiting_consumers_(0) {
+    for (size_t i = 0; i <= mask_; ++i) {
+      cells_[i].sequence.store(i, boost::memory_order_relaxed);
+    }
+  }
+
+  ~BoundedQueue() {
+    delete [] cells_;
+  }
+
+  size_t capacity() const {
+    return mask_ + 1;
+  }
+
+  /** Returns the number of queued elements. Only a snapshot if other threads
+   *  use the queue concurrently. */
+  size_t size() const {
+    // dequeue_position_ never overtakes enqueue_position_.
+    const size_t dequeue_position = dequeue_position_.load();
+    return enqueue_position_.load() - dequeue_position;
+  }
+
+  /** Adds data to the queue. Returns false if the queue is full. */
+  bool TryEnqueue(const T& data) {
+    if (!Push(data)) {
+      return false;
+    }
+    WakeUpConsumer();
+    return true;
+  }
+
+  /** Adds data to the queue, blocks while the queue is full.
+   *
+   * @remark Contains a boost::thread interruption point. */
+  void Enqueue(const T& data) {
+    for (int i = 0; i < spin_count_; ++i) {
+      if (TryEnqueue(data)) {
+        return;
+      }
+    }
+
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      WaitingGuard waiting(&waiting_producers_);
+      while (!Push(data)) {
+        not_full_.wait(lock);
+      }
+    }
+    WakeUpConsumer();
+  }
+
+  /** Removes the next element and stores it in "data". Returns false if the
+   *  queue is empty. */
+  bool TryDequeue(T* data) {
+    if (!Pop(data)) {
+      return false;
+    }
+    WakeUpProducers();
+    return true;
+  }
+
+  /** Removes and returns the next element, blocks while the queue is empty.
+   *
+   * @remark Contains a boost::thread interruption point. */
+  T Dequeue() {
+    T result;
+    BlockingPop(&result);
+    WakeUpProducers();
+    return result;
+  }
+
+  /** Blocks until the queue is not empty and appends up to "max_elements"
+   *  elements to "elements". Returns the number of appended elements.
+   *
+   * @remark Contains a boost::thread interruption point. */
+  size_t DequeueBatch(size_t max_elements, std::vector<T>* elements) {
+    assert(max_elements > 0);
+    const size_t first = elements->size();
+    T data;
+    BlockingPop(&data);
+    elements->push_back(data);
+
+    while (elements->size() - first < max_elements && Pop(&data)) {
+      elements->push_back(data);
+    }
+    // Wake up the producers once for all freed slots.
+    WakeUpProducers();
+    return elements->size() - first;
+  }
+
+ private:
+  struct Cell {
+    /** Position which may enqueue into (== position) or dequeue from
+     *  (== position + 1) this slot next. */
+    boost::atomic<size_t> sequence;
+    T data;
+  };
+
+  /** Counts a sleeping thread for as long as it waits, even if it is
+   *  interrupted. */
+  class WaitingGuard {
+   public:
+    explicit WaitingGuard(boost::atomic<int>* waiting) : waiting_(waiting) {
+      waiting_->fetch_add(1);
+      // Pairs with the fence in WakeUp*(): either the waker sees the waiter or
+      // the waiter sees the element (or slot) of the waker.
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    }
+
+    ~WaitingGuard() {
+      waiting_->fetch_sub(1);
+    }
+
+   private:
+    boost::atomic<int>* waiting_;
+  };
+
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 2;
+    while (result < value) {
+      result *= 2;
+    }
+    return result;
+  }
+
+  bool Push(const T& data) {
+    size_t position = enqueue_position_.load(boost::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[position & mask_];
+      const intptr_t difference
+          = static_cast<intptr_t>(
+                cell->sequence.load(boost::memory_order_acquire))
+            - static_cast<intptr_t>(position);
+      if (difference == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1, boost::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // The slot was not dequeued yet since the last round.
+        return false;
+      } else {
+        position = enqueue_position_.load(boost::memory_order_relaxed);
+      }
+    }
+    cell->data = data;
+    cell->sequence.store(position + 1, boost::memory_order_release);
+    return true;
+  }
+
+  bool Pop(T* data) {
+    size_t position = dequeue_position_.load(boost::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[position & mask_];
+      const intptr_t difference
+          = static_cast<intptr_t>(
+                cell->sequence.load(boost::memory_order_acquire))
+            - static_cast<intptr_t>(position + 1);
+      if (difference == 0) {
+        if (dequeue_position_.compare_exchange_weak(
+                position, position + 1, boost::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // Empty or the producer of this slot did not finish yet.
+        return false;
+      } else {
+        position = dequeue_position_.load(boost::memory_order_relaxed);
+      }
+    }
+    *data = cell->data;
+    // Do not keep e.g. the buffer of a string until the slot is reused.
+    cell->data = T();
+    cell->sequence.store(position + mask_ + 1, boost::memory_order_release);
+    return true;
+  }
+
+  void BlockingPop(T* data) {
+    for (int i = 0; i < spin_count_; ++i) {
+      if (Pop(data)) {
+        return;
+      }
+    }
+
+    boost::mutex::scoped_lock lock(mutex_);
+    WaitingGuard waiting(&waiting_consumers_);
+    while (!Pop(data)) {
+      not_empty_.wait(lock);
+    }
+  }
+
+  void WakeUpConsumer() {
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if (waiting_consumers_.load(boost::memory_order_relaxed) > 0) {
+      boost::mutex::scoped_lock lock(mutex_);
+      not_empty_.notify_one();
+    }
+  }
+
+  void WakeUpProducers() {
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if (waiting_producers_.load(boost::memory_order_relaxed) > 0) {
+      boost::mutex::scoped_lock lock(mutex_);
+      not_full_.notify_all();
+    }
+  }
+
+  static const size_t kCacheLineSize = 64;
+
+  const size_t mask_;
+
+  Cell* const cells_;
+
+  const int spin_count_;
+
+  /** Producers and consumers do not share a cache line. */
+  char padding0_[kCacheLineSize];
+
+  boost::atomic<size_t> enqueue_position_;
+
+  char padding1_[kCacheLineSize];
+
+  boost::atomic<size_t> dequeue_position_;
+
+  char padding2_[kCacheLineSize];
+
+  /** Threads which sleep in Enqueue() because the queue is full. */
+  boost::atomic<int> waiting_producers_;
+
+  /** Threads which sleep in Dequeue*() because the queue is empty. */
+  boost::atomic<int> waiting_consumers_;
+
+  /** Only taken by threads which sleep or wake up sleeping threads. */
+  boost::mutex mutex_;
+
+  boost::condition_variable not_full_;
+
+  boost::condition_variable not_empty_;
+};
+
+}  // namespace util
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_UTIL_BOUNDED_QUEUE_H_
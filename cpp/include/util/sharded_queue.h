@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_UTIL_SHARDED_QUEUE_H_
+#define CPP_INCLUDE_UTIL_SHARDED_QUEUE_H_
+
+#include <stdint.h>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cassert>
+#include <deque>
+#include <vector>
+
+#include "util/bounded_queue.h"
+
+namespace xtreemfs {
+namespace util {
+
+/** Producer consumer queue which is split into shards, each with one
+ *  consumer thread.
+ *
+ * Elements with the same key always end up in the same shard, i.e., they are
+ * dequeued in the order they were enqueued. Every shard is a BoundedQueue:
+ * Enqueue() blocks while the shard of the key is full. EnqueueWithoutBlocking()
+ * keeps the elements which do not fit in an unbounded overflow list instead.
+ *
+ * T must be default constructible and assignable.
+ */
+template <typename T>
+class ShardedQueue : private boost::noncopyable {
+ public:
+  struct Statistics {
+    /** Elements which are currently queued, including the overflow list. */
+    int64_t depth;
+    /** Highest depth since the queue was created. */
+    int64_t peak_depth;
+    /** Number of elements which were enqueued. */
+    uint64_t enqueued;
+    /** Number of elements which did not fit and went to the overflow list. */
+    uint64_t overflowed;
+  };
+
+  /** See BoundedQueue for "shard_capacity" and "spin_count". */
+  ShardedQueue(size_t shards, size_t shard_capacity, int spin_count) {
+    assert(shards > 0);
+    for (size_t i = 0; i < shards; ++i) {
+      shards_.push_back(new Shard(shard_capacity, spin_count));
+    }
+  }
+
+  ~ShardedQueue() {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      delete shards_[i];
+    }
+  }
+
+  size_t shards() const {
+    return shards_.size();
+  }
+
+  /** Adds data to the shard of "key" and wakes up its consumer if it sleeps.
+   *  Blocks while the shard is full.
+   *
+   * @remark Contains a boost::thread interruption point. */
+  void Enqueue(uint64_t key, const T& data) {
+    Shard* shard = shards_[key % shards_.size()];
+    shard->queue.Enqueue(data);
+    Enqueued(shard);
+  }
+
+  /** Adds data to the shard of "key" like Enqueue(), but appends it to the
+   *  overflow list of the shard if the shard is full. Never blocks, e.g., for
+   *  a network thread which must not wait for the consumer.
+   *
+   * @remark Must not be mixed with Enqueue() for the same shard. */
+  void EnqueueWithoutBlocking(uint64_t key, const T& data) {
+    Shard* shard = shards_[key % shards_.size()];
+    // Once elements overflowed, the following ones have to queue up behind
+    // them.
+    if (shard->overflow_size.load() > 0 || !shard->queue.TryEnqueue(data)) {
+      boost::mutex::scoped_lock lock(shard->overflow_mutex);
+      if (!shard->overflow.empty() || !shard->queue.TryEnqueue(data)) {
+        shard->overflow.push_back(data);
+        shard->overflow_size.fetch_add(1);
+        ++shard->overflowed;
+      }
+    }
+    Enqueued(shard);
+  }
+
+  /** Returns the next element of "shard". Blocks if no data is available.
+   *
+   * @remark Only one thread may dequeue from a shard.
+   * @remark Contains a boost::thread interruption point. */
+  T Dequeue(size_t shard_index) {
+    MoveOverflow(shards_[shard_index]);
+    return shards_[shard_index]->queue.Dequeue();
+  }
+
+  /** Appends the next up to "max_elements" elements of "shard" to
+   *  "elements" and returns their number. Blocks if no data is available.
+   *
+   * @remark Only one thread may dequeue from a shard.
+   * @remark Contains a boost::thread interruption point. */
+  size_t DequeueBatch(size_t shard_index,
+                      size_t max_elements,
+                      std::vector<T>* elements) {
+    MoveOverflow(shards_[shard_index]);
+    return shards_[shard_index]->queue.DequeueBatch(max_elements, elements);
+  }
+
+  void GetStatistics(size_t shard_index, Statistics* statistics) const {
+    const Shard* shard = shards_[shard_index];
+    statistics->depth = static_cast<int64_t>(shard->queue.size()
+                                             + shard->overflow_size.load());
+    statistics->peak_depth = shard->peak_depth.load();
+    statistics->enqueued = shard->enqueued.load();
+    statistics->overflowed = shard->overflowed.load();
+  }
+
+ private:
+  struct Shard {
+    Shard(size_t capacity, int spin_count)
+        : queue(capacity, spin_count),
+          overflow_size(0),
+          peak_depth(0),
+          enqueued(0),
+          overflowed(0) {}
+
+    BoundedQueue<T> queue;
+
+    /** Elements of EnqueueWithoutBlocking() which did not fit into "queue",
+     *  in order. */
+    std::deque<T> overflow;
+
+    /** Size of "overflow", readable without "overflow_mutex". */
+    boost::atomic<size_t> overflow_size;
+
+    boost::mutex overflow_mutex;
+
+    boost::atomic<int64_t> peak_depth;
+
+    boost::atomic<uint64_t> enqueued;
+
+    boost::atomic<uint64_t> overflowed;
+  };
+
+  void Enqueued(Shard* shard) {
+    ++shard->enqueued;
+
+    const int64_t depth = static_cast<int64_t>(shard->queue.size()
+                                               + shard->overflow_size.load());
+    int64_t peak_depth = shard->peak_depth.load(boost::memory_order_relaxed);
+    while (depth > peak_depth &&
+           !shard->peak_depth.compare_exchange_weak(
+               peak_depth, depth, boost::memory_order_relaxed)) {
+    }
+  }
+
+  /** Moves overflowed elements into the free slots of the shard. Called by
+   *  the consumer before it dequeues: if elements are left in the overflow
+   *  list, the queue is full and the consumer does not sleep. */
+  static void MoveOverflow(Shard* shard) {
+    if (shard->overflow_size.load() == 0) {
+      return;
+    }
+    boost::mutex::scoped_lock lock(shard->overflow_mutex);
+    while (!shard->overflow.empty()
+           && shard->queue.TryEnqueue(shard->overflow.front())) {
+      shard->overflow.pop_front();
+      shard->overflow_size.fetch_sub(1);
+    }
+  }
+
+  std::vector<Shard*> shards_;
+};
+
+}  // namespace util
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_UTIL_SHARDED_QUEUE_H_
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifndef CPP_INCLUDE_UTIL_TTL_CACHE_H_
+#define CPP_INCLUDE_UTIL_TTL_CACHE_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include <boost/thread/mutex.hpp>
+#include <list>
+#include <map>
+
+namespace xtreemfs {
+namespace util {
+
+/** Thread-safe map whose entries expire "ttl_s" seconds after they were
+ *  added. At most "max_entries" entries are kept.
+ *
+ * Since all entries have the same lifetime, the oldest entry is the next to
+ * expire. It is evicted first if the cache is full.
+ *
+ * The cache is disabled (every Get() misses) until SetLimits() was called
+ * with non-zero values.
+ */
+template <typename Key, typename Value>
+class TTLCache {
+ public:
+  TTLCache() : max_entries_(0), ttl_s_(0), hits_(0), misses_(0) {}
+
+  /** Sets the limits and removes all entries. */
+  void SetLimits(size_t max_entries, int ttl_s) {
+    boost::mutex::scoped_lock lock(mutex_);
+    max_entries_ = max_entries;
+    ttl_s_ = ttl_s;
+    entries_.clear();
+    insertion_order_.clear();
+  }
+
+  bool enabled() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return max_entries_ > 0 && ttl_s_ > 0;
+  }
+
+  /** Copies the value of "key" into "value" if it did not expire yet.
+   *
+   * @returns true on a hit. */
+  bool Get(const Key& key, Value* value) {
+    boost::mutex::scoped_lock lock(mutex_);
+    typename EntryMap::iterator it = entries_.find(key);
+    if (it != entries_.end()) {
+      if (time(NULL) < it->second.expiration_time) {
+        *value = it->second.value;
+        ++hits_;
+        return true;
+      }
+      insertion_order_.erase(it->second.position);
+      entries_.erase(it);
+    }
+    ++misses_;
+    return false;
+  }
+
+  /** Adds or replaces the entry of "key". */
+  void Put(const Key& key, const Value& value) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (max_entries_ == 0 || ttl_s_ <= 0) {
+      return;
+    }
+
+    typename EntryMap::iterator it = entries_.find(key);
+    if (it != entries_.end()) {
+      insertion_order_.erase(it->second.position);
+      entries_.erase(it);
+    }
+    while (entries_.size() >= max_entries_) {
+      entries_.erase(insertion_order_.front());
+      insertion_order_.pop_front();
+    }
+
+    Entry& entry = entries_[key];
+    entry.value = value;
+    entry.expiration_time = time(NULL) + ttl_s_;
+    entry.position = insertion_order_.insert(insertion_order_.end(), key);
+  }
+
+  size_t Size() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return entries_.size();
+  }
+
+  uint64_t hits() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return hits_;
+  }
+
+  uint64_t misses() {
+    boost::mutex::scoped_lock lock(mutex_);
+    return misses_;
+  }
+
+ private:
+  struct Entry {
+    Value value;
+    time_t expiration_time;
+    /** Position of the key in insertion_order_. */
+    typename std::list<Key>::iterator position;
+  };
+
+  typedef std::map<Key, Entry> EntryMap;
+
+  boost::mutex mutex_;
+  size_t max_entries_;
+  int ttl_s_;
+  EntryMap entries_;
+  /** Keys of entries_, oldest first. */
+  std::list<Key> insertion_order_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+}  // namespace util
+}  // namespace xtreemfs
+
+#endif  // CPP_INCLUDE_UTIL_TTL_CACHE_H_
@@ -156,6 +156,17 @@ class XtfsUtilServer {
                    const Json::Value& input,
                    Json::Value* output);
 
+  /** Returns the recorded RPC request trace as Chrome trace or, if "format"
+   *  is "jsonl", as JSON lines. */
+  void OpGetRPCTrace(const xtreemfs::pbrpc::UserCredentials& uc,
+                     const Json::Value& input,
+                     Json::Value* output);
+
+  /** Returns the socket options applied to the connection to every server. */
+  void OpGetTransportProfiles(const xtreemfs::pbrpc::UserCredentials& uc,
+                              const Json::Value& input,
+                              Json::Value* output);
+
   /** Returns XtreemFS-specific attributes. */
   void OpStat(const xtreemfs::pbrpc::UserCredentials& uc,
               const Json::Value& input,
@@ -78,6 +78,16 @@ void FuseAdapter::Start(std::list<char*>* required_fuse_options) {
                     options_->log_file_path,
                     LEVEL_WARN);
 
+  // Looking up the user and groups of a process may involve the name service
+  // (e.g., LDAP) and is done for every request. Cache the results.
+  if (options_->credentials_cache_size > 0 &&
+      options_->credentials_cache_ttl_s > 0) {
+    user_credentials_cache_.SetLimits(options_->credentials_cache_size,
+                                      options_->credentials_cache_ttl_s);
+    system_user_mapping_.SetCacheLimits(options_->credentials_cache_size,
+                                        options_->credentials_cache_ttl_s);
+  }
+
 #ifdef __APPLE__
   // If the system is newer than Tiger, reduce the number of retries and warn
   // the user about it.
@@ -324,6 +334,16 @@ void FuseAdapter::Start(std::list<char*>* required_fuse_options) {
 void FuseAdapter::Stop() {
   system_user_mapping_.StopAdditionalUserMapping();
 
+  if (user_credentials_cache_.enabled() &&
+      Logging::log->loggingActive(LEVEL_INFO)) {
+    Logging::log->getLog(LEVEL_INFO)
+        << "User credentials cache: " << user_credentials_cache_.hits()
+        << " hits, " << user_credentials_cache_.misses() << " misses. "
+        << "User and group name caches: " << system_user_mapping_.cache_hits()
+        << " hits, " << system_user_mapping_.cache_misses() << " misses."
+        << endl;
+  }
+
   // Shutdown() Client. That does also invoke a volume->Close().
   if (client_.get()) {
     client_->Shutdown();
@@ -349,6 +369,18 @@ void FuseAdapter::GenerateUserCredentials(
     gid_t gid,
     pid_t pid,
     xtreemfs::pbrpc::UserCredentials* user_credentials) {
+  ProcessCredentialsKey key;
+  const bool use_cache = user_credentials_cache_.enabled();
+  if (use_cache) {
+    key.uid = uid;
+    key.gid = gid;
+    key.pid = pid;
+    key.start_time = SystemUserMappingUnix::GetProcessStartTime(pid);
+    if (user_credentials_cache_.Get(key, user_credentials)) {
+      return;
+    }
+  }
+
   user_credentials->set_username(system_user_mapping_.UIDToUsername(uid));
 
   list<string> groupnames;
@@ -357,6 +389,12 @@ void FuseAdapter::GenerateUserCredentials(
        it != groupnames.end(); ++it) {
     user_credentials->add_groups(*it);
   }
+
+  // Without a start time, the process cannot be told apart from a later one
+  // with the same pid.
+  if (use_cache && key.start_time != 0) {
+    user_credentials_cache_.Put(key, *user_credentials);
+  }
 }
 
 void FuseAdapter::SetInterruptQueryFunction() const {
@@ -63,6 +63,8 @@ FuseOptions::FuseOptions() : Options(), fuse_descriptions_("Fuse Options") {
 #endif  // __APPLE__
   foreground = false;
   use_fuse_permission_checks = true;
+  credentials_cache_size = 1024;
+  credentials_cache_ttl_s = 0;  // Disabled.
   fuse_permission_checks_explicitly_disabled = false;
 
   fuse_descriptions_.add_options()
@@ -75,7 +77,19 @@ FuseOptions::FuseOptions() : Options(), fuse_descriptions_("Fuse Options") {
     ("no-default-permissions",
         po::value(&fuse_permission_checks_explicitly_disabled)->zero_tokens(),
         "Do not pass -o default_permissions to Fuse (disables local Fuse"
-        " permissions checks).");
+        " permissions checks).")
+    ("credentials-cache-size",
+        po::value(&credentials_cache_size)
+            ->default_value(credentials_cache_size),
+        "Maximum number of cached user credentials of processes (and of cached"
+        " user and group names each).")
+    ("credentials-cache-ttl",
+        po::value(&credentials_cache_ttl_s)
+            ->default_value(credentials_cache_ttl_s),
+        "Time (in seconds) after which the user and group names of a process"
+        " are looked up again. 0 disables the caches. A process which changes"
+        " its supplementary groups (setgroups()) but keeps its uid and gid"
+        " uses its old groups for up to this time.");
   po::options_description fuse_options_information(
       "ACL and extended attributes Support:\n"
       "  -o xtreemfs_acl Enable the correct evaluation of XtreemFS ACLs.\n"
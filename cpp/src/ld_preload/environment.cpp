@@ -73,6 +73,8 @@ Environment::Environment() : volume_(NULL) {
                         xtreemfs::util::LEVEL_WARN);
 
   xprintf("enable_async_writes: %d\n", options_.enable_async_writes);
+  open_file_table_.SetBufferSizes(options_.read_ahead_kb * 1024,
+                                  options_.write_behind_kb * 1024);
 
   // user credentials:
   uid_t uid = getuid();
@@ -104,6 +106,9 @@ Environment::Environment() : volume_(NULL) {
 
 Environment::~Environment() {
   xprintf("Environment::~Environment(): Closing volume.\n");
+  // Files the application did not close need the volume for writing pending
+  // data and closing their handles.
+  open_file_table_.Clear();
 //  volume_ = client_->CloseVolume(volume_); // not in the Client interface, but performed implicitly in ClientImplementation::Shutdown
   client_->Shutdown();
   xprintf("Environment::~Environment()\n");
@@ -8,7 +8,12 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
 
 #include "ld_preload/passthrough.h"
 #include "ld_preload/preload.h"
@@ -56,6 +61,38 @@ int open64(__const char *path, int flags, ...) {
   return open(path, flags | O_LARGEFILE, mode);
 }
 
+int openat(int dirfd, __const char *path, int flags, ...) {
+  initialize_passthrough_if_necessary();
+  xprintf(" openat(%d, %s)\n", dirfd, path);
+
+  mode_t mode = 0;
+  if (flags & O_CREAT) {
+    va_list ap;
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+  }
+
+  std::string full_path;
+  if (overlay_initialized() && is_xtreemfs_at_path(dirfd, path, &full_path)) {
+    return xtreemfs_open(full_path.c_str(), flags, mode);
+  } else {
+    return ((funcptr_openat)libc_openat)(dirfd, path, flags, mode);
+  }
+}
+
+int openat64(int dirfd, __const char *path, int flags, ...) {
+  mode_t mode = 0;
+  if (flags & O_CREAT) {
+    va_list ap;
+    va_start(ap, flags);
+    mode = va_arg(ap, mode_t);
+    va_end(ap);
+  }
+
+  return openat(dirfd, path, flags | O_LARGEFILE, mode);
+}
+
 #undef creat
 int creat(__const char *name, mode_t mode) {
   return open(name, O_CREAT | O_WRONLY | O_TRUNC, mode);
@@ -146,15 +183,158 @@ ssize_t write(int fd, const void* buf, size_t nbyte) {
   }
 }
 
+ssize_t pwrite(int fd, const void* buf, size_t nbyte, off_t offset) {
+  initialize_passthrough_if_necessary();
+  xprintf(" pwrite(%d)\n", fd);
+
+  if (overlay_initialized() && is_xtreemfs_fd(fd)) {
+    return xtreemfs_pwrite(fd, buf, nbyte, offset);
+  } else {
+    return ((funcptr_pwrite)libc_pwrite)(fd, buf, nbyte, offset);
+  }
+}
+
+ssize_t pwrite64(int fd, const void* buf, size_t nbyte, __off64_t offset) {
+  return pwrite(fd, buf, nbyte, offset);
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt) {
+  initialize_passthrough_if_necessary();
+  xprintf(" readv(%d)\n", fd);
+
+  if (overlay_initialized() && is_xtreemfs_fd(fd)) {
+    return xtreemfs_readv(fd, iov, iovcnt);
+  } else {
+    return ((funcptr_readv)libc_readv)(fd, iov, iovcnt);
+  }
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+  initialize_passthrough_if_necessary();
+  xprintf(" writev(%d)\n", fd);
+
+  if (overlay_initialized() && is_xtreemfs_fd(fd)) {
+    return xtreemfs_writev(fd, iov, iovcnt);
+  } else {
+    return ((funcptr_writev)libc_writev)(fd, iov, iovcnt);
+  }
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
+  initialize_passthrough_if_necessary();
+  xprintf(" sendfile(%d, %d)\n", out_fd, in_fd);
+
+  if (overlay_initialized() && (is_xtreemfs_fd(in_fd) || is_xtreemfs_fd(out_fd))) {
+    off64_t in_offset = offset ? *offset : 0;
+    ssize_t ret = xtreemfs_copy(in_fd, offset ? &in_offset : NULL, out_fd, NULL, count);
+    if (offset) {
+      *offset = in_offset;
+    }
+    return ret;
+  } else {
+    return ((funcptr_sendfile)libc_sendfile)(out_fd, in_fd, offset, count);
+  }
+}
+
+ssize_t sendfile64(int out_fd, int in_fd, __off64_t* offset, size_t count) {
+  return sendfile(out_fd, in_fd, offset, count);
+}
+
+ssize_t copy_file_range(int fd_in, __off64_t* off_in, int fd_out, __off64_t* off_out, size_t len, unsigned int flags) {
+  initialize_passthrough_if_necessary();
+  xprintf(" copy_file_range(%d, %d)\n", fd_in, fd_out);
+
+  if (overlay_initialized() && (is_xtreemfs_fd(fd_in) || is_xtreemfs_fd(fd_out))) {
+    if (flags != 0) {
+      errno = EINVAL;
+      return -1;
+    }
+    return xtreemfs_copy(fd_in, off_in, fd_out, off_out, len);
+  } else if (libc_copy_file_range == NULL) {
+    errno = ENOSYS;
+    return -1;
+  } else {
+    return ((funcptr_copy_file_range)libc_copy_file_range)(fd_in, off_in, fd_out, off_out, len, flags);
+  }
+}
+
+int fsync(int fd) {
+  initialize_passthrough_if_necessary();
+  xprintf(" fsync(%d)\n", fd);
+
+  if (overlay_initialized() && is_xtreemfs_fd(fd)) {
+    return xtreemfs_fsync(fd);
+  } else {
+    return ((funcptr_fsync)libc_fsync)(fd);
+  }
+}
+
+int fdatasync(int fd) {
+  initialize_passthrough_if_necessary();
+  xprintf(" fdatasync(%d)\n", fd);
+
+  if (overlay_initialized() && is_xtreemfs_fd(fd)) {
+    return xtreemfs_fsync(fd);
+  } else {
+    return ((funcptr_fdatasync)libc_fdatasync)(fd);
+  }
+}
+
+void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) {
+  initialize_passthrough_if_necessary();
+  // No xprintf() here, mmap() is called by malloc().
+
+  if (fd != -1 && overlay_initialized() && is_xtreemfs_fd(fd)) {
+    return xtreemfs_mmap(addr, length, prot, flags, fd, offset);
+  } else {
+    return ((funcptr_mmap)libc_mmap)(addr, length, prot, flags, fd, offset);
+  }
+}
+
+void* mmap64(void* addr, size_t length, int prot, int flags, int fd, __off64_t offset) {
+  return mmap(addr, length, prot, flags, fd, offset);
+}
+
+int munmap(void* addr, size_t length) {
+  initialize_passthrough_if_necessary();
+
+  if (overlay_initialized() && is_xtreemfs_mapping(addr, length)) {
+    return xtreemfs_munmap(addr, length);
+  } else {
+    return ((funcptr_munmap)libc_munmap)(addr, length);
+  }
+}
+
+int msync(void* addr, size_t length, int flags) {
+  initialize_passthrough_if_necessary();
+  xprintf(" msync(%p)\n", addr);
+
+  if (overlay_initialized() && is_xtreemfs_mapping(addr, length)) {
+    return xtreemfs_msync(addr, length, flags);
+  } else {
+    return ((funcptr_msync)libc_msync)(addr, length, flags);
+  }
+}
+
+ssize_t getdents64(int fd, void* dirp, size_t count) {
+  initialize_passthrough_if_necessary();
+  xprintf(" getdents64(%d)\n", fd);
+
+  if (overlay_initialized() && is_xtreemfs_fd(fd)) {
+    return xtreemfs_getdents64(fd, dirp, count);
+  } else if (libc_getdents64 == NULL) {
+    return syscall(SYS_getdents64, fd, dirp, count);
+  } else {
+    return ((funcptr_getdents64)libc_getdents64)(fd, dirp, count);
+  }
+}
+
 int dup(int oldfd) {
   initialize_passthrough_if_necessary();
   xprintf(" dup(%d)\n", oldfd);
 
   if (overlay_initialized() && is_xtreemfs_fd(oldfd)) {
-    //xprintf("calling xtreemfs dup(%d)\n", oldfd);
-    //return xtreemfs_dup(oldfd);
-    xprintf(" NOT IMPLEMENTED: dup for xtreemfs fd(%d)\n", oldfd);
-    return -1;
+    return xtreemfs_dup(oldfd);
   } else {
     xprintf(" calling pasthrought dup(%d)\n", oldfd);
     return ((funcptr_dup)libc_dup)(oldfd);
@@ -165,27 +345,17 @@ int dup2(int oldfd, int newfd) {
   initialize_passthrough_if_necessary();
   xprintf(" dup2(%d, %d)\n", oldfd, newfd);
 
-  if (overlay_initialized() && (is_xtreemfs_fd(newfd) || is_xtreemfs_fd(oldfd))) {
-    xprintf(" NOT IMPLEMENTED: dup2 for xtreemfs fd(%d, %d)\n", oldfd, newfd);
-    return -1;
+  if (overlay_initialized() && is_xtreemfs_fd(oldfd)) {
+    return xtreemfs_dup2(oldfd, newfd);
+  } else if (overlay_initialized() && is_xtreemfs_fd(newfd)) {
+    // Unlike dup2() of two system fds, this is not atomic: the XtreemFS file
+    // is closed first.
+    xprintf(" dest is xtreemfs fd\n");
+    xtreemfs_close(newfd);
+    return ((funcptr_dup2)libc_dup2)(oldfd, newfd);
   } else {
     return ((funcptr_dup2)libc_dup2)(oldfd, newfd);
   }
-
-//  if (overlay_initialized() && is_xtreemfs_fd(newfd)) {
-//    xprintf(" dest is xtreemfs fd\n");
-//    xtreemfs_close(newfd);
-//  } else {
-//    xprintf(" dest is system fd\n");
-//    ((funcptr_close)libc_close)(newfd);
-//  }
-//
-//  if (overlay_initialized() && is_xtreemfs_fd(oldfd)) {
-//    return xtreemfs_dup2(oldfd, newfd);
-//  } else {
-//    xprintf(" dup2 passthrough\n");
-//    return ((funcptr_dup2)libc_dup2)(oldfd, newfd);
-//  }
 }
 
 off_t lseek(int fd, off_t offset, int mode) {
@@ -199,6 +369,21 @@ off_t lseek(int fd, off_t offset, int mode) {
   }
 }
 
+int posix_fadvise(int fd, off_t offset, off_t len, int advice) {
+  initialize_passthrough_if_necessary();
+  xprintf(" posix_fadvise(%d, %ld, %ld, %d)\n", fd, offset, len, advice);
+
+  if (overlay_initialized() && is_xtreemfs_fd(fd)) {
+    return xtreemfs_posix_fadvise(fd, offset, len, advice);
+  } else {
+    return ((funcptr_posix_fadvise)libc_posix_fadvise)(fd, offset, len, advice);
+  }
+}
+
+int posix_fadvise64(int fd, __off64_t offset, __off64_t len, int advice) {
+  return posix_fadvise(fd, offset, len, advice);
+}
+
 int stat(const char *path, struct stat *buf) {
   initialize_passthrough_if_necessary();
   xprintf(" stat(%s, ...)\n", path);
@@ -297,19 +482,62 @@ extern int __lxstat64(int ver, const char *path, struct stat64 *buf) {
   }
 }
 
-/*
-extern int __fxstatat(int __ver, int __fildes, const char *__filename, struct stat *__stat_buf, int __flag) {
+int fstatat(int dirfd, const char *path, struct stat *buf, int flags) {
   initialize_passthrough_if_necessary();
-  xprintf(" __fxstatat\n");
-  return -1;
+  xprintf(" fstatat(%d, %s, ...)\n", dirfd, path);
+
+  std::string full_path;
+  if (overlay_initialized()) {
+    if ((flags & AT_EMPTY_PATH) && path[0] == '\0' && is_xtreemfs_fd(dirfd)) {
+      return xtreemfs_fstat(dirfd, buf);
+    }
+    if (is_xtreemfs_at_path(dirfd, path, &full_path)) {
+      return xtreemfs_stat(full_path.c_str(), buf);
+    }
+  }
+  return ((funcptr_fstatat)libc_fstatat)(dirfd, path, buf, flags);
 }
 
-extern int __fxstatat64(int __ver, int __fildes, const char *__filename, struct stat64 *__stat_buf, int __flag) {
+int fstatat64(int dirfd, const char *path, struct stat64 *buf, int flags) {
   initialize_passthrough_if_necessary();
-  xprintf(" __fxstatat64\n");
-  return -1;
+  xprintf(" fstatat64(%d, %s, ...)\n", dirfd, path);
+
+  std::string full_path;
+  if (overlay_initialized()) {
+    if ((flags & AT_EMPTY_PATH) && path[0] == '\0' && is_xtreemfs_fd(dirfd)) {
+      return xtreemfs_fstat64(dirfd, buf);
+    }
+    if (is_xtreemfs_at_path(dirfd, path, &full_path)) {
+      return xtreemfs_stat64(full_path.c_str(), buf);
+    }
+  }
+  // struct stat and struct stat64 are identical on 64 bit systems.
+  return ((funcptr_fstatat)libc_fstatat)(dirfd, path, reinterpret_cast<struct stat*>(buf), flags);
+}
+
+extern int __fxstatat(int ver, int dirfd, const char *path, struct stat *buf, int flags) {
+  initialize_passthrough_if_necessary();
+  xprintf(" __fxstatat(%d, %d, %s, ...)\n", ver, dirfd, path);
+
+  std::string full_path;
+  if (overlay_initialized() && is_xtreemfs_at_path(dirfd, path, &full_path)) {
+    return xtreemfs_stat(full_path.c_str(), buf);
+  } else {
+    return ((funcptr___fxstatat)libc___fxstatat)(ver, dirfd, path, buf, flags);
+  }
+}
+
+extern int __fxstatat64(int ver, int dirfd, const char *path, struct stat64 *buf, int flags) {
+  initialize_passthrough_if_necessary();
+  xprintf(" __fxstatat64(%d, %d, %s, ...)\n", ver, dirfd, path);
+
+  std::string full_path;
+  if (overlay_initialized() && is_xtreemfs_at_path(dirfd, path, &full_path)) {
+    return xtreemfs_stat64(full_path.c_str(), buf);
+  } else {
+    return ((funcptr___fxstatat64)libc___fxstatat64)(ver, dirfd, path, buf, flags);
+  }
 }
-*/
 
 FILE *fopen(const char *path, const char *mode) {
   initialize_passthrough_if_necessary();
@@ -326,8 +554,7 @@ int truncate(const char *path, off_t length) {
   xprintf(" truncate(%s, %ld)\n", path, length);
 
   if (overlay_initialized() && is_xtreemfs_path(path)) {
-    xprintf("  NOT IMPLEMENTED: truncate for xtreemfs (%s)\n", path);
-    return -1;
+    return xtreemfs_truncate(path, length);
   } else {
     return ((funcptr_truncate)libc_truncate)(path, length);
   }
@@ -338,8 +565,7 @@ int ftruncate(int fd, off_t length) {
   xprintf(" ftruncate(%d, %ld)\n", fd, length);
 
   if (overlay_initialized() && is_xtreemfs_fd(fd)) {
-    xprintf(" NOT IMPLEMENTED: ftruncate for xtreemfs fd(%d)", fd);
-    return -1;
+    return xtreemfs_ftruncate(fd, length);
   } else {
     return ((funcptr_ftruncate)libc_ftruncate)(fd, length);
   }
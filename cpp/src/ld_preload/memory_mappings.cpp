@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "ld_preload/memory_mappings.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <boost/thread/lock_guard.hpp>
+
+#include "libxtreemfs/file_handle.h"
+
+MappedFile::MappedFile(xtreemfs::FileHandle* fh,
+                       const char* address,
+                       size_t file_length)
+    : fh(fh), address(address), original(address, address + file_length) {
+}
+
+MappedFile::~MappedFile() {
+  if (fh != NULL) {
+    try {
+      fh->Close();
+    } catch(...) {
+    }
+  }
+}
+
+void MemoryMapping::GetModifiedRanges(
+    size_t start,
+    size_t length,
+    size_t page_size,
+    std::vector<std::pair<size_t, size_t> >* ranges) const {
+  const size_t end = std::min(std::min(start + length, this->length),
+                              file_length);
+  if (!file || start >= end) {
+    return;
+  }
+  const char* original = &file->original[address - file->address];
+  // Pages are aligned relative to the start of the whole mapping.
+  const size_t mapping_offset = address - file->address;
+  size_t position = start;
+  while (position < end) {
+    const size_t page_end = std::min(
+        end,
+        ((mapping_offset + position) / page_size + 1) * page_size
+            - mapping_offset);
+    if (memcmp(address + position,
+               original + position,
+               page_end - position) != 0) {
+      if (!ranges->empty()
+          && ranges->back().first + ranges->back().second == position) {
+        ranges->back().second += page_end - position;
+      } else {
+        ranges->push_back(std::make_pair(position, page_end - position));
+      }
+    }
+    position = page_end;
+  }
+}
+
+void MemoryMapping::SetWrittenBack(size_t start, size_t length) const {
+  memcpy(&file->original[address - file->address + start],
+         address + start,
+         length);
+}
+
+MemoryMappings::MemoryMappings() : count_(0) {
+}
+
+void MemoryMappings::Add(const MemoryMapping& mapping) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  mappings_[mapping.address] = mapping;
+  count_.store(mappings_.size());
+}
+
+MemoryMapping MemoryMappings::Part(const MemoryMapping& mapping,
+                                   char* start,
+                                   char* end) {
+  MemoryMapping part = mapping;
+  const size_t skipped = start - mapping.address;
+  part.address = start;
+  part.length = end - start;
+  part.offset = mapping.offset + skipped;
+  part.file_length = mapping.file_length > skipped
+      ? std::min(mapping.file_length - skipped, part.length) : 0;
+  return part;
+}
+
+MemoryMappings::MappingMap::iterator MemoryMappings::FirstCandidate(
+    char* address) {
+  // The mapping before the first one which starts after "address" may
+  // contain it.
+  MappingMap::iterator i = mappings_.upper_bound(address);
+  if (i != mappings_.begin()) {
+    --i;
+  }
+  return i;
+}
+
+void MemoryMappings::Remove(void* address,
+                            size_t length,
+                            std::vector<MemoryMapping>* removed) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  char* start = static_cast<char*>(address);
+  char* end = start + length;
+  MappingMap::iterator i = FirstCandidate(start);
+  while (i != mappings_.end() && i->first < end) {
+    const MemoryMapping mapping = i->second;
+    char* mapping_end = mapping.address + mapping.length;
+    if (mapping_end <= start) {
+      ++i;
+      continue;
+    }
+    mappings_.erase(i++);
+    char* removed_start = std::max(start, mapping.address);
+    char* removed_end = std::min(end, mapping_end);
+    removed->push_back(Part(mapping, removed_start, removed_end));
+    if (mapping.address < removed_start) {
+      mappings_[mapping.address] =
+          Part(mapping, mapping.address, removed_start);
+    }
+    if (removed_end < mapping_end) {
+      mappings_[removed_end] = Part(mapping, removed_end, mapping_end);
+    }
+  }
+  count_.store(mappings_.size());
+}
+
+void MemoryMappings::Find(void* address,
+                          size_t length,
+                          std::vector<MemoryMapping>* found) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  char* start = static_cast<char*>(address);
+  char* end = start + length;
+  for (MappingMap::iterator i = FirstCandidate(start);
+       i != mappings_.end() && i->first < end;
+       ++i) {
+    char* mapping_end = i->second.address + i->second.length;
+    if (mapping_end > start) {
+      found->push_back(Part(i->second,
+                            std::max(start, i->second.address),
+                            std::min(end, mapping_end)));
+    }
+  }
+}
+
+bool MemoryMappings::Overlaps(void* address, size_t length) {
+  std::vector<MemoryMapping> found;
+  Find(address, length, &found);
+  return !found.empty();
+}
+
+bool MemoryMappings::Empty() const {
+  return count_.load() == 0;
+}
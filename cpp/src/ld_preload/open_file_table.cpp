@@ -7,95 +7,399 @@
 
 #include "ld_preload/open_file_table.h"
 
+#include <algorithm>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+
 #include <boost/thread/lock_guard.hpp>
 
+#include "xtreemfs/MRC.pb.h"
 #include "ld_preload/passthrough.h"
 
-OpenFile::OpenFile(xtreemfs::FileHandle* fh) : fh_(fh), offset_(0), tmp_file_(NULL), tmp_file_fd_(-1) {
+/** Upper bound for the size of the fd table (8 MB on 64 bit systems). */
+static const int kMaxFileDescriptors = 1 << 20;
+/** Size of the fd table if the hard limit of open files is unlimited. */
+static const int kDefaultFileDescriptors = 1 << 16;
+
+OpenFile::OpenFile(xtreemfs::FileHandle* fh,
+                   const std::string& path,
+                   int flags,
+                   size_t read_ahead_size,
+                   size_t write_behind_size)
+    : fh_(fh),
+      path_(path),
+      flags_(flags),
+      closed_(false),
+      offset_(0),
+      read_ahead_size_(read_ahead_size),
+      read_ahead_mode_(kReadAheadNormal),
+      read_ahead_offset_(0),
+      read_ahead_length_(0),
+      read_ahead_eof_(false),
+      write_behind_size_(write_behind_size),
+      write_behind_offset_(0) {
 }
 
-void OpenFile::Initialise() {
-  tmp_file_ = tmpfile();
-  tmp_file_fd_ = fileno(tmp_file_);
+OpenFile::~OpenFile() {
+  if (fh_ != NULL && !closed_) {
+    try {
+      Close();
+    } catch(...) {
+      xprintf(" closing %s failed\n", path_.c_str());
+    }
+  }
+}
+
+int OpenFile::Read(char* buf, size_t count, int64_t offset) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  return ReadLocked(buf, count, offset);
+}
+
+int OpenFile::Read(char* buf, size_t count) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  int read = ReadLocked(buf, count, offset_);
+  offset_ += read;
+  return read;
 }
 
-void OpenFile::Deinitialise() {
-  if (tmp_file_ != NULL) {
-    fclose(tmp_file_);
-    tmp_file_ = NULL;
-    tmp_file_fd_ = -1;
+int OpenFile::ReadLocked(char* buf, size_t count, int64_t offset) {
+  // Pending writes have to be visible to the read.
+  FlushWriteBehindLocked();
+
+  if (read_ahead_length_ > 0
+      && offset >= read_ahead_offset_
+      && offset < read_ahead_offset_
+                  + static_cast<int64_t>(read_ahead_length_)) {
+    const size_t available = static_cast<size_t>(
+        read_ahead_offset_ + read_ahead_length_ - offset);
+    const size_t copied = std::min(count, available);
+    memcpy(buf,
+           &read_ahead_buffer_[static_cast<size_t>(offset - read_ahead_offset_)],
+           copied);
+    if (copied == count || read_ahead_eof_) {
+      return copied;
+    }
+    // The buffer ended before EOF, continue with the next chunk.
+    return copied + ReadLocked(buf + copied, count - copied, offset + copied);
   }
+
+  const size_t read_ahead_size = GetReadAheadSize();
+  if (count < read_ahead_size) {
+    FillReadAheadBuffer(offset, read_ahead_size);
+    const size_t copied = std::min(count, read_ahead_length_);
+    memcpy(buf, &read_ahead_buffer_[0], copied);
+    return copied;
+  }
+
+  return fh_->Read(buf, count, offset);
+}
+
+void OpenFile::FillReadAheadBuffer(int64_t offset, size_t size) {
+  read_ahead_length_ = 0;
+  if (read_ahead_buffer_.size() < size) {
+    read_ahead_buffer_.resize(size);
+  }
+  const int read = fh_->Read(&read_ahead_buffer_[0], size, offset);
+  read_ahead_offset_ = offset;
+  read_ahead_length_ = read > 0 ? read : 0;
+  read_ahead_eof_ = read_ahead_length_ < size;
 }
 
-int OpenFile::GetFileDescriptor() {
-  return tmp_file_fd_;
+size_t OpenFile::GetReadAheadSize() const {
+  switch (read_ahead_mode_) {
+    case kReadAheadSequential:
+      return 2 * read_ahead_size_;
+    case kReadAheadRandom:
+      return 0;
+    default:
+      return read_ahead_size_;
+  }
 }
 
-OpenFileTable::OpenFileTable() {
+int OpenFile::Write(const char* buf, size_t count, int64_t offset) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  return WriteLocked(buf, count, offset);
+}
+
+int OpenFile::Write(const char* buf, size_t count) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  int written = WriteLocked(buf, count, offset_);
+  offset_ += written;
+  return written;
+}
+
+int OpenFile::WriteLocked(const char* buf, size_t count, int64_t offset) {
+  // Drop read-ahead data which is overwritten.
+  if (read_ahead_length_ > 0
+      && offset < read_ahead_offset_
+                  + static_cast<int64_t>(read_ahead_length_)
+      && offset + static_cast<int64_t>(count) > read_ahead_offset_) {
+    read_ahead_length_ = 0;
+  }
+
+  if (count >= write_behind_size_) {
+    FlushWriteBehindLocked();
+    return fh_->Write(buf, count, offset);
+  }
+
+  // Only consecutive writes are combined.
+  if (!write_behind_buffer_.empty()
+      && (offset != write_behind_offset_
+                    + static_cast<int64_t>(write_behind_buffer_.size())
+          || write_behind_buffer_.size() + count > write_behind_size_)) {
+    FlushWriteBehindLocked();
+  }
+  if (write_behind_buffer_.empty()) {
+    write_behind_buffer_.reserve(write_behind_size_);
+    write_behind_offset_ = offset;
+  }
+  write_behind_buffer_.insert(write_behind_buffer_.end(), buf, buf + count);
+  return count;
+}
+
+void OpenFile::Truncate(
+    const xtreemfs::pbrpc::UserCredentials& user_credentials,
+    int64_t new_file_size) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  FlushWriteBehindLocked();
+  read_ahead_length_ = 0;
+  fh_->Truncate(user_credentials, new_file_size);
+}
+
+void OpenFile::Sync() {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  FlushWriteBehindLocked();
+  fh_->Flush();
+}
+
+int64_t OpenFile::Seek(
+    int64_t offset,
+    int whence,
+    const xtreemfs::pbrpc::UserCredentials& user_credentials) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+
+  switch (whence) {
+    case SEEK_SET:
+      offset_ = offset;
+      return offset_;
+    case SEEK_CUR:
+      offset_ += offset;
+      return offset_;
+    case SEEK_END: {
+      FlushWriteBehindLocked();
+      xtreemfs::pbrpc::Stat stat;
+      fh_->GetAttr(user_credentials, &stat);
+      offset_ = stat.size() + offset;
+      return offset_;
+    }
+  }
+  return -1;
+}
+
+void OpenFile::FlushWriteBehind() {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  FlushWriteBehindLocked();
+}
+
+void OpenFile::FlushWriteBehindLocked() {
+  if (write_behind_buffer_.empty()) {
+    return;
+  }
+  // The application was told that the data was written: keep it if the write
+  // fails, the error is reported by the calling write, fsync or close.
+  fh_->Write(&write_behind_buffer_[0],
+             write_behind_buffer_.size(),
+             write_behind_offset_);
+  write_behind_buffer_.clear();
+}
+
+void OpenFile::DropBuffers() {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  DropBuffersLocked();
+}
+
+void OpenFile::DropBuffersLocked() {
+  FlushWriteBehindLocked();
+  read_ahead_length_ = 0;
+  std::vector<char>().swap(read_ahead_buffer_);
+}
+
+void OpenFile::Close() {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+  closed_ = true;
+  if (fh_ == NULL) {
+    return;
+  }
+  try {
+    FlushWriteBehindLocked();
+  } catch(...) {
+    write_behind_buffer_.clear();
+    fh_->Close();
+    throw;
+  }
+  fh_->Close();  // implicit Flush()
+}
+
+void OpenFile::Advise(int64_t offset, int64_t length, int advice) {
+  boost::lock_guard<boost::mutex> guard(mutex_);
+
+  switch (advice) {
+    case POSIX_FADV_NORMAL:
+      read_ahead_mode_ = kReadAheadNormal;
+      break;
+    case POSIX_FADV_SEQUENTIAL:
+      read_ahead_mode_ = kReadAheadSequential;
+      break;
+    case POSIX_FADV_RANDOM:
+      read_ahead_mode_ = kReadAheadRandom;
+      read_ahead_length_ = 0;
+      break;
+    case POSIX_FADV_WILLNEED: {
+      // Prefetch the range, but not more than a sequential read-ahead.
+      size_t size = 2 * read_ahead_size_;
+      if (length > 0 && static_cast<uint64_t>(length) < size) {
+        size = static_cast<size_t>(length);
+      }
+      if (size > 0) {
+        FlushWriteBehindLocked();
+        FillReadAheadBuffer(offset, size);
+      }
+      break;
+    }
+    case POSIX_FADV_DONTNEED:
+      DropBuffersLocked();
+      break;
+  }
+}
+
+OpenFileTable::OpenFileTable()
+    : open_files_(NULL),
+      max_fds_(kDefaultFileDescriptors),
+      read_ahead_size_(0),
+      write_behind_size_(0) {
   // open a temporary file as base for returning valid file descriptors that do no interfere with the passthrough values
   tmp_file_ = tmpfile();
-  tmp_file_fd_ = fileno(tmp_file_);
-  next_fd_ = 10000;
+  tmp_file_fd_ = tmp_file_ ? fileno(tmp_file_) : -1;
+
+  // The fds are bound by the limit of open files.
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_max != RLIM_INFINITY) {
+    max_fds_ = static_cast<int>(std::min(
+        limit.rlim_max, static_cast<rlim_t>(kMaxFileDescriptors)));
+  }
+  open_files_ = new boost::shared_ptr<OpenFile>[max_fds_];
 }
 
 OpenFileTable::~OpenFileTable() {
+  delete [] open_files_;
   fclose(tmp_file_);
 }
 
-int OpenFileTable::Register(xtreemfs::FileHandle* handle) {
+void OpenFileTable::SetBufferSizes(size_t read_ahead_size,
+                                   size_t write_behind_size) {
   boost::lock_guard<boost::mutex> guard(mutex_);
-  //const int fd = ((funcptr_dup)libc_dup)(tmp_file_fd_); // NOTE: calling dup(tmp_file_fd_) would lead to a deadlock here
-  OpenFile open_file(handle);
-  open_file.Initialise();
-  const int fd = open_file.GetFileDescriptor();
-//    const int fd = next_fd_++;
-  open_files_.insert(std::make_pair(fd, open_file));
+  read_ahead_size_ = read_ahead_size;
+  write_behind_size_ = write_behind_size;
+}
+
+int OpenFileTable::AddUnmutexed(
+    const boost::shared_ptr<OpenFile>& open_file) {
+  // NOTE: dup() instead of libc's dup() would be intercepted and deadlock.
+  const int fd = ((funcptr_dup)libc_dup)(tmp_file_fd_);
+  if (fd < 0) {
+    return -1;
+  }
+  if (fd >= max_fds_) {
+    xprintf(" fd(%d) out of range of the open file table\n", fd);
+    ((funcptr_close)libc_close)(fd);
+    errno = EMFILE;
+    return -1;
+  }
+  boost::atomic_store(&open_files_[fd], open_file);
   xprintf(" +fd(%d)\n", fd);
   return fd;
 }
 
-void OpenFileTable::Unregister(int fd) {
+int OpenFileTable::Register(xtreemfs::FileHandle* handle,
+                            const std::string& path,
+                            int flags) {
   boost::lock_guard<boost::mutex> guard(mutex_);
-  FileTable::iterator i = open_files_.find(fd);
-  if (i == open_files_.end()) {
-    assert(false);
-  } else {
-    i->second.Deinitialise();
+  boost::shared_ptr<OpenFile> open_file(new OpenFile(handle,
+                                                     path,
+                                                     flags,
+                                                     read_ahead_size_,
+                                                     write_behind_size_));
+  const int fd = AddUnmutexed(open_file);
+  if (fd == -1) {
+    // The caller closes the handle.
+    open_file->fh_ = NULL;
   }
-  open_files_.erase(fd);
-  //((funcptr_close)libc_close)(fd); // close(fd);
-  xprintf(" -fd(%d)\n", fd);
+  return fd;
 }
 
-OpenFile OpenFileTable::Get(int fd) {
+int OpenFileTable::Duplicate(int fd) {
   boost::lock_guard<boost::mutex> guard(mutex_);
-  FileTable::iterator i = open_files_.find(fd);
-  if (i == open_files_.end()) {
-    return OpenFile(NULL);
-  } else {
-    return i->second;
+  boost::shared_ptr<OpenFile> open_file = Get(fd);
+  if (!open_file) {
+    errno = EBADF;
+    return -1;
   }
+  return AddUnmutexed(open_file);
 }
 
-int OpenFileTable::Set(int fd, xtreemfs::FileHandle* handle) {
-  xprintf(" +fd(%d)\n", fd);
+int OpenFileTable::Duplicate(int fd, int new_fd) {
+  // Declared before the guard: a replaced file is closed without the mutex.
+  boost::shared_ptr<OpenFile> replaced;
   boost::lock_guard<boost::mutex> guard(mutex_);
-  // TODO: fix, see Register
-  open_files_.insert(std::make_pair(fd, OpenFile(handle)));
-  return fd;
+  boost::shared_ptr<OpenFile> open_file = Get(fd);
+  if (!open_file || new_fd < 0 || new_fd >= max_fds_) {
+    errno = EBADF;
+    return -1;
+  }
+  if (fd == new_fd) {
+    return new_fd;
+  }
+  // Reserves new_fd and atomically closes whatever it referred to.
+  if (((funcptr_dup2)libc_dup2)(tmp_file_fd_, new_fd) == -1) {
+    return -1;
+  }
+  replaced = boost::atomic_exchange(&open_files_[new_fd], open_file);
+  xprintf(" +fd(%d)\n", new_fd);
+  return new_fd;
 }
 
-void OpenFileTable::SetOffset(int fd, uint64_t offset) {
+boost::shared_ptr<OpenFile> OpenFileTable::Unregister(int fd) {
   boost::lock_guard<boost::mutex> guard(mutex_);
-  FileTable::iterator i = open_files_.find(fd);
-  if (i == open_files_.end()) {
-    return;
-  } else {
-    i->second.offset_ = offset;
+  if (fd < 0 || fd >= max_fds_) {
+    return boost::shared_ptr<OpenFile>();
+  }
+  boost::shared_ptr<OpenFile> open_file = boost::atomic_exchange(
+      &open_files_[fd], boost::shared_ptr<OpenFile>());
+  if (open_file) {
+    // The fd may be reused by another open from now on.
+    ((funcptr_close)libc_close)(fd);
   }
+  xprintf(" -fd(%d)\n", fd);
+  return open_file;
+}
+
+boost::shared_ptr<OpenFile> OpenFileTable::Get(int fd) {
+  if (fd < 0 || fd >= max_fds_) {
+    return boost::shared_ptr<OpenFile>();
+  }
+  return boost::atomic_load(&open_files_[fd]);
 }
 
 bool OpenFileTable::Has(int fd) {
-  boost::lock_guard<boost::mutex> guard(mutex_);
-  return open_files_.find(fd) != open_files_.end();
+  return Get(fd).get() != NULL;
+}
+
+void OpenFileTable::Clear() {
+  for (int fd = 0; fd < max_fds_; ++fd) {
+    if (Has(fd)) {
+      Unregister(fd);
+    }
+  }
 }
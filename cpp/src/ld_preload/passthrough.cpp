@@ -13,15 +13,27 @@
 
 void* libc;
 void* libc_open;
+void* libc_openat;
 void* libc_close;
 void* libc___close;
 void* libc_read;
 void* libc_write;
 void* libc_pread;
 void* libc_pwrite;
+void* libc_readv;
+void* libc_writev;
+void* libc_sendfile;
+void* libc_copy_file_range;
+void* libc_fsync;
+void* libc_fdatasync;
+void* libc_mmap;
+void* libc_munmap;
+void* libc_msync;
+void* libc_getdents64;
 void* libc_dup;
 void* libc_dup2;
 void* libc_lseek;
+void* libc_posix_fadvise;
 void* libc_stat;
 void* libc_fstat;
 void* libc___xstat;
@@ -30,6 +42,9 @@ void* libc___fxstat;
 void* libc___fxstat64;
 void* libc___lxstat;
 void* libc___lxstat64;
+void* libc_fstatat;
+void* libc___fxstatat;
+void* libc___fxstatat64;
 
 void* libc_fopen;
 void* libc_truncate;
@@ -52,15 +67,27 @@ static void initialize_passthrough() {
   xprintf("initialize_passthrough(): Setting up pass-through\n");
   libc = dlopen("libc.so.6", RTLD_LAZY); // TODO: link with correct libc, version vs. 32 bit vs. 64 bit
   libc_open = dlsym(libc, "open");
+  libc_openat = dlsym(libc, "openat");
   libc_close = dlsym(libc, "close");
   libc___close = dlsym(libc, "__close");
   libc_read = dlsym(libc, "read");
   libc_write = dlsym(libc, "write");
   libc_pread = dlsym(libc, "pread");
   libc_pwrite = dlsym(libc, "pwrite");
+  libc_readv = dlsym(libc, "readv");
+  libc_writev = dlsym(libc, "writev");
+  libc_sendfile = dlsym(libc, "sendfile");
+  libc_copy_file_range = dlsym(libc, "copy_file_range");  // NULL before glibc 2.27
+  libc_fsync = dlsym(libc, "fsync");
+  libc_fdatasync = dlsym(libc, "fdatasync");
+  libc_mmap = dlsym(libc, "mmap");
+  libc_munmap = dlsym(libc, "munmap");
+  libc_msync = dlsym(libc, "msync");
+  libc_getdents64 = dlsym(libc, "getdents64");  // NULL before glibc 2.30
   libc_dup = dlsym(libc, "dup");
   libc_dup2 = dlsym(libc, "dup2");
   libc_lseek = dlsym(libc, "lseek");
+  libc_posix_fadvise = dlsym(libc, "posix_fadvise");
 
   libc_stat = dlsym(libc, "stat");
   libc_fstat = dlsym(libc, "fstat");
@@ -70,6 +97,9 @@ static void initialize_passthrough() {
   libc___fxstat64 = dlsym(libc, "__fxstat64");
   libc___lxstat = dlsym(libc, "__lxstat");
   libc___lxstat64 = dlsym(libc, "__lxstat64");
+  libc_fstatat = dlsym(libc, "fstatat");
+  libc___fxstatat = dlsym(libc, "__fxstatat");
+  libc___fxstatat64 = dlsym(libc, "__fxstatat64");
 
   libc_fopen = dlsym(libc, "fopen");
   libc_truncate = dlsym(libc, "truncate");
@@ -10,13 +10,26 @@
 #include <pthread.h>
 #include <cstdlib>
 #include <cstring>
+#include <errno.h>
 #include <exception>
 #include <stdio.h>
 #include <fcntl.h>
 #include <list>
+#include <set>
 #include <string>
+#include <algorithm>
+#include <cstddef>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 #include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/lock_guard.hpp>
 #include "libxtreemfs/client.h"
+#include "libxtreemfs/file_copier.h"
 #include "libxtreemfs/file_handle.h"
 #include "libxtreemfs/options.h"
 #include "libxtreemfs/pbrpc_url.h"
@@ -31,6 +44,16 @@
 
 static Environment* env = NULL;
 
+/** Maximum size of one read or write when copying between fds. */
+static const size_t kCopyBufferSize = 1 << 20;
+
+/** Size of the chunks copied in parallel between two XtreemFS files, the
+ *  default object size. */
+static const size_t kCopyChunkSize = 128 * 1024;
+
+/** Maximum size of one read or write to fill or write back a mapping. */
+static const size_t kMmapReadSize = 1 << 25;
+
 /**
  * The environment should be initialised exactly once during shared library initialisation.
  * Prior to that, all operations work in pass-through mode.
@@ -103,6 +126,42 @@ deinit_preload(void) {
   xprintf("library deinitialised! %d\n", ret);
 }
 
+/**
+ * Sets errno according to the exception which is currently handled. Must only
+ * be called from within a catch block.
+ */
+static void set_errno_from_current_exception() {
+  try {
+    throw;
+  } catch(const xtreemfs::PosixErrorException& e) {
+    errno = ConvertXtreemFSErrnoToUnix(e.posix_errno());
+  } catch(const xtreemfs::XtreemFSException& e) {
+    errno = EIO;
+  } catch(const std::exception& e) {
+    xprintf("A non-XtreemFS exception occurred: %s", std::string(e.what()).c_str());
+    errno = EIO;
+  } catch(...) {
+    errno = EIO;
+  }
+}
+
+/**
+ * Returns the OpenFile of fd. Sets errno and returns NULL if fd refers to a
+ * directory.
+ */
+static boost::shared_ptr<OpenFile> get_regular_file(int fd) {
+  boost::shared_ptr<OpenFile> file = env->open_file_table_.Get(fd);
+  if (!file) {
+    errno = EBADF;
+    return boost::shared_ptr<OpenFile>();
+  }
+  if (file->IsDirectory()) {
+    errno = EISDIR;
+    return boost::shared_ptr<OpenFile>();
+  }
+  return file;
+}
+
 /* XtreemFS equivalents to POSIX file system calls */
 
 int xtreemfs_open(const char* pathname, int flags, int mode) {
@@ -111,88 +170,632 @@ int xtreemfs_open(const char* pathname, int flags, int mode) {
   path.Parse();
 
   xtreemfs::Volume* volume = env->GetVolume();
+
+  if (flags & O_DIRECTORY) {
+    // Directories have no file handle, getdents64() reads them by path.
+    xtreemfs::pbrpc::Stat stat;
+    try {
+      volume->GetAttr(env->user_creds_, path.GetXtreemFSPath(), &stat);
+    } catch(...) {
+      set_errno_from_current_exception();
+      return -1;
+    }
+    if (!S_ISDIR(stat.mode())) {
+      errno = ENOTDIR;
+      return -1;
+    }
+    return env->open_file_table_.Register(NULL, pathname, flags);
+  }
+
   const xtreemfs::pbrpc::SYSTEM_V_FCNTL xtreem_flags = ConvertFlagsUnixToXtreemFS(flags);
 
-  xtreemfs::FileHandle* handle = volume->OpenFile(
-      env->user_creds_,
-      path.GetXtreemFSPath(),
-      xtreem_flags,
-      mode);
+  xtreemfs::FileHandle* handle = NULL;
+  try {
+    handle = volume->OpenFile(
+        env->user_creds_,
+        path.GetXtreemFSPath(),
+        xtreem_flags,
+        mode);
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
 
-  int fd = env->open_file_table_.Register(handle);
+  int fd = env->open_file_table_.Register(handle, pathname, flags);
+  if (fd == -1) {
+    handle->Close();
+  }
   xprintf(" open on xtreemfs(%s) -> %d\n", pathname, fd);
   return fd;
 }
 
 int xtreemfs_close(int fd) {
   xprintf(" close xtreemfs(%d)\n", fd);
-  OpenFile handle = env->open_file_table_.Get(fd);
-  env->open_file_table_.Unregister(fd);
-  //handle.fh_->Flush(); // implicit by close
-  handle.fh_->Close(); // TODO: error code
+  boost::shared_ptr<OpenFile> file = env->open_file_table_.Unregister(fd);
+  if (!file) {
+    errno = EBADF;
+    return -1;
+  }
+  try {
+    if (file.unique()) {
+      file->Close();
+    } else {
+      // Another thread still uses the file and closes it when it is done.
+      file->FlushWriteBehind();
+    }
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
   return 0;
 }
 
 uint64_t xtreemfs_pread(int fd, void* buf, uint64_t nbyte, uint64_t offset) {
   xprintf(" read xtreemfs(%d)\n", fd);
-  OpenFile handle = env->open_file_table_.Get(fd);
-  return handle.fh_->Read((char*)buf, nbyte, offset);
+  boost::shared_ptr<OpenFile> file = get_regular_file(fd);
+  if (!file) {
+    return -1;
+  }
+  try {
+    return file->Read(static_cast<char*>(buf), nbyte, offset);
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
 }
 
 uint64_t xtreemfs_read(int fd, void* buf, uint64_t nbyte) {
   xprintf(" read xtreemfs(%d)\n", fd);
-  OpenFile handle = env->open_file_table_.Get(fd);
-  int read = handle.fh_->Read((char*)buf, nbyte, handle.offset_);
-  env->open_file_table_.SetOffset(fd, handle.offset_ + read);
-  return read;
+  boost::shared_ptr<OpenFile> file = get_regular_file(fd);
+  if (!file) {
+    return -1;
+  }
+  try {
+    return file->Read(static_cast<char*>(buf), nbyte);
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
+}
+
+uint64_t xtreemfs_pwrite(int fd, const void* buf, uint64_t nbyte, uint64_t offset) {
+  xprintf(" pwrite xtreemfs(%d)\n", fd);
+  boost::shared_ptr<OpenFile> file = get_regular_file(fd);
+  if (!file) {
+    return -1;
+  }
+  try {
+    return file->Write(static_cast<const char*>(buf), nbyte, offset);
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
 }
 
 uint64_t xtreemfs_write(int fd, const void* buf, uint64_t nbyte) {
   xprintf(" write xtreemfs(%d)\n", fd);
-  OpenFile handle = env->open_file_table_.Get(fd);
-  int written = handle.fh_->Write((char*)buf, nbyte, handle.offset_);
-  env->open_file_table_.SetOffset(fd, handle.offset_ + written);
-  return written;
+  boost::shared_ptr<OpenFile> file = get_regular_file(fd);
+  if (!file) {
+    return -1;
+  }
+  try {
+    return file->Write(static_cast<const char*>(buf), nbyte);
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
+}
+
+ssize_t xtreemfs_readv(int fd, const struct iovec* iov, int iovcnt) {
+  xprintf(" readv xtreemfs(%d, %d)\n", fd, iovcnt);
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    const ssize_t read = xtreemfs_read(fd, iov[i].iov_base, iov[i].iov_len);
+    if (read < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += read;
+    if (static_cast<size_t>(read) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
+}
+
+ssize_t xtreemfs_writev(int fd, const struct iovec* iov, int iovcnt) {
+  xprintf(" writev xtreemfs(%d, %d)\n", fd, iovcnt);
+  ssize_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    const ssize_t written = xtreemfs_write(fd, iov[i].iov_base, iov[i].iov_len);
+    if (written < 0) {
+      return total > 0 ? total : -1;
+    }
+    total += written;
+    if (static_cast<size_t>(written) < iov[i].iov_len) {
+      break;
+    }
+  }
+  return total;
 }
 
 int xtreemfs_dup2(int oldfd, int newfd) {
   xprintf(" dup2 xtreemfs(%d, %d)\n", oldfd, newfd);
-  OpenFile handle = env->open_file_table_.Get(oldfd);
-  if (handle.fh_ == NULL) {
+  const int result = env->open_file_table_.Duplicate(oldfd, newfd);
+  if (result == -1) {
     xprintf(" dup2 error(%d, %d)\n", oldfd, newfd);
-    return -1;
   }
-  xprintf(" dup2 fffxtreemfs(%d, %d)\n", oldfd, newfd);
-  xtreemfs::FileHandle* new_handle; // = handle.fh_->Duplicate(); // TODO: implement Duplicate
-
-  xprintf(" dup2 yxtreemfs(%d, %d)\n", oldfd, newfd);
-  env->open_file_table_.Set(newfd, new_handle);
-  return newfd;
+  return result;
 }
 
 int xtreemfs_dup(int fd) {
   xprintf(" dup xtreemfs(%d)\n", fd);
-  OpenFile handle = env->open_file_table_.Get(fd);
-  xtreemfs::FileHandle* new_handle; // = handle.fh_->Duplicate(); // TODO: implement Duplicate
-  return env->open_file_table_.Register(new_handle);
+  return env->open_file_table_.Duplicate(fd);
 }
 
 off_t xtreemfs_lseek(int fd, off_t offset, int mode) {
   xprintf(" lseek xtreemfs(%d)\n", fd);
-  OpenFile handle = env->open_file_table_.Get(fd);
+  boost::shared_ptr<OpenFile> file = env->open_file_table_.Get(fd);
+  if (!file) {
+    errno = EBADF;
+    return -1;
+  }
+  if (file->IsDirectory() && mode == SEEK_END) {
+    errno = EINVAL;
+    return -1;
+  }
+  try {
+    const off_t new_offset = file->Seek(offset, mode, env->user_creds_);
+    if (new_offset < 0) {
+      errno = EINVAL;
+      return -1;
+    }
+    return new_offset;
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
+}
+
+int xtreemfs_posix_fadvise(int fd, off_t offset, off_t len, int advice) {
+  xprintf(" posix_fadvise xtreemfs(%d, %d)\n", fd, advice);
+  boost::shared_ptr<OpenFile> file = env->open_file_table_.Get(fd);
+  if (!file) {
+    return EBADF;
+  }
+  if (file->IsDirectory()) {
+    return 0;
+  }
+  try {
+    file->Advise(offset, len, advice);
+  } catch(...) {
+    // posix_fadvise() returns the error instead of setting errno.
+    const int saved_errno = errno;
+    set_errno_from_current_exception();
+    const int error = errno;
+    errno = saved_errno;
+    return error;
+  }
+  return 0;
+}
+
+int xtreemfs_fsync(int fd) {
+  xprintf(" fsync xtreemfs(%d)\n", fd);
+  boost::shared_ptr<OpenFile> file = env->open_file_table_.Get(fd);
+  if (!file) {
+    errno = EBADF;
+    return -1;
+  }
+  if (file->IsDirectory()) {
+    return 0;
+  }
+  try {
+    file->Sync();
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
+  return 0;
+}
 
-  switch (mode) {
-    case SEEK_SET:
-      env->open_file_table_.SetOffset(fd, offset);
-      return offset;
-    case SEEK_CUR:
-      env->open_file_table_.SetOffset(fd, handle.offset_ + offset);
-      return handle.offset_ + offset;
-    case SEEK_END:
-      env->open_file_table_.SetOffset(fd, offset);  // TODO
-      return offset;
+int xtreemfs_ftruncate(int fd, off_t length) {
+  xprintf(" ftruncate xtreemfs(%d, %ld)\n", fd, length);
+  boost::shared_ptr<OpenFile> file = get_regular_file(fd);
+  if (!file) {
+    return -1;
+  }
+  try {
+    file->Truncate(env->user_creds_, length);
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
   }
-  return EINVAL;
+  return 0;
+}
+
+int xtreemfs_truncate(const char* pathname, off_t length) {
+  xprintf(" truncate xtreemfs(%s, %ld)\n", pathname, length);
+  Path path(pathname);
+  path.Parse();
+  try {
+    env->GetVolume()->Truncate(env->user_creds_, path.GetXtreemFSPath(), length);
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
+  return 0;
+}
+
+bool is_xtreemfs_at_path(int dirfd, const char* path, std::string* full_path) {
+  if (path[0] == '/') {
+    if (!is_xtreemfs_path(path)) {
+      return false;
+    }
+    *full_path = path;
+    return true;
+  }
+  // Relative paths are XtreemFS paths only below an XtreemFS directory fd.
+  if (dirfd == AT_FDCWD) {
+    return false;
+  }
+  boost::shared_ptr<OpenFile> directory = env->open_file_table_.Get(dirfd);
+  if (!directory || !directory->IsDirectory()) {
+    return false;
+  }
+  *full_path = directory->path() + "/" + path;
+  return true;
+}
+
+/** Reads from an XtreemFS or a local fd at *offset and advances *offset.
+ *  Uses and advances the file offset of fd if offset is NULL. */
+static ssize_t copy_read(int fd, char* buf, size_t count, off64_t* offset) {
+  ssize_t read;
+  if (is_xtreemfs_fd(fd)) {
+    read = offset ? xtreemfs_pread(fd, buf, count, *offset)
+                  : xtreemfs_read(fd, buf, count);
+  } else {
+    read = offset ? ((funcptr_pread)libc_pread)(fd, buf, count, *offset)
+                  : ((funcptr_read)libc_read)(fd, buf, count);
+  }
+  if (read > 0 && offset) {
+    *offset += read;
+  }
+  return read;
+}
+
+/** Counterpart of copy_read() for writing. */
+static ssize_t copy_write(int fd, const char* buf, size_t count, off64_t* offset) {
+  ssize_t written;
+  if (is_xtreemfs_fd(fd)) {
+    written = offset ? xtreemfs_pwrite(fd, buf, count, *offset)
+                     : xtreemfs_write(fd, buf, count);
+  } else {
+    written = offset ? ((funcptr_pwrite)libc_pwrite)(fd, buf, count, *offset)
+                     : ((funcptr_write)libc_write)(fd, buf, count);
+  }
+  if (written > 0 && offset) {
+    *offset += written;
+  }
+  return written;
+}
+
+/** Copies between two XtreemFS files with several objects in flight. */
+static ssize_t xtreemfs_copy_between_files(OpenFile* in_file,
+                                           off64_t* in_offset,
+                                           OpenFile* out_file,
+                                           off64_t* out_offset,
+                                           size_t count) {
+  try {
+    // The copier uses the file handles directly, bypassing the buffers.
+    in_file->DropBuffers();
+    out_file->DropBuffers();
+
+    const int64_t source_offset = in_offset != NULL
+        ? *in_offset : in_file->Seek(0, SEEK_CUR, env->user_creds_);
+    const int64_t destination_offset = out_offset != NULL
+        ? *out_offset : out_file->Seek(0, SEEK_CUR, env->user_creds_);
+
+    xtreemfs::FileCopier copier(in_file->fh_,
+                                out_file->fh_,
+                                kCopyChunkSize,
+                                env->options_.copy_parallel_requests);
+    const int64_t copied = copier.Copy(source_offset,
+                                       destination_offset,
+                                       count);
+
+    if (in_offset != NULL) {
+      *in_offset += copied;
+    } else {
+      in_file->Seek(source_offset + copied, SEEK_SET, env->user_creds_);
+    }
+    if (out_offset != NULL) {
+      *out_offset += copied;
+    } else {
+      out_file->Seek(destination_offset + copied, SEEK_SET, env->user_creds_);
+    }
+    return copied;
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
+}
+
+ssize_t xtreemfs_copy(int in_fd, off64_t* in_offset,
+                      int out_fd, off64_t* out_offset,
+                      size_t count) {
+  xprintf(" copy xtreemfs(%d, %d, %lu)\n", in_fd, out_fd, count);
+  boost::shared_ptr<OpenFile> in_file = env->open_file_table_.Get(in_fd);
+  boost::shared_ptr<OpenFile> out_file = env->open_file_table_.Get(out_fd);
+  if (in_file && !in_file->IsDirectory()
+      && out_file && !out_file->IsDirectory()) {
+    return xtreemfs_copy_between_files(in_file.get(), in_offset,
+                                       out_file.get(), out_offset,
+                                       count);
+  }
+
+  // Data passes through one buffer of the library instead of the
+  // application's buffers, and XtreemFS reads and writes are object sized.
+  std::vector<char> buffer(std::min(count, kCopyBufferSize));
+  size_t copied = 0;
+  while (copied < count) {
+    const ssize_t read = copy_read(in_fd,
+                                   &buffer[0],
+                                   std::min(buffer.size(), count - copied),
+                                   in_offset);
+    if (read < 0) {
+      return copied > 0 ? copied : -1;
+    }
+    if (read == 0) {
+      break;
+    }
+    const ssize_t written = copy_write(out_fd, &buffer[0], read, out_offset);
+    if (written < 0) {
+      return copied > 0 ? copied : -1;
+    }
+    copied += written;
+    if (written < read) {
+      break;
+    }
+  }
+  return copied;
+}
+
+void* xtreemfs_mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) {
+  xprintf(" mmap xtreemfs(%d, %lu, %ld)\n", fd, length, offset);
+  boost::shared_ptr<OpenFile> file = get_regular_file(fd);
+  if (!file) {
+    return MAP_FAILED;
+  }
+
+  // Like mmap() of a local file, the fd has to be readable and shared
+  // writable mappings require an fd which was opened for writing, too.
+  const bool write_back = (flags & MAP_SHARED) && (prot & PROT_WRITE);
+  const int access_mode = file->flags() & O_ACCMODE;
+  if (access_mode == O_WRONLY || (write_back && access_mode != O_RDWR)) {
+    errno = EACCES;
+    return MAP_FAILED;
+  }
+
+  // The mapping is read at once, see PreloadOptions::mmap_max_mb.
+  const size_t max_size =
+      static_cast<size_t>(env->options_.mmap_max_mb) * 1024 * 1024;
+  if (max_size > 0 && length > max_size) {
+    xprintf(" mmap of %lu bytes exceeds mmap-max\n", length);
+    errno = ENOMEM;
+    return MAP_FAILED;
+  }
+
+  // The mapping is anonymous memory filled with the file content. Shared
+  // writable mappings write the modified pages back on msync() and munmap().
+  const int anonymous_flags =
+      (flags & ~(MAP_SHARED | MAP_PRIVATE)) | MAP_PRIVATE | MAP_ANONYMOUS;
+  char* region = static_cast<char*>(((funcptr_mmap)libc_mmap)(
+      addr, length, prot | PROT_WRITE, anonymous_flags, -1, 0));
+  if (region == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+
+  MemoryMapping mapping;
+  mapping.address = region;
+  mapping.length = length;
+  mapping.offset = offset;
+  try {
+    size_t filled = 0;
+    while (filled < length) {
+      const int read = file->Read(region + filled,
+                                  std::min(length - filled, kMmapReadSize),
+                                  offset + filled);
+      if (read <= 0) {
+        break;
+      }
+      filled += read;
+    }
+    mapping.file_length = filled;
+
+    if (write_back) {
+      // The mapping stays valid after close(fd), so it needs its own handle.
+      Path path(file->path().c_str());
+      path.Parse();
+      mapping.file.reset(new MappedFile(
+          env->GetVolume()->OpenFile(
+              env->user_creds_,
+              path.GetXtreemFSPath(),
+              xtreemfs::pbrpc::SYSTEM_V_FCNTL_H_O_RDWR),
+          region,
+          filled));
+    }
+  } catch(...) {
+    set_errno_from_current_exception();
+    ((funcptr_munmap)libc_munmap)(region, length);
+    return MAP_FAILED;
+  }
+
+  if (!(prot & PROT_WRITE) && mprotect(region, length, prot) != 0) {
+    const int saved_errno = errno;
+    ((funcptr_munmap)libc_munmap)(region, length);
+    errno = saved_errno;
+    return MAP_FAILED;
+  }
+  if (write_back) {
+    env->memory_mappings_.Add(mapping);
+  }
+  return region;
+}
+
+/** Writes the modified pages of [start, start + length) (relative to the
+ *  part "mapping") back to the file.
+ *
+ * @throws XtreemFSException */
+static void write_back_mapping(const MemoryMapping& mapping,
+                               size_t start,
+                               size_t length) {
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  boost::lock_guard<boost::mutex> guard(mapping.file->mutex);
+  std::vector<std::pair<size_t, size_t> > ranges;
+  mapping.GetModifiedRanges(start, length, page_size, &ranges);
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    size_t position = ranges[i].first;
+    const size_t end = ranges[i].first + ranges[i].second;
+    while (position < end) {
+      const size_t count = std::min(end - position, kMmapReadSize);
+      mapping.file->fh->Write(mapping.address + position,
+                              count,
+                              mapping.offset + position);
+      mapping.SetWrittenBack(position, count);
+      position += count;
+    }
+  }
+}
+
+bool is_xtreemfs_mapping(void* addr, size_t length) {
+  return !env->memory_mappings_.Empty()
+      && env->memory_mappings_.Overlaps(addr, length);
+}
+
+int xtreemfs_munmap(void* addr, size_t length) {
+  xprintf(" munmap xtreemfs(%p, %lu)\n", addr, length);
+  std::vector<MemoryMapping> removed;
+  env->memory_mappings_.Remove(addr, length, &removed);
+  int result = 0;
+  std::set<boost::shared_ptr<MappedFile> > files;
+  for (size_t i = 0; i < removed.size(); ++i) {
+    try {
+      write_back_mapping(removed[i], 0, removed[i].length);
+    } catch(...) {
+      set_errno_from_current_exception();
+      result = -1;
+    }
+    files.insert(removed[i].file);
+  }
+  removed.clear();
+  // Close the handles of mappings which were unmapped completely.
+  for (std::set<boost::shared_ptr<MappedFile> >::iterator i = files.begin();
+       i != files.end();
+       ++i) {
+    if (i->unique()) {
+      xtreemfs::FileHandle* fh = (*i)->fh;
+      (*i)->fh = NULL;
+      try {
+        fh->Close();
+      } catch(...) {
+        set_errno_from_current_exception();
+        result = -1;
+      }
+    }
+  }
+  if (((funcptr_munmap)libc_munmap)(addr, length) != 0) {
+    result = -1;
+  }
+  return result;
+}
+
+int xtreemfs_msync(void* addr, size_t length, int flags) {
+  xprintf(" msync xtreemfs(%p, %lu)\n", addr, length);
+  std::vector<MemoryMapping> found;
+  env->memory_mappings_.Find(addr, length, &found);
+  if (found.empty()) {
+    errno = ENOMEM;
+    return -1;
+  }
+  try {
+    for (size_t i = 0; i < found.size(); ++i) {
+      write_back_mapping(found[i], 0, found[i].length);
+      if (flags & MS_SYNC) {
+        found[i].file->fh->Flush();
+      }
+    }
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
+  return 0;
+}
+
+/** Layout of the records returned by the getdents64 system call. */
+struct xtreemfs_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+
+ssize_t xtreemfs_getdents64(int fd, void* dirp, size_t count) {
+  xprintf(" getdents64 xtreemfs(%d)\n", fd);
+  boost::shared_ptr<OpenFile> directory = env->open_file_table_.Get(fd);
+  if (!directory) {
+    errno = EBADF;
+    return -1;
+  }
+  if (!directory->IsDirectory()) {
+    errno = ENOTDIR;
+    return -1;
+  }
+  Path path(directory->path().c_str());
+  path.Parse();
+
+  const size_t kHeaderSize = offsetof(xtreemfs_dirent64, d_name);
+  // Do not fetch more entries than fit into the buffer.
+  const uint32_t max_entries = std::max<size_t>(1, std::min<size_t>(
+      count / (kHeaderSize + 8), env->options_.readdir_chunk_size));
+
+  size_t used = 0;
+  try {
+    const int64_t offset = directory->Seek(0, SEEK_CUR, env->user_creds_);
+    boost::scoped_ptr<xtreemfs::pbrpc::DirectoryEntries> entries(
+        env->GetVolume()->ReadDir(env->user_creds_,
+                                  path.GetXtreemFSPath(),
+                                  offset,
+                                  max_entries,
+                                  false));
+    int returned = 0;
+    for (; returned < entries->entries_size(); ++returned) {
+      const xtreemfs::pbrpc::DirectoryEntry& entry = entries->entries(returned);
+      // Records are 8 byte aligned.
+      const size_t record_length =
+          (kHeaderSize + entry.name().size() + 1 + 7) & ~static_cast<size_t>(7);
+      if (used + record_length > count) {
+        break;
+      }
+      xtreemfs_dirent64* record = reinterpret_cast<xtreemfs_dirent64*>(
+          static_cast<char*>(dirp) + used);
+      record->d_ino = entry.has_stbuf() ? entry.stbuf().ino() : 0;
+      record->d_off = offset + returned + 1;
+      record->d_reclen = record_length;
+      record->d_type = entry.has_stbuf() ? IFTODT(entry.stbuf().mode())
+                                         : DT_UNKNOWN;
+      memcpy(record->d_name, entry.name().c_str(), entry.name().size() + 1);
+      used += record_length;
+    }
+    if (returned == 0 && entries->entries_size() > 0) {
+      errno = EINVAL;
+      return -1;
+    }
+    directory->Seek(offset + returned, SEEK_SET, env->user_creds_);
+  } catch(...) {
+    set_errno_from_current_exception();
+    return -1;
+  }
+  return used;
 }
 
 /* T should be "struct stat" or "struct stat64" */
@@ -227,11 +830,20 @@ static int xtreemfs_stat_impl(const char *pathname, T *buf) {
 /* T should be "struct stat" or "struct stat64" */
 template<typename T>
 static int xtreemfs_fstat_impl(int fd, T *buf) {
-  OpenFile handle = env->open_file_table_.Get(fd);
+  boost::shared_ptr<OpenFile> file = env->open_file_table_.Get(fd);
+  if (!file) {
+    errno = EBADF;
+    return -1;
+  }
+  if (file->IsDirectory()) {
+    return xtreemfs_stat_impl(file->path().c_str(), buf);
+  }
   xtreemfs::pbrpc::Stat stat;
 
   try {
-    handle.fh_->GetAttr(env->user_creds_, &stat);
+    // The file size has to include buffered writes.
+    file->FlushWriteBehind();
+    file->fh_->GetAttr(env->user_creds_, &stat);
   } catch(const xtreemfs::PosixErrorException& e) {
     errno = ConvertXtreemFSErrnoToUnix(e.posix_errno());
     return -1;
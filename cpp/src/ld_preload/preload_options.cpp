@@ -28,8 +28,26 @@ namespace style = boost::program_options::command_line_style;
 namespace xtreemfs {
 
 PreloadOptions::PreloadOptions() : Options(), preload_descriptions_("Preload Options") {
-  // TODO:
-  //preload_descriptions_.add_options()
+  read_ahead_kb = 0;
+  write_behind_kb = 0;
+  mmap_max_mb = 1024;
+
+  preload_descriptions_.add_options()
+    ("read-ahead",
+        po::value(&read_ahead_kb)->default_value(read_ahead_kb),
+        "Reads smaller than this (in kB) fetch this much data and serve "
+        "subsequent reads from the buffer (0 disables read-ahead).")
+    ("write-behind",
+        po::value(&write_behind_kb)->default_value(write_behind_kb),
+        "Consecutive writes smaller than this (in kB) are collected and sent "
+        "at once (0 disables write-behind). Write errors of buffered data are "
+        "reported by a later write, fsync or close.")
+    ("mmap-max",
+        po::value(&mmap_max_mb)->default_value(mmap_max_mb),
+        "Larger mmap()s of XtreemFS files (in MB) fail with ENOMEM (0 means "
+        "no limit). The whole mapped range is read at mmap() time, and shared "
+        "writable mappings keep a second copy of it to find the modified "
+        "pages, i.e. a mapping takes up to twice its size in memory.");
 }
 
 void PreloadOptions::ParseCommandLine(int argc, char** argv) {
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "libxtreemfs/address_map_snapshot.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <boost/lexical_cast.hpp>
+#include <fstream>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::IstreamInputStream;
+using google::protobuf::io::OstreamOutputStream;
+
+namespace xtreemfs {
+
+/** "XAMS" in little endian order. */
+static const uint32_t kSnapshotMagic = 0x534d4158;
+static const uint32_t kSnapshotVersion = 1;
+
+static bool ReadMessage(CodedInputStream* input,
+                        google::protobuf::Message* message) {
+  uint32_t size;
+  if (!input->ReadVarint32(&size)) {
+    return false;
+  }
+  const CodedInputStream::Limit limit = input->PushLimit(size);
+  if (!message->ParseFromCodedStream(input)
+      || !input->ConsumedEntireMessage()) {
+    return false;
+  }
+  input->PopLimit(limit);
+  return true;
+}
+
+static void WriteMessage(CodedOutputStream* output,
+                         const google::protobuf::Message& message) {
+  output->WriteVarint32(message.ByteSize());
+  message.SerializeWithCachedSizes(output);
+}
+
+AddressMapSnapshot::AddressMapSnapshot() : write_time_(0) {}
+
+bool AddressMapSnapshot::Load(const std::string& path) {
+  Clear();
+
+  ifstream file(path.c_str(), ios_base::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  bool valid = false;
+  {
+    IstreamInputStream stream(&file);
+    CodedInputStream input(&stream);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t write_time = 0;
+    valid = input.ReadLittleEndian32(&magic)
+        && magic == kSnapshotMagic
+        && input.ReadVarint32(&version)
+        && version == kSnapshotVersion
+        && input.ReadVarint64(&write_time)
+        && ReadMessage(&input, &address_mappings_)
+        && ReadMessage(&input, &named_services_)
+        && ReadMessage(&input, &osd_services_);
+    write_time_ = static_cast<time_t>(write_time);
+  }
+
+  if (!valid) {
+    Logging::log->getLog(LEVEL_WARN)
+        << "Ignoring the invalid address map snapshot: " << path << endl;
+    Clear();
+  }
+  return valid;
+}
+
+bool AddressMapSnapshot::Save(const std::string& path) {
+  const string temporary_path
+      = path + ".tmp" + boost::lexical_cast<string>(getpid());
+  write_time_ = time(NULL);
+
+  {
+    ofstream file(temporary_path.c_str(),
+                  ios_base::binary | ios_base::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    {
+      OstreamOutputStream stream(&file);
+      CodedOutputStream output(&stream);
+      output.WriteLittleEndian32(kSnapshotMagic);
+      output.WriteVarint32(kSnapshotVersion);
+      output.WriteVarint64(static_cast<uint64_t>(write_time_));
+      WriteMessage(&output, address_mappings_);
+      WriteMessage(&output, named_services_);
+      WriteMessage(&output, osd_services_);
+    }
+    file.close();
+    if (file.fail()) {
+      unlink(temporary_path.c_str());
+      return false;
+    }
+  }
+
+  if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+    unlink(temporary_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+void AddressMapSnapshot::Clear() {
+  write_time_ = 0;
+  address_mappings_.Clear();
+  named_services_.Clear();
+  osd_services_.Clear();
+}
+
+bool AddressMapSnapshot::GetServicesByName(const std::string& name,
+                                           pbrpc::ServiceSet* services) const {
+  services->Clear();
+  for (int i = 0; i < named_services_.services_size(); ++i) {
+    if (named_services_.services(i).name() == name) {
+      services->add_services()->CopyFrom(named_services_.services(i));
+    }
+  }
+  return services->services_size() > 0;
+}
+
+void AddressMapSnapshot::SetServicesByName(const std::string& name,
+                                           const pbrpc::ServiceSet& services) {
+  ServiceSet others;
+  for (int i = 0; i < named_services_.services_size(); ++i) {
+    if (named_services_.services(i).name() != name) {
+      others.add_services()->CopyFrom(named_services_.services(i));
+    }
+  }
+  for (int i = 0; i < services.services_size(); ++i) {
+    if (services.services(i).name() == name) {
+      others.add_services()->CopyFrom(services.services(i));
+    }
+  }
+  named_services_.Swap(&others);
+}
+
+}  // namespace xtreemfs
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "libxtreemfs/async_write_budget.h"
+
+#include <cassert>
+
+#include <algorithm>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/thread.hpp>
+
+using namespace std;
+
+namespace xtreemfs {
+
+AsyncWriteBudget::Statistics::Statistics()
+    : size(0),
+      used_bytes(0),
+      peak_used_bytes(0),
+      owners(0),
+      waiting_threads(0),
+      blocked_acquires(0),
+      blocked_time_ms(0) {}
+
+AsyncWriteBudget::AsyncWriteBudget(uint64_t size)
+    : size_(size),
+      used_bytes_(0),
+      peak_used_bytes_(0),
+      blocked_acquires_(0),
+      blocked_time_ms_(0) {}
+
+void AsyncWriteBudget::Acquire(const void* owner, uint64_t bytes) {
+  if (size_ == 0) {
+    return;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if (!MayAcquireUnmutexed(owner, bytes)) {
+    ++blocked_acquires_;
+    list<const void*>::iterator waiting
+        = waiting_owners_.insert(waiting_owners_.end(), owner);
+    const boost::posix_time::ptime start
+        = boost::posix_time::microsec_clock::local_time();
+    try {
+      do {
+        budget_changed_.wait(lock);
+      } while (!MayAcquireUnmutexed(owner, bytes));
+    } catch (const boost::thread_interrupted&) {
+      waiting_owners_.erase(waiting);
+      budget_changed_.notify_all();
+      throw;
+    }
+    waiting_owners_.erase(waiting);
+    blocked_time_ms_ += (boost::posix_time::microsec_clock::local_time()
+        - start).total_milliseconds();
+  }
+
+  used_bytes_ += bytes;
+  peak_used_bytes_ = max(peak_used_bytes_, used_bytes_);
+  held_bytes_[owner] += bytes;
+
+  // The owners which waited behind this one may fit, too.
+  if (!waiting_owners_.empty()) {
+    budget_changed_.notify_all();
+  }
+}
+
+void AsyncWriteBudget::Release(const void* owner, uint64_t bytes) {
+  if (size_ == 0) {
+    return;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  map<const void*, uint64_t>::iterator it = held_bytes_.find(owner);
+  assert(it != held_bytes_.end() && it->second >= bytes);
+  it->second -= bytes;
+  if (it->second == 0) {
+    held_bytes_.erase(it);
+  }
+  used_bytes_ -= bytes;
+
+  if (!waiting_owners_.empty()) {
+    budget_changed_.notify_all();
+  }
+}
+
+void AsyncWriteBudget::GetStatistics(Statistics* statistics) {
+  boost::mutex::scoped_lock lock(mutex_);
+  statistics->size = size_;
+  statistics->used_bytes = used_bytes_;
+  statistics->peak_used_bytes = peak_used_bytes_;
+  statistics->owners = held_bytes_.size();
+  statistics->waiting_threads = waiting_owners_.size();
+  statistics->blocked_acquires = blocked_acquires_;
+  statistics->blocked_time_ms = blocked_time_ms_;
+}
+
+bool AsyncWriteBudget::MayAcquireUnmutexed(const void* owner, uint64_t bytes) {
+  if (used_bytes_ > 0 && used_bytes_ + bytes > size_) {
+    return false;
+  }
+
+  const uint64_t held_bytes = HeldBytesUnmutexed(owner);
+  for (list<const void*>::const_iterator it = waiting_owners_.begin();
+       it != waiting_owners_.end();
+       ++it) {
+    if (HeldBytesUnmutexed(*it) < held_bytes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t AsyncWriteBudget::HeldBytesUnmutexed(const void* owner) {
+  map<const void*, uint64_t>::const_iterator it = held_bytes_.find(owner);
+  return it == held_bytes_.end() ? 0 : it->second;
+}
+
+}  // namespace xtreemfs
@@ -12,7 +12,9 @@
 #include <boost/lexical_cast.hpp>
 #include <google/protobuf/descriptor.h>
 #include <string>
+#include <vector>
 
+#include "libxtreemfs/async_write_budget.h"
 #include "libxtreemfs/async_write_buffer.h"
 #include "libxtreemfs/file_handle_implementation.h"
 #include "libxtreemfs/file_info.h"
@@ -23,7 +25,7 @@
 #include "pbrpc/RPC.pb.h"
 #include "util/error_log.h"
 #include "util/logging.h"
-#include "util/synchronized_queue.h"
+#include "util/sharded_queue.h"
 #include "xtreemfs/OSDServiceClient.h"
 
 using namespace std;
@@ -32,6 +34,9 @@ using namespace xtreemfs::pbrpc;
 
 namespace xtreemfs {
 
+/** Responses which a callback thread takes from its queue at once. */
+static const size_t kMaxCallbacksPerBatch = 32;
+
 AsyncWriteHandler::AsyncWriteHandler(
     FileInfo* file_info,
     UUIDIterator* uuid_iterator,
@@ -40,7 +45,8 @@ AsyncWriteHandler::AsyncWriteHandler(
     const xtreemfs::pbrpc::Auth& auth_bogus,
     const xtreemfs::pbrpc::UserCredentials& user_credentials_bogus,
     const Options& volume_options,
-    util::SynchronizedQueue<CallbackEntry>& callback_queue)
+    util::ShardedQueue<CallbackEntry>& callback_queue,
+    AsyncWriteBudget* write_budget)
     : state_(IDLE),
       pending_bytes_(0),
       pending_writes_(0),
@@ -64,8 +70,10 @@ AsyncWriteHandler::AsyncWriteHandler(
       redirected_(false),
       fast_redirect_(false),
       worst_write_buffer_(0),
-      callback_queue_(callback_queue) {
-  assert(file_info && uuid_iterator && uuid_resolver && osd_service_client);
+      callback_queue_(callback_queue),
+      write_budget_(write_budget) {
+  assert(file_info && uuid_iterator && uuid_resolver && osd_service_client
+         && write_budget);
 }
 
 AsyncWriteHandler::~AsyncWriteHandler() {
@@ -116,6 +124,10 @@ void AsyncWriteHandler::Write(AsyncWriteBuffer* write_buffer) {
         + boost::lexical_cast<string>(write_buffer->data_length));
   }
 
+  // Do not hold mutex_ while waiting: HandleCallback() requires it to release
+  // the budget.
+  write_budget_->Acquire(this, write_buffer->data_length);
+
   // Append to list of writes in flight.
   {
     boost::mutex::scoped_lock lock(mutex_);
@@ -133,6 +145,7 @@ void AsyncWriteHandler::Write(AsyncWriteBuffer* write_buffer) {
     // NOTE: the following is done here to reach all threads that started
     //       waiting before the final failure
     if (state_ == FINALLY_FAILED) {
+      write_budget_->Release(this, write_buffer->data_length);
       string error =
           "Tried to asynchronously write to a finally failed write handler.";
       Logging::log->getLog(LEVEL_ERROR) << error << endl;
@@ -264,23 +277,31 @@ bool AsyncWriteHandler::WaitForPendingWritesNonBlocking(
   }
 }
 
-void AsyncWriteHandler::ProcessCallbacks(util::SynchronizedQueue<CallbackEntry>& callback_queue) {
+void AsyncWriteHandler::ProcessCallbacks(
+    util::ShardedQueue<CallbackEntry>& callback_queue,
+    size_t shard) {
+  vector<CallbackEntry> entries;
   while (!(boost::this_thread::interruption_requested() &&
            boost::this_thread::interruption_enabled())) {
-    const CallbackEntry& entry = callback_queue.Dequeue();
-    try {
-      entry.handler_->HandleCallback(entry.response_message_,
-                                 entry.data_,
-                                 entry.data_length_,
-                                 entry.error_,
-                                 entry.context_);
-    } catch (const exception& e) {
-      if (Logging::log->loggingActive(LEVEL_DEBUG)) {
-        Logging::log->getLog(LEVEL_DEBUG)
-            << "AsyncWriteHandler::ProcessCallbacks(): caught unhandled "
-            "exception: " << e.what() << ". Invalidating file handle." << endl;
+    entries.clear();
+    callback_queue.DequeueBatch(shard, kMaxCallbacksPerBatch, &entries);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const CallbackEntry& entry = entries[i];
+      try {
+        entry.handler_->HandleCallback(entry.response_message_,
+                                   entry.data_,
+                                   entry.data_length_,
+                                   entry.error_,
+                                   entry.context_);
+      } catch (const exception& e) {
+        if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+          Logging::log->getLog(LEVEL_DEBUG)
+              << "AsyncWriteHandler::ProcessCallbacks(): caught unhandled "
+              "exception: " << e.what() << ". Invalidating file handle."
+              << endl;
+        }
+        entry.handler_->FailFinallyHelper();
       }
-      entry.handler_->FailFinallyHelper();
     }
   }
 }
@@ -291,12 +312,15 @@ void AsyncWriteHandler::CallFinished(
     uint32_t data_length,
     xtreemfs::pbrpc::RPCHeader::ErrorResponse* error,
     void* context) {
-  callback_queue_.Enqueue(CallbackEntry(this,
-                                       response_message,
-                                       data,
-                                       data_length,
-                                       error,
-                                       context));
+  // The responses of a file are processed in order by the same thread. The
+  // network thread must not wait for it if the queue is full.
+  callback_queue_.EnqueueWithoutBlocking(file_info_->file_id(),
+                                         CallbackEntry(this,
+                                                       response_message,
+                                                       data,
+                                                       data_length,
+                                                       error,
+                                                       context));
 }
 
 void AsyncWriteHandler::HandleCallback(
@@ -554,6 +578,7 @@ void AsyncWriteHandler::DecreasePendingBytesHelper(
   assert(write_buffer && lock && lock->owns_lock());
 
   pending_bytes_ -= write_buffer->data_length;
+  write_budget_->Release(this, write_buffer->data_length);
 
   if (delete_buffer) {
     // the buffer is deleted
@@ -631,6 +656,7 @@ void AsyncWriteHandler::CleanUp(boost::mutex::scoped_lock* lock) {
   std::list<AsyncWriteBuffer*>::iterator it = writes_in_flight_.begin();
   while (it != writes_in_flight_.end()) {
     (*it)->file_handle->MarkAsyncWritesAsFailed();  // mark all file handles
+    write_budget_->Release(this, (*it)->data_length);
     delete *it;  // delete buffers
     it = writes_in_flight_.erase(it);  // delete pointer to buffer in list
   }
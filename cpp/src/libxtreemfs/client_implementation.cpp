@@ -10,6 +10,7 @@
 #include "libxtreemfs/client_implementation.h"
 
 #include <cstdlib>
+#include <set>
 
 #include <boost/bind.hpp>
 #include <boost/thread/thread.hpp>
@@ -23,6 +24,8 @@
 #include "libxtreemfs/vivaldi.h"
 #include "libxtreemfs/volume_implementation.h"
 #include "libxtreemfs/xtreemfs_exception.h"
+#include "rpc/request_trace.h"
+#include "rpc/transport_profile.h"
 #include "util/logging.h"
 #include "util/error_log.h"
 #include "xtreemfs/DIRServiceClient.h"
@@ -35,12 +38,68 @@ using namespace xtreemfs::util;
 
 namespace xtreemfs {
 
+/** Responses per async write callback thread which fit into the lock-free
+ *  queue. Further responses go to an overflow list, the network thread never
+ *  waits. */
+static const size_t kAsyncWriteCallbackQueueCapacity = 4096;
+
+/** Attempts of an idle callback thread before it sleeps (multi-core only). */
+static const int kAsyncWriteCallbackSpinCount = 100;
+
+/** UUIDs which may wait for a refresh, further ones are refreshed later. */
+static const size_t kRefreshQueueCapacity = 1024;
+
+/** Chooses the mapping of "uuid" in "set" for the local networks: a mapping
+ *  for a local network is preferred, the default ("*") is used otherwise.
+ *
+ * @returns false if there is no such mapping.
+ * @throws UnknownAddressSchemeException */
+static bool SelectAddressMapping(
+    const AddressMappingSet& set,
+    const std::string& uuid,
+    const boost::unordered_set<std::string>& local_networks,
+    AddressMapping* found_address_mapping) {
+  bool found = false;
+  for (int i = 0; i < set.mappings_size(); i++) {
+    const AddressMapping& am = set.mappings(i);
+    if (am.uuid() != uuid) {
+      continue;
+    }
+    if (am.protocol() != PBRPCURL::GetSchemePBRPC()
+        && am.protocol() != PBRPCURL::GetSchemePBRPCS()
+        && am.protocol() != PBRPCURL::GetSchemePBRPCG()
+        && am.protocol() != PBRPCURL::GetSchemePBRPCU()) {
+      Logging::log->getLog(LEVEL_ERROR)
+          << "Unknown scheme: " << am.protocol() << endl;
+      throw UnknownAddressSchemeException("Unknown scheme: " + am.protocol());
+    }
+
+    const string& network = am.match_network();
+    // Prefer the UUID for a matching network, use the default otherwise.
+    if (network == "*") {
+      found_address_mapping->CopyFrom(am);
+      found = true;
+    } else {
+      boost::unordered_set<string>::const_iterator local_network
+        = local_networks.find(network);
+      if (local_network != local_networks.end()) {
+        found_address_mapping->CopyFrom(am);
+        return true;
+      }
+    }
+  }
+  return found;
+}
+
 DIRUUIDResolver::DIRUUIDResolver(
     SimpleUUIDIterator& dir_uuid_iterator,
     const pbrpc::UserCredentials& user_credentials,
     const Options& options)
     : dir_uuid_iterator_(dir_uuid_iterator),
       dir_service_user_credentials_(user_credentials),
+      refresh_queue_(kRefreshQueueCapacity, 0),
+      snapshot_expiration_time_(0),
+      local_networks_expiration_time_(0),
       options_(options) {
   // Currently no AUTH is needed to access the DIR.
   dir_service_auth_.set_auth_type(AUTH_NONE);
@@ -48,6 +107,16 @@ DIRUUIDResolver::DIRUUIDResolver(
 
 void DIRUUIDResolver::Initialize(xtreemfs::rpc::Client* network_client) {
   dir_service_client_.reset(new DIRServiceClient(network_client));
+  refresh_thread_.reset(new boost::thread(boost::bind(
+      &xtreemfs::DIRUUIDResolver::RefreshAddressMappings,
+      this)));
+}
+
+void DIRUUIDResolver::Shutdown() {
+  if (refresh_thread_.get() && refresh_thread_->joinable()) {
+    refresh_thread_->interrupt();
+    refresh_thread_->join();
+  }
 }
 
 void DIRUUIDResolver::UUIDToAddress(const std::string& uuid,
@@ -61,12 +130,35 @@ void DIRUUIDResolver::UUIDToAddressWithOptions(const std::string& uuid,
   // The UUID must never be empty.
   assert(!uuid.empty());
 
-  // Try to search in cache.
-  *address = uuid_cache_.get(uuid);
-  if (!address->empty()) {
-    return;  // Cache-Hit.
+  while (true) {
+    // Try to search in cache.
+    bool refresh = false;
+    *address = uuid_cache_.get(uuid, &refresh);
+    if (!address->empty()) {
+      if (refresh && !refresh_queue_.TryEnqueue(uuid)) {
+        // Do not wait for the refresh thread, the next get() asks again.
+        uuid_cache_.CancelRefresh(uuid);
+      }
+      return;  // Cache-Hit.
+    }
+
+    // Only one thread queries the DIR, the others use its result.
+    if (uuid_cache_.BeginLookup(uuid)) {
+      break;
+    }
+  }
+
+  try {
+    *address = LookupAddressMapping(uuid, options);
+  } catch (...) {
+    uuid_cache_.EndLookup(uuid);
+    throw;
   }
+  uuid_cache_.EndLookup(uuid);
+}
 
+std::string DIRUUIDResolver::LookupAddressMapping(const std::string& uuid,
+                                                  const RPCOptions& options) {
   addressMappingGetRequest rq = addressMappingGetRequest();
   rq.set_uuid(uuid);
 
@@ -85,37 +177,22 @@ void DIRUUIDResolver::UUIDToAddressWithOptions(const std::string& uuid,
           options,
           true));
 
-  boost::unordered_set<string> local_networks = GetNetworks();
   AddressMappingSet* set = static_cast<AddressMappingSet*>(
       response->response());
   AddressMapping found_address_mapping;
-  for (int i = 0; i < set->mappings_size(); i++) {
-    const AddressMapping& am = set->mappings(i);
-    if (am.protocol() != PBRPCURL::GetSchemePBRPC()
-        && am.protocol() != PBRPCURL::GetSchemePBRPCS()
-        && am.protocol() != PBRPCURL::GetSchemePBRPCG()
-        && am.protocol() != PBRPCURL::GetSchemePBRPCU()) {
-      Logging::log->getLog(LEVEL_ERROR)
-          << "Unknown scheme: " << am.protocol() << endl;
-      response->DeleteBuffers();
-      throw UnknownAddressSchemeException("Unknown scheme: " + am.protocol());
-    }
-
-    const string& network = am.match_network();
-    // Prefer the UUID for a matching network, use the default otherwise.
-    if (network == "*") {
-      found_address_mapping = am;
-    } else {
-      boost::unordered_set<string>::const_iterator local_network
-        = local_networks.find(network);
-      if (local_network != local_networks.end()) {
-        found_address_mapping = am;
-        break;
-      }
-    }
+  bool found = false;
+  try {
+    found = SelectAddressMapping(*set,
+                                 uuid,
+                                 GetLocalNetworks(),
+                                 &found_address_mapping);
+  } catch (const XtreemFSException&) {
+    response->DeleteBuffers();
+    throw;
   }
+  response->DeleteBuffers();
 
-  if (found_address_mapping.IsInitialized()) {
+  if (found) {
     uuid_cache_.update(uuid,
                        found_address_mapping.address(),
                        found_address_mapping.port(),
@@ -128,16 +205,147 @@ void DIRUUIDResolver::UUIDToAddressWithOptions(const std::string& uuid,
       Logging::log->getLog(LEVEL_DEBUG)
           << "Service found for UUID: " << s.str() << endl;
     }
-    response->DeleteBuffers();
-    *address = s.str();
+    return s.str();
   } else {
     Logging::log->getLog(LEVEL_ERROR)
         << "Service not found for UUID: " << uuid << endl;
-    response->DeleteBuffers();
     throw AddressToUUIDNotFoundException(uuid);
   }
 }
 
+void DIRUUIDResolver::PrefetchAddressMappings() {
+  // If the queue is full, the refresh thread is busy with lookups anyway.
+  refresh_queue_.TryEnqueue("");
+}
+
+void DIRUUIDResolver::FetchAddressMappings() {
+  // An empty UUID requests the mappings of all services.
+  addressMappingGetRequest rq = addressMappingGetRequest();
+  rq.set_uuid("");
+
+  // A single attempt is enough, the mappings are looked up on demand anyway.
+  const RPCOptions prefetch_options(1,
+                                    options_.retry_delay_s,
+                                    options_.was_interrupted_function);
+  boost::scoped_ptr<rpc::SyncCallbackBase> response;
+  try {
+    response.reset(ExecuteSyncRequest(
+        boost::bind(
+            &xtreemfs::pbrpc::DIRServiceClient::
+                xtreemfs_address_mappings_get_sync,
+            dir_service_client_.get(),
+            _1,
+            boost::cref(dir_service_auth_),
+            boost::cref(dir_service_user_credentials_),
+            &rq),
+        &dir_uuid_iterator_,
+        NULL,
+        prefetch_options,
+        true));
+  } catch (const XtreemFSException& e) {
+    if (Logging::log->loggingActive(LEVEL_INFO)) {
+      Logging::log->getLog(LEVEL_INFO)
+          << "Failed to prefetch the address mappings: " << e.what() << endl;
+    }
+    return;
+  }
+
+  const AddressMappingSet* set = static_cast<AddressMappingSet*>(
+      response->response());
+  const boost::unordered_set<string> local_networks = GetLocalNetworks();
+  std::set<string> uuids;
+  for (int i = 0; i < set->mappings_size(); i++) {
+    uuids.insert(set->mappings(i).uuid());
+  }
+
+  for (std::set<string>::const_iterator it = uuids.begin();
+       it != uuids.end();
+       ++it) {
+    if (it->empty()) {
+      continue;
+    }
+    AddressMapping found_address_mapping;
+    try {
+      if (SelectAddressMapping(*set,
+                               *it,
+                               local_networks,
+                               &found_address_mapping)) {
+        uuid_cache_.update(*it,
+                           found_address_mapping.address(),
+                           found_address_mapping.port(),
+                           found_address_mapping.ttl_s());
+      }
+    } catch (const XtreemFSException&) {
+      // Not usable by this client, skip it.
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(snapshot_mutex_);
+    snapshot_.mutable_address_mappings()->CopyFrom(*set);
+  }
+
+  if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG) << "Prefetched the address mappings of "
+        << uuids.size() << " services." << endl;
+  }
+  response->DeleteBuffers();
+}
+
+void DIRUUIDResolver::RefreshAddressMappings() {
+  // Do not retry, the entry is still valid for a while.
+  const RPCOptions refresh_options(1,
+                                   options_.retry_delay_s,
+                                   options_.was_interrupted_function);
+  while (true) {
+    const string uuid = refresh_queue_.Dequeue();
+    if (uuid.empty()) {
+      FetchAddressMappings();
+
+      // Successful lookups remove the names from snapshot_service_names_.
+      std::set<string> names;
+      {
+        boost::mutex::scoped_lock lock(snapshot_mutex_);
+        names = snapshot_service_names_;
+      }
+      for (std::set<string>::const_iterator it = names.begin();
+           it != names.end();
+           ++it) {
+        try {
+          delete LookupServicesByName(*it, refresh_options);
+        } catch (const XtreemFSException& e) {
+          if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+            Logging::log->getLog(LEVEL_DEBUG) << "Failed to revalidate the"
+                " services of: " << *it << " Error: " << e.what() << endl;
+          }
+        }
+      }
+      continue;
+    }
+
+    try {
+      LookupAddressMapping(uuid, refresh_options);
+    } catch (const XtreemFSException& e) {
+      if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+        Logging::log->getLog(LEVEL_DEBUG) << "Failed to refresh the address"
+            " mapping of UUID: " << uuid << " Error: " << e.what() << endl;
+      }
+      uuid_cache_.CancelRefresh(uuid);
+    }
+  }
+}
+
+boost::unordered_set<std::string> DIRUUIDResolver::GetLocalNetworks() {
+  boost::mutex::scoped_lock lock(local_networks_mutex_);
+
+  const time_t now = time(NULL);
+  if (now >= local_networks_expiration_time_) {
+    local_networks_ = GetNetworks();
+    local_networks_expiration_time_ = now + 60;
+  }
+  return local_networks_;
+}
+
 string parse_volume_name(const std::string& volume_name) {
   // Check if there is a @ in the volume_name.
   // Everything behind the @ has to be removed as it identifies the snapshot.
@@ -260,6 +468,25 @@ vector<string> DIRUUIDResolver::VolumeNameToMRCUUIDs(const string& volume_name)
 
 
 ServiceSet* DIRUUIDResolver::GetServicesByName(const std::string& volume_name) {
+  {
+    // Only services of the loaded snapshot which were not looked up since.
+    boost::mutex::scoped_lock lock(snapshot_mutex_);
+    if (snapshot_service_names_.count(volume_name) > 0
+        && time(NULL) <= snapshot_expiration_time_) {
+      ServiceSet* services = new ServiceSet();
+      if (snapshot_.GetServicesByName(volume_name, services)) {
+        return services;
+      }
+      delete services;
+    }
+  }
+
+  return LookupServicesByName(volume_name, RPCOptionsFromOptions(options_));
+}
+
+ServiceSet* DIRUUIDResolver::LookupServicesByName(
+    const std::string& volume_name,
+    const RPCOptions& options) {
   boost::scoped_ptr<rpc::SyncCallbackBase> response;
   try {
     serviceGetByNameRequest rq = serviceGetByNameRequest();
@@ -276,7 +503,7 @@ ServiceSet* DIRUUIDResolver::GetServicesByName(const std::string& volume_name) {
             &rq),
         &dir_uuid_iterator_,
         NULL,
-        RPCOptionsFromOptions(options_),
+        options,
         true));
 
   } catch (const XtreemFSException& e) {
@@ -290,9 +517,94 @@ ServiceSet* DIRUUIDResolver::GetServicesByName(const std::string& volume_name) {
   delete[] response->data();
   delete response->error();
 
-  return static_cast<ServiceSet*>(response->response());
+  ServiceSet* services = static_cast<ServiceSet*>(response->response());
+  {
+    boost::mutex::scoped_lock lock(snapshot_mutex_);
+    snapshot_.SetServicesByName(volume_name, *services);
+    snapshot_service_names_.erase(volume_name);
+  }
+  return services;
+}
+
+bool DIRUUIDResolver::LoadSnapshot(const std::string& path, int max_age_s) {
+  boost::mutex::scoped_lock lock(snapshot_mutex_);
+
+  if (!snapshot_.Load(path)) {
+    return false;
+  }
+  const time_t age = time(NULL) - snapshot_.write_time();
+  if (age < 0 || age > max_age_s) {
+    if (Logging::log->loggingActive(LEVEL_INFO)) {
+      Logging::log->getLog(LEVEL_INFO) << "Ignoring the address map snapshot"
+          " which is " << age << " seconds old: " << path << endl;
+    }
+    snapshot_.Clear();
+    return false;
+  }
+  snapshot_expiration_time_ = snapshot_.write_time() + max_age_s;
+
+  // Add the mappings which did not expire yet.
+  const AddressMappingSet& set = snapshot_.address_mappings();
+  const boost::unordered_set<string> local_networks = GetLocalNetworks();
+  std::set<string> uuids;
+  for (int i = 0; i < set.mappings_size(); i++) {
+    uuids.insert(set.mappings(i).uuid());
+  }
+  for (std::set<string>::const_iterator it = uuids.begin();
+       it != uuids.end();
+       ++it) {
+    AddressMapping found_address_mapping;
+    try {
+      if (!it->empty()
+          && SelectAddressMapping(set,
+                                  *it,
+                                  local_networks,
+                                  &found_address_mapping)
+          && found_address_mapping.ttl_s() > age) {
+        uuid_cache_.update(*it,
+                           found_address_mapping.address(),
+                           found_address_mapping.port(),
+                           found_address_mapping.ttl_s() - age);
+      }
+    } catch (const XtreemFSException&) {
+      // Not usable by this client, skip it.
+    }
+  }
+
+  for (int i = 0; i < snapshot_.named_services().services_size(); i++) {
+    snapshot_service_names_.insert(snapshot_.named_services().services(i).name());
+  }
+
+  if (Logging::log->loggingActive(LEVEL_INFO)) {
+    Logging::log->getLog(LEVEL_INFO) << "Loaded the address map snapshot of "
+        << uuids.size() << " services which is " << age << " seconds old: "
+        << path << endl;
+  }
+
+  // Revalidate everything in the background.
+  refresh_queue_.Enqueue("");
+  return true;
+}
+
+void DIRUUIDResolver::SaveSnapshot(const std::string& path) {
+  boost::mutex::scoped_lock lock(snapshot_mutex_);
+
+  if (!snapshot_.Save(path)) {
+    Logging::log->getLog(LEVEL_WARN)
+        << "Failed to save the address map snapshot: " << path << endl;
+  }
+}
+
+void DIRUUIDResolver::GetSnapshotOSDServices(pbrpc::ServiceSet* services) {
+  boost::mutex::scoped_lock lock(snapshot_mutex_);
+  services->CopyFrom(snapshot_.osd_services());
 }
 
+void DIRUUIDResolver::SetSnapshotOSDServices(
+    const pbrpc::ServiceSet& services) {
+  boost::mutex::scoped_lock lock(snapshot_mutex_);
+  snapshot_.mutable_osd_services()->CopyFrom(services);
+}
 
 
 ClientImplementation::ClientImplementation(
@@ -301,13 +613,22 @@ ClientImplementation::ClientImplementation(
     const rpc::SSLOptions* ssl_options,
     const Options& options)
     : was_shutdown_(false),
+      address_map_snapshot_loaded_(false),
       dir_service_user_credentials_(user_credentials),
       options_(options),
       dir_service_ssl_options_(ssl_options),
       dir_uuid_iterator_(dir_service_addresses),
       uuid_resolver_(dir_uuid_iterator_,
                      user_credentials,
-                     options) {
+                     options),
+      async_write_callback_queue_(
+          options.async_writes_callback_threads,
+          kAsyncWriteCallbackQueueCapacity,
+          boost::thread::hardware_concurrency() > 1
+              ? kAsyncWriteCallbackSpinCount : 0),
+      async_write_budget_(
+          static_cast<uint64_t>(options.async_writes_max_client_buffer_mb)
+              * 1024 * 1024) {
 
   // Set bogus auth object.
   auth_bogus_.set_auth_type(AUTH_NONE);
@@ -319,6 +640,13 @@ ClientImplementation::ClientImplementation(
                     options.log_file_path,
                     LEVEL_WARN);
   initialize_error_log(20);
+  if (options.rpc_trace_buffer_size > 0) {
+    rpc::initialize_request_trace(options.rpc_trace_buffer_size);
+  }
+  rpc::TransportProfile default_transport_profile;
+  options.GetDefaultTransportProfile(&default_transport_profile);
+  rpc::initialize_transport_profiles(default_transport_profile);
+  options.SetTransportProfiles(rpc::TransportProfiles::transport_profiles);
 
   if (options_.vivaldi_enable) {
     vivaldi_.reset(new Vivaldi(dir_uuid_iterator_,
@@ -356,6 +684,10 @@ ClientImplementation::~ClientImplementation() {
 
   shutdown_logger();
   shutdown_error_log();
+  if (options_.rpc_trace_buffer_size > 0) {
+    rpc::shutdown_request_trace();
+  }
+  rpc::shutdown_transport_profiles();
 }
 
 void ClientImplementation::Start() {
@@ -364,7 +696,10 @@ void ClientImplementation::Start() {
       options_.connect_timeout_s,
       options_.request_timeout_s,
       options_.linger_timeout_s,
+      options_.rpc_write_coalescing_us,
+      options_.rpc_io_uring,
       dir_service_ssl_options_));
+  options_.SetRPCProcTimeouts(network_client_.get());
 
   network_client_thread_.reset(
       new boost::thread(boost::bind(&xtreemfs::rpc::Client::run,
@@ -376,6 +711,10 @@ void ClientImplementation::Start() {
   dir_service_client_.reset(new DIRServiceClient(network_client_.get()));
   uuid_resolver_.Initialize(network_client_.get());
 
+  address_map_snapshot_loaded_ = options_.address_map_snapshot_max_age_s > 0
+      && uuid_resolver_.LoadSnapshot(GetAddressMapSnapshotPath(),
+                                     options_.address_map_snapshot_max_age_s);
+
   // Start vivaldi thread if configured
   if (options_.vivaldi_enable) {
     if (Logging::log->loggingActive(LEVEL_INFO)) {
@@ -383,13 +722,22 @@ void ClientImplementation::Start() {
           << "Starting vivaldi..." << endl;
     }
     vivaldi_->Initialize(network_client_.get());
+    if (address_map_snapshot_loaded_) {
+      ServiceSet osd_services;
+      uuid_resolver_.GetSnapshotOSDServices(&osd_services);
+      vivaldi_->SetOSDServices(osd_services);
+    }
     vivaldi_thread_.reset(new boost::thread(boost::bind(&xtreemfs::Vivaldi::Run,
                                                         vivaldi_.get())));
   }
 
-  async_write_callback_thread_.reset(
-      new boost::thread(&xtreemfs::AsyncWriteHandler::ProcessCallbacks, 
-                        boost::ref(async_write_callback_queue_)));
+  for (size_t shard = 0; shard < async_write_callback_queue_.shards();
+       ++shard) {
+    async_write_callback_threads_.create_thread(boost::bind(
+        &xtreemfs::AsyncWriteHandler::ProcessCallbacks,
+        boost::ref(async_write_callback_queue_),
+        shard));
+  }
 }
 
 void ClientImplementation::Shutdown() {
@@ -406,15 +754,49 @@ void ClientImplementation::Shutdown() {
       it = list_open_volumes_.erase(it);
     }
 
-    if (async_write_callback_thread_->joinable()) {
-      async_write_callback_thread_->interrupt();
-      async_write_callback_thread_->join();
+    async_write_callback_threads_.interrupt_all();
+    async_write_callback_threads_.join_all();
+
+    if (options_.enable_async_writes &&
+        Logging::log->loggingActive(LEVEL_INFO)) {
+      for (size_t shard = 0; shard < async_write_callback_queue_.shards();
+           ++shard) {
+        util::ShardedQueue<AsyncWriteHandler::CallbackEntry>::Statistics
+            statistics;
+        async_write_callback_queue_.GetStatistics(shard, &statistics);
+        Logging::log->getLog(LEVEL_INFO) << "Async write callback thread "
+            << shard << ": processed responses: " << statistics.enqueued
+            << ", peak queue depth: " << statistics.peak_depth
+            << ", overflowed: " << statistics.overflowed << endl;
+      }
+    }
+
+    if (options_.async_writes_max_client_buffer_mb > 0 &&
+        Logging::log->loggingActive(LEVEL_INFO)) {
+      AsyncWriteBudget::Statistics statistics;
+      async_write_budget_.GetStatistics(&statistics);
+      Logging::log->getLog(LEVEL_INFO) << "Async write buffer of the client:"
+          " peak usage: " << statistics.peak_used_bytes << " of "
+          << statistics.size << " bytes, blocked writes: "
+          << statistics.blocked_acquires << " (" << statistics.blocked_time_ms
+          << " ms)" << endl;
     }
 
     // Stop vivaldi thread if running
     if (vivaldi_thread_.get() && vivaldi_thread_->joinable()) {
       vivaldi_thread_->interrupt();
     }
+
+    uuid_resolver_.Shutdown();
+
+    if (options_.address_map_snapshot_max_age_s > 0) {
+      if (vivaldi_.get()) {
+        ServiceSet osd_services;
+        vivaldi_->GetOSDServices(&osd_services);
+        uuid_resolver_.SetSnapshotOSDServices(osd_services);
+      }
+      uuid_resolver_.SaveSnapshot(GetAddressMapSnapshotPath());
+    }
   }
 }
 
@@ -426,6 +808,13 @@ Volume* ClientImplementation::OpenVolume(
   SimpleUUIDIterator* mrc_uuid_iterator = new SimpleUUIDIterator;
   uuid_resolver_.VolumeNameToMRCUUID(volume_name, mrc_uuid_iterator);
 
+  // Avoid that the first access to every OSD has to wait for the DIR. The
+  // prefetch runs in the background, so OpenVolume() does not wait for it
+  // either. The mappings of a snapshot are already revalidated.
+  if (!address_map_snapshot_loaded_) {
+    uuid_resolver_.PrefetchAddressMappings();
+  }
+
   VolumeImplementation* volume = new VolumeImplementation(
       this,
       client_uuid_,
@@ -756,12 +1145,20 @@ std::string ClientImplementation::UUIDToAddress(const std::string& uuid) {
   return result;
 }
 
+std::string ClientImplementation::GetAddressMapSnapshotPath() const {
+  return options_.vivaldi_filename + ".address_map";
+}
+
 const VivaldiCoordinates& ClientImplementation::GetVivaldiCoordinates() const {
   return vivaldi_->GetVivaldiCoordinates();
 }
 
-util::SynchronizedQueue<AsyncWriteHandler::CallbackEntry>& ClientImplementation::GetAsyncWriteCallbackQueue() {
+util::ShardedQueue<AsyncWriteHandler::CallbackEntry>& ClientImplementation::GetAsyncWriteCallbackQueue() {
   return async_write_callback_queue_;
 }
 
+AsyncWriteBudget* ClientImplementation::GetAsyncWriteBudget() {
+  return &async_write_budget_;
+}
+
 }  // namespace xtreemfs
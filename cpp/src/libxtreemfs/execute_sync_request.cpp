@@ -27,6 +27,8 @@
 #include "libxtreemfs/xcap_handler.h"
 #include "libxtreemfs/xtreemfs_exception.h"
 #include "pbrpc/RPC.pb.h"
+#include "rpc/client.h"
+#include "rpc/request_trace.h"
 #include "rpc/sync_callback.h"
 #include "util/error_log.h"
 #include "util/logging.h"
@@ -40,7 +42,8 @@ namespace xtreemfs {
 
 /** Helper function which delays the execution and logs an error.
  *
- * The delay ensures the server won't be flooded.
+ * The delay ensures the server won't be flooded. "server" is only used to
+ * tag the delay in the request trace.
  *
  * @throws  boost::thread_interrupted if interrupted.
  *
@@ -50,6 +53,7 @@ void DelayNextRetry(const RPCOptions& options,
     const boost::posix_time::ptime& request_sent_time,
     const std::string& delay_error,
     const xtreemfs::util::LogLevel level,
+    const std::string& server,
     rpc::SyncCallbackBase* response) {
   // delay = retry_delay - (current_time - request_sent_time)
   boost::posix_time::time_duration delay_time_left =
@@ -76,6 +80,15 @@ void DelayNextRetry(const RPCOptions& options,
   }
 
   if (!delay_time_left.is_negative()) {
+    if (rpc::RequestTrace::request_trace && response != NULL) {
+      rpc::RequestTraceEvent event;
+      event.timestamp_us = rpc::RequestTrace::Now();
+      event.type = rpc::kTraceRetryDelay;
+      event.call_id = response->call_id();
+      event.duration_us = delay_time_left.total_microseconds();
+      event.server = server;
+      rpc::RequestTrace::request_trace->Record(event);
+    }
     try {
       Interruptibilizer::SleepInterruptible(
           static_cast<int>(delay_time_left.total_milliseconds()),
@@ -130,6 +143,12 @@ rpc::SyncCallbackBase* ExecuteSyncRequest(
   // Retry unless maximum tries reached or interrupted.
   while ((++attempt <= options.max_retries() || options.max_retries() == 0) &&
          !Interruptibilizer::WasInterrupted(options.was_interrupted_cb())) {
+    // Do not start another attempt after the deadline.
+    if (response != NULL && options.DeadlinePassed()) {
+      --attempt;
+      break;
+    }
+
     // Delete any previous response;
     if (response != NULL) {
       response->DeleteBuffers();
@@ -155,7 +174,14 @@ rpc::SyncCallbackBase* ExecuteSyncRequest(
     if (attempt > 1 && xcap_handler && xcap_in_req) {
       xcap_handler->GetXCap(xcap_in_req);
     }
-    response = sync_function(service_address);
+    {
+      // The requests of this attempt time out at the deadline at the latest.
+      rpc::ScopedRequestDeadline request_deadline(options.deadline());
+      response = sync_function(service_address);
+    }
+    // Remember the contacted server, service_uuid may change below.
+    const string contacted_server = uuid_iterator_has_addresses
+        ? service_address : (service_address + " (" + service_uuid + ")");
 
     bool has_failed;
     try {
@@ -253,8 +279,17 @@ rpc::SyncCallbackBase* ExecuteSyncRequest(
            // Attempts left
           (attempt < options.max_retries() || options.max_retries() == 0 ||
            // or this last retry should be delayed.
-           (attempt == options.max_retries() && options.delay_last_attempt()))) {  // NOLINT
-        DelayNextRetry(options, request_sent_time, delay_error, level, response);  // NOLINT
+           (attempt == options.max_retries() && options.delay_last_attempt()))  // NOLINT
+          // and the next attempt would start before the deadline.
+          && (options.deadline().is_not_a_date_time() ||
+              request_sent_time + boost::posix_time::seconds(
+                  options.retry_delay_s()) < options.deadline())) {
+        DelayNextRetry(options,
+                       request_sent_time,
+                       delay_error,
+                       level,
+                       contacted_server,
+                       response);
       } else {
         break;  // Do not retry if error occurred - throw exception below.
       }
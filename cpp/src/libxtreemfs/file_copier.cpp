@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "libxtreemfs/file_copier.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "libxtreemfs/file_handle.h"
+#include "libxtreemfs/xtreemfs_exception.h"
+
+using namespace std;
+
+namespace xtreemfs {
+
+FileCopier::FileCopier(FileHandle* source,
+                       FileHandle* destination,
+                       size_t chunk_size,
+                       int parallelism)
+    : source_(source),
+      destination_(destination),
+      chunk_size_(chunk_size > 0 ? chunk_size : 1),
+      parallelism_(parallelism > 0 ? parallelism : 1),
+      source_offset_(0),
+      destination_offset_(0),
+      length_(0),
+      next_chunk_(0),
+      bytes_copied_(0),
+      failed_(false),
+      failed_with_posix_error_(false),
+      posix_errno_(xtreemfs::pbrpc::POSIX_ERROR_NONE) {}
+
+int64_t FileCopier::Copy(int64_t source_offset,
+                         int64_t destination_offset,
+                         int64_t length) {
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    source_offset_ = source_offset;
+    destination_offset_ = destination_offset;
+    length_ = length;
+    next_chunk_ = 0;
+    bytes_copied_ = 0;
+    failed_ = false;
+  }
+
+  // Do not start more workers than there are chunks.
+  const int64_t chunks = (length + chunk_size_ - 1) / chunk_size_;
+  const int workers = static_cast<int>(
+      min(static_cast<int64_t>(parallelism_), chunks));
+
+  boost::thread_group threads;
+  for (int i = 1; i < workers; ++i) {
+    threads.create_thread(boost::bind(&FileCopier::CopyChunks, this));
+  }
+  CopyChunks();
+  threads.join_all();
+
+  if (failed_) {
+    if (failed_with_posix_error_) {
+      throw PosixErrorException(posix_errno_, error_message_);
+    }
+    throw IOException(error_message_);
+  }
+  return bytes_copied_;
+}
+
+void FileCopier::CopyChunks() {
+  boost::scoped_array<char> buffer(new char[chunk_size_]);
+
+  while (true) {
+    int64_t position;
+    size_t count;
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      position = next_chunk_ * chunk_size_;
+      if (failed_ || position >= length_) {
+        return;
+      }
+      ++next_chunk_;
+      count = static_cast<size_t>(
+          min(static_cast<int64_t>(chunk_size_), length_ - position));
+    }
+
+    try {
+      const int read = source_->Read(buffer.get(),
+                                     count,
+                                     source_offset_ + position);
+      if (read > 0) {
+        destination_->Write(buffer.get(), read, destination_offset_ + position);
+      }
+
+      boost::mutex::scoped_lock lock(mutex_);
+      bytes_copied_ += read;
+      if (static_cast<size_t>(read) < count) {
+        // End of the source file: no chunks behind this one are needed.
+        length_ = min(length_, position + read);
+      }
+    } catch (const PosixErrorException& e) {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (!failed_) {
+        failed_ = true;
+        failed_with_posix_error_ = true;
+        posix_errno_ = e.posix_errno();
+        error_message_ = e.what();
+      }
+      return;
+    } catch (const std::exception& e) {
+      boost::mutex::scoped_lock lock(mutex_);
+      if (!failed_) {
+        failed_ = true;
+        failed_with_posix_error_ = false;
+        error_message_ = e.what();
+      }
+      return;
+    }
+  }
+}
+
+}  // namespace xtreemfs
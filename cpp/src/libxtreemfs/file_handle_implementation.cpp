@@ -9,6 +9,8 @@
 #include "libxtreemfs/file_handle_implementation.h"
 
 #include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
@@ -498,6 +500,8 @@ void FileHandleImplementation::Truncate(
       response->response());
   xcap_manager_.SetXCap(*updated_xcap);
   response->DeleteBuffers();
+  // Like Volume::Truncate(), the truncate epoch of cached XCaps is outdated.
+  file_info_->InvalidateOpenCapabilities();
 
   TruncatePhaseTwoAndThree(new_file_size);
 }
@@ -587,51 +591,57 @@ xtreemfs::pbrpc::Lock* FileHandleImplementation::DoAcquireLock(
   lock_request.mutable_lock_request()->set_length(length);
   lock_request.mutable_lock_request()->set_exclusive(exclusive);
 
-  // Check active locks first.
-  std::auto_ptr<Lock> conflicting_lock(new Lock());
-  bool lock_for_pid_cached, cached_lock_for_pid_equal, conflict_found;
-  file_info_->CheckLock(lock_request.lock_request(),
-                        conflicting_lock.get(),
-                        &lock_for_pid_cached,
-                        &cached_lock_for_pid_equal,
-                        &conflict_found);
-  if (conflict_found) {
-    throw PosixErrorException(POSIX_ERROR_EAGAIN, "conflicting lock");
-  }
-  // We allow only one lock per PID, i.e. an existing lock can be always
-  // overwritten. In consequence, AcquireLock always has to be executed except
-  // the new lock is equal to the current lock.
-  if (cached_lock_for_pid_equal) {
-    conflicting_lock->CopyFrom(lock_request.lock_request());
-    return conflicting_lock.release();
+  // A blocked request waits at most as long as max_tries attempts which are
+  // delayed by retry_delay_s each.
+  boost::posix_time::ptime give_up_at(boost::posix_time::pos_infin);
+  if (volume_options_.max_tries > 0) {
+    give_up_at = boost::posix_time::microsec_clock::local_time()
+        + boost::posix_time::seconds(volume_options_.max_tries
+                                     * volume_options_.retry_delay_s);
   }
-
-  // Cache could not be used. Complete lockRequest and send to OSD.
-  file_info_->GetXLocSet(
-      lock_request.mutable_file_credentials()->mutable_xlocs());
-  xcap_manager_.GetXCap(
-      lock_request.mutable_file_credentials()->mutable_xcap());
+  const int max_delay_ms = std::max(volume_options_.lock_wait_min_delay_ms,
+                                    std::min(1000,
+                                             volume_options_.retry_delay_s
+                                                 * 1000));
+  int delay_ms = volume_options_.lock_wait_min_delay_ms;
 
   boost::scoped_ptr<rpc::SyncCallbackBase> response;
-  if (!wait_for_lock) {
-    response.reset(ExecuteSyncRequest(
-        boost::bind(
-            &xtreemfs::pbrpc::OSDServiceClient::xtreemfs_lock_acquire_sync,
-            osd_service_client_,
-            _1,
-            boost::cref(auth_bogus_),
-            boost::cref(user_credentials_bogus_),
-            &lock_request),
-        osd_uuid_iterator_,
-        uuid_resolver_,
-        RPCOptionsFromOptions(volume_options_),
-        false,
-        &xcap_manager_,
-        lock_request.mutable_file_credentials()->mutable_xcap()));
-  } else {
-    // Retry to obtain the lock in case of EAGAIN responses.
-    int retries_left = volume_options_.max_tries;
-    while (retries_left == 0 || retries_left--) {
+  std::auto_ptr<Lock> conflicting_lock(new Lock());
+  while (true) {
+    // Remember the state of the active locks before checking them, so a
+    // release in between wakes up the wait below.
+    const uint64_t active_locks_version = file_info_->active_locks_version();
+
+    // Check active locks first.
+    bool lock_for_pid_cached, cached_lock_for_pid_equal, conflict_found;
+    file_info_->CheckLock(lock_request.lock_request(),
+                          conflicting_lock.get(),
+                          &lock_for_pid_cached,
+                          &cached_lock_for_pid_equal,
+                          &conflict_found);
+    if (conflict_found && !wait_for_lock) {
+      throw PosixErrorException(POSIX_ERROR_EAGAIN, "conflicting lock");
+    }
+    if (!conflict_found) {
+      // We allow only one lock per PID, i.e. an existing lock can be always
+      // overwritten. In consequence, AcquireLock always has to be executed
+      // except the new lock is equal to the current lock or to the lock which
+      // the process released recently, but which is still held at the OSD.
+      if (cached_lock_for_pid_equal ||
+          file_info_->ReviveLingeringLock(lock_request.lock_request())) {
+        conflicting_lock->CopyFrom(lock_request.lock_request());
+        return conflicting_lock.release();
+      }
+
+      // Lingering locks of this client would conflict at the OSD.
+      file_info_->DropLingeringLocks(this, lock_request.lock_request());
+
+      // Cache could not be used. Complete lockRequest and send to OSD.
+      file_info_->GetXLocSet(
+          lock_request.mutable_file_credentials()->mutable_xlocs());
+      xcap_manager_.GetXCap(
+          lock_request.mutable_file_credentials()->mutable_xcap());
+
       try {
         response.reset(ExecuteSyncRequest(
             boost::bind(
@@ -643,23 +653,39 @@ xtreemfs::pbrpc::Lock* FileHandleImplementation::DoAcquireLock(
                 &lock_request),
             osd_uuid_iterator_,
             uuid_resolver_,
-            RPCOptions(1,
-                       volume_options_.retry_delay_s,
-                       true,  //  delay this attempt in case of errors.
-                       volume_options_.was_interrupted_function),
-            false,  // UUIDIterator contains UUIDs and not addresses.
+            RPCOptionsFromOptions(volume_options_),
+            false,
             &xcap_manager_,
             lock_request.mutable_file_credentials()->mutable_xcap()));
-        break;  // If successful, do not retry again.
+        break;
       } catch(const PosixErrorException& e) {
-        if (e.posix_errno() != POSIX_ERROR_EAGAIN) {
-          // Only retry if there exists a conflicting lock and the server did
-          // return an EAGAIN - otherwise rethrow the exception.
-          response->DeleteBuffers();
+        // Only retry if another client holds a conflicting lock and the server
+        // did return an EAGAIN - otherwise rethrow the exception.
+        if (!wait_for_lock || e.posix_errno() != POSIX_ERROR_EAGAIN) {
           throw;
         }
       }
     }
+
+    if (Interruptibilizer::WasInterrupted(
+            volume_options_.was_interrupted_function)) {
+      throw PosixErrorException(POSIX_ERROR_EINTR,
+                                "waiting for a lock was interrupted");
+    }
+    if (boost::posix_time::microsec_clock::local_time() >= give_up_at) {
+      throw PosixErrorException(POSIX_ERROR_EAGAIN, "conflicting lock");
+    }
+    if (conflict_found) {
+      // A process of this client holds the lock, its release wakes us up.
+      file_info_->WaitForActiveLocksChange(active_locks_version, delay_ms);
+    } else {
+      // Another client holds the lock. Poll the OSD with an exponential
+      // backoff: quickly for short critical sections, rarely for long ones.
+      Interruptibilizer::SleepInterruptible(
+          delay_ms,
+          volume_options_.was_interrupted_function);
+    }
+    delay_ms = std::min(2 * delay_ms, max_delay_ms);
   }
   // Delete everything except the response.
   delete[] response->data();
@@ -716,6 +742,9 @@ xtreemfs::pbrpc::Lock* FileHandleImplementation::DoCheckLock(
     return conflicting_lock.release();
   }
 
+  // Lingering locks of this client would be reported by the OSD.
+  file_info_->DropLingeringLocks(this, lock_request.lock_request());
+
   // Cache could not be used. Complete lockRequest and send to OSD.
   file_info_->GetXLocSet(
       lock_request.mutable_file_credentials()->mutable_xlocs());
@@ -779,6 +808,29 @@ void FileHandleImplementation::DoReleaseLock(
     return;
   }
 
+  if (volume_options_.lock_cache_lease_ms > 0) {
+    // Keep the lock at the OSD for a while, the process may lock it again.
+    const boost::posix_time::ptime expires_at
+        = boost::posix_time::microsec_clock::local_time()
+        + boost::posix_time::milliseconds(volume_options_.lock_cache_lease_ms);
+    if (file_info_->LingerLock(lock, expires_at)) {
+      return;
+    }
+  }
+
+  DoReleaseLockAtOSD(lock);
+  file_info_->DelLock(lock);
+}
+
+void FileHandleImplementation::ReleaseLockAtOSD(
+    const xtreemfs::pbrpc::Lock& lock) {
+  boost::function<void()> operation(
+      boost::bind(&FileHandleImplementation::DoReleaseLockAtOSD, this, lock));
+  ExecuteViewCheckedOperation(operation);
+}
+
+void FileHandleImplementation::DoReleaseLockAtOSD(
+    const xtreemfs::pbrpc::Lock& lock) {
   lockRequest unlock_request;
   file_info_->GetXLocSet(
       unlock_request.mutable_file_credentials()->mutable_xlocs());
@@ -802,8 +854,6 @@ void FileHandleImplementation::DoReleaseLock(
         &xcap_manager_,
         unlock_request.mutable_file_credentials()->mutable_xcap()));
   response->DeleteBuffers();
-
-  file_info_->DelLock(lock);
 }
 
 void FileHandleImplementation::ReleaseLockOfProcess(int process_id) {
@@ -971,7 +1021,9 @@ void FileHandleImplementation::WriteBackFileSize(
   response->DeleteBuffers();
 }
 
-void FileHandleImplementation::WriteBackFileSizeAsync(const RPCOptions& options) { // NOLINT
+void FileHandleImplementation::WriteBackFileSizeAsync(
+    const RPCOptions& options,
+    bool close_file) {
   xtreemfs_update_file_sizeRequest rq;
   {
     boost::mutex::scoped_lock lock(mutex_);
@@ -991,10 +1043,11 @@ void FileHandleImplementation::WriteBackFileSizeAsync(const RPCOptions& options)
         ->CopyFrom(*osd_write_response_for_async_write_back_);
   }
   xcap_manager_.GetXCap(rq.mutable_xcap());
-  // Set to false because a close would use a sync writeback.
-  rq.set_close_file(false);
-
-  // NOTE: no vivaldi coordinates needed since close_file is set false.
+  rq.set_close_file(close_file);
+  // See WriteBackFileSize().
+  if (close_file && volume_options_.vivaldi_enable) {
+    rq.mutable_coordinates()->CopyFrom(this->client_->GetVivaldiCoordinates());
+  }
 
   try {
     string mrc_uuid;
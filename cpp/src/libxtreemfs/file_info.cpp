@@ -40,9 +40,12 @@ FileInfo::FileInfo(
       reference_count_(0),
       xlocset_(xlocset),
       osd_uuid_iterator_(xlocset),
+      active_locks_version_(0),
+      expired_locks_file_handle_(NULL),
       client_uuid_(client_uuid),
       osd_write_response_(NULL),
       osd_write_response_status_(kClean),
+      close_file_pending_(false),
 #ifdef _MSC_VER
 // Disable "warning C4355: 'this' : used in base member initializer list".
 // We can ignore that warning because we know that AsyncWriteHandler's
@@ -57,7 +60,8 @@ FileInfo::FileInfo(
                            volume->auth_bogus(),
                            volume->user_credentials_bogus(),
                            volume->volume_options(),
-                           client->GetAsyncWriteCallbackQueue()) {
+                           client->GetAsyncWriteCallbackQueue(),
+                           client->GetAsyncWriteBudget()) {
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif  // _MSC_VER
@@ -68,6 +72,7 @@ FileInfo::FileInfo(
 
 FileInfo::~FileInfo() {
   assert(active_locks_.size() == 0);
+  assert(lingering_locks_.size() == 0);
 }
 
 FileHandleImplementation* FileInfo::CreateFileHandle(
@@ -118,6 +123,13 @@ void FileInfo::CloseFileHandle(FileHandleImplementation* file_handle) {
 
     open_file_handles_.remove(file_handle);
   }
+  {
+    // The volume may still release expired lingering locks with file_handle.
+    boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+    while (expired_locks_file_handle_ == file_handle) {
+      active_locks_changed_.wait(mutex_lock);
+    }
+  }
   // Waiting does not require a lock on the open_file_handles_.
   file_handle->WaitForAsyncOperations();
   // Defer the deletion of file_handle as it might be needed by
@@ -170,6 +182,7 @@ bool FileInfo::TryToUpdateOSDWriteResponse(
     osd_write_response_.reset(response);
     osd_write_response_xcap_.CopyFrom(xcap);
     osd_write_response_status_ = kDirty;
+    volume_->ScheduleFileSizeUpdate(file_id_);
 
     return true;
   } else {
@@ -188,7 +201,10 @@ void FileInfo::WriteBackFileSizeAsync(const RPCOptions& options) {
     osd_write_response_status_ = kDirtyAndAsyncPending;
     file_handle->set_osd_write_response_for_async_write_back(
         *(osd_write_response_.get()));
-    file_handle->WriteBackFileSizeAsync(options);
+    file_handle->WriteBackFileSizeAsync(options, close_file_pending_);
+    close_file_pending_ = false;
+    // Wake up a Flush() which waits for the update to be sent.
+    osd_write_response_cond_.notify_all();
   }
 }
 
@@ -227,6 +243,12 @@ void FileInfo::RenamePath(const std::string& path,
   }
 }
 
+void FileInfo::InvalidateOpenCapabilities() {
+  string path;
+  GetPath(&path);
+  volume_->InvalidateOpenCapabilities(path);
+}
+
 void FileInfo::WaitForPendingFileSizeUpdates() {
   boost::mutex::scoped_lock lock(osd_write_response_mutex_);
 
@@ -241,6 +263,19 @@ void FileInfo::WaitForPendingFileSizeUpdatesHelper(
   }
 }
 
+void FileInfo::WaitForScheduledFileSizeUpdateHelper(
+    boost::mutex::scoped_lock* lock) {
+  assert(lock->owns_lock());
+  const boost::system_time deadline = boost::get_system_time()
+      + boost::posix_time::milliseconds(
+            2 * volume_->volume_options().file_size_update_coalescing_ms);
+  while (osd_write_response_status_ == kDirty) {
+    if (!osd_write_response_cond_.timed_wait(*lock, deadline)) {
+      break;
+    }
+  }
+}
+
 void FileInfo::AsyncFileSizeUpdateResponseHandler(
     const xtreemfs::pbrpc::OSDWriteResponse& owr,
     FileHandleImplementation* file_handle,
@@ -255,6 +290,7 @@ void FileInfo::AsyncFileSizeUpdateResponseHandler(
       osd_write_response_status_ = kClean;
     } else {
       osd_write_response_status_ = kDirty;  // Still dirty.
+      volume_->ScheduleFileSizeUpdate(file_id_);
     }
   }
 
@@ -297,7 +333,24 @@ void FileInfo::FlushPendingFileSizeUpdate(FileHandleImplementation* file_handle,
 
   bool no_response_sent = true;
   if (osd_write_response_.get()) {
+    bool scheduled = false;
+    if (osd_write_response_status_ == kDirty &&
+        volume_->ScheduleUrgentFileSizeUpdate(file_id_)) {
+      // Let the background thread send the update together with those of
+      // other flushed or closed files. If it does not pick it up in time or
+      // the update fails, it is sent synchronously below.
+      scheduled = true;
+      close_file_pending_ = close_file;
+      WaitForScheduledFileSizeUpdateHelper(&lock);
+    }
     WaitForPendingFileSizeUpdatesHelper(&lock);
+    if (scheduled && close_file) {
+      if (!close_file_pending_ && osd_write_response_status_ == kClean) {
+        // The background thread did close the file along with the update.
+        no_response_sent = false;
+      }
+      close_file_pending_ = false;
+    }
     if (osd_write_response_status_ == kDirty) {
       osd_write_response_status_ = kDirtyAndSyncPending;
       // Create a copy of OSDWriteResponse to pass to FileHandle.
@@ -308,6 +361,7 @@ void FileInfo::FlushPendingFileSizeUpdate(FileHandleImplementation* file_handle,
         file_handle->WriteBackFileSize(response_copy, close_file);
       } catch (const XtreemFSException&) {
         osd_write_response_status_ = kDirty;
+        volume_->ScheduleFileSizeUpdate(file_id_);
         throw;  // Rethrow error.
       }
 
@@ -399,7 +453,270 @@ void FileInfo::DelLock(const xtreemfs::pbrpc::Lock& lock) {
     // Only up to one lock per PID. If its unlocked, just delete it.
     delete it->second;
     active_locks_.erase(it);
+
+    ++active_locks_version_;
+    active_locks_changed_.notify_all();
+  }
+}
+
+uint64_t FileInfo::active_locks_version() {
+  boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+  return active_locks_version_;
+}
+
+void FileInfo::WaitForActiveLocksChange(uint64_t version, int timeout_ms) {
+  const boost::system_time until = boost::get_system_time()
+      + boost::posix_time::milliseconds(timeout_ms);
+  boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+  while (active_locks_version_ == version) {
+    if (!active_locks_changed_.timed_wait(mutex_lock, until)) {
+      return;
+    }
+  }
+}
+
+bool FileInfo::LingerLock(const xtreemfs::pbrpc::Lock& lock,
+                          const boost::posix_time::ptime& expires_at) {
+  assert(lock.client_uuid() == client_uuid_);
+  boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+
+  map<unsigned int, Lock*>::iterator it = active_locks_.find(lock.client_pid());
+  if (it == active_locks_.end()) {
+    return false;
+  }
+  // Only up to one lock per PID, the OSD overwrote any older lingering lock.
+  map<unsigned int, LingeringLock>::iterator lingering
+      = lingering_locks_.find(lock.client_pid());
+  if (lingering != lingering_locks_.end()) {
+    delete lingering->second.lock;
+    lingering_locks_.erase(lingering);
   }
+  LingeringLock lingering_lock;
+  lingering_lock.lock = it->second;
+  lingering_lock.expires_at = expires_at;
+  lingering_lock.state = LingeringLock::kLingering;
+  lingering_locks_[lock.client_pid()] = lingering_lock;
+  active_locks_.erase(it);
+
+  ++active_locks_version_;
+  active_locks_changed_.notify_all();
+  return true;
+}
+
+bool FileInfo::ReviveLingeringLock(const xtreemfs::pbrpc::Lock& lock) {
+  assert(lock.client_uuid() == client_uuid_);
+  boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+
+  map<unsigned int, LingeringLock>::iterator it
+      = lingering_locks_.find(lock.client_pid());
+  if (it == lingering_locks_.end()
+      || it->second.state != LingeringLock::kLingering
+      || !CheckIfLocksAreEqual(lock, *(it->second.lock))
+      || lock.exclusive() != it->second.lock->exclusive()
+      || active_locks_.find(lock.client_pid()) != active_locks_.end()) {
+    return false;
+  }
+  active_locks_[lock.client_pid()] = it->second.lock;
+  lingering_locks_.erase(it);
+  return true;
+}
+
+namespace {
+
+/** Selects the lingering locks which are in the way of "lock". */
+class LingeringLockInTheWay {
+ public:
+  explicit LingeringLockInTheWay(const Lock& lock) : lock_(lock) {}
+
+  bool operator()(const Lock& lingering_lock,
+                  const boost::posix_time::ptime& expires_at) const {
+    return lingering_lock.client_pid() == lock_.client_pid()
+        || CheckIfLocksDoConflict(lock_, lingering_lock);
+  }
+
+ private:
+  const Lock& lock_;
+};
+
+/** Selects the lingering locks which expired at "now". */
+class LingeringLockExpired {
+ public:
+  explicit LingeringLockExpired(const boost::posix_time::ptime& now)
+      : now_(now) {}
+
+  bool operator()(const Lock& lingering_lock,
+                  const boost::posix_time::ptime& expires_at) const {
+    return expires_at <= now_;
+  }
+
+ private:
+  const boost::posix_time::ptime now_;
+};
+
+/** Selects all lingering locks. */
+class AnyLingeringLock {
+ public:
+  bool operator()(const Lock& lingering_lock,
+                  const boost::posix_time::ptime& expires_at) const {
+    return true;
+  }
+};
+
+}  // namespace
+
+template<class Predicate>
+bool FileInfo::IsReleasingLingeringLockUnmutexed(Predicate drop) {
+  for (map<unsigned int, LingeringLock>::iterator it = lingering_locks_.begin();
+       it != lingering_locks_.end(); ++it) {
+    if (it->second.state != LingeringLock::kLingering
+        && drop(*(it->second.lock), it->second.expires_at)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template<class Predicate>
+void FileInfo::CollectLingeringLocksUnmutexed(Predicate drop,
+                                              vector<Lock>* locks) {
+  for (map<unsigned int, LingeringLock>::iterator it = lingering_locks_.begin();
+       it != lingering_locks_.end(); ++it) {
+    if (it->second.state == LingeringLock::kLingering
+        && drop(*(it->second.lock), it->second.expires_at)) {
+      it->second.state = LingeringLock::kReleasing;
+      locks->push_back(*(it->second.lock));
+    }
+  }
+}
+
+void FileInfo::ReleaseLingeringLocks(FileHandleImplementation* file_handle,
+                                     const vector<Lock>& locks,
+                                     bool forget_failed) {
+  for (size_t i = 0; i < locks.size(); ++i) {
+    bool released = false;
+    try {
+      file_handle->ReleaseLockAtOSD(locks[i]);
+      released = true;
+    } catch(const XtreemFSException& e) {
+      Logging::log->getLog(LEVEL_WARN) << "Failed to release the lingering"
+          " lock of the PID: " << locks[i].client_pid() << " of file: "
+          << file_id_ << ". Error: " << e.what() << endl;
+    } catch(...) {
+      // E.g., boost::thread_interrupted: the OSD may still hold the locks.
+      boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+      for (size_t j = i; j < locks.size(); ++j) {
+        FinishLingeringLockReleaseUnmutexed(locks[j], false);
+      }
+      throw;
+    }
+
+    boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+    FinishLingeringLockReleaseUnmutexed(locks[i], released || forget_failed);
+  }
+}
+
+void FileInfo::FinishLingeringLockReleaseUnmutexed(
+    const xtreemfs::pbrpc::Lock& lock,
+    bool released) {
+  map<unsigned int, LingeringLock>::iterator it
+      = lingering_locks_.find(lock.client_pid());
+  if (it != lingering_locks_.end()
+      && it->second.state == LingeringLock::kReleasing
+      && CheckIfLocksAreEqual(lock, *(it->second.lock))) {
+    if (released) {
+      delete it->second.lock;
+      lingering_locks_.erase(it);
+    } else {
+      it->second.state = LingeringLock::kLingering;
+    }
+  }
+  active_locks_changed_.notify_all();
+}
+
+void FileInfo::DropLingeringLocks(FileHandleImplementation* file_handle,
+                                  const xtreemfs::pbrpc::Lock& lock) {
+  const LingeringLockInTheWay in_the_way(lock);
+  vector<Lock> locks;
+  {
+    boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+    // The OSD would report a conflict until their release finished.
+    while (IsReleasingLingeringLockUnmutexed(in_the_way)) {
+      active_locks_changed_.wait(mutex_lock);
+    }
+    CollectLingeringLocksUnmutexed(in_the_way, &locks);
+  }
+  ReleaseLingeringLocks(file_handle, locks, false);
+}
+
+bool FileInfo::CollectExpiredLingeringLocks(
+    const boost::posix_time::ptime& now) {
+  boost::mutex::scoped_lock lock_fhlist(open_file_handles_mutex_);
+  if (open_file_handles_.empty()) {
+    // The file is being closed, the last close releases all locks.
+    return false;
+  }
+
+  boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+  if (expired_locks_file_handle_ != NULL) {
+    return false;
+  }
+  const LingeringLockExpired expired(now);
+  bool found = false;
+  for (map<unsigned int, LingeringLock>::iterator it = lingering_locks_.begin();
+       it != lingering_locks_.end(); ++it) {
+    if (it->second.state == LingeringLock::kLingering
+        && expired(*(it->second.lock), it->second.expires_at)) {
+      it->second.state = LingeringLock::kExpired;
+      found = true;
+    }
+  }
+  if (found) {
+    expired_locks_file_handle_ = open_file_handles_.front();
+  }
+  return found;
+}
+
+void FileInfo::ReleaseExpiredLingeringLocks() {
+  FileHandleImplementation* file_handle;
+  vector<Lock> locks;
+  {
+    boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+    file_handle = expired_locks_file_handle_;
+    for (map<unsigned int, LingeringLock>::iterator it
+             = lingering_locks_.begin();
+         it != lingering_locks_.end(); ++it) {
+      if (it->second.state == LingeringLock::kExpired) {
+        it->second.state = LingeringLock::kReleasing;
+        locks.push_back(*(it->second.lock));
+      }
+    }
+  }
+
+  try {
+    ReleaseLingeringLocks(file_handle, locks, false);
+  } catch(...) {
+    boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+    expired_locks_file_handle_ = NULL;
+    active_locks_changed_.notify_all();
+    throw;
+  }
+
+  // The file may be closed and deleted as soon as the mutex is released.
+  boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+  expired_locks_file_handle_ = NULL;
+  active_locks_changed_.notify_all();
+}
+
+void FileInfo::CancelExpiredLingeringLocks() {
+  boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+  for (map<unsigned int, LingeringLock>::iterator it = lingering_locks_.begin();
+       it != lingering_locks_.end(); ++it) {
+    if (it->second.state == LingeringLock::kExpired) {
+      it->second.state = LingeringLock::kLingering;
+    }
+  }
+  expired_locks_file_handle_ = NULL;
+  active_locks_changed_.notify_all();
 }
 
 void FileInfo::ReleaseLockOfProcess(FileHandleImplementation* file_handle,
@@ -418,6 +735,17 @@ void FileInfo::ReleaseLockOfProcess(FileHandleImplementation* file_handle,
 }
 
 void FileInfo::ReleaseAllLocks(FileHandleImplementation* file_handle) {
+  vector<Lock> lingering_locks;
+  {
+    boost::mutex::scoped_lock mutex_lock(active_locks_mutex_);
+    while (IsReleasingLingeringLockUnmutexed(AnyLingeringLock())) {
+      active_locks_changed_.wait(mutex_lock);
+    }
+    CollectLingeringLocksUnmutexed(AnyLingeringLock(), &lingering_locks);
+  }
+  // The file is closed, a failed release is not retried.
+  ReleaseLingeringLocks(file_handle, lingering_locks, true);
+
   // Do not use pointers here to ensure the deletion of this list - otherwise
   // a ReleaseLock() may fail and the memory wont be freed.
   list<Lock> active_locks_copy;
@@ -436,8 +764,9 @@ void FileInfo::ReleaseAllLocks(FileHandleImplementation* file_handle) {
   for (list<Lock>::const_iterator it = active_locks_copy.begin();
        it != active_locks_copy.end();
        ++it) {
-    // The lock itself will be deleted by ReleaseLock.
-    file_handle->ReleaseLock(*it);
+    // Bypasses the lingering of released locks.
+    file_handle->ReleaseLockAtOSD(*it);
+    DelLock(*it);
   }
 }
 
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "libxtreemfs/file_size_update_queue.h"
+
+using namespace std;
+
+namespace xtreemfs {
+
+bool FileSizeUpdateQueue::Add(uint64_t file_id) {
+  boost::mutex::scoped_lock lock(mutex_);
+  return dirty_.insert(file_id).second;
+}
+
+bool FileSizeUpdateQueue::AddUrgent(uint64_t file_id) {
+  boost::mutex::scoped_lock lock(mutex_);
+  dirty_.insert(file_id);
+  if (!urgent_.insert(file_id).second) {
+    return false;
+  }
+  if (urgent_.size() == 1) {
+    urgent_cond_.notify_one();
+  }
+  return true;
+}
+
+bool FileSizeUpdateQueue::WaitForUrgent(const boost::system_time& deadline) {
+  boost::mutex::scoped_lock lock(mutex_);
+  while (urgent_.empty()) {
+    if (!urgent_cond_.timed_wait(lock, deadline)) {
+      break;
+    }
+  }
+  return !urgent_.empty();
+}
+
+void FileSizeUpdateQueue::Take(bool all, std::vector<uint64_t>* file_ids) {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (all) {
+    file_ids->insert(file_ids->end(), dirty_.begin(), dirty_.end());
+    dirty_.clear();
+  } else {
+    file_ids->insert(file_ids->end(), urgent_.begin(), urgent_.end());
+    for (set<uint64_t>::const_iterator it = urgent_.begin();
+         it != urgent_.end();
+         ++it) {
+      dirty_.erase(*it);
+    }
+  }
+  urgent_.clear();
+}
+
+size_t FileSizeUpdateQueue::Size() {
+  boost::mutex::scoped_lock lock(mutex_);
+  return dirty_.size();
+}
+
+}  // namespace xtreemfs
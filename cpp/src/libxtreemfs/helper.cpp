@@ -285,10 +285,16 @@ bool CheckIfUnsignedInteger(const std::string& string) {
 }
 
 RPCOptions RPCOptionsFromOptions(const Options& options) {
-  return RPCOptions(options.max_tries,
-                    options.retry_delay_s,
-                    false,  // do not delay last attempt
-                    options.was_interrupted_function);
+  RPCOptions rpc_options(options.max_tries,
+                         options.retry_delay_s,
+                         false,  // do not delay last attempt
+                         options.was_interrupted_function);
+  if (options.operation_timeout_s > 0) {
+    rpc_options.set_deadline(
+        boost::posix_time::microsec_clock::local_time()
+        + boost::posix_time::seconds(options.operation_timeout_s));
+  }
+  return rpc_options;
 }
 
 #ifdef __APPLE__
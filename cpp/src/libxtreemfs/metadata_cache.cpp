@@ -7,13 +7,20 @@
 
 #include "libxtreemfs/metadata_cache.h"
 
+#include <algorithm>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite_inl.h>
+#include <limits>
+
 #include "libxtreemfs/helper.h"
+#include "libxtreemfs/persistent_metadata_cache.h"
 #include "util/logging.h"
 #include "xtreemfs/OSD.pb.h"
 
 using namespace std;
 using namespace xtreemfs::pbrpc;
 using namespace xtreemfs::util;
+using google::protobuf::io::CodedInputStream;
 
 /** MetadataCache for Stat, listxattrResponse and XAttr objects per path.
  * \file
@@ -55,9 +62,94 @@ using namespace xtreemfs::util;
 
 namespace xtreemfs {
 
+/** InvalidatePrefix() and RenamePrefix() change at most this many entries below
+ *  a directory right away. Larger subtrees are invalidated lazily. */
+static const int kMaxEagerlyChangedEntries = 1024;
+
+/** Number of entries CollectInvalidatedUnmutexed() looks at per update. */
+static const int kCollectBatchSize = 16;
+
+/** Parses the serialized DirectoryEntries of a MetadataCacheEntry. Unlike
+ *  ParseFromString(), listings larger than 64 MB are supported. */
+static void ParseDirEntries(const std::string& serialized,
+                            DirectoryEntries* dir_entries) {
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(serialized.data()),
+                         static_cast<int>(serialized.size()));
+  input.SetTotalBytesLimit(numeric_limits<int>::max(), -1);
+  if (!dir_entries->ParsePartialFromCodedStream(&input)) {
+    dir_entries->Clear();
+  }
+}
+
+/** Returns true if the serialized DirectoryEntries contain "name". Only the
+ *  names are looked at, the DirectoryEntries are not parsed. */
+static bool ContainsDirEntry(const std::string& serialized,
+                             const std::string& name) {
+  using google::protobuf::internal::WireFormatLite;
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(serialized.data()),
+                         static_cast<int>(serialized.size()));
+  input.SetTotalBytesLimit(numeric_limits<int>::max(), -1);
+
+  string entry_name;
+  uint32_t tag;
+  while ((tag = input.ReadTag()) != 0) {
+    if (WireFormatLite::GetTagFieldNumber(tag)
+            != DirectoryEntries::kEntriesFieldNumber) {
+      if (!WireFormatLite::SkipField(&input, tag)) {
+        return false;
+      }
+      continue;
+    }
+    uint32_t length;
+    if (!input.ReadVarint32(&length)) {
+      return false;
+    }
+    const CodedInputStream::Limit limit = input.PushLimit(length);
+    while ((tag = input.ReadTag()) != 0) {
+      if (WireFormatLite::GetTagFieldNumber(tag)
+              == DirectoryEntry::kNameFieldNumber) {
+        if (!WireFormatLite::ReadString(&input, &entry_name)) {
+          return false;
+        }
+        if (entry_name == name) {
+          return true;
+        }
+      } else if (!WireFormatLite::SkipField(&input, tag)) {
+        return false;
+      }
+    }
+    input.PopLimit(limit);
+  }
+  return false;
+}
+
 MetadataCache::MetadataCache(uint64_t size, uint64_t ttl_s)
-    : size_(size), ttl_s_(ttl_s) {
+    : size_(size),
+      ttl_s_(ttl_s),
+      negative_enabled_(false),
+      negative_size_(0),
+      negative_ttl_s_(0),
+      xattr_negative_ttl_s_(0),
+      persistent_cache_(NULL),
+      clock_(&MetadataCache::SystemClock),
+      generation_(0) {
+  enabled = size > 0 ? true : false;
+}
+
+MetadataCache::MetadataCache(uint64_t size,
+                             uint64_t ttl_s,
+                             uint64_t negative_size,
+                             uint64_t negative_ttl_s)
+    : size_(size),
+      ttl_s_(ttl_s),
+      negative_size_(negative_size),
+      negative_ttl_s_(negative_ttl_s),
+      xattr_negative_ttl_s_(0),
+      persistent_cache_(NULL),
+      clock_(&MetadataCache::SystemClock),
+      generation_(0) {
   enabled = size > 0 ? true : false;
+  negative_enabled_ = negative_size > 0 && negative_ttl_s > 0;
 }
 
 MetadataCache::~MetadataCache() {
@@ -106,6 +198,11 @@ void MetadataCache::InvalidatePrefix(const std::string& path) {
 
   // Clean any possible cached contents of the directory "path".
   const std::string prefix = path + "/";
+  if (!IsSmallSubtreeUnmutexed(prefix)) {
+    // Do not block all other operations while removing the entries.
+    InvalidateLazilyUnmutexed(path);
+    return;
+  }
   // Here it's not possible to reuse it_map as there may be additional entries
   // between path and path+"/" (for instance path+".").
   it_map = index.lower_bound(prefix);
@@ -128,16 +225,35 @@ void MetadataCache::RenamePrefix(const std::string& path,
   boost::mutex::scoped_lock lock(mutex_);
 
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  // "new_path" was replaced if it existed.
+  by_map::iterator it_map = index.find(new_path);
+  if (it_map != index.end()) {
+    delete *it_map;
+    index.erase(it_map);
+  }
+
+  it_map = index.find(path);
   if (it_map != index.end()) {
     MetadataCacheEntry* cached_entry = *it_map;
-    cached_entry->path = new_path;
-    it_map = index.erase(it_map);
-    index.insert(cached_entry);
+    // The path must not change while the entry is part of the indexes.
+    index.erase(it_map);
+    if (IsInvalidatedUnmutexed(*cached_entry)) {
+      // Below "new_path" it would not be covered by the invalidation anymore.
+      delete cached_entry;
+    } else {
+      cached_entry->path = new_path;
+      index.insert(cached_entry);
+    }
   }
 
   // Clean any possible cached contents of the directory "path".
   const std::string prefix = path + "/";
+  if (!IsSmallSubtreeUnmutexed(prefix)) {
+    // Renaming every entry would block all other operations, so they are
+    // dropped instead and have to be retrieved again from the MRC.
+    InvalidateLazilyUnmutexed(path);
+    return;
+  }
   const std::string prefix_new = new_path + "/";
   it_map = index.lower_bound(prefix);
   while (it_map != index.end()) {
@@ -145,34 +261,114 @@ void MetadataCache::RenamePrefix(const std::string& path,
     if (cached_entry->path.find(prefix) != 0) {
       break;
     }
+    it_map = index.erase(it_map);
+    if (IsInvalidatedUnmutexed(*cached_entry)) {
+      delete cached_entry;
+      continue;
+    }
     // Change prefix.
     cached_entry->path.replace(0, prefix.length(), prefix_new);
-    it_map = index.erase(it_map);
+    by_map::iterator it_replaced = index.find(cached_entry->path);
+    if (it_replaced != index.end()) {
+      delete *it_replaced;
+      index.erase(it_replaced);
+    }
     index.insert(cached_entry);
   }
 }
 
+time_t MetadataCache::SystemClock() {
+  return time(NULL);
+}
+
+void MetadataCache::SetClock(Clock clock) {
+  boost::mutex::scoped_lock lock(mutex_);
+  clock_ = clock;
+}
+
+void MetadataCache::SetPersistentCache(
+    PersistentMetadataCache* persistent_cache) {
+  persistent_cache_ = persistent_cache;
+}
+
+void MetadataCache::SetXAttrNegativeTtl(uint64_t xattr_negative_ttl_s) {
+  boost::mutex::scoped_lock lock(mutex_);
+  xattr_negative_ttl_s_ = xattr_negative_ttl_s;
+}
+
+bool MetadataCache::IsNegativelyCachedXAttr(const std::string& name) {
+  return name.compare(0, 9, "security.") == 0
+      || name.compare(0, 17, "system.posix_acl_") == 0;
+}
+
+bool MetadataCache::IsXAttrKnownMissingUnmutexed(
+    const MetadataCacheEntry& cache_entry,
+    const std::string& name,
+    uint64_t current_time_s) {
+  if (xattr_negative_ttl_s_ <= ttl_s_ || !IsNegativelyCachedXAttr(name)) {
+    return false;
+  }
+  // The list was fetched ttl_s_ seconds before it expired.
+  if (cache_entry.xattrs_timeout_s - ttl_s_ + xattr_negative_ttl_s_
+          < current_time_s) {
+    return false;
+  }
+  const listxattrResponse& cached_xattrs = *cache_entry.xattrs;
+  for (int i = 0; i < cached_xattrs.xattrs_size(); i++) {
+    if (cached_xattrs.xattrs(i).name() == name) {
+      return false;
+    }
+  }
+  return true;
+}
 
 MetadataCache::GetStatResult MetadataCache::GetStat(
     const std::string& path,
     xtreemfs::pbrpc::Stat* stat) {
-  if (path.empty() || !enabled) {
+  GetStatResult result = GetStatFromMemory(path, stat);
+  if (result == kStatNotCached && persistent_cache_ != NULL
+      && persistent_cache_->GetStat(path, stat)) {
+    UpdateStat(path, *stat);
+    result = kStatCached;
+  }
+  return result;
+}
+
+MetadataCache::GetStatResult MetadataCache::GetStatFromMemory(
+    const std::string& path,
+    xtreemfs::pbrpc::Stat* stat) {
+  if (path.empty() || !(enabled || negative_enabled_)) {
     return kStatNotCached;
   }
 
   boost::mutex::scoped_lock lock(mutex_);
 
+  if (negative_enabled_) {
+    NonExistentMap::iterator it_negative = non_existent_.find(path);
+    if (it_negative != non_existent_.end()) {
+      if (it_negative->second.timeout_s >= static_cast<uint64_t>(clock_())) {
+        if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+          Logging::log->getLog(LEVEL_DEBUG)
+              << "MetadataCache GetStat hit non-existent path: " << path
+              << endl;
+        }
+        return kPathDoesntExist;
+      }
+      EraseNonExistentUnmutexed(it_negative);
+    }
+  }
+
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path);
+  by_hash::iterator it_hash = FindUnmutexed(path);
   if (it_hash != index.end()) {
     MetadataCacheEntry* cache_entry = *it_hash;
     // We must never have cached a hard link.
-    assert(cache_entry->stat == NULL || cache_entry->stat->nlink() == 1);
+    assert(!cache_entry->has_stat || cache_entry->stat.nlink == 1);
     // Entry found for path, check timeout of Stat value.
-    uint64_t current_time_s = time(NULL);
+    uint64_t current_time_s = clock_();
     if (cache_entry->stat_timeout_s >= current_time_s) {
-      if (cache_entry->stat != NULL) {
-        stat->CopyFrom(*(cache_entry->stat));
+      if (cache_entry->has_stat) {
+        cache_entry->stat.CopyTo(stat);
         return kStatCached;
       }
     } else {
@@ -201,23 +397,22 @@ MetadataCache::GetStatResult MetadataCache::GetStat(
       string parent_dir = ResolveParentDirectory(path);
       string basename = GetBasename(path);
 
-      by_hash::iterator it_hash = index.find(parent_dir);
+      by_hash::iterator it_hash = FindUnmutexed(parent_dir);
       if (it_hash != index.end()) {
         MetadataCacheEntry* cache_entry = *it_hash;
 
         if (cache_entry->dir_entries != NULL) {
-          uint64_t current_time_s = time(NULL);
+          uint64_t current_time_s = clock_();
           if (cache_entry->dir_entries_timeout_s >= current_time_s) {
             // The parent directory is cached - we can find out if path exists.
-            path_probably_exists = false;
-            const DirectoryEntries& cached_dentries =
-                *(cache_entry->dir_entries);
-            for (int i = 0; i < cached_dentries.entries_size(); i++) {
-              const DirectoryEntry& dentry = cached_dentries.entries(i);
-              if (dentry.name() == basename) {
-                path_probably_exists = true;
-                break;
-              }
+            path_probably_exists = ContainsDirEntry(
+                cache_entry->dir_entries->serialized, basename);
+            // Spare the scan of the listing for further lookups.
+            if (!path_probably_exists && negative_enabled_) {
+              AddNonExistentUnmutexed(
+                  path,
+                  min(current_time_s + negative_ttl_s_,
+                      cache_entry->dir_entries_timeout_s));
             }
           } else {
             // Expired => remove from cache.
@@ -258,12 +453,25 @@ void MetadataCache::UpdateStat(const std::string& path,
     return;
   }
 
+  if (persistent_cache_ != NULL) {
+    persistent_cache_->PutStat(path, stat);
+  }
+
   boost::mutex::scoped_lock lock(mutex_);
 
+  if (!invalidated_prefixes_.empty()) {
+    CollectInvalidatedUnmutexed(kCollectBatchSize);
+  }
+
+  NonExistentMap::iterator it_negative = non_existent_.find(path);
+  if (it_negative != non_existent_.end()) {
+    EraseNonExistentUnmutexed(it_negative);
+  }
+
   MetadataCacheEntry* cache_entry = NULL;
   // Check if there's already an Entry for path.
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     cache_entry = *it_map;
   } else {
@@ -275,13 +483,14 @@ void MetadataCache::UpdateStat(const std::string& path,
 
     cache_entry = new MetadataCacheEntry();
     cache_entry->path = path;
+    cache_entry->generation = generation_;
   }
 
-  if (cache_entry->stat == NULL) {
-    cache_entry->stat = new Stat;
-  }
-  cache_entry->stat->CopyFrom(stat);
-  cache_entry->stat_timeout_s = time(NULL) + ttl_s_;
+  cache_entry->stat.CopyFrom(stat);
+  cache_entry->stat.user_id = InternOwnerNameUnmutexed(stat.user_id());
+  cache_entry->stat.group_id = InternOwnerNameUnmutexed(stat.group_id());
+  cache_entry->has_stat = true;
+  cache_entry->stat_timeout_s = clock_() + ttl_s_;
   cache_entry->timeout_s = cache_entry->stat_timeout_s;
 
   if (it_map != index.end()) {
@@ -305,27 +514,27 @@ void MetadataCache::UpdateStatTime(const std::string& path,
   boost::mutex::scoped_lock lock(mutex_);
 
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     MetadataCacheEntry* cache_entry = *it_map;
-    Stat* cached_stat = cache_entry->stat;
-    if (cached_stat == NULL) {
+    if (!cache_entry->has_stat) {
       return;
     }
+    CachedStat* cached_stat = &cache_entry->stat;
     uint64_t time_ns = timestamp_s * 1000000000;
     if ((to_set & SETATTR_ATIME)
-        && time_ns > cached_stat->atime_ns()) {
-      cached_stat->set_atime_ns(time_ns);
+        && time_ns > cached_stat->atime_ns) {
+      cached_stat->atime_ns = time_ns;
     }
     if ((to_set & SETATTR_MTIME)
-        && time_ns > cached_stat->mtime_ns()) {
-      cached_stat->set_mtime_ns(time_ns);
+        && time_ns > cached_stat->mtime_ns) {
+      cached_stat->mtime_ns = time_ns;
     }
     if ((to_set & SETATTR_CTIME)
-        && time_ns > cached_stat->ctime_ns()) {
-      cached_stat->set_ctime_ns(time_ns);
+        && time_ns > cached_stat->ctime_ns) {
+      cached_stat->ctime_ns = time_ns;
     }
-    cache_entry->stat_timeout_s = time(NULL) + ttl_s_;
+    cache_entry->stat_timeout_s = clock_() + ttl_s_;
     cache_entry->timeout_s = cache_entry->stat_timeout_s;
     it_map = index.erase(it_map);
     index.insert(it_map, cache_entry);
@@ -343,54 +552,55 @@ void MetadataCache::UpdateStatAttributes(const std::string& path,
   boost::mutex::scoped_lock lock(mutex_);
 
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     MetadataCacheEntry* cache_entry = *it_map;
-    Stat* cached_stat = cache_entry->stat;
-    if (cached_stat == NULL) {
+    if (!cache_entry->has_stat) {
       return;
     }
+    CachedStat* cached_stat = &cache_entry->stat;
 
     if ((to_set & SETATTR_ATTRIBUTES)) {
-      cached_stat->set_attributes(stat.attributes());
+      cached_stat->attributes = stat.attributes();
+      cached_stat->has_attributes = true;
     }
     if ((to_set & SETATTR_MODE)) {
       // Modify only the last 12 Bits (3 bits for sticky bit, set GID and
       // set UID and 3 * 3 bits for the file access mode).
-      cached_stat->set_mode((cached_stat->mode() & 0xFFFFF000) |
-          (stat.mode() & 0x00000FFF));
+      cached_stat->mode = (cached_stat->mode & 0xFFFFF000) |
+          (stat.mode() & 0x00000FFF);
     }
     if ((to_set & SETATTR_UID)) {
-      cached_stat->set_user_id(stat.user_id());
+      cached_stat->user_id = InternOwnerNameUnmutexed(stat.user_id());
     }
     if ((to_set & SETATTR_GID)) {
-      cached_stat->set_group_id(stat.group_id());
+      cached_stat->group_id = InternOwnerNameUnmutexed(stat.group_id());
     }
     if ((to_set & SETATTR_SIZE)) {
       if (stat.has_truncate_epoch() &&
-          stat.truncate_epoch() > cached_stat->truncate_epoch()) {
-        cached_stat->set_size(stat.size());
-        cached_stat->set_truncate_epoch(stat.truncate_epoch());
+          stat.truncate_epoch() > cached_stat->truncate_epoch) {
+        cached_stat->size = stat.size();
+        cached_stat->truncate_epoch = stat.truncate_epoch();
       } else if (stat.has_truncate_epoch() &&
-                 stat.truncate_epoch() == cached_stat->truncate_epoch() &&
-                 stat.size() > cached_stat->size()) {
-        cached_stat->set_size(stat.size());
+                 stat.truncate_epoch() == cached_stat->truncate_epoch &&
+                 stat.size() > cached_stat->size) {
+        cached_stat->size = stat.size();
       }
       if (Logging::log->loggingActive(LEVEL_DEBUG)) {
         Logging::log->getLog(LEVEL_DEBUG)
             << "MetadataCache UpdateStatAttributes SETATTR_SIZE: new size: "
-            << cached_stat->size() << " truncate epoch: "
-            << cached_stat->truncate_epoch() << endl;
+            << cached_stat->size << " truncate epoch: "
+            << cached_stat->truncate_epoch << endl;
       }
     }
     if ((to_set & SETATTR_ATIME)) {
-      cached_stat->set_atime_ns(stat.atime_ns());
+      cached_stat->atime_ns = stat.atime_ns();
     }
     if ((to_set & SETATTR_MTIME)) {
-      cached_stat->set_mtime_ns(stat.mtime_ns());
+      cached_stat->mtime_ns = stat.mtime_ns();
     }
     if ((to_set & SETATTR_CTIME)) {
-      cached_stat->set_ctime_ns(stat.ctime_ns());
+      cached_stat->ctime_ns = stat.ctime_ns();
     }
 
     if (Logging::log->loggingActive(LEVEL_DEBUG)) {
@@ -399,7 +609,7 @@ void MetadataCache::UpdateStatAttributes(const std::string& path,
           << to_set << endl;
     }
 
-    cache_entry->stat_timeout_s = time(NULL) + ttl_s_;
+    cache_entry->stat_timeout_s = clock_() + ttl_s_;
     cache_entry->timeout_s = cache_entry->stat_timeout_s;
     it_map = index.erase(it_map);
     index.insert(it_map, cache_entry);
@@ -418,58 +628,58 @@ xtreemfs::pbrpc::Setattrs MetadataCache::SimulateSetStatAttributes(
   boost::mutex::scoped_lock lock(mutex_);
 
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     MetadataCacheEntry* cache_entry = *it_map;
-    if (cache_entry->stat == NULL) {
+    if (!cache_entry->has_stat) {
       return to_set;
     }
 
-    const Stat& cached_stat = *(cache_entry->stat);
+    const CachedStat& cached_stat = cache_entry->stat;
 
     if ((to_set & SETATTR_ATTRIBUTES)) {
-      if (cached_stat.attributes() == stat.attributes()) {
+      if (cached_stat.attributes == stat.attributes()) {
         actual_to_set &= ~SETATTR_ATTRIBUTES;
       }
     }
     if ((to_set & SETATTR_MODE)) {
       // Modify only the last 12 Bits (3 bits for sticky bit, set GID and
       // set UID and 3 * 3 bits for the file access mode).
-      if ((cached_stat.mode() & 0x00000FFF) == (stat.mode() & 0x00000FFF)) {
+      if ((cached_stat.mode & 0x00000FFF) == (stat.mode() & 0x00000FFF)) {
         actual_to_set &= ~SETATTR_MODE;
       }
     }
     if ((to_set & SETATTR_UID)) {
-      if (cached_stat.user_id() == stat.user_id()) {
+      if (*cached_stat.user_id == stat.user_id()) {
         actual_to_set &= ~SETATTR_UID;
       }
     }
     if ((to_set & SETATTR_GID)) {
-      if (cached_stat.group_id() == stat.group_id()) {
+      if (*cached_stat.group_id == stat.group_id()) {
         actual_to_set &= ~SETATTR_GID;
       }
     }
     if ((to_set & SETATTR_SIZE)) {
       if ((stat.has_truncate_epoch() &&
-           stat.truncate_epoch() < cached_stat.truncate_epoch()) ||
+           stat.truncate_epoch() < cached_stat.truncate_epoch) ||
           (stat.has_truncate_epoch() &&
-           stat.truncate_epoch() == cached_stat.truncate_epoch() &&
-           stat.size() == cached_stat.size())) {
+           stat.truncate_epoch() == cached_stat.truncate_epoch &&
+           stat.size() == cached_stat.size)) {
         actual_to_set &= ~SETATTR_SIZE;
       }
     }
     if ((to_set & SETATTR_ATIME)) {
-      if (stat.atime_ns() == cached_stat.atime_ns()) {
+      if (stat.atime_ns() == cached_stat.atime_ns) {
         actual_to_set &= ~SETATTR_ATIME;
       }
     }
     if ((to_set & SETATTR_MTIME)) {
-      if (stat.mtime_ns() == cached_stat.mtime_ns()) {
+      if (stat.mtime_ns() == cached_stat.mtime_ns) {
         actual_to_set &= ~SETATTR_MTIME;
       }
     }
     if ((to_set & SETATTR_CTIME)) {
-      if (stat.ctime_ns() == cached_stat.ctime_ns()) {
+      if (stat.ctime_ns() == cached_stat.ctime_ns) {
         actual_to_set &= ~SETATTR_CTIME;
       }
     }
@@ -492,16 +702,16 @@ void MetadataCache::UpdateStatFromOSDWriteResponse(
   boost::mutex::scoped_lock lock(mutex_);
 
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     MetadataCacheEntry* cache_entry = *it_map;
-    Stat* cached_stat = cache_entry->stat;
-    if (cached_stat != NULL) {
-      if (response.truncate_epoch() > cached_stat->truncate_epoch() ||
-          (response.truncate_epoch() == cached_stat->truncate_epoch() &&
-           response.size_in_bytes() > cached_stat->size())) {
-        cached_stat->set_size(response.size_in_bytes());
-        cached_stat->set_truncate_epoch(response.truncate_epoch());
+    if (cache_entry->has_stat) {
+      CachedStat* cached_stat = &cache_entry->stat;
+      if (response.truncate_epoch() > cached_stat->truncate_epoch ||
+          (response.truncate_epoch() == cached_stat->truncate_epoch &&
+           response.size_in_bytes() > cached_stat->size)) {
+        cached_stat->size = response.size_in_bytes();
+        cached_stat->truncate_epoch = response.truncate_epoch();
       }
     }
   }
@@ -515,10 +725,9 @@ void MetadataCache::InvalidateStat(const std::string& path) {
   boost::mutex::scoped_lock lock(mutex_);
 
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path);
+  by_hash::iterator it_hash = FindUnmutexed(path);
   if (it_hash != index.end()) {
-    delete (*it_hash)->stat;
-    (*it_hash)->stat = NULL;
+    (*it_hash)->has_stat = false;
   }
 }
 
@@ -526,46 +735,53 @@ xtreemfs::pbrpc::DirectoryEntries* MetadataCache::GetDirEntries(
     const std::string& path,
     uint64_t offset,
     uint32_t count) {
+  DirectoryEntries* result = GetDirEntriesFromMemory(path, offset, count);
+  if (result == NULL && persistent_cache_ != NULL) {
+    DirectoryEntries dir_entries;
+    if (persistent_cache_->GetDirEntries(path, &dir_entries)) {
+      UpdateDirEntries(path, dir_entries);
+      result = GetDirEntriesFromMemory(path, offset, count);
+    }
+  }
+  return result;
+}
+
+xtreemfs::pbrpc::DirectoryEntries* MetadataCache::GetDirEntriesFromMemory(
+    const std::string& path,
+    uint64_t offset,
+    uint32_t count) {
   boost::mutex::scoped_lock lock(mutex_);
 
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path);
+  by_hash::iterator it_hash = FindUnmutexed(path);
   if (it_hash != index.end()) {
     // Entry found for path, check timeout of DirectoryEntries value.
     MetadataCacheEntry* cache_entry = *it_hash;
-    uint64_t current_time_s = time(NULL);
+    uint64_t current_time_s = clock_();
     if (cache_entry->dir_entries != NULL) {
       if (cache_entry->dir_entries_timeout_s >= current_time_s) {
-        DirectoryEntries* cached_dentries = cache_entry->dir_entries;
-        DirectoryEntries* result = new DirectoryEntries;
-
-        // Copy all entries from cache.
-        if (offset == 0 && count >=
-                static_cast<uint32_t>(cached_dentries->entries_size())) {
-          if (Logging::log->loggingActive(LEVEL_DEBUG)) {
-            Logging::log->getLog(LEVEL_DEBUG)
-              << "MetadataCache GetDirEntries hit: " << path << " ["
-              << cache_.size() << "]" << endl;
-          }
-          result->CopyFrom(*cached_dentries);
-        } else {
-          // Copy only selected entries from cache.
-          if (Logging::log->loggingActive(LEVEL_DEBUG)) {
-            Logging::log->getLog(LEVEL_DEBUG)
-              << "MetadataCache GetDirEntries hit (partial copy): " << path
-              << " [" << cache_.size() << "] offset: " << offset
-              << " count: " << count << endl;
-          }
-          // TODO(mberlin): Clearly, this is wrong. The current specification
-          // uses only an int to index all entries while a uint64_t offset is
-          // allowed in the interface.
-          uint32_t offset_in_cached_entries = static_cast<uint32_t>(offset);
-          for (uint32_t i = offset_in_cached_entries;
-               i < offset_in_cached_entries + count;
-               i++) {
-            result->add_entries()->CopyFrom(cached_dentries->entries(i));
-          }
+        if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+          Logging::log->getLog(LEVEL_DEBUG)
+            << "MetadataCache GetDirEntries hit: " << path << " ["
+            << cache_.size() << "] offset: " << offset
+            << " count: " << count << endl;
         }
+        // Copy only the selected entries and parse them without blocking
+        // other lookups.
+        // TODO(mberlin): Clearly, this is wrong. The current specification
+        // uses only an int to index all entries while a uint64_t offset is
+        // allowed in the interface.
+        const int size = cache_entry->dir_entries->size();
+        const int begin = static_cast<int>(min(offset,
+                                               static_cast<uint64_t>(size)));
+        const int end = static_cast<int>(min(offset + count,
+                                             static_cast<uint64_t>(size)));
+        const string cached_dentries(
+            cache_entry->dir_entries->Slice(begin, end));
+        lock.unlock();
+
+        DirectoryEntries* result = new DirectoryEntries;
+        ParseDirEntries(cached_dentries, result);
         return result;
       } else {
         // Expired => remove from cache.
@@ -599,12 +815,32 @@ void MetadataCache::UpdateDirEntries(
     return;
   }
 
+  if (persistent_cache_ != NULL) {
+    persistent_cache_->PutDirEntries(path, dir_entries);
+  }
+
   boost::mutex::scoped_lock lock(mutex_);
 
+  if (!invalidated_prefixes_.empty()) {
+    CollectInvalidatedUnmutexed(kCollectBatchSize);
+  }
+
+  // The listed entries do exist.
+  if (!non_existent_.empty()) {
+    const string prefix = path == "/" ? path : path + "/";
+    for (int i = 0; i < dir_entries.entries_size(); i++) {
+      NonExistentMap::iterator it_negative
+          = non_existent_.find(prefix + dir_entries.entries(i).name());
+      if (it_negative != non_existent_.end()) {
+        EraseNonExistentUnmutexed(it_negative);
+      }
+    }
+  }
+
   MetadataCacheEntry* cache_entry = NULL;
   // Check if there's already an Entry for path.
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     cache_entry = *it_map;
   } else {
@@ -616,13 +852,14 @@ void MetadataCache::UpdateDirEntries(
 
     cache_entry = new MetadataCacheEntry();
     cache_entry->path = path;
+    cache_entry->generation = generation_;
   }
 
   if (cache_entry->dir_entries == NULL) {
-    cache_entry->dir_entries = new DirectoryEntries;
+    cache_entry->dir_entries = new CachedDirEntries;
   }
   cache_entry->dir_entries->CopyFrom(dir_entries);
-  cache_entry->dir_entries_timeout_s = time(NULL) + ttl_s_;
+  cache_entry->dir_entries_timeout_s = clock_() + ttl_s_;
   cache_entry->timeout_s = cache_entry->dir_entries_timeout_s;
 
   if (it_map != index.end()) {
@@ -644,22 +881,23 @@ void MetadataCache::InvalidateDirEntry(const std::string& path_to_directory,
   boost::mutex::scoped_lock lock(mutex_);
 
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path_to_directory);
+  by_hash::iterator it_hash = FindUnmutexed(path_to_directory);
   if (it_hash != index.end()) {
-    DirectoryEntries* cached_dentries = (*it_hash)->dir_entries;
+    CachedDirEntries* cached_dentries = (*it_hash)->dir_entries;
     if (cached_dentries == NULL) {
       return;
     }
 
-    // Copy new DirectoryEntries without entry "name".
-    DirectoryEntries* new_dentries = new DirectoryEntries;
-    for (int i = 0; i < cached_dentries->entries_size(); i++) {
-      if (cached_dentries->entries(i).name() != entry_name) {
-        new_dentries->add_entries()->CopyFrom(cached_dentries->entries(i));
+    // Store new DirectoryEntries without entry "name".
+    DirectoryEntries dentries;
+    ParseDirEntries(cached_dentries->serialized, &dentries);
+    DirectoryEntries new_dentries;
+    for (int i = 0; i < dentries.entries_size(); i++) {
+      if (dentries.entries(i).name() != entry_name) {
+        new_dentries.add_entries()->Swap(dentries.mutable_entries(i));
       }
     }
-    delete (*it_hash)->dir_entries;
-    (*it_hash)->dir_entries = new_dentries;
+    cached_dentries->CopyFrom(new_dentries);
   }
 }
 
@@ -671,7 +909,7 @@ void MetadataCache::InvalidateDirEntries(const std::string& path) {
   boost::mutex::scoped_lock lock(mutex_);
 
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path);
+  by_hash::iterator it_hash = FindUnmutexed(path);
   if (it_hash != index.end()) {
     delete (*it_hash)->dir_entries;
     (*it_hash)->dir_entries = NULL;
@@ -680,16 +918,27 @@ void MetadataCache::InvalidateDirEntries(const std::string& path) {
 
 bool MetadataCache::GetXAttr(const std::string& path, const std::string& name,
                              std::string* value, bool* xattrs_cached) {
+  bool found = GetXAttrFromMemory(path, name, value, xattrs_cached);
+  if (!*xattrs_cached && LoadXAttrsFromPersistentCache(path)) {
+    found = GetXAttrFromMemory(path, name, value, xattrs_cached);
+  }
+  return found;
+}
+
+bool MetadataCache::GetXAttrFromMemory(const std::string& path,
+                                       const std::string& name,
+                                       std::string* value,
+                                       bool* xattrs_cached) {
   assert(xattrs_cached != NULL);
   boost::mutex::scoped_lock lock(mutex_);
 
   *xattrs_cached = false;
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path);
+  by_hash::iterator it_hash = FindUnmutexed(path);
   if (it_hash != index.end()) {
     // Entry found for path, check timeout of listxattrResponse value.
     MetadataCacheEntry* cache_entry = *it_hash;
-    uint64_t current_time_s = time(NULL);
+    uint64_t current_time_s = clock_();
     if (cache_entry->xattrs != NULL) {
       if (cache_entry->xattrs_timeout_s >= current_time_s) {
         *xattrs_cached = true;
@@ -707,6 +956,14 @@ bool MetadataCache::GetXAttr(const std::string& path, const std::string& name,
           }
         }
         return true;
+      } else if (IsXAttrKnownMissingUnmutexed(*cache_entry, name,
+                                              current_time_s)) {
+        if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+          Logging::log->getLog(LEVEL_DEBUG)
+              << "MetadataCache GetXAttr negative hit: " << path << endl;
+        }
+        *xattrs_cached = true;
+        return false;
       } else {
         // Expired => remove from cache.
         if (Logging::log->loggingActive(LEVEL_DEBUG)) {
@@ -736,16 +993,27 @@ bool MetadataCache::GetXAttrSize(const std::string& path,
                                  const std::string& name,
                                  int* size,
                                  bool* xattrs_cached) {
+  bool found = GetXAttrSizeFromMemory(path, name, size, xattrs_cached);
+  if (!*xattrs_cached && LoadXAttrsFromPersistentCache(path)) {
+    found = GetXAttrSizeFromMemory(path, name, size, xattrs_cached);
+  }
+  return found;
+}
+
+bool MetadataCache::GetXAttrSizeFromMemory(const std::string& path,
+                                           const std::string& name,
+                                           int* size,
+                                           bool* xattrs_cached) {
   assert(xattrs_cached != NULL);
   boost::mutex::scoped_lock lock(mutex_);
 
   *xattrs_cached = false;
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path);
+  by_hash::iterator it_hash = FindUnmutexed(path);
   if (it_hash != index.end()) {
     // Entry found for path, check timeout of listxattrResponse value.
     MetadataCacheEntry* cache_entry = *it_hash;
-    uint64_t current_time_s = time(NULL);
+    uint64_t current_time_s = clock_();
     if (cache_entry->xattrs != NULL) {
       if (cache_entry->xattrs_timeout_s >= current_time_s) {
         *xattrs_cached = true;
@@ -763,6 +1031,14 @@ bool MetadataCache::GetXAttrSize(const std::string& path,
           }
         }
         return false;
+      } else if (IsXAttrKnownMissingUnmutexed(*cache_entry, name,
+                                              current_time_s)) {
+        if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+          Logging::log->getLog(LEVEL_DEBUG)
+              << "MetadataCache GetXAttrSize negative hit: " << path << endl;
+        }
+        *xattrs_cached = true;
+        return false;
       } else {
         // Expired => remove from cache.
         if (Logging::log->loggingActive(LEVEL_DEBUG)) {
@@ -790,14 +1066,35 @@ bool MetadataCache::GetXAttrSize(const std::string& path,
 
 xtreemfs::pbrpc::listxattrResponse* MetadataCache::GetXAttrs(
     const std::string& path) {
+  listxattrResponse* result = GetXAttrsFromMemory(path);
+  if (result == NULL && LoadXAttrsFromPersistentCache(path)) {
+    result = GetXAttrsFromMemory(path);
+  }
+  return result;
+}
+
+bool MetadataCache::LoadXAttrsFromPersistentCache(const std::string& path) {
+  if (persistent_cache_ == NULL || !enabled) {
+    return false;
+  }
+  listxattrResponse xattrs;
+  if (!persistent_cache_->GetXAttrs(path, &xattrs)) {
+    return false;
+  }
+  UpdateXAttrs(path, xattrs);
+  return true;
+}
+
+xtreemfs::pbrpc::listxattrResponse* MetadataCache::GetXAttrsFromMemory(
+    const std::string& path) {
   boost::mutex::scoped_lock lock(mutex_);
 
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path);
+  by_hash::iterator it_hash = FindUnmutexed(path);
   if (it_hash != index.end()) {
     // Entry found for path, check timeout of listxattrResponse value.
     MetadataCacheEntry* cache_entry = *it_hash;
-    uint64_t current_time_s = time(NULL);
+    uint64_t current_time_s = clock_();
     if (cache_entry->xattrs != NULL) {
       if (cache_entry->xattrs_timeout_s >= current_time_s) {
         // Create copy of object.
@@ -847,7 +1144,7 @@ void MetadataCache::UpdateXAttr(
   MetadataCacheEntry* cache_entry = NULL;
   // Check if there's already an Entry for path.
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     cache_entry = *it_map;
   } else {
@@ -860,11 +1157,14 @@ void MetadataCache::UpdateXAttr(
     return;
   }
   if (cache_entry->xattrs_timeout_s <
-          static_cast<uint64_t>(time(NULL))) {
-    return;  // Do not update expired xattrs.
+          static_cast<uint64_t>(clock_())) {
+    // Do not update expired xattrs, but they must not answer that "name" is
+    // missing any longer.
+    delete cache_entry->xattrs;
+    cache_entry->xattrs = NULL;
+    return;
   }
 
-
   // Find "name" and update it
   bool name_found = false;
   for (int i = 0; i < cache_entry->xattrs->xattrs_size(); i++) {
@@ -894,12 +1194,20 @@ void MetadataCache::UpdateXAttrs(
     return;
   }
 
+  if (persistent_cache_ != NULL) {
+    persistent_cache_->PutXAttrs(path, xattrs);
+  }
+
   boost::mutex::scoped_lock lock(mutex_);
 
+  if (!invalidated_prefixes_.empty()) {
+    CollectInvalidatedUnmutexed(kCollectBatchSize);
+  }
+
   MetadataCacheEntry* cache_entry = NULL;
   // Check if there's already an Entry for path.
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     cache_entry = *it_map;
   } else {
@@ -911,14 +1219,17 @@ void MetadataCache::UpdateXAttrs(
 
     cache_entry = new MetadataCacheEntry();
     cache_entry->path = path;
+    cache_entry->generation = generation_;
   }
 
   if (cache_entry->xattrs == NULL) {
     cache_entry->xattrs = new listxattrResponse;
   }
   cache_entry->xattrs->CopyFrom(xattrs);
-  cache_entry->xattrs_timeout_s = time(NULL) + ttl_s_;
-  cache_entry->timeout_s = cache_entry->xattrs_timeout_s;
+  cache_entry->xattrs_timeout_s = clock_() + ttl_s_;
+  // Keep the entry for the negative xattr lookups.
+  cache_entry->timeout_s = cache_entry->xattrs_timeout_s
+      + (xattr_negative_ttl_s_ > ttl_s_ ? xattr_negative_ttl_s_ - ttl_s_ : 0);
 
   if (it_map != index.end()) {
     // Replace existing entry.
@@ -941,7 +1252,7 @@ void MetadataCache::InvalidateXAttr(const std::string& path,
   MetadataCacheEntry* cache_entry = NULL;
   // Check if there's already an Entry for path.
   by_map& index = cache_.get<IndexMap>();
-  by_map::iterator it_map = index.find(path);
+  by_map::iterator it_map = cache_.project<IndexMap>(FindUnmutexed(path));
   if (it_map != index.end()) {
     cache_entry = *it_map;
   } else {
@@ -954,7 +1265,7 @@ void MetadataCache::InvalidateXAttr(const std::string& path,
     return;
   }
   if (cache_entry->xattrs_timeout_s <
-          static_cast<uint64_t>(time(NULL))) {
+          static_cast<uint64_t>(clock_())) {
     return;  // Do not update expired xattrs.
   }
 
@@ -977,18 +1288,205 @@ void MetadataCache::InvalidateXAttrs(const std::string& path) {
   boost::mutex::scoped_lock lock(mutex_);
 
   by_hash& index = cache_.get<IndexHash>();
-  by_hash::iterator it_hash = index.find(path);
+  by_hash::iterator it_hash = FindUnmutexed(path);
   if (it_hash != index.end()) {
     delete (*it_hash)->xattrs;
     (*it_hash)->xattrs = NULL;
   }
 }
 
+bool MetadataCache::HasXAttrs(const std::string& path) {
+  if (path.empty() || !enabled) {
+    return false;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    by_hash& index = cache_.get<IndexHash>();
+    by_hash::iterator it_hash = FindUnmutexed(path);
+    if (it_hash != index.end() && (*it_hash)->xattrs != NULL
+        && (*it_hash)->xattrs_timeout_s
+               >= static_cast<uint64_t>(clock_())) {
+      return true;
+    }
+  }
+
+  return LoadXAttrsFromPersistentCache(path);
+}
+
 uint64_t MetadataCache::Size() {
   boost::mutex::scoped_lock lock(mutex_);
   return cache_.size();
 }
 
+void MetadataCache::UpdateNonExistent(const std::string& path) {
+  if (path.empty() || path == "/" || !negative_enabled_) {
+    return;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  // Forget an outdated positive entry.
+  by_hash& index = cache_.get<IndexHash>();
+  by_hash::iterator it_hash = index.find(path);
+  if (it_hash != index.end()) {
+    delete *it_hash;
+    index.erase(it_hash);
+  }
+
+  AddNonExistentUnmutexed(path, clock_() + negative_ttl_s_);
+}
+
+void MetadataCache::InvalidateNonExistent(const std::string& path) {
+  if (path.empty() || !negative_enabled_) {
+    return;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  InvalidateNonExistentUnmutexed(path);
+}
+
+uint64_t MetadataCache::NonExistentSize() {
+  boost::mutex::scoped_lock lock(mutex_);
+  return non_existent_.size();
+}
+
+void MetadataCache::AddNonExistentUnmutexed(const std::string& path,
+                                            uint64_t timeout_s) {
+  NonExistentMap::iterator it = non_existent_.find(path);
+  if (it != non_existent_.end()) {
+    EraseNonExistentUnmutexed(it);
+  }
+  while (non_existent_.size() >= negative_size_) {
+    EraseNonExistentUnmutexed(non_existent_.find(non_existent_order_.front()));
+  }
+
+  NonExistentEntry& entry = non_existent_[path];
+  entry.timeout_s = timeout_s;
+  entry.position = non_existent_order_.insert(non_existent_order_.end(), path);
+}
+
+void MetadataCache::InvalidateNonExistentUnmutexed(const std::string& path) {
+  NonExistentMap::iterator it = non_existent_.find(path);
+  if (it != non_existent_.end()) {
+    EraseNonExistentUnmutexed(it);
+  }
+
+  // As in InvalidatePrefix(), there may be entries between path and path+"/".
+  const std::string prefix = path == "/" ? path : path + "/";
+  it = non_existent_.lower_bound(prefix);
+  while (it != non_existent_.end() && it->first.find(prefix) == 0) {
+    EraseNonExistentUnmutexed(it++);
+  }
+}
+
+void MetadataCache::EraseNonExistentUnmutexed(NonExistentMap::iterator it) {
+  non_existent_order_.erase(it->second.position);
+  non_existent_.erase(it);
+}
+
+MetadataCache::by_hash::iterator MetadataCache::FindUnmutexed(
+    const std::string& path) {
+  by_hash& index = cache_.get<IndexHash>();
+  by_hash::iterator it_hash = index.find(path);
+  if (it_hash != index.end()
+      && !invalidated_prefixes_.empty()
+      && IsInvalidatedUnmutexed(**it_hash)) {
+    delete *it_hash;
+    index.erase(it_hash);
+    return index.end();
+  }
+  return it_hash;
+}
+
+bool MetadataCache::IsInvalidatedUnmutexed(const MetadataCacheEntry& entry) {
+  // Check "entry.path" and all of its parent directories.
+  string prefix = entry.path;
+  while (!prefix.empty()) {
+    map<string, uint64_t>::const_iterator it
+        = invalidated_generations_.find(prefix);
+    if (it != invalidated_generations_.end()
+        && entry.generation < it->second) {
+      return true;
+    }
+    const size_t slash = prefix.rfind('/');
+    if (slash == string::npos || prefix == "/") {
+      break;
+    }
+    prefix.resize(slash == 0 ? 1 : slash);
+  }
+  return false;
+}
+
+bool MetadataCache::IsSmallSubtreeUnmutexed(const std::string& prefix) {
+  by_map& index = cache_.get<IndexMap>();
+  by_map::iterator it_map = index.lower_bound(prefix);
+  for (int i = 0; i <= kMaxEagerlyChangedEntries; ++i, ++it_map) {
+    if (it_map == index.end() || (*it_map)->path.find(prefix) != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MetadataCache::InvalidateLazilyUnmutexed(const std::string& path) {
+  if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG)
+        << "MetadataCache invalidates the entries below " << path
+        << " lazily." << endl;
+  }
+  invalidated_prefixes_.push_back(InvalidatedPrefix());
+  invalidated_prefixes_.back().path = path;
+  invalidated_prefixes_.back().generation = ++generation_;
+  invalidated_generations_[path] = generation_;
+}
+
+void MetadataCache::CollectInvalidatedUnmutexed(int n) {
+  by_map& index = cache_.get<IndexMap>();
+  while (n > 0 && !invalidated_prefixes_.empty()) {
+    const InvalidatedPrefix& invalidated = invalidated_prefixes_.front();
+    const string prefix = invalidated.path == "/" ? invalidated.path
+                                                  : invalidated.path + "/";
+    if (collect_position_.empty()) {
+      collect_position_ = prefix;
+    }
+
+    by_map::iterator it_map = index.lower_bound(collect_position_);
+    for (; n > 0; --n) {
+      if (it_map == index.end() || (*it_map)->path.find(prefix) != 0) {
+        break;
+      }
+      if ((*it_map)->generation < invalidated.generation) {
+        delete *it_map;
+        it_map = index.erase(it_map);
+      } else {
+        ++it_map;
+      }
+    }
+    if (n == 0 && it_map != index.end()
+        && (*it_map)->path.find(prefix) == 0) {
+      collect_position_ = (*it_map)->path;
+      return;
+    }
+
+    // All entries below the prefix are gone.
+    map<string, uint64_t>::iterator it_generation
+        = invalidated_generations_.find(invalidated.path);
+    if (it_generation != invalidated_generations_.end()
+        && it_generation->second == invalidated.generation) {
+      invalidated_generations_.erase(it_generation);
+    }
+    invalidated_prefixes_.pop_front();
+    collect_position_.clear();
+  }
+}
+
+const std::string* MetadataCache::InternOwnerNameUnmutexed(
+    const std::string& name) {
+  return &*owner_names_.insert(name).first;
+}
+
 void MetadataCache::EvictUnmutexed(int n) {
   // Evict one entry from cache if it's full.
   while (cache_.size() > size_ - n) {
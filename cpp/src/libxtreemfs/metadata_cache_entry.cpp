@@ -6,16 +6,84 @@
  */
 
 #include "libxtreemfs/metadata_cache_entry.h"
+
+#include <google/protobuf/wire_format_lite_inl.h>
+
 #include "xtreemfs/MRC.pb.h"
 
+using google::protobuf::internal::WireFormatLite;
+
 namespace xtreemfs {
 
+void CachedStat::CopyFrom(const xtreemfs::pbrpc::Stat& stat) {
+  dev = stat.dev();
+  ino = stat.ino();
+  size = stat.size();
+  atime_ns = stat.atime_ns();
+  mtime_ns = stat.mtime_ns();
+  ctime_ns = stat.ctime_ns();
+  etag = stat.etag();
+  mode = stat.mode();
+  nlink = stat.nlink();
+  blksize = stat.blksize();
+  truncate_epoch = stat.truncate_epoch();
+  attributes = stat.attributes();
+  has_etag = stat.has_etag();
+  has_attributes = stat.has_attributes();
+}
+
+void CachedStat::CopyTo(xtreemfs::pbrpc::Stat* stat) const {
+  stat->Clear();
+  stat->set_dev(dev);
+  stat->set_ino(ino);
+  stat->set_mode(mode);
+  stat->set_nlink(nlink);
+  stat->set_user_id(*user_id);
+  stat->set_group_id(*group_id);
+  stat->set_size(size);
+  stat->set_atime_ns(atime_ns);
+  stat->set_mtime_ns(mtime_ns);
+  stat->set_ctime_ns(ctime_ns);
+  stat->set_blksize(blksize);
+  if (has_etag) {
+    stat->set_etag(etag);
+  }
+  stat->set_truncate_epoch(truncate_epoch);
+  if (has_attributes) {
+    stat->set_attributes(attributes);
+  }
+}
+
+void CachedDirEntries::CopyFrom(
+    const xtreemfs::pbrpc::DirectoryEntries& dir_entries) {
+  dir_entries.SerializePartialToString(&serialized);
+
+  // Serializing cached the size of every entry.
+  const size_t tag_size = WireFormatLite::TagSize(
+      xtreemfs::pbrpc::DirectoryEntries::kEntriesFieldNumber,
+      WireFormatLite::TYPE_MESSAGE);
+  offsets.resize(dir_entries.entries_size());
+  size_t offset = 0;
+  for (int i = 0; i < dir_entries.entries_size(); i++) {
+    offsets[i] = static_cast<uint32_t>(offset);
+    offset += tag_size + WireFormatLite::LengthDelimitedSize(
+        dir_entries.entries(i).GetCachedSize());
+  }
+}
+
+std::string CachedDirEntries::Slice(int begin, int end) const {
+  if (begin >= end) {
+    return std::string();
+  }
+  const size_t end_offset = end < size() ? offsets[end] : serialized.size();
+  return serialized.substr(offsets[begin], end_offset - offsets[begin]);
+}
+
 MetadataCacheEntry::MetadataCacheEntry()
-    : dir_entries(NULL), stat(NULL), xattrs(NULL) {}
+    : generation(0), dir_entries(NULL), has_stat(false), xattrs(NULL) {}
 
 MetadataCacheEntry::~MetadataCacheEntry() {
   delete dir_entries;
-  delete stat;
   delete xattrs;
 }
 
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "libxtreemfs/open_capability_cache.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+
+namespace xtreemfs {
+
+bool OpenCapabilityCache::Key::operator<(const Key& other) const {
+  if (path != other.path) {
+    return path < other.path;
+  }
+  if (flags != other.flags) {
+    return flags < other.flags;
+  }
+  if (username != other.username) {
+    return username < other.username;
+  }
+  return groups < other.groups;
+}
+
+OpenCapabilityCache::OpenCapabilityCache(uint64_t size, uint64_t ttl_s)
+    : size_(size), ttl_s_(ttl_s) {}
+
+bool OpenCapabilityCache::IsCacheable(SYSTEM_V_FCNTL flags) {
+  return (flags & (SYSTEM_V_FCNTL_H_O_TRUNC | SYSTEM_V_FCNTL_H_O_EXCL)) == 0;
+}
+
+OpenCapabilityCache::Key OpenCapabilityCache::MakeKey(
+    const std::string& path,
+    SYSTEM_V_FCNTL flags,
+    const UserCredentials& user_credentials) {
+  Key key;
+  key.path = path;
+  key.flags = flags;
+  key.username = user_credentials.username();
+  key.groups.assign(user_credentials.groups().begin(),
+                    user_credentials.groups().end());
+  return key;
+}
+
+void OpenCapabilityCache::Put(const std::string& path,
+                              SYSTEM_V_FCNTL flags,
+                              const UserCredentials& user_credentials,
+                              const FileCredentials& file_credentials) {
+  if (size_ == 0 || ttl_s_ == 0 || !IsCacheable(flags)
+      || file_credentials.xcap().replicate_on_close()) {
+    return;
+  }
+  const uint64_t lifetime_s = min(
+      ttl_s_,
+      static_cast<uint64_t>(file_credentials.xcap().expire_timeout_s() / 2));
+  if (lifetime_s == 0) {
+    return;
+  }
+
+  const Key key = MakeKey(path, flags, user_credentials);
+  boost::mutex::scoped_lock lock(mutex_);
+
+  EntryMap::iterator it = entries_.find(key);
+  if (it != entries_.end()) {
+    EraseUnmutexed(it);
+  }
+  while (entries_.size() >= size_) {
+    EraseUnmutexed(entries_.find(insertion_order_.front()));
+  }
+
+  Entry& entry = entries_[key];
+  entry.file_credentials.CopyFrom(file_credentials);
+  entry.expiration_time = time(NULL) + lifetime_s;
+  entry.position = insertion_order_.insert(insertion_order_.end(), key);
+}
+
+bool OpenCapabilityCache::Get(const std::string& path,
+                              SYSTEM_V_FCNTL flags,
+                              const UserCredentials& user_credentials,
+                              FileCredentials* file_credentials) {
+  if (size_ == 0 || ttl_s_ == 0 || !IsCacheable(flags)) {
+    return false;
+  }
+
+  const Key key = MakeKey(path, flags, user_credentials);
+  boost::mutex::scoped_lock lock(mutex_);
+
+  EntryMap::iterator it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+  if (time(NULL) >= it->second.expiration_time) {
+    EraseUnmutexed(it);
+    return false;
+  }
+  file_credentials->CopyFrom(it->second.file_credentials);
+  return true;
+}
+
+void OpenCapabilityCache::Invalidate(const std::string& path) {
+  if (size_ == 0 || path.empty()) {
+    return;
+  }
+
+  Key first;
+  first.path = path;
+  first.flags = static_cast<SYSTEM_V_FCNTL>(0);
+  const string prefix = path == "/" ? path : path + "/";
+
+  boost::mutex::scoped_lock lock(mutex_);
+
+  // All entries of "path" and below it follow "first", but entries like
+  // "path.suffix" are in between.
+  EntryMap::iterator it = entries_.lower_bound(first);
+  while (it != entries_.end()) {
+    const string& entry_path = it->first.path;
+    if (entry_path == path
+        || entry_path.compare(0, prefix.size(), prefix) == 0) {
+      EraseUnmutexed(it++);
+    } else if (entry_path.compare(0, path.size(), path) == 0) {
+      ++it;
+    } else {
+      break;
+    }
+  }
+}
+
+uint64_t OpenCapabilityCache::Size() {
+  boost::mutex::scoped_lock lock(mutex_);
+  return entries_.size();
+}
+
+void OpenCapabilityCache::EraseUnmutexed(EntryMap::iterator it) {
+  insertion_order_.erase(it->second.position);
+  entries_.erase(it);
+}
+
+}  // namespace xtreemfs
@@ -12,6 +12,7 @@
 #include <boost/algorithm/string/compare.hpp>
 #include <boost/algorithm/string.hpp>  // boost::algorithm::starts_with
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/program_options/cmdline.hpp>
 #include <boost/tokenizer.hpp>
 #include <boost/utility.hpp>
@@ -27,7 +28,9 @@
   #include <cstdlib>
 #endif
 
+#include "rpc/client.h"
 #include "rpc/ssl_options.h"
+#include "rpc/transport_profile.h"
 #include "libxtreemfs/pbrpc_url.h"
 #include "libxtreemfs/version_management.h"
 #include "libxtreemfs/xtreemfs_exception.h"
@@ -73,11 +76,21 @@ Options::Options()
   // Optimizations.
   metadata_cache_size = 100000;
   metadata_cache_ttl_s = 10;
+  metadata_cache_negative_size = 10000;
+  metadata_cache_negative_ttl_s = 0;  // Only cached directories answer ENOENT.
+  metadata_cache_xattr_negative_ttl_s = 0;
+  metadata_cache_persistent_dir = "";
+  open_capability_cache_size = 1024;
+  open_capability_cache_ttl_s = 0;  // Every open() asks the MRC by default.
   enable_async_writes = false;
   async_writes_max_request_size_kb = 128;  // default object size in kB.
   async_writes_max_requests = 10;  // Only 10 pending requests allowed by default.
+  async_writes_max_client_buffer_mb = 0;
+  async_writes_callback_threads = 2;
   readdir_chunk_size = 1024;
+  readdir_prefetch_xattrs = 0;
   enable_atime = false;
+  copy_parallel_requests = 8;
 
   // Error Handling options.
   // A RPC call may be retried up to "max{_read|_write|}_tries" times. The
@@ -102,6 +115,7 @@ Options::Options()
   retry_delay_s = 15;
   connect_timeout_s = 15;
   request_timeout_s = 15;
+  operation_timeout_s = 0;
   linger_timeout_s = 600;  // 10 Minutes.
 
 #ifdef HAS_OPENSSL
@@ -115,6 +129,7 @@ Options::Options()
   grid_ssl = false;
   ssl_verify_certificates = false;
   ssl_method_string = "ssltls";
+  ssl_kernel_tls = false;
 #endif  // HAS_OPENSSL
 
   // Grid Support options.
@@ -161,8 +176,21 @@ Options::Options()
 
   // Advanced XtreemFS options.
   periodic_file_size_updates_interval_s = 60;  // Default: 1 Minute.
+  file_size_update_coalescing_ms = 0;  // Flush() and Close() write back.
   periodic_xcap_renewal_interval_s = 60;  // Default: 1 Minute.
+  address_map_snapshot_max_age_s = 0;  // No snapshot by default.
   vivaldi_zipf_generator_skew = 0.5;
+  rpc_trace_buffer_size = 0;  // Tracing disabled by default.
+  rpc_write_coalescing_us = 0;
+  rpc_disable_tcp_nodelay = false;
+  rpc_tcp_keepalive_s = 0;  // No keepalive probes.
+  rpc_busy_poll_us = 0;
+  rpc_socket_buffer_kb = 0;  // Autotuned by the OS.
+  rpc_link_bandwidth_mbit = 0;
+  rpc_prewarm_osd_connections = false;
+  rpc_io_uring = false;
+  lock_wait_min_delay_ms = 10;
+  lock_cache_lease_ms = 0;  // Every unlock is sent to the OSD.
 
   // Internal options, not available from the command line interface.
   was_interrupted_function = NULL;
@@ -203,6 +231,37 @@ void Options::GenerateProgramOptionsDescriptions() {
     ("metadata-cache-ttl-s",
         po::value(&metadata_cache_ttl_s)->default_value(metadata_cache_ttl_s),
         "Time to live after which cached entries will expire.")
+    ("metadata-cache-negative-size",
+        po::value(&metadata_cache_negative_size)
+          ->default_value(metadata_cache_negative_size),
+        "Number of non-existent paths which will be cached.")
+    ("metadata-cache-negative-ttl-s",
+        po::value(&metadata_cache_negative_ttl_s)
+          ->default_value(metadata_cache_negative_ttl_s),
+        "Time to live after which cached non-existent paths will expire."
+        "\n(Set to 0 to disable caching them.)")
+    ("metadata-cache-xattr-negative-ttl-s",
+        po::value(&metadata_cache_xattr_negative_ttl_s)
+          ->default_value(metadata_cache_xattr_negative_ttl_s),
+        "Time to live of missing \"security.*\" and \"system.posix_acl_*\""
+        " attributes. Only effective if greater than metadata-cache-ttl-s."
+        "\n(Set to 0 to disable caching them.)")
+    ("metadata-cache-persistent-dir",
+        po::value(&metadata_cache_persistent_dir)
+          ->default_value(metadata_cache_persistent_dir),
+        "Directory in which the metadata of snapshots is kept across mounts."
+        " It must be owned by the user and not be writable by others."
+        "\n(Leave empty to disable it.)")
+    ("open-capability-cache-size",
+        po::value(&open_capability_cache_size)
+          ->default_value(open_capability_cache_size),
+        "Number of capabilities of opened files which are kept to re-open"
+        " them without asking the MRC.")
+    ("open-capability-cache-ttl-s",
+        po::value(&open_capability_cache_ttl_s)
+          ->default_value(open_capability_cache_ttl_s),
+        "Time to live of cached capabilities, at most half of their validity."
+        "\n(Set to 0 to disable the cache.)")
     ("enable-async-writes",
         po::value(&enable_async_writes)
           ->default_value(enable_async_writes)->zero_tokens(),
@@ -212,9 +271,33 @@ void Options::GenerateProgramOptionsDescriptions() {
             ->implicit_value(async_writes_max_requests),
         "Maximum number of pending write requests per file. Asynchronous writes"
         " will block if this limit is reached first.")
+    ("async-writes-max-client-buffer-mb",
+        po::value(&async_writes_max_client_buffer_mb)
+            ->default_value(async_writes_max_client_buffer_mb),
+        "Maximum size of the pending write requests of all files in MB."
+        " Asynchronous writes will block if it is reached, files with fewer"
+        " pending writes go first.\n(Set to 0 to disable the limit.)")
+    ("async-writes-callback-threads",
+        po::value(&async_writes_callback_threads)
+            ->default_value(async_writes_callback_threads),
+        "Number of threads which process the responses of asynchronous writes"
+        " of all files. The responses of one file are always processed by the"
+        " same thread.")
     ("readdir-chunk-size",
         po::value(&readdir_chunk_size)->default_value(readdir_chunk_size),
-        "Number of entries requested per readdir.");
+        "Number of entries requested per readdir.")
+    ("readdir-prefetch-xattrs",
+        po::value(&readdir_prefetch_xattrs)
+          ->default_value(readdir_prefetch_xattrs),
+        "Maximum number of entries of a listed directory whose extended"
+        " attributes are fetched into the metadata cache. Every entry costs"
+        " one request to the MRC before readdir returns."
+        "\n(Set to 0 to disable it.)")
+    ("copy-parallel-requests",
+        po::value(&copy_parallel_requests)
+            ->default_value(copy_parallel_requests),
+        "Maximum number of objects read and written in parallel when a file"
+        " is copied. Each one buffers one object.");
 
   error_handling_.add_options()
     ("max-tries",
@@ -252,6 +335,11 @@ void Options::GenerateProgramOptionsDescriptions() {
     ("request-timeout",
         po::value(&request_timeout_s)->default_value(request_timeout_s),
         "Timeout after which a request will be retried (in seconds).")
+    ("operation-timeout",
+        po::value(&operation_timeout_s)->default_value(operation_timeout_s),
+        "Timeout after which an operation fails, including all of its retries"
+        " (in seconds, 0 means no limit). Requests time out at this point at"
+        " the latest. Reads and writes of file data are not limited.")
     ("linger-timeout",
         po::value(&linger_timeout_s)->default_value(linger_timeout_s),
         "Time after which idle connections will be closed (in seconds).");
@@ -308,7 +396,16 @@ void Options::GenerateProgramOptionsDescriptions() {
         "\n  - tlsv11 accepts TLSv1.1 only\n"
         "  - tlsv12 accepts TLSv1.2 only"
 #endif  // BOOST_VERSION > 105300
-        );
+        )
+    ("kernel-tls",
+        po::value(&ssl_kernel_tls)->default_value(ssl_kernel_tls)
+            ->zero_tokens(),
+        "Let the kernel encrypt and decrypt the data of SSL connections after"
+        " the handshake (Linux kernel TLS, requires the 'tls' module and an"
+        " AES-GCM cipher). Only TLSv1.2 connections are offloaded, i.e. use"
+        " '--min-ssl-method tlsv12': with the default 'ssltls' the handshake"
+        " usually negotiates TLSv1.3 and OpenSSL keeps doing the work. Falls"
+        " back to OpenSSL if not supported.");
 #endif  // HAS_OPENSSL
 
   grid_options_.add_options()
@@ -370,10 +467,23 @@ void Options::GenerateProgramOptionsDescriptions() {
         po::value(&periodic_file_size_updates_interval_s),
         "Pause time (in seconds) between two invocations of the thread which "
         "writes back file size updates to the MRC in the background.")
+    ("filesize-update-coalescing-ms",
+        po::value(&file_size_update_coalescing_ms)
+            ->default_value(file_size_update_coalescing_ms),
+        "Delay (in ms) during which the file size updates of flushed and"
+        " closed files are collected and sent together by the background"
+        " thread. 0 lets every Flush() and close send its update itself.")
     ("periodic-xcap-renewal-interval",
         po::value(&periodic_xcap_renewal_interval_s),
         "Pause time (in seconds) between two invocations of the thread which "
         "renews the XCap of all open file handles.")
+    ("address-map-snapshot-max-age",
+        po::value(&address_map_snapshot_max_age_s)
+            ->default_value(address_map_snapshot_max_age_s),
+        "Keeps a snapshot of the address mappings, volume services and OSD"
+        " coordinates known by the DIR in <vivaldi-filename>.address_map. A"
+        " snapshot younger than this (in seconds) is used at startup and"
+        " revalidated in the background. 0 disables the snapshot.")
     ("async-writes-max-reqsize-kb",
         po::value(&async_writes_max_request_size_kb)
             ->implicit_value(async_writes_max_request_size_kb),
@@ -383,6 +493,93 @@ void Options::GenerateProgramOptionsDescriptions() {
         po::value(&vivaldi_zipf_generator_skew)
           ->default_value(vivaldi_zipf_generator_skew),
         "Skewness of the Zipf distribution used for vivaldi OSD selection.")
+    ("rpc-trace-buffer-size",
+        po::value(&rpc_trace_buffer_size)
+          ->default_value(rpc_trace_buffer_size),
+        "Number of RPC events (enqueue, connect, write, response, callback, "
+        "retry delay) kept in memory for diagnosis. Retrieve them with "
+        "'xtfsutil --rpc-trace'. (Set to 0 to disable tracing.)")
+    ("rpc-write-coalescing-us",
+        po::value(&rpc_write_coalescing_us)
+          ->default_value(rpc_write_coalescing_us),
+        "Time (in microseconds) a small request to an idle connection waits"
+        " for further requests which are sent with the same write. Requests"
+        " queued during a write are always sent together."
+        "\n(Set to 0 to send immediately.)")
+    ("rpc-proc-timeout",
+        po::value< std::vector<std::string> >(&rpc_proc_timeouts)
+          ->composing(),
+        "Request timeout of a single operation which replaces request-timeout"
+        " for it. Format: <interface id>:<proc id>:<timeout in ms>, e.g., "
+        "20001:4:2000 for getattr requests to the MRC. The ids are listed in"
+        " the generated *ServiceConstants.h files. (Can be specified multiple"
+        " times.)")
+    ("rpc-disable-tcp-nodelay",
+        po::value(&rpc_disable_tcp_nodelay)
+          ->default_value(rpc_disable_tcp_nodelay)->zero_tokens(),
+        "Do not set TCP_NODELAY, i.e., let Nagle's algorithm delay small"
+        " requests.")
+    ("rpc-tcp-keepalive-s",
+        po::value(&rpc_tcp_keepalive_s)
+          ->default_value(rpc_tcp_keepalive_s),
+        "Idle time (in seconds) of a connection after which TCP keepalive"
+        " probes are sent.\n(Set to 0 to disable keepalive.)")
+    ("rpc-busy-poll-us",
+        po::value(&rpc_busy_poll_us)
+          ->default_value(rpc_busy_poll_us),
+        "Time (in microseconds) a receive busy-polls the network device"
+        " (SO_BUSY_POLL, Linux only) instead of waiting for an interrupt."
+        "\n(Set to 0 to disable it.)")
+    ("rpc-socket-buffer-kb",
+        po::value(&rpc_socket_buffer_kb)
+          ->default_value(rpc_socket_buffer_kb),
+        "Size (in kB) of the send and receive buffer of every connection. A"
+        " fixed size disables the autotuning of the OS.\n(Set to 0 to size"
+        " them from rpc-link-bandwidth-mbit or let the OS size them.)")
+    ("rpc-link-bandwidth-mbit",
+        po::value(&rpc_link_bandwidth_mbit)
+          ->default_value(rpc_link_bandwidth_mbit),
+        "Bandwidth (in Mbit/s) of the links to the servers. If set, the socket"
+        " buffers are sized to twice the bandwidth-delay product, using the"
+        " RTT measured by Vivaldi or the TCP handshake.\n(Set to 0 to disable"
+        " it.)")
+    ("rpc-transport-profile",
+        po::value< std::vector<std::string> >(&rpc_transport_profiles)
+          ->composing(),
+        "Socket options of a single server which replace the rpc-* options"
+        " above for it. Format: <host>[:<port>][,<key>=<value>]... with the"
+        " keys nodelay (0 or 1), keepalive-s, busy-poll-us, buffer-kb and"
+        " bandwidth-mbit, e.g., osd1.example.com,bandwidth-mbit=40000. Show"
+        " the applied options with 'xtfsutil --transport-profiles'. (Can be"
+        " specified multiple times.)")
+    ("rpc-prewarm-osd-connections",
+        po::value(&rpc_prewarm_osd_connections)
+          ->default_value(rpc_prewarm_osd_connections)->zero_tokens(),
+        "Connect to all OSDs of a file's replicas when it is opened and not"
+        " open yet, so the first read or write does not wait for the TCP and"
+        " SSL handshake.")
+    ("rpc-io-uring",
+        po::value(&rpc_io_uring)
+          ->default_value(rpc_io_uring)->zero_tokens(),
+        "Read and write connections without SSL through io_uring (Linux 6.0"
+        " or newer): received data lands in registered buffers without a"
+        " system call per read, and the writes to all servers are submitted"
+        " together. Falls back to regular sockets if io_uring is not"
+        " available.")
+    ("lock-wait-min-delay-ms",
+        po::value(&lock_wait_min_delay_ms)
+          ->default_value(lock_wait_min_delay_ms),
+        "Time (in ms) after which a blocking lock request (F_SETLKW) is"
+        " retried if another client holds a conflicting lock. The delay doubles"
+        " with every further conflict up to one second. Waiting for a lock of"
+        " the same client does not poll at all.")
+    ("lock-cache-lease-ms",
+        po::value(&lock_cache_lease_ms)
+          ->default_value(lock_cache_lease_ms),
+        "Time (in ms) an unlocked lock is still held at the OSD. If the same"
+        " process locks the same range again during this time, no request is"
+        " sent. Other clients may have to wait up to twice this time for the"
+        " lock.\n(Set to 0 to disable it.)")
     ("enable-atime",
         po::value(&enable_atime)->default_value(enable_atime)->zero_tokens(),
         "Enable updates of atime attribute in Fuse and metadata cache.");
@@ -540,11 +737,73 @@ std::vector<std::string> Options::ParseCommandLine(int argc, char** argv) {
          << endl << endl;
   }
 
+  if (copy_parallel_requests < 1) {
+    throw InvalidCommandLineParametersException("The number of parallel"
+        " requests of a file copy (copy-parallel-requests) must be greater 0.");
+  }
+
+  if (file_size_update_coalescing_ms < 0) {
+    throw InvalidCommandLineParametersException("The file size update"
+        " coalescing delay (filesize-update-coalescing-ms) must not be"
+        " negative.");
+  }
+
   if (async_writes_max_requests < 1) {
     throw InvalidCommandLineParametersException("The maximum number of pending"
         " asynchronous writes (async-writes-max-reqs) must be greater 0.");
   }
 
+  if (rpc_write_coalescing_us < 0) {
+    throw InvalidCommandLineParametersException("The write coalescing window"
+        " (rpc-write-coalescing-us) must not be negative.");
+  }
+
+  if (lock_wait_min_delay_ms < 1) {
+    throw InvalidCommandLineParametersException("The delay between two"
+        " attempts of a blocking lock request (lock-wait-min-delay-ms) must be"
+        " greater 0.");
+  }
+
+  if (lock_cache_lease_ms < 0) {
+    throw InvalidCommandLineParametersException("The lease of cached locks"
+        " (lock-cache-lease-ms) must not be negative.");
+  }
+
+  for (vector<string>::const_iterator it = rpc_proc_timeouts.begin();
+       it != rpc_proc_timeouts.end();
+       ++it) {
+    uint32_t interface_id, proc_id;
+    int32_t timeout_ms;
+    ParseRPCProcTimeout(*it, &interface_id, &proc_id, &timeout_ms);
+  }
+
+  if (rpc_tcp_keepalive_s < 0 || rpc_busy_poll_us < 0
+      || rpc_socket_buffer_kb < 0 || rpc_link_bandwidth_mbit < 0) {
+    throw InvalidCommandLineParametersException("The options"
+        " rpc-tcp-keepalive-s, rpc-busy-poll-us, rpc-socket-buffer-kb and"
+        " rpc-link-bandwidth-mbit must not be negative.");
+  }
+
+  for (vector<string>::const_iterator it = rpc_transport_profiles.begin();
+       it != rpc_transport_profiles.end();
+       ++it) {
+    string address;
+    rpc::TransportProfile profile;
+    ParseTransportProfile(*it, &address, &profile);
+  }
+
+  if (async_writes_max_client_buffer_mb < 0) {
+    throw InvalidCommandLineParametersException("The size of the asynchronous"
+        " write buffer (async-writes-max-client-buffer-mb) must not be"
+        " negative.");
+  }
+
+  if (async_writes_callback_threads < 1) {
+    throw InvalidCommandLineParametersException("The number of threads which"
+        " process the responses of asynchronous writes"
+        " (async-writes-callback-threads) must be greater 0.");
+  }
+
   if (!enable_async_writes && (vm.count("async-writes-max-reqsize-kb") ||
       vm.count("async-writes-max-reqs"))) {
     throw InvalidCommandLineParametersException("You specified async-writes-*"
@@ -706,7 +965,8 @@ xtreemfs::rpc::SSLOptions* Options::GenerateSSLOptions() const {
         grid_ssl || protocol == PBRPCURL::GetSchemePBRPCG(),
         ssl_verify_certificates,
         ssl_ignore_verify_errors,
-        ssl_method_string);
+        ssl_method_string,
+        ssl_kernel_tls);
   }
 #else
   opts = new xtreemfs::rpc::SSLOptions();
@@ -715,6 +975,78 @@ xtreemfs::rpc::SSLOptions* Options::GenerateSSLOptions() const {
   return opts;
 }
 
+void Options::SetRPCProcTimeouts(xtreemfs::rpc::Client* client) const {
+  for (vector<string>::const_iterator it = rpc_proc_timeouts.begin();
+       it != rpc_proc_timeouts.end();
+       ++it) {
+    uint32_t interface_id, proc_id;
+    int32_t timeout_ms;
+    ParseRPCProcTimeout(*it, &interface_id, &proc_id, &timeout_ms);
+    client->SetRequestTimeout(interface_id, proc_id, timeout_ms);
+  }
+}
+
+void Options::ParseRPCProcTimeout(const std::string& entry,
+                                  uint32_t* interface_id,
+                                  uint32_t* proc_id,
+                                  int32_t* timeout_ms) {
+  vector<string> fields;
+  boost::split(fields, entry, boost::is_any_of(":"));
+  try {
+    if (fields.size() == 3) {
+      *interface_id = boost::lexical_cast<uint32_t>(fields[0]);
+      *proc_id = boost::lexical_cast<uint32_t>(fields[1]);
+      *timeout_ms = boost::lexical_cast<int32_t>(fields[2]);
+      if (*timeout_ms > 0 && fields[0][0] != '-' && fields[1][0] != '-') {
+        return;
+      }
+    }
+  } catch (const boost::bad_lexical_cast&) {
+    // Handled below.
+  }
+  throw InvalidCommandLineParametersException("Invalid request timeout"
+      " (rpc-proc-timeout) '" + entry + "'. Expected <interface id>:<proc"
+      " id>:<timeout in ms> with a timeout greater 0.");
+}
+
+void Options::GetDefaultTransportProfile(
+    xtreemfs::rpc::TransportProfile* profile) const {
+  profile->tcp_no_delay = !rpc_disable_tcp_nodelay;
+  profile->keep_alive_idle_s = rpc_tcp_keepalive_s;
+  profile->busy_poll_us = rpc_busy_poll_us;
+  profile->buffer_bytes = rpc_socket_buffer_kb * 1024;
+  profile->link_bandwidth_mbit = rpc_link_bandwidth_mbit;
+}
+
+void Options::SetTransportProfiles(
+    xtreemfs::rpc::TransportProfiles* profiles) const {
+  for (vector<string>::const_iterator it = rpc_transport_profiles.begin();
+       it != rpc_transport_profiles.end();
+       ++it) {
+    string address;
+    rpc::TransportProfile profile;
+    ParseTransportProfile(*it, &address, &profile);
+    profiles->SetProfile(address, profile);
+  }
+}
+
+void Options::ParseTransportProfile(
+    const std::string& entry,
+    std::string* address,
+    xtreemfs::rpc::TransportProfile* profile) const {
+  rpc::TransportProfile default_profile;
+  GetDefaultTransportProfile(&default_profile);
+  string error;
+  if (!rpc::TransportProfiles::ParseProfile(entry,
+                                            default_profile,
+                                            address,
+                                            profile,
+                                            &error)) {
+    throw InvalidCommandLineParametersException("Invalid transport profile"
+        " (rpc-transport-profile) '" + entry + "': " + error);
+  }
+}
+
 void Options::ReadPasswordFromStdin(const std::string& msg,
                                     std::string* password) {
   cout << msg << endl;
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "libxtreemfs/persistent_metadata_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <boost/lexical_cast.hpp>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::StringOutputStream;
+
+namespace xtreemfs {
+
+/** "XPMC" in little endian order. */
+static const uint32_t kFileMagic = 0x434d5058;
+static const uint32_t kFileVersion = 1;
+
+/** Writes "data" completely to "fd".
+ *
+ * @returns false on an error. */
+static bool WriteAll(int fd, const string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    ssize_t result = write(fd, data.data() + written, data.size() - written);
+    if (result == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += result;
+  }
+  return true;
+}
+
+/** Returns false and sets "reason" if the directory of "path" is owned by
+ *  another user or writable by other users, who could then replace the file.
+ */
+static bool IsPrivateDirectory(const string& path, string* reason) {
+  const size_t slash = path.rfind('/');
+  const string directory = slash == string::npos ? "."
+      : slash == 0 ? "/" : path.substr(0, slash);
+  struct stat directory_stat;
+  if (stat(directory.c_str(), &directory_stat) != 0) {
+    *reason = "cannot access the directory " + directory;
+    return false;
+  }
+  if (directory_stat.st_uid != geteuid()) {
+    *reason = "the directory " + directory + " is owned by another user";
+    return false;
+  }
+  if ((directory_stat.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+    *reason = "the directory " + directory + " is writable by other users";
+    return false;
+  }
+  return true;
+}
+
+PersistentMetadataCache::PersistentMetadataCache()
+    : fd_(-1), mapped_(NULL), mapped_length_(0), mapped_records_end_(0) {}
+
+PersistentMetadataCache::~PersistentMetadataCache() {
+  Close();
+}
+
+bool PersistentMetadataCache::CreateFile(const std::string& path,
+                                         const std::string& validity_token) {
+  string header;
+  {
+    StringOutputStream stream(&header);
+    CodedOutputStream output(&stream);
+    output.WriteLittleEndian32(kFileMagic);
+    output.WriteVarint32(kFileVersion);
+    output.WriteVarint32(validity_token.size());
+    output.WriteString(validity_token);
+  }
+
+  // Clients which still use the old file keep their (valid) mapping. Other
+  // users must not read path names, stats and xattrs of the snapshot.
+  const string temporary_path
+      = path + ".tmp" + boost::lexical_cast<string>(getpid());
+  int fd = open(temporary_path.c_str(),
+                O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW,
+                0600);
+  if (fd == -1) {
+    return false;
+  }
+  const bool written = WriteAll(fd, header);
+  if (close(fd) != 0 || !written
+      || rename(temporary_path.c_str(), path.c_str()) != 0) {
+    unlink(temporary_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool PersistentMetadataCache::Open(const std::string& path,
+                                   const std::string& validity_token) {
+  Close();
+  boost::mutex::scoped_lock lock(mutex_);
+
+  string reason;
+  if (!IsPrivateDirectory(path, &reason)) {
+    Logging::log->getLog(LEVEL_WARN) << "Not using the persistent metadata"
+        " cache " << path << ": " << reason << endl;
+    return false;
+  }
+
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    fd_ = open(path.c_str(), O_RDWR | O_NOFOLLOW);
+    if (fd_ == -1) {
+      if (errno != ENOENT || !CreateFile(path, validity_token)) {
+        return false;
+      }
+      continue;
+    }
+
+    // Do not index a record which is appended right now.
+    flock(fd_, LOCK_EX);
+    struct stat file_stat;
+    if (fstat(fd_, &file_stat) != 0 || file_stat.st_uid != geteuid()) {
+      Logging::log->getLog(LEVEL_WARN) << "Not using the persistent metadata"
+          " cache " << path << ": it is owned by another user" << endl;
+      flock(fd_, LOCK_UN);
+      CloseUnmutexed();
+      return false;
+    }
+    // Files of older clients were readable by everyone.
+    if ((file_stat.st_mode & 077) != 0) {
+      fchmod(fd_, file_stat.st_mode & 0700);
+    }
+    if (file_stat.st_size > 0) {
+      void* mapped = mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED,
+                          fd_, 0);
+      if (mapped != MAP_FAILED) {
+        mapped_ = static_cast<const char*>(mapped);
+        mapped_length_ = file_stat.st_size;
+      }
+    }
+
+    uint64_t valid_length = 0;
+    if (mapped_ != NULL && ReadFileUnmutexed(validity_token, &valid_length)) {
+      if (valid_length < mapped_length_) {
+        // Remove the rest of a record whose append was interrupted.
+        if (ftruncate(fd_, valid_length) != 0) {
+          Logging::log->getLog(LEVEL_WARN) << "Failed to truncate the"
+              " persistent metadata cache: " << path << endl;
+        }
+      }
+      mapped_records_end_ = valid_length;
+      flock(fd_, LOCK_UN);
+      return true;
+    }
+
+    flock(fd_, LOCK_UN);
+    CloseUnmutexed();
+    if (attempt == 0) {
+      if (Logging::log->loggingActive(LEVEL_INFO)) {
+        Logging::log->getLog(LEVEL_INFO) << "Replacing the outdated persistent"
+            " metadata cache: " << path << endl;
+      }
+      if (!CreateFile(path, validity_token)) {
+        return false;
+      }
+    }
+  }
+  return false;
+}
+
+bool PersistentMetadataCache::ReadFileUnmutexed(
+    const std::string& validity_token,
+    uint64_t* valid_length) {
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(mapped_);
+  uint64_t position = 0;
+  {
+    CodedInputStream input(
+        data, static_cast<int>(min(mapped_length_, uint64_t(INT_MAX))));
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint32_t token_length = 0;
+    string token;
+    if (!input.ReadLittleEndian32(&magic)
+        || magic != kFileMagic
+        || !input.ReadVarint32(&version)
+        || version != kFileVersion
+        || !input.ReadVarint32(&token_length)
+        || !input.ReadString(&token, token_length)
+        || token != validity_token) {
+      return false;
+    }
+    position = input.CurrentPosition();
+  }
+
+  // Index all records up to the first incomplete one.
+  while (position < mapped_length_) {
+    CodedInputStream input(
+        data + position,
+        static_cast<int>(min(mapped_length_ - position, uint64_t(INT_MAX))));
+    uint32_t type = 0;
+    uint32_t path_length = 0;
+    string path;
+    uint32_t length = 0;
+    if (!input.ReadVarint32(&type)
+        || type < kStat || type > kXAttrs
+        || !input.ReadVarint32(&path_length)
+        || !input.ReadString(&path, path_length)
+        || !input.ReadVarint32(&length)
+        || !input.Skip(length)) {
+      break;
+    }
+    Location& location = index_[make_pair(static_cast<int>(type), path)];
+    location.offset = position + input.CurrentPosition() - length;
+    location.length = length;
+    position += input.CurrentPosition();
+  }
+
+  *valid_length = position;
+  return true;
+}
+
+void PersistentMetadataCache::Close() {
+  boost::mutex::scoped_lock lock(mutex_);
+  CloseUnmutexed();
+}
+
+void PersistentMetadataCache::CloseUnmutexed() {
+  index_.clear();
+  if (mapped_ != NULL) {
+    munmap(const_cast<char*>(mapped_), mapped_length_);
+    mapped_ = NULL;
+    mapped_length_ = 0;
+    mapped_records_end_ = 0;
+  }
+  if (fd_ != -1) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+bool PersistentMetadataCache::Get(RecordType type,
+                                  const std::string& path,
+                                  google::protobuf::Message* message) {
+  boost::mutex::scoped_lock lock(mutex_);
+  Index::const_iterator it = index_.find(make_pair(static_cast<int>(type),
+                                                   path));
+  if (it == index_.end()) {
+    return false;
+  }
+
+  const Location& location = it->second;
+  if (location.offset + location.length <= mapped_records_end_) {
+    return message->ParseFromArray(mapped_ + location.offset, location.length);
+  }
+
+  // Appended after Open().
+  string buffer(location.length, '\0');
+  ssize_t result = pread(fd_, &buffer[0], location.length, location.offset);
+  return result == static_cast<ssize_t>(location.length)
+      && message->ParseFromString(buffer);
+}
+
+void PersistentMetadataCache::Put(RecordType type,
+                                  const std::string& path,
+                                  const google::protobuf::Message& message) {
+  boost::mutex::scoped_lock lock(mutex_);
+  if (fd_ == -1) {
+    return;
+  }
+  const pair<int, string> key(static_cast<int>(type), path);
+  if (index_.find(key) != index_.end()) {
+    return;
+  }
+
+  string record;
+  const int length = message.ByteSize();
+  {
+    StringOutputStream stream(&record);
+    CodedOutputStream output(&stream);
+    output.WriteVarint32(type);
+    output.WriteVarint32(path.size());
+    output.WriteString(path);
+    output.WriteVarint32(length);
+    message.SerializeWithCachedSizes(&output);
+  }
+
+  flock(fd_, LOCK_EX);
+  off_t offset = lseek(fd_, 0, SEEK_END);
+  const bool written = offset != -1 && WriteAll(fd_, record);
+  if (!written && offset != -1 && ftruncate(fd_, offset) != 0) {
+    // The incomplete record ends the index for the next Open().
+    Logging::log->getLog(LEVEL_WARN) << "Failed to remove an incomplete"
+        " record from the persistent metadata cache." << endl;
+  }
+  flock(fd_, LOCK_UN);
+  if (!written) {
+    Logging::log->getLog(LEVEL_WARN) << "Failed to append to the persistent"
+        " metadata cache, path: " << path << endl;
+    return;
+  }
+
+  Location& location = index_[key];
+  location.offset = offset + record.size() - length;
+  location.length = length;
+}
+
+bool PersistentMetadataCache::GetStat(const std::string& path,
+                                      xtreemfs::pbrpc::Stat* stat) {
+  return Get(kStat, path, stat);
+}
+
+bool PersistentMetadataCache::GetDirEntries(
+    const std::string& path,
+    xtreemfs::pbrpc::DirectoryEntries* dir_entries) {
+  return Get(kDirEntries, path, dir_entries);
+}
+
+bool PersistentMetadataCache::GetXAttrs(
+    const std::string& path,
+    xtreemfs::pbrpc::listxattrResponse* xattrs) {
+  return Get(kXAttrs, path, xattrs);
+}
+
+void PersistentMetadataCache::PutStat(const std::string& path,
+                                      const xtreemfs::pbrpc::Stat& stat) {
+  Put(kStat, path, stat);
+}
+
+void PersistentMetadataCache::PutDirEntries(
+    const std::string& path,
+    const xtreemfs::pbrpc::DirectoryEntries& dir_entries) {
+  Put(kDirEntries, path, dir_entries);
+}
+
+void PersistentMetadataCache::PutXAttrs(
+    const std::string& path,
+    const xtreemfs::pbrpc::listxattrResponse& xattrs) {
+  Put(kXAttrs, path, xattrs);
+}
+
+uint64_t PersistentMetadataCache::Size() {
+  boost::mutex::scoped_lock lock(mutex_);
+  return index_.size();
+}
+
+}  // namespace xtreemfs
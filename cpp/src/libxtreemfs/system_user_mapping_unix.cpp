@@ -9,12 +9,17 @@
 #ifndef WIN32
 #include "libxtreemfs/system_user_mapping_unix.h"
 
+#include <fcntl.h>
 #include <grp.h>
 #include <pwd.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <boost/cstdint.hpp>
 #include <boost/lexical_cast.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 
@@ -38,6 +43,10 @@ std::string SystemUserMappingUnix::UIDToUsername(uid_t uid) {
   }
 
   string username;
+  if (username_cache_.Get(uid, &username)) {
+    return username;
+  }
+
   // Retrieve username.
   size_t bufsize = sysconf(_SC_GETPW_R_SIZE_MAX);
   if (bufsize == -1) {
@@ -76,17 +85,21 @@ std::string SystemUserMappingUnix::UIDToUsername(uid_t uid) {
     additional_user_mapping_->LocalToGlobalUsername(username_local, &username);
   }
 
+  username_cache_.Put(uid, username);
   return username;
 }
 
 uid_t SystemUserMappingUnix::UsernameToUID(const std::string& username) {
+  uid_t uid = 65534;  // nobody.
+  if (uid_cache_.Get(username, &uid)) {
+    return uid;
+  }
+
   string local_username(username);
   if (additional_user_mapping_.get()) {
     additional_user_mapping_->GlobalToLocalUsername(username, &local_username);
   }
 
-  uid_t uid = 65534;  // nobody.
-
   // Retrieve uid.
   size_t bufsize = sysconf(_SC_GETPW_R_SIZE_MAX);
   if (bufsize == -1) {
@@ -141,6 +154,7 @@ uid_t SystemUserMappingUnix::UsernameToUID(const std::string& username) {
   }
   delete[] buf;
 
+  uid_cache_.Put(username, uid);
   return uid;
 }
 
@@ -149,8 +163,11 @@ std::string SystemUserMappingUnix::GIDToGroupname(gid_t gid) {
     return string("-1");
   }
 
-
   string groupname;
+  if (groupname_cache_.Get(gid, &groupname)) {
+    return groupname;
+  }
+
   // Retrieve username.
   size_t bufsize = sysconf(_SC_GETGR_R_SIZE_MAX);
   if (bufsize == -1) {
@@ -190,18 +207,22 @@ std::string SystemUserMappingUnix::GIDToGroupname(gid_t gid) {
                                                      &groupname);
   }
 
+  groupname_cache_.Put(gid, groupname);
   return groupname;
 }
 
 gid_t SystemUserMappingUnix::GroupnameToGID(const std::string& groupname) {
+  gid_t gid = 65534;  // nobody.
+  if (gid_cache_.Get(groupname, &gid)) {
+    return gid;
+  }
+
   string local_groupname(groupname);
   if (additional_user_mapping_.get()) {
     additional_user_mapping_->GlobalToLocalGroupname(groupname,
                                                      &local_groupname);
   }
 
-  gid_t gid = 65534;  // nobody.
-
   // Retrieve gid.
   size_t bufsize = sysconf(_SC_GETPW_R_SIZE_MAX);
   if (bufsize == -1) {
@@ -256,6 +277,7 @@ gid_t SystemUserMappingUnix::GroupnameToGID(const std::string& groupname) {
   }
   delete[] buf;
 
+  gid_cache_.Put(groupname, gid);
   return gid;
 }
 
@@ -291,5 +313,54 @@ void SystemUserMappingUnix::GetGroupnames(uid_t uid,
 #endif
 }
 
+uint64_t SystemUserMappingUnix::GetProcessStartTime(pid_t pid) {
+  uint64_t start_time = 0;
+#ifdef __linux__
+  // Field 22 of /proc/<pid>/stat. The second field (the command name) may
+  // contain spaces and is enclosed in parentheses. The file is read with
+  // plain syscalls as this is done for every request.
+  char filename[64];
+  snprintf(filename, sizeof(filename), "/proc/%d/stat", static_cast<int>(pid));
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    return 0;
+  }
+  char content[1024];
+  ssize_t length = read(fd, content, sizeof(content) - 1);
+  close(fd);
+  if (length <= 0) {
+    return 0;
+  }
+  content[length] = '\0';
+
+  const char* position = strrchr(content, ')');
+  // Skip field 2 and the fields 3 to 21.
+  for (int field = 2; field < 22 && position != NULL; ++field) {
+    position = strchr(position + 1, ' ');
+  }
+  if (position != NULL) {
+    start_time = strtoull(position + 1, NULL, 10);
+  }
+#endif
+  return start_time;
+}
+
+void SystemUserMappingUnix::SetCacheLimits(size_t max_entries, int ttl_s) {
+  username_cache_.SetLimits(max_entries, ttl_s);
+  uid_cache_.SetLimits(max_entries, ttl_s);
+  groupname_cache_.SetLimits(max_entries, ttl_s);
+  gid_cache_.SetLimits(max_entries, ttl_s);
+}
+
+uint64_t SystemUserMappingUnix::cache_hits() {
+  return username_cache_.hits() + uid_cache_.hits()
+      + groupname_cache_.hits() + gid_cache_.hits();
+}
+
+uint64_t SystemUserMappingUnix::cache_misses() {
+  return username_cache_.misses() + uid_cache_.misses()
+      + groupname_cache_.misses() + gid_cache_.misses();
+}
+
 }  // namespace xtreemfs
 #endif // !WIN32
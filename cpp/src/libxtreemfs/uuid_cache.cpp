@@ -19,6 +19,16 @@ using namespace xtreemfs::util;
 
 namespace xtreemfs {
 
+UUIDCache::UUIDCache() : clock_(&UUIDCache::SystemClock) {
+}
+
+UUIDCache::UUIDCache(Clock clock) : clock_(clock) {
+}
+
+time_t UUIDCache::SystemClock() {
+  return time(NULL);
+}
+
 void UUIDCache::update(
     const std::string& uuid,
     const std::string& address,
@@ -37,7 +47,11 @@ void UUIDCache::update(
   uuidMapping.address = address;
   uuidMapping.uuid = uuid;
   uuidMapping.port = port;
-  uuidMapping.timeout = time(NULL) + ttls;  // calc timeout in seconds
+  const time_t now = clock_();
+  uuidMapping.timeout = now + ttls;  // calc timeout in seconds
+  // Refresh in the background in the last quarter of the lifetime.
+  uuidMapping.refresh_time = now + ttls - ttls / 4;
+  uuidMapping.refresh_pending = false;
 
   // address contains update-time to evict old entries
   cache_[uuid] = uuidMapping;
@@ -47,15 +61,27 @@ void UUIDCache::update(
  * Old UUIDs are invalidated but there is no active pulling of new UUIDs.
  */
 std::string UUIDCache::get(const std::string& uuid) {
+  return get(uuid, NULL);
+}
+
+std::string UUIDCache::get(const std::string& uuid, bool* refresh) {
   boost::mutex::scoped_lock lock(mutex_);
 
   std::map<string, UUIDMapping >::iterator it = cache_.find(uuid);
 
   // entry found?
+  if (refresh) {
+    *refresh = false;
+  }
   if (it != cache_.end()) {
     // entry timed out?
-    const UUIDMapping mapping = it->second;
-    if (time(NULL) < mapping.timeout) {
+    const time_t now = clock_();
+    const UUIDMapping& mapping = it->second;
+    if (now < mapping.timeout) {
+      if (refresh && now >= mapping.refresh_time && !mapping.refresh_pending) {
+        it->second.refresh_pending = true;
+        *refresh = true;
+      }
       // Build ip-address:port from AddressMapping.
       ostringstream s;
       s << mapping.address << ":" << mapping.port;
@@ -75,4 +101,32 @@ std::string UUIDCache::get(const std::string& uuid) {
   return "";
 }
 
+void UUIDCache::CancelRefresh(const std::string& uuid) {
+  boost::mutex::scoped_lock lock(mutex_);
+
+  std::map<string, UUIDMapping >::iterator it = cache_.find(uuid);
+  if (it != cache_.end()) {
+    it->second.refresh_pending = false;
+  }
+}
+
+bool UUIDCache::BeginLookup(const std::string& uuid) {
+  boost::mutex::scoped_lock lock(mutex_);
+
+  if (lookups_.insert(uuid).second) {
+    return true;
+  }
+  while (lookups_.find(uuid) != lookups_.end()) {
+    lookup_finished_.wait(lock);
+  }
+  return false;
+}
+
+void UUIDCache::EndLookup(const std::string& uuid) {
+  boost::mutex::scoped_lock lock(mutex_);
+
+  lookups_.erase(uuid);
+  lookup_finished_.notify_all();
+}
+
 }  // namespace xtreemfs
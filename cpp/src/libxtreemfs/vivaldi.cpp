@@ -22,7 +22,9 @@
 #include "libxtreemfs/options.h"
 #include "libxtreemfs/pbrpc_url.h"
 #include "libxtreemfs/simple_uuid_iterator.h"
+#include "libxtreemfs/uuid_resolver.h"
 #include "libxtreemfs/xtreemfs_exception.h"
+#include "rpc/transport_profile.h"
 #include "util/logging.h"
 #include "util/zipf_generator.h"
 #include "xtreemfs/DIRServiceClient.h"
@@ -97,6 +99,11 @@ void Vivaldi::Run() {
   list<KnownOSD> known_osds;
   bool valid_known_osds = false;
 
+  // OSDs set by SetOSDServices() spare the first request to the DIR.
+  ServiceSet initial_osds;
+  GetOSDServices(&initial_osds);
+  bool use_initial_osds = initial_osds.services_size() > 0;
+
   vector<uint64_t> current_retries;
   int retries_in_a_row = 0;
   list<KnownOSD>::iterator chosen_osd_service;
@@ -108,7 +115,13 @@ void Vivaldi::Run() {
       // Get a list of OSDs from the DIR(s)
       if ((vivaldi_iterations %
                vivaldi_options_.vivaldi_max_iterations_before_updating) == 0) {
-        valid_known_osds = UpdateKnownOSDs(&known_osds, own_node);
+        if (use_initial_osds) {
+          FillKnownOSDs(initial_osds, &known_osds, own_node);
+          valid_known_osds = true;
+          use_initial_osds = false;
+        } else {
+          valid_known_osds = UpdateKnownOSDs(&known_osds, own_node);
+        }
         if (valid_known_osds && !known_osds.empty()) {
           rank_generator.set_size(known_osds.size());
         }
@@ -177,6 +190,19 @@ void Vivaldi::Run() {
           boost::posix_time::time_duration rtt = end_time - start_time;
           uint64_t measured_rtt = rtt.total_milliseconds();
 
+          // The socket buffers of new connections are sized for this RTT.
+          if (rpc::TransportProfiles::transport_profiles) {
+            try {
+              string address;
+              uuid_resolver_->UUIDToAddress(chosen_osd_service->GetUUID(),
+                                            &address);
+              rpc::TransportProfiles::transport_profiles->UpdateRTT(
+                  address, rtt.total_microseconds());
+            } catch (const XtreemFSException&) {
+              // The mapping expired meanwhile, skip this sample.
+            }
+          }
+
           xtreemfs::pbrpc::xtreemfs_pingMesssage* ping_response_obj =
               static_cast<xtreemfs::pbrpc::xtreemfs_pingMesssage*>(
               ping_response->response());
@@ -419,53 +445,11 @@ bool Vivaldi::UpdateKnownOSDs(list<KnownOSD>* updated_osds,
         true));
 
     ServiceSet* received_osds = static_cast<ServiceSet*>(response->response());
-    updated_osds->clear();
-
-    // Fill the list, ignoring every offline OSD
-    for (int i = 0; i < received_osds->services_size(); i++) {
-      const Service& service = received_osds->services(i);
-      if (service.last_updated_s() > 0) {  // only online OSDs
-        const ServiceDataMap& sdm = service.data();
-        const string* coordinates_string = NULL;
-        for (int j = 0; j < sdm.data_size(); ++j) {
-          if (sdm.data(j).key() == "vivaldi_coordinates") {
-            coordinates_string = &sdm.data(j).value();
-            break;
-          }
-        }
-
-        // If the DIR does not have the OSD's coordinates, we discard this
-        // entry
-        if (coordinates_string) {
-          // Parse the coordinates provided by the DIR
-          VivaldiCoordinates osd_coords;
-          OutputUtils::StringToCoordinates(*coordinates_string, osd_coords);
-          KnownOSD new_osd(service.uuid(), osd_coords);
-
-          // Calculate the current distance from the client to the new OSD
-          double new_osd_distance = own_node.CalculateDistance(
-               *(own_node.GetCoordinates()),
-               osd_coords);
-
-          list<KnownOSD>::iterator up_iterator = updated_osds->begin();
-          while (up_iterator != updated_osds->end()) {
-            double old_osd_distance =
-                own_node.CalculateDistance(*up_iterator->GetCoordinates(),
-                                           *(own_node.GetCoordinates()));
-            if (old_osd_distance >= new_osd_distance) {
-              updated_osds->insert(up_iterator, new_osd);
-              break;
-            } else {
-              up_iterator++;
-            }
-          }
-
-          if (up_iterator == updated_osds->end()) {
-            updated_osds->push_back(new_osd);
-          }
-        }  // if (coordinates_string)
-      }
-    }  // for
+    {
+      boost::mutex::scoped_lock lock(osd_services_mutex_);
+      osd_services_.CopyFrom(*received_osds);
+    }
+    FillKnownOSDs(*received_osds, updated_osds, own_node);
     response->DeleteBuffers();
   } catch (const XtreemFSException& e) {
     if (response.get()) {
@@ -479,6 +463,68 @@ bool Vivaldi::UpdateKnownOSDs(list<KnownOSD>* updated_osds,
   return retval;
 }  // update_known_osds
 
+void Vivaldi::FillKnownOSDs(const pbrpc::ServiceSet& received_osds,
+                            std::list<KnownOSD>* updated_osds,
+                            const VivaldiNode& own_node) {
+  updated_osds->clear();
+
+  // Fill the list, ignoring every offline OSD
+  for (int i = 0; i < received_osds.services_size(); i++) {
+    const Service& service = received_osds.services(i);
+    if (service.last_updated_s() > 0) {  // only online OSDs
+      const ServiceDataMap& sdm = service.data();
+      const string* coordinates_string = NULL;
+      for (int j = 0; j < sdm.data_size(); ++j) {
+        if (sdm.data(j).key() == "vivaldi_coordinates") {
+          coordinates_string = &sdm.data(j).value();
+          break;
+        }
+      }
+
+      // If the DIR does not have the OSD's coordinates, we discard this
+      // entry
+      if (coordinates_string) {
+        // Parse the coordinates provided by the DIR
+        VivaldiCoordinates osd_coords;
+        OutputUtils::StringToCoordinates(*coordinates_string, osd_coords);
+        KnownOSD new_osd(service.uuid(), osd_coords);
+
+        // Calculate the current distance from the client to the new OSD
+        double new_osd_distance = own_node.CalculateDistance(
+             *(own_node.GetCoordinates()),
+             osd_coords);
+
+        list<KnownOSD>::iterator up_iterator = updated_osds->begin();
+        while (up_iterator != updated_osds->end()) {
+          double old_osd_distance =
+              own_node.CalculateDistance(*up_iterator->GetCoordinates(),
+                                         *(own_node.GetCoordinates()));
+          if (old_osd_distance >= new_osd_distance) {
+            updated_osds->insert(up_iterator, new_osd);
+            break;
+          } else {
+            up_iterator++;
+          }
+        }
+
+        if (up_iterator == updated_osds->end()) {
+          updated_osds->push_back(new_osd);
+        }
+      }  // if (coordinates_string)
+    }
+  }  // for
+}
+
+void Vivaldi::SetOSDServices(const pbrpc::ServiceSet& services) {
+  boost::mutex::scoped_lock lock(osd_services_mutex_);
+  osd_services_.CopyFrom(services);
+}
+
+void Vivaldi::GetOSDServices(pbrpc::ServiceSet* services) const {
+  boost::mutex::scoped_lock lock(osd_services_mutex_);
+  services->CopyFrom(osd_services_);
+}
+
 const VivaldiCoordinates& Vivaldi::GetVivaldiCoordinates() const {
   boost::mutex::scoped_lock lock(coordinate_mutex_);
   return my_vivaldi_coordinates_;
@@ -11,11 +11,16 @@
 #include <boost/bind.hpp>
 #include <boost/thread/thread.hpp>
 #include <limits>
+#include <list>
 #include <map>
+#include <sstream>
 #include <string>
+#include <vector>
+#include <sys/stat.h>
 
 #include "libxtreemfs/client_implementation.h"
 #include "libxtreemfs/execute_sync_request.h"
+#include "libxtreemfs/file_copier.h"
 #include "libxtreemfs/file_handle_implementation.h"
 #include "libxtreemfs/file_info.h"
 #include "libxtreemfs/helper.h"
@@ -55,12 +60,19 @@ VolumeImplementation::VolumeImplementation(
       // Disable retries and interrupted querying for periodic threads.
       periodic_threads_options_(1, 40, false, NULL),
       metadata_cache_(options.metadata_cache_size,
-                      options.metadata_cache_ttl_s) {
+                      options.metadata_cache_ttl_s,
+                      options.metadata_cache_negative_size,
+                      options.metadata_cache_negative_ttl_s),
+      open_capability_cache_(options.open_capability_cache_size,
+                             options.open_capability_cache_ttl_s) {
   // Set AuthType to AUTH_NONE as it's currently not used.
   auth_bogus_.set_auth_type(AUTH_NONE);
   // Set username "xtreemfs" as it does not get checked at server side.
   user_credentials_bogus_.set_username("xtreemfs");
 
+  metadata_cache_.SetXAttrNegativeTtl(
+      options.metadata_cache_xattr_negative_ttl_s);
+
   mrc_uuid_iterator_.reset(mrc_uuid_iterator);
 }
 
@@ -86,7 +98,10 @@ void VolumeImplementation::Start() {
       volume_options_.connect_timeout_s,  // Connect timeout.
       volume_options_.request_timeout_s,  // Request timeout.
       volume_options_.linger_timeout_s,  // Linger timeout.
+      volume_options_.rpc_write_coalescing_us,
+      volume_options_.rpc_io_uring,
       volume_ssl_options_));
+  volume_options_.SetRPCProcTimeouts(network_client_.get());
 
   // Create thread which runs the network client.
   network_client_thread_.reset(
@@ -99,6 +114,10 @@ void VolumeImplementation::Start() {
   // Register StripingPolicies.
   stripe_translators_[STRIPING_POLICY_RAID0] = new StripeTranslatorRaid0();
 
+  if (!volume_options_.metadata_cache_persistent_dir.empty()) {
+    OpenPersistentMetadataCache();
+  }
+
   // Start periodic threads.
   xcap_renewal_thread_.reset(new boost::thread(boost::bind(
       &xtreemfs::VolumeImplementation::PeriodicXCapRenewal,
@@ -106,6 +125,60 @@ void VolumeImplementation::Start() {
   filesize_writeback_thread_.reset(new boost::thread(boost::bind(
       &xtreemfs::VolumeImplementation::PeriodicFileSizeUpdate,
       this)));
+  if (volume_options_.lock_cache_lease_ms > 0) {
+    lingering_locks_release_thread_.reset(new boost::thread(boost::bind(
+        &xtreemfs::VolumeImplementation::PeriodicLingeringLocksRelease,
+        this)));
+  }
+}
+
+void VolumeImplementation::OpenPersistentMetadataCache() {
+  // Only the metadata of snapshots ("volume@snapshot") never changes.
+  if (volume_name_.find('@') == string::npos) {
+    Logging::log->getLog(LEVEL_WARN) << "The persistent metadata cache is only"
+        " used for snapshots, ignoring it for the volume: " << volume_name_
+        << endl;
+    return;
+  }
+
+  // Identifies the snapshot: a deleted and recreated snapshot with the same
+  // name has a different root directory.
+  string validity_token;
+  try {
+    boost::scoped_ptr<StatVFS> stat_vfs(StatFS(user_credentials_bogus_));
+    Stat root_stat;
+    GetAttrHelper(user_credentials_bogus_, "/", true, &root_stat);
+
+    ostringstream token;
+    token << volume_name_ << " " << stat_vfs->fsid() << " "
+          << root_stat.ino() << " " << root_stat.ctime_ns() << " "
+          << root_stat.mtime_ns();
+    validity_token = token.str();
+  } catch(const XtreemFSException& e) {
+    Logging::log->getLog(LEVEL_WARN) << "Not using the persistent metadata"
+        " cache, failed to retrieve the state of the volume: " << e.what()
+        << endl;
+    return;
+  }
+
+  string file_name = volume_name_;
+  replace(file_name.begin(), file_name.end(), '/', '_');
+  const string path = volume_options_.metadata_cache_persistent_dir + "/"
+      + file_name + ".metadata_cache";
+
+  persistent_metadata_cache_.reset(new PersistentMetadataCache());
+  if (!persistent_metadata_cache_->Open(path, validity_token)) {
+    Logging::log->getLog(LEVEL_WARN) << "Failed to open the persistent"
+        " metadata cache: " << path << endl;
+    persistent_metadata_cache_.reset(NULL);
+    return;
+  }
+  if (Logging::log->loggingActive(LEVEL_INFO)) {
+    Logging::log->getLog(LEVEL_INFO) << "Loaded "
+        << persistent_metadata_cache_->Size() << " entries from the persistent"
+        " metadata cache: " << path << endl;
+  }
+  metadata_cache_.SetPersistentCache(persistent_metadata_cache_.get());
 }
 
 /**
@@ -117,6 +190,10 @@ void VolumeImplementation::CloseInternal() {
   xcap_renewal_thread_->interrupt();
   filesize_writeback_thread_->join();
   xcap_renewal_thread_->join();
+  if (lingering_locks_release_thread_.get()) {
+    lingering_locks_release_thread_->interrupt();
+    lingering_locks_release_thread_->join();
+  }
 
   boost::mutex::scoped_lock lock_oft(open_file_table_mutex_);
 
@@ -217,6 +294,7 @@ void VolumeImplementation::Symlink(
   timestampResponse* ts_response = static_cast<timestampResponse*>(
       response->response());
 
+  metadata_cache_.InvalidateNonExistent(link_path);
   const string parent_dir = ResolveParentDirectory(link_path);
   metadata_cache_.UpdateStatTime(
       parent_dir,
@@ -252,6 +330,7 @@ void VolumeImplementation::Link(
   timestampResponse* ts_response = static_cast<timestampResponse*>(
       response->response());
 
+  metadata_cache_.InvalidateNonExistent(link_path);
   const string parent_dir = ResolveParentDirectory(link_path);
   metadata_cache_.UpdateStatTime(
       parent_dir,
@@ -337,67 +416,109 @@ FileHandle* VolumeImplementation::OpenFileWithTruncateSize(
     async_writes_enabled = false;
   }
 
-  openRequest rq;
-  rq.set_volume_name(volume_name_);
-  rq.set_path(path);
-  rq.set_flags(flags);
-  rq.set_mode(mode);
-  rq.set_attributes(attributes);
-
-  // set vivaldi coordinates if vivaldi is enabled
-  if (volume_options_.vivaldi_enable) {
-    rq.mutable_coordinates()->CopyFrom(this->client_->GetVivaldiCoordinates());
+  // A re-open may use the XCap and XLocSet of a previous open().
+  FileCredentials cached_credentials;
+  const bool cached = open_capability_cache_.Get(path,
+                                                 flags,
+                                                 user_credentials,
+                                                 &cached_credentials);
+  if (!cached && (flags & SYSTEM_V_FCNTL_H_O_TRUNC)) {
+    // The truncate epoch of cached XCaps is outdated afterwards.
+    open_capability_cache_.Invalidate(path);
   }
 
-  boost::scoped_ptr<rpc::SyncCallbackBase> response(
-      ExecuteSyncRequest(
-          boost::bind(
-              &xtreemfs::pbrpc::MRCServiceClient::open_sync,
-              mrc_service_client_.get(),
-              _1,
-              boost::cref(auth_bogus_),
-              boost::cref(user_credentials),
-              &rq),
-          mrc_uuid_iterator_.get(),
-          uuid_resolver_,
-          RPCOptionsFromOptions(volume_options_)));
+  boost::scoped_ptr<rpc::SyncCallbackBase> response;
+  const FileCredentials* file_credentials = &cached_credentials;
+  uint64_t timestamp_s = 0;
+  if (!cached) {
+    openRequest rq;
+    rq.set_volume_name(volume_name_);
+    rq.set_path(path);
+    rq.set_flags(flags);
+    rq.set_mode(mode);
+    rq.set_attributes(attributes);
+
+    // set vivaldi coordinates if vivaldi is enabled
+    if (volume_options_.vivaldi_enable) {
+      rq.mutable_coordinates()->CopyFrom(
+          this->client_->GetVivaldiCoordinates());
+    }
 
-  openResponse* open_response = static_cast<openResponse*>(
-      response->response());
-  // We must have obtained file credentials.
-  assert(open_response->has_creds());
+    response.reset(
+        ExecuteSyncRequest(
+            boost::bind(
+                &xtreemfs::pbrpc::MRCServiceClient::open_sync,
+                mrc_service_client_.get(),
+                _1,
+                boost::cref(auth_bogus_),
+                boost::cref(user_credentials),
+                &rq),
+            mrc_uuid_iterator_.get(),
+            uuid_resolver_,
+            RPCOptionsFromOptions(volume_options_)));
+
+    openResponse* open_response = static_cast<openResponse*>(
+        response->response());
+    // We must have obtained file credentials.
+    assert(open_response->has_creds());
+    file_credentials = &open_response->creds();
+    timestamp_s = open_response->timestamp_s();
+  } else if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG)
+        << "open: using the cached XCap of: " << path << endl;
+  }
 
-  if (open_response->creds().xlocs().replicas_size() == 0) {
+  if (file_credentials->xlocs().replicas_size() == 0) {
     string error = "MRC assigned no OSDs to file on open: " + path +
-        ", xloc: " + open_response->creds().xlocs().DebugString();
+        ", xloc: " + file_credentials->xlocs().DebugString();
     Logging::log->getLog(LEVEL_ERROR) << error << endl;
     ErrorLog::error_log->AppendError(error);
     throw PosixErrorException(POSIX_ERROR_EIO, error);
   }
 
   FileHandleImplementation* file_handle = NULL;
+  bool new_file_info = false;
   // Create a FileInfo object if it does not exist yet.
   {
     boost::mutex::scoped_lock lock(open_file_table_mutex_);
 
-    FileInfo* file_info = GetFileInfoOrCreateUnmutexed(
-        ExtractFileIdFromXCap(open_response->creds().xcap()),
-        path,
-        open_response->creds().xcap().replicate_on_close(),
-        open_response->creds().xlocs());
-    file_handle = file_info->CreateFileHandle(open_response->creds().xcap(),
+    const uint64_t file_id = ExtractFileIdFromXCap(file_credentials->xcap());
+    map<uint64_t, FileInfo*>::const_iterator it
+        = open_file_table_.find(file_id);
+    FileInfo* file_info = NULL;
+    new_file_info = it == open_file_table_.end();
+    if (cached && !new_file_info) {
+      // The XLocSet of the open file is at least as recent as the cached one.
+      file_info = it->second;
+    } else {
+      file_info = GetFileInfoOrCreateUnmutexed(
+          file_id,
+          path,
+          file_credentials->xcap().replicate_on_close(),
+          file_credentials->xlocs());
+    }
+    file_handle = file_info->CreateFileHandle(file_credentials->xcap(),
                                               async_writes_enabled);
   }
 
-  // Copy timestamp and free response memory.
-  uint64_t timestamp_s = open_response->timestamp_s();
-  response->DeleteBuffers();
+  // Files which are already open use connections to their OSDs anyway.
+  if (new_file_info && volume_options_.rpc_prewarm_osd_connections) {
+    PrewarmOSDConnections(file_credentials->xlocs());
+  }
+
+  if (!cached) {
+    open_capability_cache_.Put(path, flags, user_credentials,
+                               *file_credentials);
+    // Free response memory.
+    response->DeleteBuffers();
+  }
 
   // If O_CREAT is set and the file did not previously exist, upon successful
   // completion, open() shall mark for update the st_atime, st_ctime, and
   // st_mtime fields of the file and the st_ctime and st_mtime fields of
-  // the parent directory.
-  if ((flags & SYSTEM_V_FCNTL_H_O_CREAT)) {
+  // the parent directory. A cached XCap implies that the file did exist.
+  if ((flags & SYSTEM_V_FCNTL_H_O_CREAT) && !cached) {
+    metadata_cache_.InvalidateNonExistent(path);
     const string parent_dir = ResolveParentDirectory(path);
     metadata_cache_.UpdateStatTime(
         parent_dir,
@@ -536,18 +657,27 @@ void VolumeImplementation::GetAttrHelper(
   rq.set_path(path);
   rq.set_known_etag(0);
 
-  boost::scoped_ptr<rpc::SyncCallbackBase> response(
-      ExecuteSyncRequest(
-          boost::bind(
-              &xtreemfs::pbrpc::MRCServiceClient::getattr_sync,
-              mrc_service_client_.get(),
-              _1,
-              boost::cref(auth_bogus_),
-              boost::cref(user_credentials),
-              &rq),
-          mrc_uuid_iterator_.get(),
-          uuid_resolver_,
-          RPCOptionsFromOptions(volume_options_)));
+  boost::scoped_ptr<rpc::SyncCallbackBase> response;
+  try {
+    response.reset(
+        ExecuteSyncRequest(
+            boost::bind(
+                &xtreemfs::pbrpc::MRCServiceClient::getattr_sync,
+                mrc_service_client_.get(),
+                _1,
+                boost::cref(auth_bogus_),
+                boost::cref(user_credentials),
+                &rq),
+            mrc_uuid_iterator_.get(),
+            uuid_resolver_,
+            RPCOptionsFromOptions(volume_options_)));
+  } catch (const PosixErrorException& e) {
+    if (e.posix_errno() == POSIX_ERROR_ENOENT) {
+      // Answer repeated lookups of the missing path locally.
+      metadata_cache_.UpdateNonExistent(path);
+    }
+    throw;
+  }
   getattrResponse* getattr = static_cast<getattrResponse*>(
       response->response());
 
@@ -684,6 +814,8 @@ void VolumeImplementation::SetAttr(
   // "chmod" or "chown" operations result into updating the ctime attribute.
   if ((to_set &  SETATTR_MODE) || (to_set &  SETATTR_UID) ||
       (to_set &  SETATTR_GID)) {
+    // Cached XCaps of the path and below it may no longer be permitted.
+    open_capability_cache_.Invalidate(path);
     to_set = static_cast<Setattrs>(to_set | SETATTR_CTIME);
     rq.mutable_stbuf()->set_ctime_ns(static_cast<uint64_t>(
         ts_response->timestamp_s()) * 1000000000);
@@ -725,6 +857,7 @@ void VolumeImplementation::Unlink(
 
   // 2. Invalidate metadata caches.
   metadata_cache_.Invalidate(path);
+  open_capability_cache_.Invalidate(path);
   const string parent_dir = ResolveParentDirectory(path);
   metadata_cache_.UpdateStatTime(
       parent_dir,
@@ -797,6 +930,9 @@ void VolumeImplementation::Rename(
   renameResponse* rename_response = static_cast<renameResponse*>(
       response->response());
 
+  open_capability_cache_.Invalidate(path);
+  open_capability_cache_.Invalidate(new_path);
+
   // 2. Remove file content of any previous files at "new_path".
   if (rename_response->has_creds()) {
     UnlinkAtOSD(rename_response->creds(), new_path);
@@ -824,6 +960,7 @@ void VolumeImplementation::Rename(
   //     directory."
   //    see http://pubs.opengroup.org/onlinepubs/009695399/functions/rename.html
   metadata_cache_.Invalidate(new_path);
+  metadata_cache_.InvalidateNonExistent(new_path);
   // Rename all affected entries.
   metadata_cache_.RenamePrefix(path, new_path);
   // http://pubs.opengroup.org/onlinepubs/009695399/functions/rename.html:
@@ -847,6 +984,82 @@ void VolumeImplementation::Rename(
   response->DeleteBuffers();
 }
 
+void VolumeImplementation::CopyFile(
+    const xtreemfs::pbrpc::UserCredentials& user_credentials,
+    const std::string& path,
+    const std::string& new_path) {
+  Stat stat;
+  GetAttr(user_credentials, path, &stat);
+  if ((stat.mode() & S_IFMT) == S_IFDIR) {
+    throw PosixErrorException(POSIX_ERROR_EISDIR,
+                              "Cannot copy the directory: " + path);
+  }
+  // Truncating the destination must not destroy the source.
+  Stat new_stat;
+  bool new_path_exists = true;
+  try {
+    GetAttr(user_credentials, new_path, &new_stat);
+  } catch (const PosixErrorException& e) {
+    if (e.posix_errno() != POSIX_ERROR_ENOENT) {
+      throw;
+    }
+    new_path_exists = false;
+  }
+  if (new_path_exists && new_stat.ino() == stat.ino()) {
+    throw PosixErrorException(POSIX_ERROR_EINVAL,
+                              "Cannot copy " + path + " onto itself: "
+                              + new_path);
+  }
+
+  FileHandle* source = OpenFile(user_credentials,
+                                path,
+                                SYSTEM_V_FCNTL_H_O_RDONLY);
+  FileHandle* destination = NULL;
+  try {
+    destination = OpenFile(
+        user_credentials,
+        new_path,
+        static_cast<SYSTEM_V_FCNTL>(SYSTEM_V_FCNTL_H_O_CREAT
+                                    | SYSTEM_V_FCNTL_H_O_TRUNC
+                                    | SYSTEM_V_FCNTL_H_O_WRONLY),
+        stat.mode() & 07777);
+
+    // Copy object-wise so that every request addresses a single OSD.
+    const size_t chunk_size = stat.blksize() > 0 ? stat.blksize() : 128 * 1024;
+    FileCopier copier(source,
+                      destination,
+                      chunk_size,
+                      volume_options_.copy_parallel_requests);
+    copier.Copy(0, 0, stat.size());
+    destination->Flush();
+  } catch (const XtreemFSException&) {
+    // Close both handles and report the original error.
+    if (destination) {
+      try {
+        destination->Close();
+      } catch (const XtreemFSException&) {
+      }
+    }
+    try {
+      source->Close();
+    } catch (const XtreemFSException&) {
+    }
+    throw;
+  }
+
+  try {
+    destination->Close();
+  } catch (const XtreemFSException&) {
+    try {
+      source->Close();
+    } catch (const XtreemFSException&) {
+      // Report the error of the destination.
+    }
+    throw;
+  }
+  source->Close();
+}
+
 void VolumeImplementation::MakeDirectory(
     const xtreemfs::pbrpc::UserCredentials& user_credentials,
     const std::string& path,
@@ -871,6 +1084,7 @@ void VolumeImplementation::MakeDirectory(
   timestampResponse* ts_response = static_cast<timestampResponse*>(
       response->response());
 
+  metadata_cache_.InvalidateNonExistent(path);
   const string parent_dir = ResolveParentDirectory(path);
   metadata_cache_.UpdateStatTime(
       parent_dir,
@@ -912,6 +1126,7 @@ void VolumeImplementation::DeleteDirectory(
       static_cast<Setattrs>(SETATTR_CTIME | SETATTR_MTIME));
   metadata_cache_.InvalidatePrefix(path);
   metadata_cache_.InvalidateDirEntry(parent_dir, GetBasename(path));
+  open_capability_cache_.Invalidate(path);
 
   response->DeleteBuffers();
 }
@@ -1045,11 +1260,54 @@ xtreemfs::pbrpc::DirectoryEntries* VolumeImplementation::ReadDir(
       static_cast<uint32_t>(result->entries_size()) < count &&
       !names_only) {
     metadata_cache_.UpdateDirEntries(path, *result);
+    if (volume_options_.readdir_prefetch_xattrs > 0) {
+      PrefetchXAttrs(user_credentials, path, *result);
+    }
   }
 
   return result;
 }
 
+void VolumeImplementation::PrefetchXAttrs(
+    const xtreemfs::pbrpc::UserCredentials& user_credentials,
+    const std::string& path,
+    const xtreemfs::pbrpc::DirectoryEntries& dir_entries) {
+  // Like the stat entries, only the first ones which fit into the cache.
+  const int max_entries = static_cast<int>(min(
+      volume_options_.metadata_cache_size,
+      static_cast<uint64_t>(dir_entries.entries_size())));
+  int fetched = 0;
+  for (int i = 0;
+       i < max_entries && fetched < volume_options_.readdir_prefetch_xattrs;
+       i++) {
+    const DirectoryEntry& dentry = dir_entries.entries(i);
+    string entry_path;
+    if (dentry.name() == ".") {
+      entry_path = path;
+    } else if (dentry.name() == ".." ||
+               (dentry.has_stbuf() && dentry.stbuf().nlink() > 1)) {
+      continue;  // Do not cache hard links.
+    } else {
+      entry_path = ConcatenatePath(path, dentry.name());
+    }
+    if (metadata_cache_.HasXAttrs(entry_path)) {
+      continue;
+    }
+
+    fetched++;
+    try {
+      // Also stores the list in the metadata cache.
+      boost::scoped_ptr<listxattrResponse> xattrs(
+          ListXAttrs(user_credentials, entry_path, false));
+    } catch (const PosixErrorException&) {
+      // E.g., the entry was deleted in the meantime.
+    } catch (const XtreemFSException&) {
+      // Do not wait for the MRC once per entry.
+      return;
+    }
+  }
+}
+
 /**
  * @warning This implementation does return cached values for "xtreemfs.*"
  *          attributes. Use ListXAttrs(user_credentials, path, false) to make
@@ -1138,6 +1396,8 @@ void VolumeImplementation::SetXAttr(
   response->DeleteBuffers();
 
   metadata_cache_.UpdateXAttr(path, name, value);
+  // E.g., ACLs or the replication policy may have changed.
+  open_capability_cache_.Invalidate(path);
 }
 
 bool VolumeImplementation::GetXAttr(
@@ -1293,6 +1553,7 @@ void VolumeImplementation::RemoveXAttr(
   response->DeleteBuffers();
 
   metadata_cache_.InvalidateXAttr(path, name);
+  open_capability_cache_.Invalidate(path);
 }
 
 void VolumeImplementation::AddReplica(
@@ -1319,6 +1580,7 @@ void VolumeImplementation::AddReplica(
           RPCOptionsFromOptions(volume_options_)));
 
   response->DeleteBuffers();
+  open_capability_cache_.Invalidate(path);
 
   // Trigger the replication at this point by reading at least one byte.
   FileHandle* file_handle = OpenFile(user_credentials,
@@ -1418,6 +1680,8 @@ void VolumeImplementation::RemoveReplica(
           uuid_resolver_,
           RPCOptionsFromOptions(volume_options_)));
 
+  open_capability_cache_.Invalidate(path);
+
   // Update the local XLocSet cached at FileInfo if it exists.
   uint64_t file_id = ExtractFileIdFromXCap(creds->xcap());
   map<uint64_t, FileInfo*>::const_iterator it = open_file_table_.find(file_id);
@@ -1473,6 +1737,28 @@ void VolumeImplementation::GetSuitableOSDs(
   response->DeleteBuffers();
 }
 
+/**
+ * @remark Called without open_file_table_mutex_, UUIDToAddress() may block.
+ */
+void VolumeImplementation::PrewarmOSDConnections(const XLocSet& xlocset) {
+  for (int i = 0; i < xlocset.replicas_size(); ++i) {
+    const Replica& replica = xlocset.replicas(i);
+    for (int j = 0; j < replica.osd_uuids_size(); ++j) {
+      string address;
+      try {
+        uuid_resolver_->UUIDToAddress(replica.osd_uuids(j), &address);
+      } catch (const XtreemFSException& e) {
+        if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+          Logging::log->getLog(LEVEL_DEBUG) << "Not connecting to the OSD "
+              << replica.osd_uuids(j) << " in advance: " << e.what() << endl;
+        }
+        continue;
+      }
+      network_client_->Prewarm(address);
+    }
+  }
+}
+
 /**
  * @remark Ownership is NOT transferred to the caller.
  *
@@ -1566,38 +1852,113 @@ void VolumeImplementation::PeriodicXCapRenewal() {
   }
 }
 
+void VolumeImplementation::InvalidateOpenCapabilities(
+    const std::string& path) {
+  open_capability_cache_.Invalidate(path);
+}
+
+void VolumeImplementation::ScheduleFileSizeUpdate(uint64_t file_id) {
+  file_size_update_queue_.Add(file_id);
+}
+
+bool VolumeImplementation::ScheduleUrgentFileSizeUpdate(uint64_t file_id) {
+  if (volume_options_.file_size_update_coalescing_ms <= 0) {
+    return false;
+  }
+  file_size_update_queue_.AddUrgent(file_id);
+  return true;
+}
+
 void VolumeImplementation::PeriodicFileSizeUpdate() {
+  boost::posix_time::seconds interval(
+      volume_options_.periodic_file_size_updates_interval_s);
+  boost::posix_time::milliseconds coalescing_delay(
+      volume_options_.file_size_update_coalescing_ms);
+  boost::system_time next_periodic_run = boost::get_system_time() + interval;
+
+  while (true) {
+    // Send thread to sleep until the next run or an urgent update.
+    const bool urgent =
+        file_size_update_queue_.WaitForUrgent(next_periodic_run);
+    bool periodic_run = boost::get_system_time() >= next_periodic_run;
+    if (urgent && !periodic_run) {
+      // Give other files the chance to join this batch.
+      boost::this_thread::sleep(coalescing_delay);
+      periodic_run = boost::get_system_time() >= next_periodic_run;
+    }
+    if (periodic_run) {
+      next_periodic_run = boost::get_system_time() + interval;
+    }
+
+    vector<uint64_t> file_ids;
+    file_size_update_queue_.Take(periodic_run, &file_ids);
+    WriteBackFileSizesAsync(file_ids);
+  }
+}
+
+void VolumeImplementation::PeriodicLingeringLocksRelease() {
+  // A lock is released at most one lease after it expired.
+  boost::posix_time::milliseconds interval(volume_options_.lock_cache_lease_ms);
   while (true) {
-    // Send thread to sleep.
-    boost::posix_time::seconds interval(
-        volume_options_.periodic_file_size_updates_interval_s);
     boost::this_thread::sleep(interval);
 
+    // The locks are released without blocking the open_file_table_. Until
+    // then, files with collected locks cannot be closed.
+    list<FileInfo*> file_infos;
     {
       boost::mutex::scoped_lock lock(open_file_table_mutex_);
-
-      if (Logging::log->loggingActive(LEVEL_DEBUG)) {
-        Logging::log->getLog(LEVEL_DEBUG)
-            << "START open_file_table: Periodic filesize update for "
-            << open_file_table_.size()
-            << " open files." << std::endl;
-      }
-
-      // Iterate over the open_file_table_.
-      map<uint64_t, FileInfo*>::iterator it;
-      for (it = open_file_table_.begin();
+      const boost::posix_time::ptime now
+          = boost::posix_time::microsec_clock::local_time();
+      for (map<uint64_t, FileInfo*>::iterator it = open_file_table_.begin();
            it != open_file_table_.end(); ++it) {
-        it->second->WriteBackFileSizeAsync(periodic_threads_options_);
+        if (it->second->CollectExpiredLingeringLocks(now)) {
+          file_infos.push_back(it->second);
+        }
       }
+    }
 
-      if (Logging::log->loggingActive(LEVEL_DEBUG)) {
-        Logging::log->getLog(LEVEL_DEBUG)
-            << "END open_file_table: Periodic filesize update for "
-            << open_file_table_.size()
-            << " open files." << std::endl;
+    while (!file_infos.empty()) {
+      FileInfo* file_info = file_infos.front();
+      file_infos.pop_front();
+      try {
+        file_info->ReleaseExpiredLingeringLocks();
+      } catch(...) {
+        // E.g., interrupted: let the other files be closed.
+        for (list<FileInfo*>::iterator it = file_infos.begin();
+             it != file_infos.end(); ++it) {
+          (*it)->CancelExpiredLingeringLocks();
+        }
+        throw;
       }
     }
   }
 }
 
+void VolumeImplementation::WriteBackFileSizesAsync(
+    const std::vector<uint64_t>& file_ids) {
+  boost::mutex::scoped_lock lock(open_file_table_mutex_);
+
+  if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG)
+        << "START open_file_table: Periodic filesize update for "
+        << file_ids.size() << " of " << open_file_table_.size()
+        << " open files." << std::endl;
+  }
+
+  // All requests are sent before any response is awaited, so the updates are
+  // pipelined over the connection to the MRC.
+  for (size_t i = 0; i < file_ids.size(); ++i) {
+    map<uint64_t, FileInfo*>::iterator it = open_file_table_.find(file_ids[i]);
+    if (it != open_file_table_.end()) {
+      it->second->WriteBackFileSizeAsync(periodic_threads_options_);
+    }
+  }
+
+  if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG)
+        << "END open_file_table: Periodic filesize update for "
+        << file_ids.size() << " open files." << std::endl;
+  }
+}
+
 }  // namespace xtreemfs
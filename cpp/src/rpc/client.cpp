@@ -15,12 +15,15 @@
 #include <boost/algorithm/string/trim.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/interprocess/detail/atomic.hpp>
+#include <boost/thread/tss.hpp>
 #include <fstream>
 #include <iostream>
 #include <utility>
 #include <set>
 #include <string>
+#include <vector>
 
+#include "rpc/request_trace.h"
 #include "util/logging.h"
 
 #ifdef HAS_OPENSSL
@@ -44,8 +47,10 @@ using namespace boost;
 using namespace google::protobuf;
 
 #if (BOOST_VERSION < 104800)
+using boost::interprocess::detail::atomic_add32;
 using boost::interprocess::detail::atomic_inc32;
 #else
+using boost::interprocess::ipcdetail::atomic_add32;
 using boost::interprocess::ipcdetail::atomic_inc32;
 #endif  // BOOST_VERSION < 104800
 
@@ -58,18 +63,77 @@ using boost::interprocess::ipcdetail::atomic_inc32;
 namespace xtreemfs {
 namespace rpc {
 
+/** Length of a tick of Client::request_deadlines_, i.e., requests time out up
+ *  to this late. */
+static const int kRequestDeadlineTickMs = 100;
+
+/** Number of call ids a thread takes at once. */
+static const uint32_t kCallIdBlockSize = 64;
+
+/** Call ids taken by a thread which were not used yet. */
+struct CallIdBlock {
+  CallIdBlock() : client_instance_id(0), next(0), end(0) {}
+
+  /** Client::instance_id_ of the Client which handed out the block. */
+  uint32_t client_instance_id;
+  uint32_t next;
+  uint32_t end;
+};
+
+static boost::thread_specific_ptr<CallIdBlock> thread_call_ids;
+
+/** Number of Client objects created so far. */
+static uint32_t client_instances = 1;
+
+/** Deadline of the requests sent by the current thread, see
+ *  ScopedRequestDeadline. */
+static boost::thread_specific_ptr<posix_time::ptime> thread_request_deadline;
+
+ScopedRequestDeadline::ScopedRequestDeadline(const posix_time::ptime& deadline)
+    : previous_(Current()) {
+  if (deadline.is_not_a_date_time()) {
+    return;
+  }
+  if (thread_request_deadline.get() == NULL) {
+    thread_request_deadline.reset(new posix_time::ptime(deadline));
+  } else if (previous_.is_not_a_date_time() || deadline < previous_) {
+    *thread_request_deadline = deadline;
+  }
+}
+
+ScopedRequestDeadline::~ScopedRequestDeadline() {
+  if (thread_request_deadline.get() != NULL) {
+    *thread_request_deadline = previous_;
+  }
+}
+
+posix_time::ptime ScopedRequestDeadline::Current() {
+  posix_time::ptime* deadline = thread_request_deadline.get();
+  return deadline == NULL ? posix_time::ptime(posix_time::not_a_date_time)
+                          : *deadline;
+}
+
 Client::Client(int32_t connect_timeout_s,
                int32_t request_timeout_s,
                int32_t max_con_linger,
+               int32_t write_coalescing_us,
+               bool use_io_uring,
                const SSLOptions* options)
     : service_(),
       stopped_(false),
       stopped_ioservice_only_(false),
+      instance_id_(atomic_inc32(&client_instances)),
       callid_counter_(1),
       rq_timeout_timer_(service_),
       rq_timeout_s_(request_timeout_s),
+      request_deadlines_start_(posix_time::microsec_clock::local_time()),
+      request_deadlines_(0),
+      request_deadline_timer_(service_),
+      request_deadline_timer_running_(false),
       connect_timeout_s_(connect_timeout_s),
-      max_con_linger_(max_con_linger)
+      max_con_linger_(max_con_linger),
+      write_coalescing_us_(write_coalescing_us),
+      use_io_uring_(use_io_uring)
 #ifndef HAS_OPENSSL
 {
   // Delete SSL options because they are not used when not compiled with SSL.
@@ -77,6 +141,7 @@ Client::Client(int32_t connect_timeout_s,
 }
 #else
       ,use_gridssl_(false),
+      use_kernel_tls_(false),
       ssl_options(options),
       pemFileName(NULL),
       certFileName(NULL),
@@ -89,6 +154,15 @@ Client::Client(int32_t connect_timeout_s,
     }
 
     use_gridssl_ = options->use_grid_ssl();
+    // Grid SSL does not encrypt the data at all.
+    use_kernel_tls_ = options->use_kernel_tls() && !use_gridssl_;
+    if (use_kernel_tls_ && options->ssl_method_string() != "tlsv12" &&
+        Logging::log->loggingActive(LEVEL_WARN)) {
+      Logging::log->getLog(LEVEL_WARN) << "Kernel TLS only takes over TLSv1.2"
+          " connections, which the SSL method '" << options->ssl_method_string()
+          << "' does not enforce. Other connections are encrypted by OpenSSL."
+          << endl;
+    }
     ssl_context_ = new boost::asio::ssl::context(
         service_,
         string_to_ssl_method(
@@ -111,6 +185,11 @@ Client::Client(int32_t connect_timeout_s,
                        boost::asio::ssl::context::verify_fail_if_no_peer_cert,
                        &xtreemfs::rpc::verify_certificate_callback);
 #endif  // BOOST_VERSION > 104601
+#if (BOOST_VERSION > 104601)
+    ssl_session_cache_.Attach(ssl_context_->native_handle());
+#else  // BOOST_VERSION > 104601
+    ssl_session_cache_.Attach(ssl_context_->impl());
+#endif  // BOOST_VERSION > 104601
 
     OpenSSL_add_all_algorithms();
     OpenSSL_add_all_ciphers();
@@ -403,7 +482,19 @@ void Client::sendRequest(const string& address,
                          Message* response_message,
                          void* context,
                          ClientRequestCallbackInterface *callback) {
-  uint32_t call_id = atomic_inc32(&callid_counter_);
+  // Every thread takes kCallIdBlockSize call ids at once.
+  CallIdBlock* call_ids = thread_call_ids.get();
+  if (call_ids == NULL) {
+    call_ids = new CallIdBlock();
+    thread_call_ids.reset(call_ids);
+  }
+  if (call_ids->client_instance_id != instance_id_
+      || call_ids->next == call_ids->end) {
+    call_ids->client_instance_id = instance_id_;
+    call_ids->next = atomic_add32(&callid_counter_, kCallIdBlockSize);
+    call_ids->end = call_ids->next + kCallIdBlockSize;
+  }
+  uint32_t call_id = call_ids->next++;
   ClientRequest* request = new ClientRequest(address,
                                         call_id,
                                         interface_id,
@@ -416,20 +507,26 @@ void Client::sendRequest(const string& address,
                                         response_message,
                                         context,
                                         callback);
-
-  boost::mutex::scoped_lock lock(requests_mutex_);
-  if (stopped_) {
-    lock.unlock();
-
-    AbortClientRequest(request,
-                       "Request aborted since RPC client was stopped.");
-  } else {
-    bool wasEmpty = requests_.empty();
-    requests_.push(request);
-    if (wasEmpty) {
-      service_.post(boost::bind(&Client::sendInternalRequest, this));
+  map<pair<uint32_t, uint32_t>, posix_time::time_duration>::const_iterator
+      timeout = proc_timeouts_.find(make_pair(interface_id, proc_id));
+  request->set_timeout(timeout == proc_timeouts_.end()
+                           ? posix_time::seconds(rq_timeout_s_)
+                           : timeout->second);
+  request->set_deadline(ScopedRequestDeadline::Current());
+
+  if (!stopped_.load(boost::memory_order_relaxed)) {
+    TraceRequestEvent(kTraceEnqueued, call_id, proc_id, address);
+    bool was_empty;
+    if (submission_queue_.Push(request, &was_empty)) {
+      // Only the first request of a batch wakes up the network thread.
+      if (was_empty) {
+        service_.post(boost::bind(&Client::sendInternalRequest, this));
+      }
+      return;
     }
   }
+
+  AbortClientRequest(request, "Request aborted since RPC client was stopped.");
 }
 
 void Client::sendInternalRequest() {
@@ -437,18 +534,16 @@ void Client::sendInternalRequest() {
     return;
   }
   // Process requests.
-  do {
-    ClientRequest *rq = NULL;
-    {
-      boost::mutex::scoped_lock lock(requests_mutex_);
-      if (requests_.empty())
-        break;
-      rq = requests_.front();
-      requests_.pop();
-    }
+  submission_queue_.PopAll(&submitted_requests_);
+  for (vector<ClientRequest*>::iterator it = submitted_requests_.begin();
+       it != submitted_requests_.end();
+       ++it) {
+    ClientRequest *rq = *it;
     assert(rq != NULL);
 
     rq->RequestSent();
+    TraceRequestEvent(kTraceDequeued, rq->call_id(), rq->proc_id(),
+                      rq->address());
 
     ClientConnection *con = NULL;
     connection_map::iterator iter = connections_.find(rq->address());
@@ -456,6 +551,7 @@ void Client::sendInternalRequest() {
       con = iter->second;
     if (con) {
       con->AddRequest(rq);
+      ScheduleRequestDeadline(rq);
       con->DoProcess();
     } else {
       // New connection.
@@ -474,25 +570,10 @@ void Client::sendInternalRequest() {
           std::string server = addr.substr(0, colonpos);
           std::string port = addr.substr(colonpos + 1);
 
-          con = new ClientConnection(server,
-                                     port,
-                                     service_,
-                                     &request_table_,
-                                     connect_timeout_s_,
-                                     connect_timeout_s_
-#ifdef HAS_OPENSSL
-                                     ,use_gridssl_,
-                                     ssl_context_
-#endif  // HAS_OPENSSL
-                                     );
-
-          if (Logging::log->loggingActive(LEVEL_DEBUG)) {
-            Logging::log->getLog(LEVEL_DEBUG) << "new connection for "
-                << addr << endl;
-          }
-
+          con = CreateConnection(server, port);
           connections_[addr] = con;
           con->AddRequest(rq);
+          ScheduleRequestDeadline(rq);
           con->DoProcess();
         } catch(std::out_of_range &exception) {
           RPCHeader::ErrorResponse* err = new RPCHeader::ErrorResponse();
@@ -505,7 +586,62 @@ void Client::sendInternalRequest() {
         }
       }
     }
-  } while (true);
+  }
+  submitted_requests_.clear();
+}
+
+void Client::Prewarm(const std::string& address) {
+  if (!stopped_) {
+    service_.post(boost::bind(&Client::PrewarmInternal, this, address));
+  }
+}
+
+void Client::PrewarmInternal(const std::string& address) {
+  if (stopped_ioservice_only_
+      || connections_.find(address) != connections_.end()) {
+    return;
+  }
+
+  const size_t colonpos = address.find_last_of(":");
+  if (colonpos == string::npos) {
+    Logging::log->getLog(LEVEL_WARN) << "Cannot connect to an invalid"
+        " address: " << address << endl;
+    return;
+  }
+
+  ClientConnection* con = CreateConnection(address.substr(0, colonpos),
+                                           address.substr(colonpos + 1));
+  connections_[address] = con;
+  // Without requests, the connection only connects and stays idle.
+  con->DoProcess();
+}
+
+ClientConnection* Client::CreateConnection(const std::string& server,
+                                           const std::string& port) {
+  ClientConnection* con = new ClientConnection(server,
+                                               port,
+                                               service_,
+                                               &request_table_,
+                                               &request_deadlines_,
+                                               connect_timeout_s_,
+                                               connect_timeout_s_,
+                                               write_coalescing_us_
+#ifdef HAS_IO_URING
+                                               ,io_uring_.get()
+#endif  // HAS_IO_URING
+#ifdef HAS_OPENSSL
+                                               ,use_gridssl_,
+                                               ssl_context_,
+                                               &ssl_session_cache_,
+                                               use_kernel_tls_
+#endif  // HAS_OPENSSL
+                                               );
+
+  if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG) << "new connection for "
+        << con->GetServerAddress() << endl;
+  }
+  return con;
 }
 
 void Client::handleTimeout(const boost::system::error_code& error) {
@@ -516,42 +652,103 @@ void Client::handleTimeout(const boost::system::error_code& error) {
   }
 
   try {
-    posix_time::ptime deadline = posix_time::microsec_clock::local_time()
-        - posix_time::seconds(rq_timeout_s_);
-
-    // Connections which have timed out requests have to be reset later.
-    set<ClientConnection*> to_be_reset_cons;
+    // Close inactive connections.
+    posix_time::ptime linger_deadline = posix_time::microsec_clock::local_time()
+        - posix_time::seconds(max_con_linger_);
 
-    // Remove all timed out requests.
-    request_map::iterator iter = request_table_.begin();
-    while (iter != request_table_.end()) {
-      ClientRequest* rq = iter->second;
-      if (rq->time_sent() < deadline) {
-        ClientConnection* respective_con = rq->client_connection();
-        assert(respective_con);
-        to_be_reset_cons.insert(respective_con);
-
-        string error = "Request timed out (call id = "
-            + boost::lexical_cast<string>(rq->call_id())
-            + ", interface id = "
-            + boost::lexical_cast<string>(rq->interface_id())
-            + ", proc id = " + boost::lexical_cast<string>(rq->proc_id())
-            + ", server = " + respective_con->GetServerAddress()
-            + ").";
-        RPCHeader::ErrorResponse* err = new RPCHeader::ErrorResponse();
-        err->set_error_message(error);
-        err->set_error_type(IO_ERROR);
-        err->set_posix_errno(POSIX_ERROR_EINVAL);
-        rq->set_error(err);
-        rq->ExecuteCallback();
-        request_table_.erase(iter++);
+    connection_map::iterator iter = connections_.begin();
+    while (iter != connections_.end()) {
+      ClientConnection* con = iter->second;
+      assert(con != NULL);
+      if (con->last_used() < linger_deadline) {
+        string error = "Connection was inactive for more than "
+            + boost::lexical_cast<string>(max_con_linger_)
+            + " seconds.";
         if (Logging::log->loggingActive(LEVEL_INFO)) {
-          Logging::log->getLog(LEVEL_INFO) << error << endl;
+          Logging::log->getLog(LEVEL_INFO) << "Closing connection to '"
+              << iter->first << "' since it " << error.substr(11) << endl;
         }
+        con->Close(error);
+        delete con;
+        connections_.erase(iter++);
       } else {
         ++iter;
       }
     }
+  } catch (std::exception &e) {
+    Logging::log->getLog(LEVEL_ERROR) << "An exception occurred while checking"
+        " for inactive connections: " << e.what() << endl;
+  }
+  rq_timeout_timer_.expires_from_now(posix_time::seconds(rq_timeout_s_));
+  rq_timeout_timer_.async_wait(boost::bind(&Client::handleTimeout,
+                                           this,
+                                           asio::placeholders::error));
+}
+
+void Client::ScheduleRequestDeadline(ClientRequest* request) {
+  const posix_time::ptime expires_at = request->expires_at();
+  if (expires_at.is_special()) {
+    return;
+  }
+  // The tick of expires_at may already be partly over, use the next one.
+  request_deadlines_.Schedule(request->deadline_timer(),
+                              ToDeadlineTick(expires_at) + 1);
+
+  if (!request_deadline_timer_running_) {
+    request_deadline_timer_running_ = true;
+    request_deadline_timer_.expires_from_now(
+        posix_time::milliseconds(kRequestDeadlineTickMs));
+    request_deadline_timer_.async_wait(
+        boost::bind(&Client::HandleRequestDeadlines,
+                    this,
+                    asio::placeholders::error));
+  }
+}
+
+void Client::HandleRequestDeadlines(const boost::system::error_code& error) {
+  request_deadline_timer_running_ = false;
+  // Do nothing when the timer was canceled.
+  if (error == boost::asio::error::operation_aborted
+      || stopped_ioservice_only_) {
+    return;
+  }
+
+  try {
+    vector<TimerWheel::Timer*> expired;
+    request_deadlines_.Advance(
+        ToDeadlineTick(posix_time::microsec_clock::local_time()), &expired);
+
+    // Connections which have timed out requests have to be reset later.
+    set<ClientConnection*> to_be_reset_cons;
+
+    // Remove all timed out requests.
+    for (vector<TimerWheel::Timer*>::iterator iter = expired.begin();
+         iter != expired.end();
+         ++iter) {
+      ClientRequest* rq = static_cast<ClientRequest*>((*iter)->context());
+      assert(request_table_.find(rq->call_id()) != request_table_.end());
+      ClientConnection* respective_con = rq->client_connection();
+      assert(respective_con);
+      to_be_reset_cons.insert(respective_con);
+
+      string error = "Request timed out (call id = "
+          + boost::lexical_cast<string>(rq->call_id())
+          + ", interface id = "
+          + boost::lexical_cast<string>(rq->interface_id())
+          + ", proc id = " + boost::lexical_cast<string>(rq->proc_id())
+          + ", server = " + respective_con->GetServerAddress()
+          + ").";
+      RPCHeader::ErrorResponse* err = new RPCHeader::ErrorResponse();
+      err->set_error_message(error);
+      err->set_error_type(IO_ERROR);
+      err->set_posix_errno(POSIX_ERROR_EINVAL);
+      rq->set_error(err);
+      request_table_.erase(rq->call_id());
+      rq->ExecuteCallback();
+      if (Logging::log->loggingActive(LEVEL_INFO)) {
+        Logging::log->getLog(LEVEL_INFO) << error << endl;
+      }
+    }
 
     // Reset all connections which had timed out requests.
     for (set<ClientConnection*>::iterator iter = to_be_reset_cons.begin();
@@ -574,38 +771,35 @@ void Client::handleTimeout(const boost::system::error_code& error) {
       (*iter)->Reset();
       (*iter)->SendError(POSIX_ERROR_EIO, error);
     }
-
-    // Close inactive connections.
-    posix_time::ptime linger_deadline = posix_time::microsec_clock::local_time()
-        - posix_time::seconds(max_con_linger_);
-
-    connection_map::iterator iter2 = connections_.begin();
-    while (iter2 != connections_.end()) {
-      ClientConnection* con = iter2->second;
-      assert(con != NULL);
-      if (con->last_used() < linger_deadline) {
-        string error = "Connection was inactive for more than "
-            + boost::lexical_cast<string>(max_con_linger_)
-            + " seconds.";
-        if (Logging::log->loggingActive(LEVEL_INFO)) {
-          Logging::log->getLog(LEVEL_INFO) << "Closing connection to '"
-              << iter2->first << "' since it " << error.substr(11) << endl;
-        }
-        con->Close(error);
-        delete con;
-        connections_.erase(iter2++);
-      } else {
-        ++iter2;
-      }
-    }
   } catch (std::exception &e) {
     Logging::log->getLog(LEVEL_ERROR) << "An exception occurred while checking"
-        " for timed out requests and connections: " << e.what() << endl;
+        " for timed out requests: " << e.what() << endl;
+  }
+
+  if (request_deadlines_.size() > 0 && !request_deadline_timer_running_) {
+    request_deadline_timer_running_ = true;
+    request_deadline_timer_.expires_from_now(
+        posix_time::milliseconds(kRequestDeadlineTickMs));
+    request_deadline_timer_.async_wait(
+        boost::bind(&Client::HandleRequestDeadlines,
+                    this,
+                    asio::placeholders::error));
   }
-  rq_timeout_timer_.expires_from_now(posix_time::seconds(rq_timeout_s_));
-  rq_timeout_timer_.async_wait(boost::bind(&Client::handleTimeout,
-                                           this,
-                                           asio::placeholders::error));
+}
+
+uint64_t Client::ToDeadlineTick(const posix_time::ptime& time) const {
+  if (time <= request_deadlines_start_) {
+    return 0;
+  }
+  return (time - request_deadlines_start_).total_milliseconds()
+      / kRequestDeadlineTickMs;
+}
+
+void Client::SetRequestTimeout(uint32_t interface_id,
+                               uint32_t proc_id,
+                               int32_t timeout_ms) {
+  proc_timeouts_[make_pair(interface_id, proc_id)]
+      = posix_time::milliseconds(timeout_ms);
 }
 
 void Client::AbortClientRequest(ClientRequest* request,
@@ -649,6 +843,25 @@ void Client::run() {
 #endif  // !HAS_OPENSSL
   }
 
+  if (use_io_uring_) {
+#ifdef HAS_IO_URING
+    // Connections are only created in the context of service_, i.e., after
+    // this point.
+    string error;
+    io_uring_.reset(IOUring::Create(service_, &error));
+    if (io_uring_.get() == NULL) {
+      Logging::log->getLog(LEVEL_WARN) << "io_uring is not available ("
+          << error << "), using regular sockets." << endl;
+    } else if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+      Logging::log->getLog(LEVEL_DEBUG) << "Using io_uring for TCP"
+          " connections." << endl;
+    }
+#else
+    Logging::log->getLog(LEVEL_WARN) << "io_uring is not supported by this"
+        " build, using regular sockets." << endl;
+#endif  // HAS_IO_URING
+  }
+
   // Does not return as long as there are running timers (e.g.,
   // rq_timeout_timer_) or pending boost::asio callbacks.
   service_.run();
@@ -661,24 +874,23 @@ void Client::run() {
   }
   connections_.clear();
 
-  // A request may not have made it from requests_ to request_table_. Cancel
-  // those, too.
-  {
-    boost::mutex::scoped_lock lock(requests_mutex_);
-    while (requests_.size()) {
-      ClientRequest* request = requests_.front();
-      requests_.pop();
-
-      AbortClientRequest(request,
-                         "Request aborted since RPC client was stopped.");
-    }
+  // A request may not have made it from submission_queue_ to request_table_.
+  // Cancel those, too. Later requests are aborted by sendRequest().
+  submitted_requests_.clear();
+  submission_queue_.Close(&submitted_requests_);
+  for (vector<ClientRequest*>::iterator it = submitted_requests_.begin();
+       it != submitted_requests_.end();
+       ++it) {
+    AbortClientRequest(*it, "Request aborted since RPC client was stopped.");
   }
+  submitted_requests_.clear();
 
   // Delete requests which were successfully sent, but not response was received
   // for them.
   for (request_map::iterator iter = request_table_.begin();
        iter != request_table_.end();
        ++iter) {
+    request_deadlines_.Cancel(iter->second->deadline_timer());
     AbortClientRequest(iter->second,
                        "Request aborted since RPC client was stopped.");
   }
@@ -691,12 +903,7 @@ void Client::run() {
 }
 
 void Client::shutdown() {
-  bool already_stopped = false;
-  {
-    boost::mutex::scoped_lock lock(requests_mutex_);
-    already_stopped = stopped_;
-    stopped_ = true;
-  }
+  bool already_stopped = stopped_.exchange(true);
 
   if (!already_stopped) {
     if (Logging::log->loggingActive(LEVEL_DEBUG)) {
@@ -715,6 +922,7 @@ void Client::shutdown() {
 void Client::ShutdownHandler() {
   stopped_ioservice_only_ = true;
   rq_timeout_timer_.cancel();
+  request_deadline_timer_.cancel();
 
   for (connection_map::iterator iter = connections_.begin();
        iter != connections_.end();
@@ -20,8 +20,12 @@
 #endif  // HAS_VALGRIND
 
 #include "rpc/grid_ssl_socket_channel.h"
+#include "rpc/io_uring_socket_channel.h"
+#include "rpc/ktls_socket_channel.h"
+#include "rpc/request_trace.h"
 #include "rpc/ssl_socket_channel.h"
 #include "rpc/tcp_socket_channel.h"
+#include "rpc/transport_profile.h"
 #include "util/logging.h"
 
 namespace xtreemfs {
@@ -34,16 +38,42 @@ using namespace boost;
 using namespace google::protobuf;
 using namespace boost::asio::ip;
 
+/** Upper bound of the bytes sent with one write, unless a single request is
+ *  larger. */
+static const size_t kMaxBatchBytes = 1024 * 1024;
+
+/** Upper bound of the buffers passed to one write. boost::asio does not pass
+ *  more to a single sendmsg() call. */
+static const size_t kMaxBatchBuffers = 64;
+
+/** Requests up to this size (including data) are copied into one buffer. It
+ *  equals the maximum size of a TLS record. */
+static const size_t kMaxCoalescedRequestSize = 16 * 1024;
+
+/** Returns the number of bytes "request" takes on the wire. */
+static size_t RequestSize(ClientRequest* request) {
+  const RecordMarker* marker = request->request_marker();
+  return RecordMarker::get_size() + marker->header_len()
+      + marker->message_len() + marker->data_len();
+}
+
 ClientConnection::ClientConnection(
     const string& server_name,
     const string& port,
     asio::io_service& service,
     request_map *request_table,
+    TimerWheel* request_deadlines,
     int32_t connect_timeout_s,
-    int32_t max_reconnect_interval_s
+    int32_t max_reconnect_interval_s,
+    int32_t write_coalescing_us
+#ifdef HAS_IO_URING
+    ,IOUring* io_uring
+#endif  // HAS_IO_URING
 #ifdef HAS_OPENSSL
     ,bool use_gridssl,
-    boost::asio::ssl::context* ssl_context
+    boost::asio::ssl::context* ssl_context,
+    SSLSessionCache* ssl_session_cache,
+    bool use_kernel_tls
 #endif  // HAS_OPENSSL
     )
     : receive_marker_(NULL),
@@ -52,6 +82,7 @@ ClientConnection::ClientConnection(
       receive_data_(NULL),
       connection_state_(IDLE),
       requests_(),
+      requests_being_sent_(0),
       current_request_(NULL),
       server_name_(server_name),
       server_port_(port),
@@ -60,15 +91,25 @@ ClientConnection::ClientConnection(
       socket_(NULL),
       endpoint_(NULL),
       request_table_(request_table),
+      request_deadlines_(request_deadlines),
       timer_(service),
       connect_timeout_s_(connect_timeout_s),
       max_reconnect_interval_s_(max_reconnect_interval_s),
+      write_coalescing_us_(write_coalescing_us),
+      coalescing_timer_(service),
+      coalescing_(false),
       next_reconnect_at_(boost::posix_time::not_a_date_time),
       last_connect_was_at_(boost::posix_time::not_a_date_time),
-      reconnect_interval_s_(1)
+      reconnect_interval_s_(1),
+      receive_started_at_us_(0)
+#ifdef HAS_IO_URING
+      ,io_uring_(io_uring)
+#endif  // HAS_IO_URING
 #ifdef HAS_OPENSSL
       ,use_gridssl_(use_gridssl),
-      ssl_context_(ssl_context)
+      ssl_context_(ssl_context),
+      ssl_session_cache_(ssl_session_cache),
+      use_kernel_tls_(use_kernel_tls)
 #endif  // HAS_OPENSSL
 {
   receive_marker_buffer_ = new char[RecordMarker::get_size()];
@@ -77,7 +118,7 @@ ClientConnection::ClientConnection(
 
 void ClientConnection::AddRequest(ClientRequest* request) {
   request->set_client_connection(this);
-  requests_.push(PendingRequest(request->call_id(), request));
+  requests_.push_back(PendingRequest(request->call_id(), request));
   (*request_table_)[request->call_id()] = request;
 }
 
@@ -96,17 +137,19 @@ void ClientConnection::SendError(POSIXErrno posix_errno,
         // ClientRequest still exists in request_table_, it's safe to access it.
         ClientRequest *request = requests_.front().rq;
         request->set_error(new RPCHeader::ErrorResponse(err));
-        request->ExecuteCallback();
+        request_deadlines_->Cancel(request->deadline_timer());
         request_table_->erase(call_id);
+        request->ExecuteCallback();
 
         Logging::log->getLog(LEVEL_ERROR)
             << "operation failed: call_id=" << call_id
             << " errno=" << posix_errno
             << " message=" << error_message << endl;
       }
-      requests_.pop();
+      requests_.pop_front();
     }
   }
+  requests_being_sent_ = 0;
 }
 
 void ClientConnection::DoProcess() {
@@ -115,6 +158,18 @@ void ClientConnection::DoProcess() {
   if (connection_state_ == IDLE) {
     if (endpoint_ == NULL) {
       Connect();
+    } else if (write_coalescing_us_ > 0 && !requests_.empty()
+               && RequestSize(requests_.back().rq)
+                   <= kMaxCoalescedRequestSize) {
+      // Give further small requests the chance to be sent with this one.
+      connection_state_ = ACTIVE;
+      coalescing_ = true;
+      coalescing_timer_.expires_from_now(
+          posix_time::microseconds(write_coalescing_us_));
+      coalescing_timer_.async_wait(
+          boost::bind(&ClientConnection::OnCoalescingTimeout,
+                      this,
+                      asio::placeholders::error));
     } else {
       // Do write.
       SendRequest();
@@ -156,21 +211,42 @@ void ClientConnection::CreateChannel() {
     socket_ = NULL;
   }
 #ifndef HAS_OPENSSL
-  socket_ = new TCPSocketChannel(service_);
+  socket_ = CreateTCPChannel();
 #else
   if (ssl_context_ == NULL) {
-    socket_ = new TCPSocketChannel(service_);
+    socket_ = CreateTCPChannel();
   } else if (use_gridssl_) {
-    socket_ = new GridSSLSocketChannel(service_, *ssl_context_);
+    socket_ = new GridSSLSocketChannel(service_,
+                                       *ssl_context_,
+                                       ssl_session_cache_,
+                                       GetServerAddress());
+  } else if (use_kernel_tls_) {
+    socket_ = new KTLSSocketChannel(service_,
+                                    *ssl_context_,
+                                    ssl_session_cache_,
+                                    GetServerAddress());
   } else {
-    socket_ = new SSLSocketChannel(service_, *ssl_context_);
+    socket_ = new SSLSocketChannel(service_,
+                                   *ssl_context_,
+                                   ssl_session_cache_,
+                                   GetServerAddress());
   }
 #endif  // !HAS_OPENSSL
 }
 
+AbstractSocketChannel* ClientConnection::CreateTCPChannel() {
+#ifdef HAS_IO_URING
+  if (io_uring_ != NULL) {
+    return new IOUringSocketChannel(service_, io_uring_);
+  }
+#endif  // HAS_IO_URING
+  return new TCPSocketChannel(service_);
+}
+
 void ClientConnection::Connect() {
   connection_state_ = CONNECTING;
   last_connect_was_at_ = posix_time::second_clock::local_time();
+  TraceRequestEvent(kTraceConnectStart, 0, 0, GetServerAddress());
 #if (BOOST_VERSION > 104200)
   asio::ip::tcp::resolver::query query(
       server_name_,
@@ -201,6 +277,15 @@ void ClientConnection::OnConnectTimeout(const boost::system::error_code& err) {
                 + "' timed out");
 }
 
+void ClientConnection::OnCoalescingTimeout(
+    const boost::system::error_code& err) {
+  if (err == asio::error::operation_aborted || connection_state_ == CLOSED
+      || !coalescing_) {
+    return;
+  }
+  SendRequest();
+}
+
 void ClientConnection::PostResolve(const boost::system::error_code& err,
                                    tcp::resolver::iterator endpoint_iterator) {
   if (err == asio::error::operation_aborted || err == asio::error::eof
@@ -275,6 +360,11 @@ void ClientConnection::PostConnect(const boost::system::error_code& err,
   } else {
     // Do something useful.
     reconnect_interval_s_ = 1;
+    TraceRequestEvent(kTraceConnected, 0, 0, GetServerAddress());
+    if (TransportProfiles::transport_profiles) {
+      TransportProfiles::transport_profiles->Apply(GetServerAddress(),
+                                                   socket_->lowest_layer());
+    }
     next_reconnect_at_ = posix_time::not_a_date_time;
 
     if (Logging::log->loggingActive(LEVEL_DEBUG)) {
@@ -292,50 +382,112 @@ void ClientConnection::PostConnect(const boost::system::error_code& err,
     connection_state_ = IDLE;
     if (!requests_.empty()) {
       SendRequest();
-      ReceiveRequest();
     }
+    // Also read from connections without requests (see Client::Prewarm()),
+    // as the loop is only started here.
+    ReceiveRequest();
   }
 }
 
 void ClientConnection::SendRequest() {
-  if (!requests_.empty()) {
-    connection_state_ = ACTIVE;
+  coalescing_ = false;
+
+  // If a request is no longer present in request_table_, it was already
+  // deleted meanwhile (e.g. by Client::handleTimeout()).
+  while (!requests_.empty() &&
+         request_table_->find(requests_.front().call_id)
+             == request_table_->end()) {
+    requests_.pop_front();
+  }
+  if (requests_.empty()) {
+    connection_state_ = IDLE;
+    return;
+  }
+  connection_state_ = ACTIVE;
+
+  // Select the requests of this write. Deleted ones are skipped.
+  size_t batch_size = 0;
+  size_t batch_bytes = 0;
+  size_t batch_buffers = 0;
+  size_t coalesced_bytes = 0;
+  for (deque<PendingRequest>::const_iterator it = requests_.begin();
+       it != requests_.end();
+       ++it) {
+    if (request_table_->find(it->call_id) == request_table_->end()) {
+      ++batch_size;
+      continue;
+    }
+    const size_t bytes = RequestSize(it->rq);
+    const bool coalesce = bytes <= kMaxCoalescedRequestSize;
+    const size_t buffers = coalesce ? 1 : 2;
+    if (batch_size > 0 && (batch_bytes + bytes > kMaxBatchBytes
+                           || batch_buffers + buffers > kMaxBatchBuffers)) {
+      break;
+    }
+    ++batch_size;
+    batch_bytes += bytes;
+    batch_buffers += buffers;
+    if (coalesce) {
+      coalesced_bytes += bytes;
+    }
+  }
 
-    uint32_t call_id = requests_.front().call_id;
-    ClientRequest* rq = requests_.front().rq;
+  // Consecutive small requests share one buffer. It is reserved up front, so
+  // the buffers which point into it stay valid.
+  boost::shared_ptr<vector<char> > coalesced(new vector<char>());
+  coalesced->reserve(coalesced_bytes);
+  size_t coalesced_start = 0;
+  vector<boost::asio::const_buffer> bufs;
+  for (size_t i = 0; i < batch_size; ++i) {
+    uint32_t call_id = requests_[i].call_id;
+    ClientRequest* rq = requests_[i].rq;
     assert(rq != NULL);
+    if (request_table_->find(call_id) == request_table_->end()) {
+      continue;
+    }
 
-    // If the request is no longer present in request_table_, it was already
-    // deleted meanwhile (e.g. by Client::handleTimeout()).
-    // Get request from table.
-    request_map::iterator iter = request_table_->find(call_id);
-    if (iter == request_table_->end()) {
-      // ClientRequest was already deleted, stop here.
-      requests_.pop();
-      SendRequest();
-    } else {
-      // Process ClientRequest.
-      const RecordMarker* rrm = rq->request_marker();
-
-      vector<boost::asio::const_buffer> bufs;
-      bufs.push_back(boost::asio::buffer(
-          reinterpret_cast<const void*>(rq->rq_hdr_msg()),
-          RecordMarker::get_size() + rrm->header_len() + rrm->message_len()));
+    const RecordMarker* rrm = rq->request_marker();
+    const size_t header_bytes
+        = RecordMarker::get_size() + rrm->header_len() + rrm->message_len();
+    TraceRequestEvent(kTraceWriteStart, call_id, rq->proc_id(),
+                      GetServerAddress());
 
+    if (RequestSize(rq) <= kMaxCoalescedRequestSize) {
+      coalesced->insert(coalesced->end(),
+                        rq->rq_hdr_msg(),
+                        rq->rq_hdr_msg() + header_bytes);
       if (rrm->data_len() > 0) {
-        bufs.push_back(boost::asio::buffer(
-            reinterpret_cast<const void*>(rq->rq_data()), rrm->data_len()));
+        coalesced->insert(coalesced->end(),
+                          rq->rq_data(),
+                          rq->rq_data() + rrm->data_len());
       }
+      continue;
+    }
 
-      socket_->async_write(bufs, boost::bind(
-          &ClientConnection::PostWrite,
-          this,
-          asio::placeholders::error,
-          asio::placeholders::bytes_transferred));
+    if (coalesced->size() > coalesced_start) {
+      bufs.push_back(boost::asio::buffer(&(*coalesced)[coalesced_start],
+                                         coalesced->size() - coalesced_start));
+      coalesced_start = coalesced->size();
     }
-  } else {
-    connection_state_ = IDLE;
+    bufs.push_back(boost::asio::buffer(
+        reinterpret_cast<const void*>(rq->rq_hdr_msg()), header_bytes));
+    if (rrm->data_len() > 0) {
+      bufs.push_back(boost::asio::buffer(
+          reinterpret_cast<const void*>(rq->rq_data()), rrm->data_len()));
+    }
+  }
+  if (coalesced->size() > coalesced_start) {
+    bufs.push_back(boost::asio::buffer(&(*coalesced)[coalesced_start],
+                                       coalesced->size() - coalesced_start));
   }
+
+  requests_being_sent_ = batch_size;
+  socket_->async_write(bufs, boost::bind(
+      &ClientConnection::PostWrite,
+      this,
+      asio::placeholders::error,
+      asio::placeholders::bytes_transferred,
+      coalesced));
 }
 
 void ClientConnection::ReceiveRequest() {
@@ -349,6 +501,9 @@ void ClientConnection::ReceiveRequest() {
 }
 
 void ClientConnection::Reset() {
+  coalescing_ = false;
+  coalescing_timer_.cancel();
+  requests_being_sent_ = 0;
   CreateChannel();
   delete endpoint_;
   endpoint_ = NULL;
@@ -386,6 +541,7 @@ void ClientConnection::Reset() {
 void ClientConnection::Close(const std::string& error) {
   resolver_.cancel();
   timer_.cancel();
+  coalescing_timer_.cancel();
 
   if (socket_) {
       socket_->close();
@@ -404,8 +560,10 @@ void ClientConnection::Close(const std::string& error) {
                 " locally due to: " + error);
 }
 
-void ClientConnection::PostWrite(const boost::system::error_code& err,
-                                 size_t bytes_written) {
+void ClientConnection::PostWrite(
+    const boost::system::error_code& err,
+    size_t bytes_written,
+    boost::shared_ptr<std::vector<char> > coalesced_requests) {
   if (err == asio::error::operation_aborted || err == asio::error::eof
       || connection_state_ == CLOSED) {
     return;
@@ -415,15 +573,29 @@ void ClientConnection::PostWrite(const boost::system::error_code& err,
     SendError(POSIX_ERROR_EIO,
               "Could not send request to '" + server_name_ + ":" +server_port_
                   + "': " + err.message());
-  } else {
-    // Pop sent request.
-    if (!requests_.empty()) {
-      requests_.pop();
-      connection_state_ = IDLE;
-
-      if (!requests_.empty()) {
-        SendRequest();
+  } else if (requests_being_sent_ > 0) {
+    // Pop sent requests.
+    for (; requests_being_sent_ > 0 && !requests_.empty();
+         --requests_being_sent_) {
+      if (RequestTrace::request_trace) {
+        // The request may have been deleted meanwhile (e.g. timed out).
+        request_map::iterator iter =
+            request_table_->find(requests_.front().call_id);
+        if (iter != request_table_->end()) {
+          RequestTrace::request_trace->Record(kTraceWriteFinished,
+                                              iter->second->call_id(),
+                                              iter->second->proc_id(),
+                                              GetServerAddress());
+        }
       }
+      requests_.pop_front();
+    }
+    requests_being_sent_ = 0;
+    connection_state_ = IDLE;
+
+    // Everything which was queued meanwhile goes out with the next write.
+    if (!requests_.empty()) {
+      SendRequest();
     }
   }
 }
@@ -448,6 +620,11 @@ void ClientConnection::PostReadRecordMarker(
                                 RecordMarker::get_size());
     }
 #endif  // HAS_VALGRIND
+    if (RequestTrace::request_trace) {
+      // The call id is not known before the header was parsed.
+      receive_started_at_us_ = RequestTrace::Now();
+    }
+
     // Do read.
     receive_marker_ = new RecordMarker(receive_marker_buffer_);
 
@@ -534,6 +711,16 @@ void ClientConnection::PostReadMessage(const boost::system::error_code& err) {
 
     uint32 call_id = respHdr->call_id();
 
+    if (RequestTrace::request_trace) {
+      RequestTraceEvent event;
+      event.timestamp_us = receive_started_at_us_;
+      event.type = kTraceFirstResponseByte;
+      event.call_id = call_id;
+      event.proc_id = rq->proc_id();
+      event.server = GetServerAddress();
+      RequestTrace::request_trace->Record(event);
+    }
+
     if (respHdr->has_error_response()) {
       // Error response.
       rq->set_error(new RPCHeader::ErrorResponse(respHdr->error_response()));
@@ -578,6 +765,7 @@ void ClientConnection::PostReadMessage(const boost::system::error_code& err) {
     }
 
     // Remove from table and clean up buffers.
+    request_deadlines_->Cancel(rq->deadline_timer());
     request_table_->erase(call_id);
     DeleteInternalBuffers();
     rq->ExecuteCallback();
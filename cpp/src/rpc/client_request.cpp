@@ -14,6 +14,7 @@
 #include "pbrpc/RPC.pb.h"
 #include "rpc/client_request_callback_interface.h"
 #include "rpc/record_marker.h"
+#include "rpc/request_trace.h"
 #include "util/logging.h"
 
 namespace xtreemfs {
@@ -43,6 +44,10 @@ ClientRequest::ClientRequest(const string& address,
       context_(context),
       callback_(callback),
       address_(address),
+      timeout_(boost::posix_time::pos_infin),
+      deadline_(boost::posix_time::not_a_date_time),
+      deadline_timer_(this),
+      next_submitted_(NULL),
       callback_executed_(false),
       error_(NULL),
       resp_header_(NULL),
@@ -101,6 +106,7 @@ ClientRequest::~ClientRequest() {
 void ClientRequest::ExecuteCallback() {
   if (!callback_executed_) {
     callback_executed_ = true;
+    TraceRequestEvent(kTraceCallbackDispatched, call_id_, proc_id_, address_);
     callback_->RequestCompleted(this);
   }
 }
@@ -109,5 +115,13 @@ void ClientRequest::RequestSent() {
   time_sent_ = posix_time::microsec_clock::local_time();
 }
 
+posix_time::ptime ClientRequest::expires_at() const {
+  posix_time::ptime expires_at = time_sent_ + timeout_;
+  if (!deadline_.is_not_a_date_time() && deadline_ < expires_at) {
+    expires_at = deadline_;
+  }
+  return expires_at;
+}
+
 }  // namespace rpc
 }  // namespace xtreemfs
@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifdef HAS_IO_URING
+
+#include "rpc/io_uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <set>
+#include <string>
+
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Size of the submission queue. Submissions beyond it are passed to the
+ *  kernel right away. */
+static const unsigned kSubmissionQueueEntries = 256;
+
+/** Size of the completion queue. Every connection has a pending receive and
+ *  possibly a send. If it overflows, the kernel buffers the completions
+ *  (IORING_FEAT_NODROP). */
+static const unsigned kCompletionQueueEntries = 4096;
+
+static int io_uring_setup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int fd,
+                          unsigned to_submit,
+                          unsigned min_complete,
+                          unsigned flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                  min_complete, flags, NULL, 0));
+}
+
+static int io_uring_register(int fd,
+                             unsigned opcode,
+                             void* arg,
+                             unsigned nr_args) {
+  return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg,
+                                  nr_args));
+}
+
+IOUring* IOUring::Create(boost::asio::io_service& service,
+                         std::string* error) {
+  IOUring* ring = new IOUring(service);
+  if (!ring->Initialize(error)) {
+    delete ring;
+    return NULL;
+  }
+  return ring;
+}
+
+IOUring::IOUring(boost::asio::io_service& service)
+    : service_(service),
+      ring_fd_(-1),
+      rings_(NULL),
+      rings_size_(0),
+      sqes_(NULL),
+      sqes_size_(0),
+      sq_head_(NULL),
+      sq_tail_(NULL),
+      sq_flags_(NULL),
+      sq_array_(NULL),
+      sq_mask_(0),
+      sq_entries_(0),
+      sq_local_tail_(0),
+      sq_pending_(0),
+      flush_posted_(false),
+      cq_head_(NULL),
+      cq_tail_(NULL),
+      cqes_(NULL),
+      cq_mask_(0),
+      waiting_(false),
+      buffer_ring_(NULL),
+      buffer_ring_size_(0),
+      buffer_ring_tail_(0),
+      buffers_(NULL),
+      multishot_receive_(true) {}
+
+IOUring::~IOUring() {
+  event_fd_.reset();
+  if (ring_fd_ >= 0) {
+    // Cancels all operations and unregisters the receive buffers.
+    close(ring_fd_);
+  }
+  if (sqes_ != NULL) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (rings_ != NULL) {
+    munmap(rings_, rings_size_);
+  }
+  if (buffer_ring_ != NULL) {
+    munmap(buffer_ring_, buffer_ring_size_);
+  }
+  if (buffers_ != NULL) {
+    munmap(buffers_, kBuffers * kBufferSize);
+  }
+  for (set<Operation*>::iterator it = operations_.begin();
+       it != operations_.end();
+       ++it) {
+    delete *it;
+  }
+}
+
+bool IOUring::Initialize(std::string* error) {
+  io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = kCompletionQueueEntries;
+  ring_fd_ = io_uring_setup(kSubmissionQueueEntries, &params);
+  if (ring_fd_ < 0) {
+    *error = string("io_uring_setup failed: ") + strerror(errno);
+    return false;
+  }
+  // Completions must neither be dropped nor sockets be read by kernel
+  // threads (Linux 5.7).
+  const unsigned kRequiredFeatures = IORING_FEAT_SINGLE_MMAP
+      | IORING_FEAT_NODROP | IORING_FEAT_FAST_POLL;
+  if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+    *error = "the kernel is too old";
+    return false;
+  }
+
+  rings_size_ = max(
+      params.sq_off.array + params.sq_entries * sizeof(unsigned),
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+  rings_ = mmap(NULL, rings_size_, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  if (rings_ == MAP_FAILED) {
+    rings_ = NULL;
+    *error = string("cannot map the queues: ") + strerror(errno);
+    return false;
+  }
+  char* rings = static_cast<char*>(rings_);
+  sq_head_ = reinterpret_cast<unsigned*>(rings + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(rings + params.sq_off.tail);
+  sq_flags_ = reinterpret_cast<unsigned*>(rings + params.sq_off.flags);
+  sq_array_ = reinterpret_cast<unsigned*>(rings + params.sq_off.array);
+  sq_mask_ = *reinterpret_cast<unsigned*>(rings + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_local_tail_ = *sq_tail_;
+  cq_head_ = reinterpret_cast<unsigned*>(rings + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(rings + params.cq_off.tail);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(rings + params.cq_off.cqes);
+  cq_mask_ = *reinterpret_cast<unsigned*>(rings + params.cq_off.ring_mask);
+
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    *error = string("cannot map the submission queue: ") + strerror(errno);
+    return false;
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  // The buffer ring has to be page aligned.
+  buffer_ring_size_ = kBuffers * sizeof(io_uring_buf);
+  void* buffer_ring = mmap(NULL, buffer_ring_size_, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  void* buffers = mmap(NULL, kBuffers * kBufferSize, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buffer_ring != MAP_FAILED) {
+    buffer_ring_ = static_cast<io_uring_buf*>(buffer_ring);
+  }
+  if (buffers != MAP_FAILED) {
+    buffers_ = static_cast<char*>(buffers);
+  }
+  if (buffer_ring_ == NULL || buffers_ == NULL) {
+    *error = string("cannot allocate the receive buffers: ")
+        + strerror(errno);
+    return false;
+  }
+  io_uring_buf_reg registration;
+  memset(&registration, 0, sizeof(registration));
+  registration.ring_addr = reinterpret_cast<uintptr_t>(buffer_ring_);
+  registration.ring_entries = kBuffers;
+  registration.bgid = kBufferGroup;
+  if (io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING,
+                        &registration, 1) != 0) {
+    // Provided buffer rings exist since Linux 5.19.
+    *error = string("cannot register the receive buffers: ")
+        + strerror(errno);
+    return false;
+  }
+  for (unsigned id = 0; id < kBuffers; ++id) {
+    ReturnBuffer(static_cast<uint16_t>(id));
+  }
+
+  int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (event_fd < 0) {
+    *error = string("eventfd failed: ") + strerror(errno);
+    return false;
+  }
+  if (io_uring_register(ring_fd_, IORING_REGISTER_EVENTFD, &event_fd, 1)
+      != 0) {
+    *error = string("cannot register the eventfd: ") + strerror(errno);
+    close(event_fd);
+    return false;
+  }
+  event_fd_.reset(new boost::asio::posix::stream_descriptor(service_,
+                                                            event_fd));
+  return true;
+}
+
+io_uring_sqe* IOUring::GetSQE(Operation* operation) {
+  if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE)
+      == sq_entries_) {
+    Submit();
+    if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE)
+        == sq_entries_) {
+      return NULL;
+    }
+  }
+
+  const unsigned index = sq_local_tail_ & sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->user_data = reinterpret_cast<uintptr_t>(operation);
+  sq_array_[index] = index;
+  ++sq_local_tail_;
+  ++sq_pending_;
+
+  if (operation != NULL) {
+    operations_.insert(operation);
+    WaitForCompletions();
+  }
+  if (!flush_posted_) {
+    flush_posted_ = true;
+    service_.post(boost::bind(&IOUring::Flush, this));
+  }
+  return sqe;
+}
+
+io_uring_sqe* IOUring::GetSQE() {
+  return GetSQE(NULL);
+}
+
+void IOUring::Submit() {
+  if (sq_pending_ == 0) {
+    return;
+  }
+  __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+  int submitted;
+  do {
+    submitted = io_uring_enter(ring_fd_, sq_pending_, 0, 0);
+  } while (submitted < 0 && errno == EINTR);
+
+  if (submitted >= 0) {
+    sq_pending_ -= min(static_cast<unsigned>(submitted), sq_pending_);
+  } else if (errno != EAGAIN && errno != EBUSY) {
+    Logging::log->getLog(LEVEL_ERROR) << "io_uring_enter failed: "
+        << strerror(errno) << endl;
+  }
+  // Out of memory or too many completions: retry in the next round.
+  if (sq_pending_ > 0 && !flush_posted_) {
+    flush_posted_ = true;
+    service_.post(boost::bind(&IOUring::Flush, this));
+  }
+}
+
+void IOUring::ReturnBuffer(uint16_t id) {
+  io_uring_buf* entry = &buffer_ring_[buffer_ring_tail_ & (kBuffers - 1)];
+  entry->addr = reinterpret_cast<uintptr_t>(buffer(id));
+  entry->len = kBufferSize;
+  entry->bid = id;
+  ++buffer_ring_tail_;
+  __atomic_store_n(&buffer_ring_[0].resv, buffer_ring_tail_,
+                   __ATOMIC_RELEASE);
+}
+
+void IOUring::WaitForCompletions() {
+  // Without pending operations, io_service::run() has to be able to return.
+  if (waiting_ || operations_.empty()) {
+    return;
+  }
+  waiting_ = true;
+  event_fd_->async_read_some(
+      boost::asio::null_buffers(),
+      boost::bind(&IOUring::OnCompletions,
+                  this,
+                  boost::asio::placeholders::error));
+}
+
+void IOUring::OnCompletions(const boost::system::error_code& error) {
+  if (error == boost::asio::error::operation_aborted) {
+    return;
+  }
+  waiting_ = false;
+  uint64_t count;
+  if (read(event_fd_->native_handle(), &count, sizeof(count)) < 0
+      && errno != EAGAIN) {
+    Logging::log->getLog(LEVEL_ERROR) << "cannot read the io_uring eventfd: "
+        << strerror(errno) << endl;
+  }
+  Reap();
+  WaitForCompletions();
+}
+
+void IOUring::Flush() {
+  flush_posted_ = false;
+  Submit();
+  // Sends often complete during the submission.
+  Reap();
+  WaitForCompletions();
+}
+
+void IOUring::Reap() {
+  while (true) {
+    unsigned head = *cq_head_;
+    const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      if ((__atomic_load_n(sq_flags_, __ATOMIC_ACQUIRE)
+           & IORING_SQ_CQ_OVERFLOW) == 0) {
+        break;
+      }
+      // Let the kernel move the buffered completions to the queue.
+      io_uring_enter(ring_fd_, 0, 0, IORING_ENTER_GETEVENTS);
+      continue;
+    }
+
+    const io_uring_cqe* cqe = &cqes_[head & cq_mask_];
+    const uint64_t user_data = cqe->user_data;
+    const int result = cqe->res;
+    const uint32_t flags = cqe->flags;
+    // Free the entry before the operation possibly submits again.
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+
+    Operation* operation = reinterpret_cast<Operation*>(user_data);
+    if (operation == NULL) {
+      continue;
+    }
+    if (!operation->Complete(result, flags)
+        && (flags & IORING_CQE_F_MORE) == 0) {
+      operations_.erase(operation);
+      delete operation;
+    }
+  }
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_IO_URING
@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifdef HAS_IO_URING
+
+#include "rpc/io_uring_socket_channel.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <cassert>
+#include <vector>
+
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+namespace rpc {
+
+bool IOUringSocketChannel::ReceiveOperation::Complete(int result,
+                                                      uint32_t flags) {
+  if (channel_ != NULL) {
+    channel_->OnReceive(result, flags);
+  } else if (flags & IORING_CQE_F_BUFFER) {
+    // Received after the channel was closed.
+    io_uring_->ReturnBuffer(flags >> IORING_CQE_BUFFER_SHIFT);
+  }
+  return false;
+}
+
+IOUringSocketChannel::SendOperation::SendOperation(
+    IOUringSocketChannel* channel,
+    const std::vector<boost::asio::const_buffer>& buffers,
+    ReadWriteHandler handler)
+    : channel_(channel),
+      handler_(handler),
+      first_iovec_(0),
+      bytes_written_(0) {
+  iovecs_.reserve(buffers.size());
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    iovec entry;
+    entry.iov_base = const_cast<void*>(
+        boost::asio::buffer_cast<const void*>(buffers[i]));
+    entry.iov_len = boost::asio::buffer_size(buffers[i]);
+    if (entry.iov_len > 0) {
+      iovecs_.push_back(entry);
+    }
+  }
+  memset(&message_, 0, sizeof(message_));
+}
+
+bool IOUringSocketChannel::SendOperation::Complete(int result,
+                                                   uint32_t flags) {
+  if (channel_ == NULL) {
+    // Closed meanwhile, the handler was already called.
+    return false;
+  }
+  return channel_->OnSend(result);
+}
+
+IOUringSocketChannel::IOUringSocketChannel(boost::asio::io_service& service,
+                                           IOUring* io_uring)
+    : service_(service),
+      io_uring_(io_uring),
+      socket_(new boost::asio::ip::tcp::socket(service)),
+      closed_(false),
+      receive_(NULL),
+      read_buffer_(0),
+      read_buffer_offset_(0),
+      bytes_read_(0),
+      send_(NULL) {}
+
+IOUringSocketChannel::~IOUringSocketChannel() {
+  close();
+  delete socket_;
+}
+
+void IOUringSocketChannel::async_connect(
+    const boost::asio::ip::tcp::endpoint& peer_endpoint,
+    ConnectHandler handler) {
+  socket_->async_connect(peer_endpoint, handler);
+}
+
+void IOUringSocketChannel::async_read(
+    const std::vector<boost::asio::mutable_buffer>& buffers,
+    ReadWriteHandler handler) {
+  assert(read_handler_.empty());
+  if (closed_) {
+    service_.post(boost::bind(handler,
+                              boost::asio::error::bad_descriptor,
+                              0));
+    return;
+  }
+  read_buffers_ = buffers;
+  read_buffer_ = 0;
+  read_buffer_offset_ = 0;
+  bytes_read_ = 0;
+  read_handler_ = handler;
+  // Like boost::asio, never call the handler from here.
+  ContinueRead(true);
+}
+
+void IOUringSocketChannel::async_read(
+    const boost::asio::mutable_buffers_1& buffer,
+    ReadWriteHandler handler) {
+  async_read(vector<boost::asio::mutable_buffer>(1, buffer), handler);
+}
+
+void IOUringSocketChannel::async_write(
+    const std::vector<boost::asio::const_buffer> & buffers,
+    ReadWriteHandler handler) {
+  assert(send_ == NULL);
+  if (closed_) {
+    service_.post(boost::bind(handler,
+                              boost::asio::error::bad_descriptor,
+                              0));
+    return;
+  }
+  send_ = new SendOperation(this, buffers, handler);
+  if (send_->iovecs_.empty()) {
+    delete send_;
+    send_ = NULL;
+    service_.post(boost::bind(handler, boost::system::error_code(), 0));
+  } else if (!Send()) {
+    delete send_;
+    send_ = NULL;
+    service_.post(boost::bind(handler,
+                              boost::asio::error::no_buffer_space,
+                              0));
+  }
+}
+
+void IOUringSocketChannel::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+
+  // The kernel keeps the socket open as long as operations are pending.
+  IOUring::Operation* operations[] = { receive_, send_ };
+  for (size_t i = 0; i < 2; ++i) {
+    if (operations[i] == NULL) {
+      continue;
+    }
+    io_uring_sqe* sqe = io_uring_->GetSQE();
+    if (sqe != NULL) {
+      sqe->opcode = IORING_OP_ASYNC_CANCEL;
+      sqe->fd = -1;
+      sqe->addr = reinterpret_cast<uintptr_t>(operations[i]);
+    }
+  }
+  boost::system::error_code ignored_error;
+  socket_->shutdown(boost::asio::ip::tcp::socket::shutdown_both,
+                    ignored_error);
+  // Queued entries refer to the descriptor which may be reused after the
+  // close.
+  io_uring_->Submit();
+  socket_->close(ignored_error);
+
+  if (receive_ != NULL) {
+    receive_->channel_ = NULL;
+    receive_ = NULL;
+  }
+  for (deque<ReceivedData>::const_iterator it = received_.begin();
+       it != received_.end();
+       ++it) {
+    io_uring_->ReturnBuffer(it->buffer_id);
+  }
+  received_.clear();
+
+  // Like boost::asio, abort the pending operations.
+  if (!read_handler_.empty()) {
+    service_.post(boost::bind(read_handler_,
+                              boost::asio::error::operation_aborted,
+                              bytes_read_));
+    read_handler_.clear();
+  }
+  if (send_ != NULL) {
+    service_.post(boost::bind(send_->handler_,
+                              boost::asio::error::operation_aborted,
+                              send_->bytes_written_));
+    send_->channel_ = NULL;
+    send_ = NULL;
+  }
+}
+
+bool IOUringSocketChannel::Receive() {
+  if (receive_ != NULL) {
+    return true;
+  }
+  receive_ = new ReceiveOperation(this, io_uring_);
+  io_uring_sqe* sqe = io_uring_->GetSQE(receive_);
+  if (sqe == NULL) {
+    delete receive_;
+    receive_ = NULL;
+    return false;
+  }
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = socket_->native_handle();
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = io_uring_->buffer_group();
+  if (io_uring_->multishot_receive()) {
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+  }
+  return true;
+}
+
+void IOUringSocketChannel::OnReceive(int result, uint32_t flags) {
+  if ((flags & IORING_CQE_F_MORE) == 0) {
+    // Deleted by the ring.
+    receive_ = NULL;
+  }
+  if (flags & IORING_CQE_F_BUFFER) {
+    const uint16_t buffer_id = flags >> IORING_CQE_BUFFER_SHIFT;
+    if (result > 0) {
+      received_.push_back(ReceivedData(buffer_id, result));
+    } else {
+      io_uring_->ReturnBuffer(buffer_id);
+    }
+  }
+
+  if (result == 0) {
+    receive_error_ = boost::asio::error::eof;
+  } else if (result == -ENOBUFS) {
+    // All buffers hold data which was not read yet. The receive is
+    // submitted again by the next read.
+  } else if (result == -EINVAL && io_uring_->multishot_receive()) {
+    if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+      Logging::log->getLog(LEVEL_DEBUG) << "io_uring does not support"
+          " multishot receives, receiving once per read." << endl;
+    }
+    io_uring_->DisableMultishotReceive();
+  } else if (result < 0) {
+    receive_error_ = boost::system::error_code(
+        -result, boost::asio::error::get_system_category());
+  }
+
+  if (!read_handler_.empty()) {
+    ContinueRead(false);
+  }
+}
+
+bool IOUringSocketChannel::Send() {
+  io_uring_sqe* sqe = io_uring_->GetSQE(send_);
+  if (sqe == NULL) {
+    return false;
+  }
+  send_->message_.msg_iov = &send_->iovecs_[send_->first_iovec_];
+  send_->message_.msg_iovlen = send_->iovecs_.size() - send_->first_iovec_;
+  sqe->opcode = IORING_OP_SENDMSG;
+  sqe->fd = socket_->native_handle();
+  sqe->addr = reinterpret_cast<uintptr_t>(&send_->message_);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_NOSIGNAL;
+  return true;
+}
+
+bool IOUringSocketChannel::OnSend(int result) {
+  boost::system::error_code error;
+  if (result >= 0) {
+    send_->bytes_written_ += result;
+    size_t written = result;
+    while (written > 0) {
+      iovec& entry = send_->iovecs_[send_->first_iovec_];
+      if (written >= entry.iov_len) {
+        written -= entry.iov_len;
+        ++send_->first_iovec_;
+      } else {
+        entry.iov_base = static_cast<char*>(entry.iov_base) + written;
+        entry.iov_len -= written;
+        written = 0;
+      }
+    }
+    if (send_->first_iovec_ < send_->iovecs_.size()) {
+      // Partial write.
+      if (Send()) {
+        return true;
+      }
+      error = boost::asio::error::no_buffer_space;
+    }
+  } else {
+    error = boost::system::error_code(
+        -result, boost::asio::error::get_system_category());
+  }
+
+  // The operation is deleted by the ring after the handler returned.
+  const size_t bytes_written = send_->bytes_written_;
+  ReadWriteHandler handler = send_->handler_;
+  send_ = NULL;
+  handler(error, bytes_written);
+  return false;
+}
+
+void IOUringSocketChannel::ContinueRead(bool post_handler) {
+  while (read_buffer_ < read_buffers_.size()) {
+    const boost::asio::mutable_buffer& target = read_buffers_[read_buffer_];
+    const size_t space
+        = boost::asio::buffer_size(target) - read_buffer_offset_;
+    if (space == 0) {
+      ++read_buffer_;
+      read_buffer_offset_ = 0;
+      continue;
+    }
+    if (received_.empty()) {
+      break;
+    }
+
+    ReceivedData& data = received_.front();
+    const size_t length = min(space, data.length);
+    memcpy(boost::asio::buffer_cast<char*>(target) + read_buffer_offset_,
+           io_uring_->buffer(data.buffer_id) + data.offset,
+           length);
+    read_buffer_offset_ += length;
+    bytes_read_ += length;
+    data.offset += length;
+    data.length -= length;
+    if (data.length == 0) {
+      io_uring_->ReturnBuffer(data.buffer_id);
+      received_.pop_front();
+    }
+  }
+
+  boost::system::error_code error;
+  if (read_buffer_ < read_buffers_.size()) {
+    if (!receive_error_) {
+      if (Receive()) {
+        return;
+      }
+      error = boost::asio::error::no_buffer_space;
+    } else {
+      error = receive_error_;
+    }
+  }
+
+  ReadWriteHandler handler;
+  handler.swap(read_handler_);
+  if (post_handler) {
+    service_.post(boost::bind(handler, error, bytes_read_));
+  } else {
+    handler(error, bytes_read_);
+  }
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_IO_URING
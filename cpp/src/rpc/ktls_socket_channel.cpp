@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifdef HAS_OPENSSL
+
+#include "rpc/ktls_socket_channel.h"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/ssl.h>
+#include <stdint.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef HAS_KTLS
+#include <linux/tls.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif  // !SOL_TLS
+#endif  // HAS_KTLS
+
+#include "rpc/transport_profile.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+namespace rpc {
+
+#if defined(HAS_KTLS) && (OPENSSL_VERSION_NUMBER >= 0x10101000L)
+/** Length of the implicit part of the AES-GCM nonce. */
+static const size_t kSaltLength = 4;
+
+/** Length of the explicit part of the AES-GCM nonce. */
+static const size_t kExplicitIVLength = 8;
+
+/** Keys of one direction of a connection in the layout of the kernel. */
+struct KernelTLSKeys {
+  KernelTLSKeys() : sequence_number(0) {
+    memset(salt, 0, sizeof(salt));
+    memset(iv, 0, sizeof(iv));
+  }
+
+  ~KernelTLSKeys() {
+    if (!key.empty()) {
+      OPENSSL_cleanse(&key[0], key.size());
+    }
+    OPENSSL_cleanse(salt, sizeof(salt));
+  }
+
+  std::vector<unsigned char> key;
+  unsigned char salt[kSaltLength];
+  unsigned char iv[kExplicitIVLength];
+  /** Sequence number of the next record. */
+  uint64_t sequence_number;
+};
+
+/** Derives both directions' keys from the master secret of the session
+ *  (RFC 5246, Section 6.3 and RFC 5288, Section 3). */
+static bool DeriveTLS12Keys(SSL* ssl,
+                            const EVP_MD* digest,
+                            size_t key_length,
+                            KernelTLSKeys* tx,
+                            KernelTLSKeys* rx) {
+  unsigned char master_key[SSL_MAX_MASTER_KEY_LENGTH];
+  const size_t master_key_length = SSL_SESSION_get_master_key(
+      SSL_get_session(ssl), master_key, sizeof(master_key));
+  unsigned char client_random[SSL3_RANDOM_SIZE];
+  unsigned char server_random[SSL3_RANDOM_SIZE];
+  SSL_get_client_random(ssl, client_random, sizeof(client_random));
+  SSL_get_server_random(ssl, server_random, sizeof(server_random));
+
+  // client key, server key, client salt, server salt. AEAD ciphers have no
+  // MAC keys.
+  vector<unsigned char> key_block(2 * key_length + 2 * kSaltLength);
+  size_t key_block_length = key_block.size();
+  static const char kLabel[] = "key expansion";
+  EVP_PKEY_CTX* context = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, NULL);
+  const bool result = context != NULL
+      && master_key_length > 0
+      && EVP_PKEY_derive_init(context) > 0
+      && EVP_PKEY_CTX_set_tls1_prf_md(context, digest) > 0
+      && EVP_PKEY_CTX_set1_tls1_prf_secret(
+             context, master_key, static_cast<int>(master_key_length)) > 0
+      && EVP_PKEY_CTX_add1_tls1_prf_seed(
+             context,
+             reinterpret_cast<const unsigned char*>(kLabel),
+             static_cast<int>(sizeof(kLabel) - 1)) > 0
+      && EVP_PKEY_CTX_add1_tls1_prf_seed(
+             context, server_random, sizeof(server_random)) > 0
+      && EVP_PKEY_CTX_add1_tls1_prf_seed(
+             context, client_random, sizeof(client_random)) > 0
+      && EVP_PKEY_derive(context, &key_block[0], &key_block_length) > 0;
+  EVP_PKEY_CTX_free(context);
+  OPENSSL_cleanse(master_key, sizeof(master_key));
+  if (result) {
+    tx->key.assign(key_block.begin(), key_block.begin() + key_length);
+    rx->key.assign(key_block.begin() + key_length,
+                   key_block.begin() + 2 * key_length);
+    memcpy(tx->salt, &key_block[2 * key_length], kSaltLength);
+    memcpy(rx->salt, &key_block[2 * key_length + kSaltLength], kSaltLength);
+    // Both Finished messages were the first records with these keys.
+    tx->sequence_number = 1;
+    rx->sequence_number = 1;
+    // The explicit nonce only has to be unique, it is sent with the record.
+    for (size_t i = 0; i < kExplicitIVLength; ++i) {
+      tx->iv[i] = static_cast<unsigned char>(
+          tx->sequence_number >> (8 * (kExplicitIVLength - 1 - i)));
+    }
+  }
+  OPENSSL_cleanse(&key_block[0], key_block.size());
+  return result;
+}
+
+template <class CryptoInfo>
+static bool SetCryptoInfo(int fd,
+                          int direction,
+                          uint16_t version,
+                          uint16_t cipher_type,
+                          const KernelTLSKeys& keys) {
+  CryptoInfo info;
+  memset(&info, 0, sizeof(info));
+  info.info.version = version;
+  info.info.cipher_type = cipher_type;
+  memcpy(info.key, &keys.key[0], sizeof(info.key));
+  memcpy(info.salt, keys.salt, sizeof(info.salt));
+  memcpy(info.iv, keys.iv, sizeof(info.iv));
+  for (size_t i = 0; i < sizeof(info.rec_seq); ++i) {
+    info.rec_seq[i] = static_cast<unsigned char>(
+        keys.sequence_number >> (8 * (sizeof(info.rec_seq) - 1 - i)));
+  }
+  const bool result
+      = setsockopt(fd, SOL_TLS, direction, &info, sizeof(info)) == 0;
+  OPENSSL_cleanse(&info, sizeof(info));
+  return result;
+}
+
+/** Hands "keys" of "direction" (TLS_TX or TLS_RX) to the kernel. */
+static bool SetKernelKeys(int fd,
+                          int direction,
+                          uint16_t version,
+                          const KernelTLSKeys& keys) {
+  if (keys.key.size() == TLS_CIPHER_AES_GCM_128_KEY_SIZE) {
+    return SetCryptoInfo<tls12_crypto_info_aes_gcm_128>(
+        fd, direction, version, TLS_CIPHER_AES_GCM_128, keys);
+  } else {
+    return SetCryptoInfo<tls12_crypto_info_aes_gcm_256>(
+        fd, direction, version, TLS_CIPHER_AES_GCM_256, keys);
+  }
+}
+#endif  // HAS_KTLS && OPENSSL_VERSION_NUMBER >= 0x10101000L
+
+KTLSSocketChannel::KTLSSocketChannel(boost::asio::io_service& service,
+                                     boost::asio::ssl::context& context,
+                                     SSLSessionCache* session_cache,
+                                     const std::string& address)
+    : SSLSocketChannel(service, context, session_cache, address),
+      kernel_tx_(false),
+      kernel_rx_(false) {
+}
+
+KTLSSocketChannel::~KTLSSocketChannel() {
+}
+
+void KTLSSocketChannel::PostHandshake() {
+  string reason;
+  if (EnableKernelTLS(&reason)) {
+    if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+      Logging::log->getLog(LEVEL_DEBUG) << "The kernel encrypts and decrypts"
+          " the records of the connection to " << address() << "." << endl;
+    }
+  } else if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG) << "Not using kernel TLS"
+        << (kernel_rx_ ? " for sending" : "") << " on the connection to "
+        << address() << ": " << reason << endl;
+  }
+
+  if (TransportProfiles::transport_profiles) {
+    TransportProfiles::transport_profiles->RecordKernelTLS(address(),
+                                                           kernel_tx_,
+                                                           kernel_rx_);
+  }
+}
+
+bool KTLSSocketChannel::EnableKernelTLS(std::string* reason) {
+#if !defined(HAS_KTLS) || (OPENSSL_VERSION_NUMBER < 0x10101000L)
+  *reason = "not supported by this build";
+  return false;
+#else
+  SSL* ssl = native_ssl();
+  // With TLS 1.3, OpenSSL would still write KeyUpdate and alert records
+  // after the handshake, which the kernel's records would not account for.
+  if (SSL_version(ssl) != TLS1_2_VERSION) {
+    *reason = string("the protocol ") + SSL_get_version(ssl)
+        + " is not supported";
+    return false;
+  }
+  const SSL_CIPHER* cipher = SSL_get_current_cipher(ssl);
+  size_t key_length;
+  switch (SSL_CIPHER_get_cipher_nid(cipher)) {
+    case NID_aes_128_gcm:
+      key_length = TLS_CIPHER_AES_GCM_128_KEY_SIZE;
+      break;
+    case NID_aes_256_gcm:
+      key_length = TLS_CIPHER_AES_GCM_256_KEY_SIZE;
+      break;
+    default:
+      *reason = string("the cipher ") + SSL_CIPHER_get_name(cipher)
+          + " is not supported";
+      return false;
+  }
+  const EVP_MD* digest = SSL_CIPHER_get_handshake_digest(cipher);
+
+  KernelTLSKeys tx;
+  KernelTLSKeys rx;
+  if (!DeriveTLS12Keys(ssl, digest, key_length, &tx, &rx)) {
+    *reason = "the keys could not be derived";
+    return false;
+  }
+
+  // Records which OpenSSL already read have to be decrypted by OpenSSL.
+  if (SSL_pending(ssl) != 0) {
+    *reason = "OpenSSL already received application data";
+    return false;
+  }
+  const int fd = lowest_layer().native_handle();
+  if (setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0) {
+    *reason = string("the kernel does not support TLS: ") + strerror(errno);
+    return false;
+  }
+  // Without keys, the "tls" ULP passes the data through unchanged. Receiving
+  // is offloaded first: OpenSSL would answer a renegotiation request it read
+  // with records the kernel does not know about.
+  if (!SetKernelKeys(fd, TLS_RX, TLS_1_2_VERSION, rx)) {
+    *reason = string("the kernel rejected the keys: ") + strerror(errno);
+    return false;
+  }
+  kernel_rx_ = true;
+  if (!SetKernelKeys(fd, TLS_TX, TLS_1_2_VERSION, tx)) {
+    *reason = string("the kernel rejected the keys: ") + strerror(errno);
+    return false;
+  }
+  kernel_tx_ = true;
+  return true;
+#endif  // !HAS_KTLS || OPENSSL_VERSION_NUMBER < 0x10101000L
+}
+
+void KTLSSocketChannel::async_read(
+    const std::vector<boost::asio::mutable_buffer>& buffers,
+    ReadWriteHandler handler) {
+  if (kernel_rx_) {
+    boost::asio::async_read(ssl_stream_.next_layer(), buffers, handler);
+  } else {
+    SSLSocketChannel::async_read(buffers, handler);
+  }
+}
+
+void KTLSSocketChannel::async_read(
+    const boost::asio::mutable_buffers_1& buffer,
+    ReadWriteHandler handler) {
+  if (kernel_rx_) {
+    boost::asio::async_read(ssl_stream_.next_layer(), buffer, handler);
+  } else {
+    SSLSocketChannel::async_read(buffer, handler);
+  }
+}
+
+void KTLSSocketChannel::async_write(
+    const std::vector<boost::asio::const_buffer> & buffers,
+    ReadWriteHandler handler) {
+  if (kernel_tx_) {
+    boost::asio::async_write(ssl_stream_.next_layer(), buffers, handler);
+  } else {
+    SSLSocketChannel::async_write(buffers, handler);
+  }
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_OPENSSL
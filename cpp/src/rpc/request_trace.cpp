@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "rpc/request_trace.h"
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace xtreemfs {
+namespace rpc {
+
+namespace {
+
+/** Escapes characters which are not allowed inside a JSON string. */
+string EscapeJSONString(const string& input) {
+  string result;
+  result.reserve(input.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    const char c = input[i];
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      result += ' ';
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+}  // anonymous namespace
+
+RequestTrace::RequestTrace(size_t max_events)
+    : init_count_(1),
+      events_(max_events > 0 ? max_events : 1),
+      next_(0),
+      count_(0) {}
+
+void RequestTrace::Record(RequestTraceEventType type,
+                          uint32_t call_id,
+                          uint32_t proc_id,
+                          const std::string& server) {
+  RequestTraceEvent event;
+  event.timestamp_us = Now();
+  event.type = type;
+  event.call_id = call_id;
+  event.proc_id = proc_id;
+  event.server = server;
+  Record(event);
+}
+
+void RequestTrace::Record(const RequestTraceEvent& event) {
+  boost::mutex::scoped_lock lock(events_mutex_);
+  events_[next_] = event;
+  next_ = (next_ + 1) % events_.size();
+  if (count_ < events_.size()) {
+    ++count_;
+  }
+}
+
+std::vector<RequestTraceEvent> RequestTrace::events() {
+  boost::mutex::scoped_lock lock(events_mutex_);
+  vector<RequestTraceEvent> result;
+  result.reserve(count_);
+  size_t oldest = (next_ + events_.size() - count_) % events_.size();
+  for (size_t i = 0; i < count_; ++i) {
+    result.push_back(events_[(oldest + i) % events_.size()]);
+  }
+  return result;
+}
+
+void RequestTrace::DumpAsJSONLines(std::ostream* out) {
+  vector<RequestTraceEvent> copy = events();
+  for (size_t i = 0; i < copy.size(); ++i) {
+    const RequestTraceEvent& event = copy[i];
+    *out << "{\"ts_us\":" << event.timestamp_us
+         << ",\"event\":\"" << EventTypeToString(event.type) << "\""
+         << ",\"call_id\":" << event.call_id
+         << ",\"proc_id\":" << event.proc_id
+         << ",\"server\":\"" << EscapeJSONString(event.server) << "\"";
+    if (event.type == kTraceRetryDelay) {
+      *out << ",\"duration_us\":" << event.duration_us;
+    }
+    *out << "}\n";
+  }
+}
+
+void RequestTrace::DumpAsChromeTrace(std::ostream* out) {
+  vector<RequestTraceEvent> copy = events();
+  *out << "{\"traceEvents\":[";
+  for (size_t i = 0; i < copy.size(); ++i) {
+    const RequestTraceEvent& event = copy[i];
+    if (i > 0) {
+      *out << ",";
+    }
+    *out << "\n{\"name\":\"" << EventTypeToString(event.type) << "\"";
+    if (event.type == kTraceRetryDelay) {
+      // Complete event: starts at timestamp and lasts duration_us.
+      *out << ",\"ph\":\"X\",\"ts\":" << event.timestamp_us
+           << ",\"dur\":" << event.duration_us;
+    } else {
+      *out << ",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << event.timestamp_us;
+    }
+    *out << ",\"pid\":1,\"tid\":" << event.call_id
+         << ",\"args\":{\"proc_id\":" << event.proc_id
+         << ",\"server\":\"" << EscapeJSONString(event.server) << "\"}}";
+  }
+  *out << "\n]}\n";
+}
+
+int64_t RequestTrace::Now() {
+  static const boost::posix_time::ptime kEpoch(
+      boost::gregorian::date(1970, 1, 1));
+  return (boost::posix_time::microsec_clock::universal_time() - kEpoch)
+      .total_microseconds();
+}
+
+const char* RequestTrace::EventTypeToString(RequestTraceEventType type) {
+  switch (type) {
+    case kTraceEnqueued:
+      return "enqueued";
+    case kTraceDequeued:
+      return "dequeued";
+    case kTraceConnectStart:
+      return "connect_start";
+    case kTraceConnected:
+      return "connected";
+    case kTraceWriteStart:
+      return "write_start";
+    case kTraceWriteFinished:
+      return "write_finished";
+    case kTraceFirstResponseByte:
+      return "first_response_byte";
+    case kTraceCallbackDispatched:
+      return "callback_dispatched";
+    case kTraceRetryDelay:
+      return "retry_delay";
+  }
+  return "unknown";
+}
+
+void initialize_request_trace(size_t max_events) {
+  // Do not initialize the trace multiple times.
+  if (RequestTrace::request_trace) {
+    RequestTrace::request_trace->register_init();
+    return;
+  }
+
+  RequestTrace::request_trace = new RequestTrace(max_events);
+}
+
+void shutdown_request_trace() {
+  // Delete the trace only if no instance is left.
+  if (RequestTrace::request_trace
+      && RequestTrace::request_trace->register_shutdown()) {
+    delete RequestTrace::request_trace;
+    RequestTrace::request_trace = NULL;
+  }
+}
+
+RequestTrace* RequestTrace::request_trace = NULL;
+
+}  // namespace rpc
+}  // namespace xtreemfs
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifdef HAS_OPENSSL
+
+#include "rpc/ssl_session_cache.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/once.hpp>
+#include <map>
+#include <string>
+
+#include "rpc/transport_profile.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+namespace rpc {
+
+int SSLSessionCache::binding_index_ = -1;
+
+static boost::once_flag binding_index_once = BOOST_ONCE_INIT;
+
+static void CreateBindingIndex(int* index) {
+  *index = SSL_get_ex_new_index(0, NULL, NULL, NULL, NULL);
+}
+
+SSLSessionCache::SSLSessionCache() {
+  boost::call_once(binding_index_once,
+                   boost::bind(&CreateBindingIndex, &binding_index_));
+}
+
+SSLSessionCache::~SSLSessionCache() {
+  for (map<string, SSL_SESSION*>::iterator it = sessions_.begin();
+       it != sessions_.end();
+       ++it) {
+    SSL_SESSION_free(it->second);
+  }
+}
+
+void SSLSessionCache::Attach(SSL_CTX* context) {
+  SSL_CTX_set_session_cache_mode(
+      context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(context, &SSLSessionCache::NewSessionCallback);
+}
+
+void SSLSessionCache::StartHandshake(SSL* ssl,
+                                     Binding* binding,
+                                     const std::string& address) {
+  binding->cache = this;
+  binding->address = address;
+  binding->handshake_started_at
+      = boost::posix_time::microsec_clock::local_time();
+  SSL_set_ex_data(ssl, binding_index_, binding);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  map<string, SSL_SESSION*>::const_iterator it = sessions_.find(address);
+  if (it != sessions_.end()) {
+    // Takes its own reference.
+    SSL_set_session(ssl, it->second);
+  }
+}
+
+void SSLSessionCache::FinishHandshake(SSL* ssl,
+                                      Binding* binding,
+                                      const boost::system::error_code& error) {
+  if (error) {
+    // The server may have dropped the session or changed its certificate.
+    Remove(binding->address);
+    return;
+  }
+
+  const bool resumed = SSL_session_reused(ssl) == 1;
+  if (Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG) << "TLS session to "
+        << binding->address << (resumed ? " resumed." : " negotiated.")
+        << endl;
+  }
+  if (TransportProfiles::transport_profiles) {
+    TransportProfiles::transport_profiles->RecordTLSHandshake(
+        binding->address,
+        (boost::posix_time::microsec_clock::local_time()
+            - binding->handshake_started_at).total_microseconds(),
+        resumed);
+  }
+}
+
+void SSLSessionCache::Remove(const std::string& address) {
+  boost::mutex::scoped_lock lock(mutex_);
+  map<string, SSL_SESSION*>::iterator it = sessions_.find(address);
+  if (it != sessions_.end()) {
+    SSL_SESSION_free(it->second);
+    sessions_.erase(it);
+  }
+}
+
+size_t SSLSessionCache::size() {
+  boost::mutex::scoped_lock lock(mutex_);
+  return sessions_.size();
+}
+
+int SSLSessionCache::NewSessionCallback(SSL* ssl, SSL_SESSION* session) {
+  Binding* binding = static_cast<Binding*>(
+      SSL_get_ex_data(ssl, binding_index_));
+  if (binding == NULL || binding->cache == NULL) {
+    // Not a connection of an rpc::Client, let OpenSSL free the session.
+    return 0;
+  }
+  binding->cache->Put(binding->address, session);
+  return 1;
+}
+
+void SSLSessionCache::Put(const std::string& address, SSL_SESSION* session) {
+  boost::mutex::scoped_lock lock(mutex_);
+  SSL_SESSION*& cached = sessions_[address];
+  if (cached != NULL) {
+    SSL_SESSION_free(cached);
+  }
+  cached = session;
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_OPENSSL
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "rpc/submission_queue.h"
+
+#include <algorithm>
+
+#include "rpc/client_request.h"
+
+namespace xtreemfs {
+namespace rpc {
+
+SubmissionQueue::SubmissionQueue() : head_(NULL) {}
+
+ClientRequest* SubmissionQueue::closed_marker() {
+  // Never dereferenced, only its address is compared.
+  static char marker;
+  return reinterpret_cast<ClientRequest*>(&marker);
+}
+
+bool SubmissionQueue::Push(ClientRequest* request, bool* was_empty) {
+  ClientRequest* head = head_.load(boost::memory_order_relaxed);
+  do {
+    if (head == closed_marker()) {
+      return false;
+    }
+    request->set_next_submitted(head);
+  } while (!head_.compare_exchange_weak(head,
+                                        request,
+                                        boost::memory_order_release,
+                                        boost::memory_order_relaxed));
+  *was_empty = head == NULL;
+  return true;
+}
+
+void SubmissionQueue::PopAll(std::vector<ClientRequest*>* requests) {
+  // Only Close() sets the marker, it does not run concurrently.
+  ClientRequest* head = head_.load(boost::memory_order_relaxed);
+  if (head == NULL || head == closed_marker()) {
+    return;
+  }
+  AppendReversed(head_.exchange(NULL, boost::memory_order_acquire), requests);
+}
+
+void SubmissionQueue::Close(std::vector<ClientRequest*>* requests) {
+  ClientRequest* head
+      = head_.exchange(closed_marker(), boost::memory_order_acquire);
+  if (head != closed_marker()) {
+    AppendReversed(head, requests);
+  }
+}
+
+void SubmissionQueue::AppendReversed(ClientRequest* head,
+                                     std::vector<ClientRequest*>* requests) {
+  const size_t first = requests->size();
+  for (ClientRequest* request = head; request != NULL;) {
+    ClientRequest* next = request->next_submitted();
+    request->set_next_submitted(NULL);
+    requests->push_back(request);
+    request = next;
+  }
+  std::reverse(requests->begin() + first, requests->end());
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
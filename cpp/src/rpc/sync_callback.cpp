@@ -64,6 +64,11 @@ xtreemfs::pbrpc::RPCHeader::ErrorResponse* SyncCallbackBase::error() {
   return request_->resp_message();
 }
 
+uint32_t SyncCallbackBase::call_id() {
+  WaitForResponse();
+  return request_->call_id();
+}
+
 void SyncCallbackBase::DeleteBuffers() {
   if (request_) {
     request_->clear_error();
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "rpc/timer_wheel.h"
+
+#include <algorithm>
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Number of ticks covered by the whole wheel. */
+static const uint64_t kWheelTicks
+    = static_cast<uint64_t>(1) << (TimerWheel::kSlotBits * TimerWheel::kLevels);
+
+TimerWheel::TimerWheel(uint64_t current_tick)
+    : current_tick_(current_tick),
+      size_(0) {
+  for (int level = 0; level < kLevels; ++level) {
+    for (size_t index = 0; index < kSlots; ++index) {
+      Timer* sentinel = &slots_[level][index];
+      sentinel->prev_ = sentinel;
+      sentinel->next_ = sentinel;
+    }
+  }
+}
+
+void TimerWheel::Schedule(Timer* timer, uint64_t expires_at_tick) {
+  if (timer->IsScheduled()) {
+    Unlink(timer);
+  } else {
+    ++size_;
+  }
+  timer->expires_at_tick_ = expires_at_tick;
+  // The slot of current_tick_ was already processed.
+  Place(timer, current_tick_ + 1);
+}
+
+void TimerWheel::Cancel(Timer* timer) {
+  if (timer->IsScheduled()) {
+    Unlink(timer);
+    --size_;
+  }
+}
+
+void TimerWheel::Advance(uint64_t tick, std::vector<Timer*>* expired) {
+  if (size_ == 0) {
+    current_tick_ = std::max(current_tick_, tick);
+    return;
+  }
+
+  while (current_tick_ < tick) {
+    ++current_tick_;
+
+    // Move the timers of every upper slot which starts now one level down.
+    for (int level = 1; level < kLevels; ++level) {
+      const int shift = kSlotBits * level;
+      if ((current_tick_ & ((static_cast<uint64_t>(1) << shift) - 1)) != 0) {
+        break;
+      }
+      Cascade(level, (current_tick_ >> shift) & (kSlots - 1));
+    }
+
+    Timer* sentinel = &slots_[0][current_tick_ & (kSlots - 1)];
+    while (sentinel->next_ != sentinel) {
+      Timer* timer = sentinel->next_;
+      Unlink(timer);
+      if (timer->expires_at_tick_ <= current_tick_) {
+        --size_;
+        expired->push_back(timer);
+      } else {
+        // Was beyond the end of the wheel when it was scheduled.
+        Place(timer, current_tick_ + 1);
+      }
+    }
+
+    if (size_ == 0) {
+      current_tick_ = tick;
+    }
+  }
+}
+
+void TimerWheel::Place(Timer* timer, uint64_t min_tick) {
+  uint64_t tick = std::max(timer->expires_at_tick_, min_tick);
+  if (tick - current_tick_ >= kWheelTicks) {
+    tick = current_tick_ + kWheelTicks - 1;
+  }
+  const uint64_t delta = tick - current_tick_;
+
+  int level = 0;
+  while (level < kLevels - 1
+         && delta >= (static_cast<uint64_t>(1) << (kSlotBits * (level + 1)))) {
+    ++level;
+  }
+
+  Timer* sentinel
+      = &slots_[level][(tick >> (kSlotBits * level)) & (kSlots - 1)];
+  timer->prev_ = sentinel->prev_;
+  timer->next_ = sentinel;
+  sentinel->prev_->next_ = timer;
+  sentinel->prev_ = timer;
+}
+
+void TimerWheel::Cascade(int level, size_t index) {
+  Timer* sentinel = &slots_[level][index];
+  if (sentinel->next_ == sentinel) {
+    return;
+  }
+
+  // Detach the list first, a timer may be placed into the same slot again.
+  Timer* first = sentinel->next_;
+  Timer* last = sentinel->prev_;
+  sentinel->next_ = sentinel;
+  sentinel->prev_ = sentinel;
+  last->next_ = NULL;
+
+  for (Timer* timer = first; timer != NULL;) {
+    Timer* next = timer->next_;
+    Place(timer, current_tick_);
+    timer = next;
+  }
+}
+
+void TimerWheel::Unlink(Timer* timer) {
+  timer->prev_->next_ = timer->next_;
+  timer->next_->prev_ = timer->prev_;
+  timer->prev_ = NULL;
+  timer->next_ = NULL;
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include "rpc/transport_profile.h"
+
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#ifndef WIN32
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif  // !WIN32
+
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Lower bound of auto-sized buffers, i.e., the usual OS default. */
+static const int kMinAutoBufferBytes = 64 * 1024;
+
+/** Upper bound of auto-sized buffers. The OS may cap them further (e.g.,
+ *  net.core.rmem_max on Linux). */
+static const int kMaxAutoBufferBytes = 32 * 1024 * 1024;
+
+TransportProfile::TransportProfile()
+    : tcp_no_delay(false),
+      keep_alive_idle_s(0),
+      busy_poll_us(0),
+      buffer_bytes(0),
+      link_bandwidth_mbit(0) {}
+
+AppliedTransportProfile::AppliedTransportProfile()
+    : rtt_us(0),
+      tcp_no_delay(-1),
+      keep_alive(-1),
+      send_buffer_bytes(-1),
+      receive_buffer_bytes(-1),
+      connections(0),
+      tls_handshakes(0),
+      tls_resumed_handshakes(0),
+      tls_handshake_us(0),
+      tls_handshake_total_us(0),
+      kernel_tls_tx(-1),
+      kernel_tls_rx(-1) {}
+
+TransportProfiles::TransportProfiles(const TransportProfile& default_profile)
+    : init_count_(1),
+      default_profile_(default_profile) {}
+
+bool TransportProfiles::ParseProfile(const std::string& entry,
+                                     const TransportProfile& base,
+                                     std::string* address,
+                                     TransportProfile* profile,
+                                     std::string* error) {
+  vector<string> fields;
+  boost::split(fields, entry, boost::is_any_of(","));
+  if (fields[0].empty()) {
+    *error = "The address is missing.";
+    return false;
+  }
+  *address = fields[0];
+  *profile = base;
+
+  for (size_t i = 1; i < fields.size(); ++i) {
+    const size_t separator = fields[i].find('=');
+    if (separator == string::npos) {
+      *error = "Expected <key>=<value> instead of '" + fields[i] + "'.";
+      return false;
+    }
+    const string key = fields[i].substr(0, separator);
+    int value;
+    try {
+      value = boost::lexical_cast<int>(fields[i].substr(separator + 1));
+    } catch (const boost::bad_lexical_cast&) {
+      *error = "The value of '" + key + "' is not a number.";
+      return false;
+    }
+    if (value < 0) {
+      *error = "The value of '" + key + "' must not be negative.";
+      return false;
+    }
+
+    if (key == "nodelay") {
+      profile->tcp_no_delay = value != 0;
+    } else if (key == "keepalive-s") {
+      profile->keep_alive_idle_s = value;
+    } else if (key == "busy-poll-us") {
+      profile->busy_poll_us = value;
+    } else if (key == "buffer-kb") {
+      if (value > kMaxAutoBufferBytes / 1024) {
+        *error = "The buffer size must not exceed "
+            + boost::lexical_cast<string>(kMaxAutoBufferBytes / 1024) + " kB.";
+        return false;
+      }
+      profile->buffer_bytes = value * 1024;
+    } else if (key == "bandwidth-mbit") {
+      profile->link_bandwidth_mbit = value;
+    } else {
+      *error = "Unknown key '" + key + "'.";
+      return false;
+    }
+  }
+  return true;
+}
+
+void TransportProfiles::SetProfile(const std::string& address,
+                                   const TransportProfile& profile) {
+  boost::mutex::scoped_lock lock(mutex_);
+  profiles_[address] = profile;
+}
+
+void TransportProfiles::UpdateRTT(const std::string& address, int64_t rtt_us) {
+  if (rtt_us <= 0) {
+    return;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  map<string, int64_t>::iterator it = rtts_us_.find(address);
+  if (it == rtts_us_.end()) {
+    rtts_us_[address] = rtt_us;
+  } else {
+    // Same smoothing as TCP's SRTT (RFC 6298).
+    it->second = (7 * it->second + rtt_us) / 8;
+  }
+}
+
+TransportProfile TransportProfiles::GetProfile(const std::string& address,
+                                               int64_t* rtt_us) {
+  boost::mutex::scoped_lock lock(mutex_);
+  map<string, TransportProfile>::const_iterator profile
+      = profiles_.find(address);
+  if (profile == profiles_.end()) {
+    profile = profiles_.find(address.substr(0, address.rfind(':')));
+  }
+  TransportProfile result
+      = profile != profiles_.end() ? profile->second : default_profile_;
+
+  map<string, int64_t>::const_iterator rtt = rtts_us_.find(address);
+  *rtt_us = rtt != rtts_us_.end() ? rtt->second : 0;
+
+  if (result.buffer_bytes == 0
+      && result.link_bandwidth_mbit > 0
+      && *rtt_us > 0) {
+    result.buffer_bytes = AutoBufferBytes(result.link_bandwidth_mbit, *rtt_us);
+  }
+  return result;
+}
+
+int TransportProfiles::AutoBufferBytes(int link_bandwidth_mbit,
+                                       int64_t rtt_us) {
+  // Mbit/s * us / 8 = bytes in flight. Twice that, as the OS keeps part of
+  // the buffer for its own bookkeeping and the window has to cover bursts.
+  const int64_t bytes
+      = 2 * static_cast<int64_t>(link_bandwidth_mbit) * rtt_us / 8;
+  return static_cast<int>(std::max(
+      static_cast<int64_t>(kMinAutoBufferBytes),
+      std::min(static_cast<int64_t>(kMaxAutoBufferBytes), bytes)));
+}
+
+void TransportProfiles::Apply(
+    const std::string& address,
+    boost::asio::ip::tcp::socket::lowest_layer_type& socket) {
+  using boost::asio::ip::tcp;
+
+#ifdef TCP_INFO
+  {
+    // The TCP handshake is a first RTT sample of servers Vivaldi did not ping
+    // yet.
+    boost::mutex::scoped_lock lock(mutex_);
+    if (rtts_us_.find(address) == rtts_us_.end()) {
+      struct tcp_info info;
+      socklen_t length = sizeof(info);
+      if (getsockopt(socket.native_handle(), IPPROTO_TCP, TCP_INFO,
+                     &info, &length) == 0 && info.tcpi_rtt > 0) {
+        rtts_us_[address] = info.tcpi_rtt;
+      }
+    }
+  }
+#endif  // TCP_INFO
+
+  AppliedTransportProfile applied;
+  applied.address = address;
+  applied.requested = GetProfile(address, &applied.rtt_us);
+  const TransportProfile& profile = applied.requested;
+
+  boost::system::error_code error;
+  socket.set_option(tcp::no_delay(profile.tcp_no_delay), error);
+  if (error) {
+    applied.failed_options += " nodelay";
+  }
+
+  socket.set_option(boost::asio::socket_base::keep_alive(
+                        profile.keep_alive_idle_s > 0),
+                    error);
+  if (error) {
+    applied.failed_options += " keepalive";
+  }
+#ifdef TCP_KEEPIDLE
+  if (profile.keep_alive_idle_s > 0) {
+    const int idle_s = profile.keep_alive_idle_s;
+    if (setsockopt(socket.native_handle(), IPPROTO_TCP, TCP_KEEPIDLE,
+                   &idle_s, sizeof(idle_s)) != 0) {
+      applied.failed_options += " keepalive-s";
+    }
+  }
+#endif  // TCP_KEEPIDLE
+
+  if (profile.busy_poll_us > 0) {
+#ifdef SO_BUSY_POLL
+    // Values above net.core.busy_read require CAP_NET_ADMIN.
+    const int busy_poll_us = profile.busy_poll_us;
+    if (setsockopt(socket.native_handle(), SOL_SOCKET, SO_BUSY_POLL,
+                   &busy_poll_us, sizeof(busy_poll_us)) != 0) {
+      applied.failed_options += " busy-poll-us";
+    }
+#else
+    applied.failed_options += " busy-poll-us";
+#endif  // SO_BUSY_POLL
+  }
+
+  // Setting a size disables the autotuning of the OS for this socket.
+  if (profile.buffer_bytes > 0) {
+    socket.set_option(
+        boost::asio::socket_base::send_buffer_size(profile.buffer_bytes),
+        error);
+    if (error) {
+      applied.failed_options += " send-buffer";
+    }
+    socket.set_option(
+        boost::asio::socket_base::receive_buffer_size(profile.buffer_bytes),
+        error);
+    if (error) {
+      applied.failed_options += " receive-buffer";
+    }
+  }
+  boost::algorithm::trim(applied.failed_options);
+
+  tcp::no_delay no_delay;
+  socket.get_option(no_delay, error);
+  if (!error) {
+    applied.tcp_no_delay = no_delay.value() ? 1 : 0;
+  }
+  boost::asio::socket_base::keep_alive keep_alive;
+  socket.get_option(keep_alive, error);
+  if (!error) {
+    applied.keep_alive = keep_alive.value() ? 1 : 0;
+  }
+  boost::asio::socket_base::send_buffer_size send_buffer_size;
+  socket.get_option(send_buffer_size, error);
+  if (!error) {
+    applied.send_buffer_bytes = send_buffer_size.value();
+  }
+  boost::asio::socket_base::receive_buffer_size receive_buffer_size;
+  socket.get_option(receive_buffer_size, error);
+  if (!error) {
+    applied.receive_buffer_bytes = receive_buffer_size.value();
+  }
+
+  if (!applied.failed_options.empty()
+      && Logging::log->loggingActive(LEVEL_DEBUG)) {
+    Logging::log->getLog(LEVEL_DEBUG) << "Could not set the socket options '"
+        << applied.failed_options << "' of the connection to: " << address
+        << endl;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  AppliedTransportProfile& previous = applied_[address];
+  // The TLS handshake of this connection was already recorded.
+  applied.connections = previous.connections + 1;
+  applied.tls_handshakes = previous.tls_handshakes;
+  applied.tls_resumed_handshakes = previous.tls_resumed_handshakes;
+  applied.tls_handshake_us = previous.tls_handshake_us;
+  applied.tls_handshake_total_us = previous.tls_handshake_total_us;
+  applied.kernel_tls_tx = previous.kernel_tls_tx;
+  applied.kernel_tls_rx = previous.kernel_tls_rx;
+  previous = applied;
+}
+
+void TransportProfiles::RecordTLSHandshake(const std::string& address,
+                                           int64_t duration_us,
+                                           bool resumed) {
+  boost::mutex::scoped_lock lock(mutex_);
+  AppliedTransportProfile& applied = applied_[address];
+  applied.address = address;
+  ++applied.tls_handshakes;
+  if (resumed) {
+    ++applied.tls_resumed_handshakes;
+  }
+  applied.tls_handshake_us = duration_us;
+  applied.tls_handshake_total_us += duration_us;
+}
+
+void TransportProfiles::RecordKernelTLS(const std::string& address,
+                                        bool tx,
+                                        bool rx) {
+  boost::mutex::scoped_lock lock(mutex_);
+  AppliedTransportProfile& applied = applied_[address];
+  applied.address = address;
+  applied.kernel_tls_tx = tx ? 1 : 0;
+  applied.kernel_tls_rx = rx ? 1 : 0;
+}
+
+std::vector<AppliedTransportProfile> TransportProfiles::applied() {
+  boost::mutex::scoped_lock lock(mutex_);
+  vector<AppliedTransportProfile> result;
+  for (map<string, AppliedTransportProfile>::const_iterator it
+           = applied_.begin();
+       it != applied_.end();
+       ++it) {
+    result.push_back(it->second);
+  }
+  return result;
+}
+
+void initialize_transport_profiles(const TransportProfile& default_profile) {
+  // Do not initialize the profiles multiple times.
+  if (TransportProfiles::transport_profiles) {
+    TransportProfiles::transport_profiles->register_init();
+    return;
+  }
+
+  TransportProfiles::transport_profiles
+      = new TransportProfiles(default_profile);
+}
+
+void shutdown_transport_profiles() {
+  // Delete the profiles only if no instance is left.
+  if (TransportProfiles::transport_profiles
+      && TransportProfiles::transport_profiles->register_shutdown()) {
+    delete TransportProfiles::transport_profiles;
+    TransportProfiles::transport_profiles = NULL;
+  }
+}
+
+TransportProfiles* TransportProfiles::transport_profiles = NULL;
+
+}  // namespace rpc
+}  // namespace xtreemfs
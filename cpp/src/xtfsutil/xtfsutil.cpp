@@ -635,6 +635,71 @@ bool ShowErrors(const string& xctl_file,
   }
 }
 
+// Prints the RPC request trace of the client.
+bool ShowRPCTrace(const string& xctl_file,
+                  const string& path,
+                  const variables_map& vm) {
+  Json::Value request(Json::objectValue);
+  request["operation"] = "getRPCTrace";
+  request["format"] = vm["rpc-trace"].as<string>();
+
+  Json::Value response;
+  if (executeOperation(xctl_file, request, &response)) {
+    cout << response["result"].asString();
+    return true;
+  } else {
+    cerr << "Showing RPC trace FAILED" << endl;
+    return false;
+  }
+}
+
+// Prints the socket options of the client's connections.
+bool ShowTransportProfiles(const string& xctl_file,
+                           const string& path,
+                           const variables_map& vm) {
+  Json::Value request(Json::objectValue);
+  request["operation"] = "getTransportProfiles";
+
+  Json::Value response;
+  if (executeOperation(xctl_file, request, &response)) {
+    const Json::Value& servers = response["result"];
+    for (Json::ArrayIndex i = 0; i < servers.size(); ++i) {
+      const Json::Value& server = servers[i];
+      const Json::Value& socket = server["socket"];
+      cout << server["address"].asString()
+           << "  connections: " << server["connections"].asInt()
+           << "  rtt: " << server["rtt_us"].asInt() << " us"
+           << "  nodelay: " << socket["nodelay"].asInt()
+           << "  keepalive: " << socket["keepalive"].asInt()
+           << "  busy poll: " << server["requested"]["busy_poll_us"].asInt()
+           << " us"
+           << "  send buffer: " << socket["send_buffer_bytes"].asInt()
+           << "  receive buffer: " << socket["receive_buffer_bytes"].asInt();
+      if (!server["failed_options"].asString().empty()) {
+        cout << "  failed: " << server["failed_options"].asString();
+      }
+      const Json::Value& tls = server["tls"];
+      if (tls["handshakes"].asInt() > 0) {
+        cout << "  TLS handshakes: " << tls["handshakes"].asInt()
+             << " (resumed: " << tls["resumed_handshakes"].asInt()
+             << ", last: " << tls["last_handshake_us"].asInt()
+             << " us, average: " << tls["average_handshake_us"].asInt()
+             << " us)";
+      }
+      if (tls["kernel_tx"].asInt() >= 0) {
+        cout << "  kernel TLS: "
+             << (tls["kernel_tx"].asInt() == 1 ? "tx" : "off")
+             << (tls["kernel_rx"].asInt() == 1 ? "+rx" : "");
+      }
+      cout << endl;
+    }
+    return true;
+  } else {
+    cerr << "Showing transport profiles FAILED" << endl;
+    return false;
+  }
+}
+
 // Returns a list of OSDs suitable for a new replica.
 bool GetSuitableOSDs(const string& xctl_file,
                      const string& path,
@@ -1028,6 +1093,12 @@ int main(int argc, char **argv) {
       ("help,h", "produce help message")
       ("version,V", "Show the version number.")
       ("errors", "show client errors for a volume")
+      ("rpc-trace", value<string>()->implicit_value("chrome"),
+       "dump the RPC request trace of the client (format: chrome or jsonl,"
+       " requires mount option --rpc-trace-buffer-size)")
+      ("transport-profiles",
+       "show the socket options and TLS handshakes of the client's connections"
+       " to every server")
       ("set-dsp", "set (change) the default striping policy (volume)")
       ("striping-policy,p",
        value<string>()->implicit_value("RAID0"),
@@ -1280,6 +1351,14 @@ int main(int argc, char **argv) {
     ++operationsCount;
     failedOperationsCount += ShowErrors(xctl_file, path_on_volume, vm) ? 0 : 1;
   }
+  if (vm.count("rpc-trace") > 0) {
+    ++operationsCount;
+    failedOperationsCount += ShowRPCTrace(xctl_file, path_on_volume, vm) ? 0 : 1;
+  }
+  if (vm.count("transport-profiles") > 0) {
+    ++operationsCount;
+    failedOperationsCount += ShowTransportProfiles(xctl_file, path_on_volume, vm) ? 0 : 1;
+  }
   if (vm.count("set-quota") > 0) {
     ++operationsCount;
 	failedOperationsCount += SetVolumeQuota(xctl_file, path_on_volume, vm) ? 0 : 1;
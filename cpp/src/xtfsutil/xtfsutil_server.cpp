@@ -14,6 +14,7 @@
 #include <cassert>
 #include <errno.h>
 #include <list>
+#include <sstream>
 #ifndef WIN32
 #include <sys/fcntl.h>
 #endif  // !WIN32
@@ -23,6 +24,8 @@
 #include "libxtreemfs/volume.h"
 #include "libxtreemfs/xtreemfs_exception.h"
 #include "libxtreemfs/helper.h"
+#include "rpc/request_trace.h"
+#include "rpc/transport_profile.h"
 #include "util/error_log.h"
 #include "util/logging.h"
 
@@ -82,6 +85,10 @@ void XtfsUtilServer::ParseAndExecute(const xtreemfs::pbrpc::UserCredentials& uc,
   try {
     if (op_name == "getErrors") {
       OpGetErrors(uc, input, &result);
+    } else if (op_name == "getRPCTrace") {
+      OpGetRPCTrace(uc, input, &result);
+    } else if (op_name == "getTransportProfiles") {
+      OpGetTransportProfiles(uc, input, &result);
     } else if (op_name == "getattr") {
       OpStat(uc, input, &result);
     } else if (op_name == "setDefaultSP") {
@@ -141,6 +148,81 @@ void XtfsUtilServer::OpGetErrors(const xtreemfs::pbrpc::UserCredentials& uc,
   (*output)["result"] = result;
 }
 
+void XtfsUtilServer::OpGetRPCTrace(
+    const xtreemfs::pbrpc::UserCredentials& uc,
+    const Json::Value& input,
+    Json::Value* output) {
+  if (rpc::RequestTrace::request_trace == NULL) {
+    (*output)["error"] = Json::Value("RPC tracing is not enabled. Mount the"
+                                     " volume with --rpc-trace-buffer-size.");
+    return;
+  }
+
+  ostringstream trace;
+  if (input.isMember("format")
+      && input["format"].isString()
+      && input["format"].asString() == "jsonl") {
+    rpc::RequestTrace::request_trace->DumpAsJSONLines(&trace);
+  } else {
+    rpc::RequestTrace::request_trace->DumpAsChromeTrace(&trace);
+  }
+  (*output)["result"] = Json::Value(trace.str());
+}
+
+void XtfsUtilServer::OpGetTransportProfiles(
+    const xtreemfs::pbrpc::UserCredentials& uc,
+    const Json::Value& input,
+    Json::Value* output) {
+  Json::Value result(Json::arrayValue);
+  if (rpc::TransportProfiles::transport_profiles) {
+    const vector<rpc::AppliedTransportProfile> applied
+        = rpc::TransportProfiles::transport_profiles->applied();
+    for (size_t i = 0; i < applied.size(); ++i) {
+      Json::Value server(Json::objectValue);
+      server["address"] = Json::Value(applied[i].address);
+      server["connections"] = Json::Value(applied[i].connections);
+      server["rtt_us"] = Json::Value(static_cast<int>(applied[i].rtt_us));
+
+      Json::Value requested(Json::objectValue);
+      requested["nodelay"] = Json::Value(applied[i].requested.tcp_no_delay);
+      requested["keepalive_s"]
+          = Json::Value(applied[i].requested.keep_alive_idle_s);
+      requested["busy_poll_us"]
+          = Json::Value(applied[i].requested.busy_poll_us);
+      requested["buffer_bytes"]
+          = Json::Value(applied[i].requested.buffer_bytes);
+      requested["bandwidth_mbit"]
+          = Json::Value(applied[i].requested.link_bandwidth_mbit);
+      server["requested"] = requested;
+
+      Json::Value socket(Json::objectValue);
+      socket["nodelay"] = Json::Value(applied[i].tcp_no_delay);
+      socket["keepalive"] = Json::Value(applied[i].keep_alive);
+      socket["send_buffer_bytes"] = Json::Value(applied[i].send_buffer_bytes);
+      socket["receive_buffer_bytes"]
+          = Json::Value(applied[i].receive_buffer_bytes);
+      server["socket"] = socket;
+      server["failed_options"] = Json::Value(applied[i].failed_options);
+
+      Json::Value tls(Json::objectValue);
+      tls["handshakes"] = Json::Value(applied[i].tls_handshakes);
+      tls["resumed_handshakes"]
+          = Json::Value(applied[i].tls_resumed_handshakes);
+      tls["last_handshake_us"]
+          = Json::Value(static_cast<int>(applied[i].tls_handshake_us));
+      tls["average_handshake_us"] = Json::Value(static_cast<int>(
+          applied[i].tls_handshakes > 0
+              ? applied[i].tls_handshake_total_us / applied[i].tls_handshakes
+              : 0));
+      tls["kernel_tx"] = Json::Value(applied[i].kernel_tls_tx);
+      tls["kernel_rx"] = Json::Value(applied[i].kernel_tls_rx);
+      server["tls"] = tls;
+      result.append(server);
+    }
+  }
+  (*output)["result"] = result;
+}
+
 void XtfsUtilServer::OpStat(const xtreemfs::pbrpc::UserCredentials& uc,
                             const Json::Value& input,
                             Json::Value* output) {
@@ -80,7 +80,7 @@ bool TestEnvironment::Start() {
   client.reset(Client::CreateClient(
       options.service_addresses,
       user_credentials,
-      NULL,  // No SSL options.
+      options.GenerateSSLOptions(),  // NULL unless SSL is configured.
       options));
 
   // Start the client (a connection to the DIR service will be setup).
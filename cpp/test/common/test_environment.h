@@ -29,7 +29,7 @@ class Client;
  *  run unit tests.
  *
  *  Modify options accordingly before executing Start() to influence
- *  the client.
+ *  the client. For SSL, also call EnableSSL() of the servers.
  */
 class TestEnvironment {
  public:
@@ -15,6 +15,9 @@
 #endif  // !WIN32
 
 #include <boost/asio.hpp>
+#ifdef HAS_OPENSSL
+#include <boost/asio/ssl.hpp>
+#endif  // HAS_OPENSSL
 #include <boost/bind.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/lexical_cast.hpp>
@@ -176,6 +179,23 @@ template <class Derived> class TestRPCServer {
     RemovePointlessDropRules(lock);
   }
 
+#ifdef HAS_OPENSSL
+  /** Accepts SSL connections only, which present the PEM certificate chain
+   *  "cert_file" with the private key "key_file". Call before Start(). */
+  void EnableSSL(const std::string& cert_file, const std::string& key_file) {
+    ssl_context_.reset(new boost::asio::ssl::context(
+        boost::asio::ssl::context::sslv23_server));
+    ssl_context_->set_options(boost::asio::ssl::context::no_sslv2);
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L)
+    // The test certificates have 1024 bit keys.
+    SSL_CTX_set_security_level(ssl_context_->native_handle(), 0);
+#endif  // OPENSSL_VERSION_NUMBER >= 0x10100000L
+    ssl_context_->use_certificate_chain_file(cert_file);
+    ssl_context_->use_private_key_file(key_file,
+                                       boost::asio::ssl::context::pem);
+  }
+#endif  // HAS_OPENSSL
+
   /** The connection will be shut down once after this call. */
   void DropConnection() {
     boost::mutex::scoped_lock lock(drop_connection_mutex_);
@@ -320,235 +340,269 @@ template <class Derived> class TestRPCServer {
       std::string remote_address =
           sock->remote_endpoint().address().to_string() + ":"
           + boost::lexical_cast<std::string>(sock->remote_endpoint().port());
-      boost::scoped_array<char> record_marker_buffer(
-          new char[xtreemfs::rpc::RecordMarker::get_size()]);
-      boost::scoped_array<char> header_buffer;
-      boost::scoped_array<char> message_buffer;
-      boost::scoped_array<char> data_buffer;
-
-      if (Logging::log->loggingActive(xtreemfs::util::LEVEL_DEBUG)) {
-        Logging::log->getLog(xtreemfs::util::LEVEL_DEBUG)
-          << "New client connection from: " << remote_address << std::endl;
+#ifdef HAS_OPENSSL
+      if (ssl_context_.get()) {
+        boost::asio::ssl::stream<boost::asio::ip::tcp::socket&> ssl_sock(
+            *sock, *ssl_context_);
+        ssl_sock.handshake(boost::asio::ssl::stream_base::server);
+        ProcessRequests(&ssl_sock, remote_address);
+      } else {
+        ProcessRequests(sock.get(), remote_address);
       }
-
-      for (;;) {
-        if (boost::this_thread::interruption_requested()) {
-          if (Logging::log->loggingActive(xtreemfs::util::LEVEL_DEBUG)) {
-            Logging::log->getLog(xtreemfs::util::LEVEL_DEBUG)
-              << "Received interrupt, aborting test server connection to: "
-              << remote_address << std::endl;
-          }
-          break;
+#else
+      ProcessRequests(sock.get(), remote_address);
+#endif  // HAS_OPENSSL
+    } catch (const boost::system::system_error& e) {
+      if (e.code() != boost::asio::error::eof) {
+        if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
+          Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
+              << "Exception in thread: " << e.what() << std::endl;
         }
+      }
+    }
+    {
+      boost::mutex::scoped_lock lock(active_sessions_mutex_);
+      active_sessions_.erase(boost::this_thread::get_id());
+      active_sessions_socks_.erase(boost::this_thread::get_id());
+    }
+  }
 
-        size_t length = 0;
-        boost::scoped_ptr<xtreemfs::rpc::RecordMarker> request_rm;
-        try {
-          // Read record marker.
-          length = boost::asio::read(
-              *sock,
-              boost::asio::buffer(record_marker_buffer.get(),
-              xtreemfs::rpc::RecordMarker::get_size()));
-          if (length < xtreemfs::rpc::RecordMarker::get_size()) {
-            if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
-              Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
-                  << "Read invalid record marker from: "
-                  << remote_address << std::endl;
-            }
-            break;
-          }
-          request_rm.reset(
-              new xtreemfs::rpc::RecordMarker(record_marker_buffer.get()));
+  /** Reads requests from "stream" and answers them until the connection is
+   *  closed or the session is interrupted. */
+  template <class Stream>
+  void ProcessRequests(Stream* stream, const std::string& remote_address) {
+    using xtreemfs::util::Logging;
 
-          // Read header, message and data.
-          std::vector<boost::asio::mutable_buffer> bufs;
-          header_buffer.reset(new char[request_rm->header_len()]);
-          bufs.push_back(
-              boost::asio::buffer(reinterpret_cast<void*>(header_buffer.get()),
-              request_rm->header_len()));
-          if (request_rm->message_len() > 0) {
-            message_buffer.reset(new char[request_rm->message_len()]);
-            bufs.push_back(
-                boost::asio::buffer(
-                    reinterpret_cast<void*>(message_buffer.get()),
-                request_rm->message_len()));
-          } else {
-            if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
-              Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
-                  << "Received a request with an empty message from: "
-                  << remote_address << std::endl;
-            }
-            break;
-          }
-          if (request_rm->data_len() > 0) {
-            data_buffer.reset(new char[request_rm->data_len()]);
-            bufs.push_back(
-                boost::asio::buffer(reinterpret_cast<void*>(data_buffer.get()),
-                request_rm->data_len()));
-          } else {
-            data_buffer.reset(NULL);
-          }
+    boost::scoped_array<char> record_marker_buffer(
+        new char[xtreemfs::rpc::RecordMarker::get_size()]);
+    boost::scoped_array<char> header_buffer;
+    boost::scoped_array<char> message_buffer;
+    boost::scoped_array<char> data_buffer;
 
-          length = boost::asio::read(*sock, bufs);
+    if (Logging::log->loggingActive(xtreemfs::util::LEVEL_DEBUG)) {
+      Logging::log->getLog(xtreemfs::util::LEVEL_DEBUG)
+        << "New client connection from: " << remote_address << std::endl;
+    }
 
-          if (length != (request_rm->header_len()
-                         + request_rm->message_len()
-                         + request_rm->data_len())) {
-            if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
-              Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
-                << "Failed to read a complete request from: "
-                << remote_address << std::endl;
-            }
-            break;
-          }
-        } catch (const boost::system::error_code& error) {
-          if (error == boost::asio::error::eof) {
-            break;  // Connection closed cleanly by peer.
-          } else {
-            throw;
-          }
+    for (;;) {
+      if (boost::this_thread::interruption_requested()) {
+        if (Logging::log->loggingActive(xtreemfs::util::LEVEL_DEBUG)) {
+          Logging::log->getLog(xtreemfs::util::LEVEL_DEBUG)
+            << "Received interrupt, aborting test server connection to: "
+            << remote_address << std::endl;
         }
+        break;
+      }
 
-        // Parse header and message.
-        xtreemfs::pbrpc::RPCHeader request_rpc_header;
-        if (!request_rpc_header.ParseFromArray(
-                reinterpret_cast<void*>(header_buffer.get()),
-                request_rm->header_len())) {
+      size_t length = 0;
+      boost::scoped_ptr<xtreemfs::rpc::RecordMarker> request_rm;
+      try {
+        // Read record marker.
+        length = boost::asio::read(
+            *stream,
+            boost::asio::buffer(record_marker_buffer.get(),
+            xtreemfs::rpc::RecordMarker::get_size()));
+        if (length < xtreemfs::rpc::RecordMarker::get_size()) {
           if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
             Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
-                << "Failed to parse request header received from: "
+                << "Read invalid record marker from: "
                 << remote_address << std::endl;
           }
           break;
         }
-
-        uint32_t interface_id
-            = request_rpc_header.request_header().interface_id();
-        uint32_t proc_id = request_rpc_header.request_header().proc_id();
-        if (interface_id != interface_id_) {
+        request_rm.reset(
+            new xtreemfs::rpc::RecordMarker(record_marker_buffer.get()));
+
+        // Read header, message and data.
+        std::vector<boost::asio::mutable_buffer> bufs;
+        header_buffer.reset(new char[request_rm->header_len()]);
+        bufs.push_back(
+            boost::asio::buffer(reinterpret_cast<void*>(header_buffer.get()),
+            request_rm->header_len()));
+        if (request_rm->message_len() > 0) {
+          message_buffer.reset(new char[request_rm->message_len()]);
+          bufs.push_back(
+              boost::asio::buffer(
+                  reinterpret_cast<void*>(message_buffer.get()),
+              request_rm->message_len()));
+        } else {
           if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
             Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
-                << "Received a message which was not intended for this service"
-                   " with interface id: " << interface_id_ << " (Message from"
-                   " = " << remote_address
-                << " (interface id = " << interface_id << ", proc id = "
-                << proc_id << ")" << std::endl;
+                << "Received a request with an empty message from: "
+                << remote_address << std::endl;
           }
           break;
         }
+        if (request_rm->data_len() > 0) {
+          data_buffer.reset(new char[request_rm->data_len()]);
+          bufs.push_back(
+              boost::asio::buffer(reinterpret_cast<void*>(data_buffer.get()),
+              request_rm->data_len()));
+        } else {
+          data_buffer.reset(NULL);
+        }
 
-        boost::scoped_ptr<google::protobuf::Message> request_message(
-            xtreemfs::pbrpc::GetMessageForProcID(interface_id, proc_id));
-        if (!request_message.get()) {
+        length = boost::asio::read(*stream, bufs);
+
+        if (length != (request_rm->header_len()
+                       + request_rm->message_len()
+                       + request_rm->data_len())) {
           if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
             Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
-                << "Failed to find a suitable request message type for message"
-                    " received from: " << remote_address << " (interface id = "
-                << interface_id
-                << ", proc id = " << proc_id << ")" << std::endl;
+              << "Failed to read a complete request from: "
+              << remote_address << std::endl;
           }
           break;
         }
-
-        if (!request_message->ParseFromArray(
-                reinterpret_cast<void*>(message_buffer.get()),
-                request_rm->message_len())) {
-          if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
-            Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
-                << "Failed to parse request message received from: "
-                << remote_address << std::endl;
-            break;
-          }
+      } catch (const boost::system::error_code& error) {
+        if (error == boost::asio::error::eof) {
+          break;  // Connection closed cleanly by peer.
+        } else {
+          throw;
         }
+      }
 
-        // Check if the request should be dropped.
-        if (CheckIfRequestShallBeDropped(proc_id)) {
-          continue;
+      // Parse header and message.
+      xtreemfs::pbrpc::RPCHeader request_rpc_header;
+      if (!request_rpc_header.ParseFromArray(
+              reinterpret_cast<void*>(header_buffer.get()),
+              request_rm->header_len())) {
+        if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
+          Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
+              << "Failed to parse request header received from: "
+              << remote_address << std::endl;
         }
+        break;
+      }
 
-        // Process request.
-        boost::scoped_array<char> response_data;
-        uint32_t response_data_len = 0;
-        boost::scoped_ptr<google::protobuf::Message> response_message(
-            ExecuteOperation(proc_id,
-                request_rpc_header.request_header().auth_data(),
-                request_rpc_header.request_header().user_creds(),
-                *request_message,
-                data_buffer.get(),
-                request_rm->data_len(),
-                &response_data,
-                &response_data_len));
-        if (!response_message.get()) {
-          Logging::log->getLog(xtreemfs::util::LEVEL_ERROR)
-              << "No response was generated. Operation with proc id = "
-              << proc_id << " is probably not implemented? (interface_id = "
-              << interface_id_ << ")" << std::endl;
-          break;
-        }
-        if (!response_message->IsInitialized()) {
-          Logging::log->getLog(xtreemfs::util::LEVEL_ERROR)
-              << "Response message is not valid."
-                 " Not all required fields have been initialized: "
-              << response_message->InitializationErrorString() << std::endl;
-          break;
+      uint32_t interface_id
+          = request_rpc_header.request_header().interface_id();
+      uint32_t proc_id = request_rpc_header.request_header().proc_id();
+      if (interface_id != interface_id_) {
+        if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
+          Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
+              << "Received a message which was not intended for this service"
+                 " with interface id: " << interface_id_ << " (Message from"
+                 " = " << remote_address
+              << " (interface id = " << interface_id << ", proc id = "
+              << proc_id << ")" << std::endl;
         }
+        break;
+      }
 
-        // Send response.
-        xtreemfs::pbrpc::RPCHeader response_header(request_rpc_header);
-        xtreemfs::rpc::RecordMarker response_rm(
-            response_header.ByteSize(),
-            response_message->ByteSize(),
-            response_data_len);
-
-        size_t response_bytes_size = xtreemfs::rpc::RecordMarker::get_size()
-                                     + response_rm.header_len()
-                                     + response_rm.message_len()
-                                     + response_rm.data_len();
-        boost::scoped_array<char> response_bytes(new char[response_bytes_size]);
-        char* response = response_bytes.get();
-        response_rm.serialize(response);
-        response += xtreemfs::rpc::RecordMarker::get_size();
-
-        response_header.CheckInitialized();
-        if (!response_header.SerializeToArray(response, response_rm.header_len())) {
-            Logging::log->getLog(xtreemfs::util::LEVEL_ERROR)
-                << "Failed to serialize header" << std::endl;
-            break;
+      boost::scoped_ptr<google::protobuf::Message> request_message(
+          xtreemfs::pbrpc::GetMessageForProcID(interface_id, proc_id));
+      if (!request_message.get()) {
+        if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
+          Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
+              << "Failed to find a suitable request message type for message"
+                  " received from: " << remote_address << " (interface id = "
+              << interface_id
+              << ", proc id = " << proc_id << ")" << std::endl;
         }
-        response += response_rm.header_len();
+        break;
+      }
 
-        response_message->CheckInitialized();
-        if (!response_message->SerializeToArray(response, response_rm.message_len())) {
-            Logging::log->getLog(xtreemfs::util::LEVEL_ERROR)
-                << "Failed to serialize message" << std::endl;
-            break;
+      if (!request_message->ParseFromArray(
+              reinterpret_cast<void*>(message_buffer.get()),
+              request_rm->message_len())) {
+        if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
+          Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
+              << "Failed to parse request message received from: "
+              << remote_address << std::endl;
+          break;
         }
+      }
 
-        response += response_rm.message_len();
+      // Check if the request should be dropped.
+      if (CheckIfRequestShallBeDropped(proc_id)) {
+        continue;
+      }
 
-        if (response_data.get() != NULL) {
-          memcpy(response, response_data.get(), response_data_len);
-        }
+      // Process request.
+      boost::scoped_array<char> response_data;
+      uint32_t response_data_len = 0;
+      boost::scoped_ptr<google::protobuf::Message> response_message(
+          ExecuteOperation(proc_id,
+              request_rpc_header.request_header().auth_data(),
+              request_rpc_header.request_header().user_creds(),
+              *request_message,
+              data_buffer.get(),
+              request_rm->data_len(),
+              &response_data,
+              &response_data_len));
+      if (!response_message.get()) {
+        Logging::log->getLog(xtreemfs::util::LEVEL_ERROR)
+            << "No response was generated. Operation with proc id = "
+            << proc_id << " is probably not implemented? (interface_id = "
+            << interface_id_ << ")" << std::endl;
+        break;
+      }
+      // Operations answer with an error by returning an ErrorResponse.
+      boost::scoped_ptr<xtreemfs::pbrpc::RPCHeader::ErrorResponse>
+          error_response;
+      if (response_message->GetDescriptor()
+          == xtreemfs::pbrpc::RPCHeader::ErrorResponse::descriptor()) {
+        error_response.reset(new xtreemfs::pbrpc::RPCHeader::ErrorResponse(
+            static_cast<const xtreemfs::pbrpc::RPCHeader::ErrorResponse&>(
+                *response_message)));
+        // Nothing follows the header of an error response.
+        response_message.reset(new xtreemfs::pbrpc::emptyResponse());
+      }
+      if (!response_message->IsInitialized()) {
+        Logging::log->getLog(xtreemfs::util::LEVEL_ERROR)
+            << "Response message is not valid."
+               " Not all required fields have been initialized: "
+            << response_message->InitializationErrorString() << std::endl;
+        break;
+      }
 
-        std::vector<boost::asio::mutable_buffer> write_bufs;
-        write_bufs.push_back(
-            boost::asio::buffer(reinterpret_cast<void*>(response_bytes.get()),
-            response_bytes_size));
+      // Send response.
+      xtreemfs::pbrpc::RPCHeader response_header(request_rpc_header);
+      if (error_response.get()) {
+        response_header.mutable_error_response()->Swap(error_response.get());
+      }
+      xtreemfs::rpc::RecordMarker response_rm(
+          response_header.ByteSize(),
+          response_message->ByteSize(),
+          response_data_len);
+
+      size_t response_bytes_size = xtreemfs::rpc::RecordMarker::get_size()
+                                   + response_rm.header_len()
+                                   + response_rm.message_len()
+                                   + response_rm.data_len();
+      boost::scoped_array<char> response_bytes(new char[response_bytes_size]);
+      char* response = response_bytes.get();
+      response_rm.serialize(response);
+      response += xtreemfs::rpc::RecordMarker::get_size();
+
+      response_header.CheckInitialized();
+      if (!response_header.SerializeToArray(response, response_rm.header_len())) {
+          Logging::log->getLog(xtreemfs::util::LEVEL_ERROR)
+              << "Failed to serialize header" << std::endl;
+          break;
+      }
+      response += response_rm.header_len();
 
-        boost::asio::write(*sock, write_bufs);
+      response_message->CheckInitialized();
+      if (!response_message->SerializeToArray(response, response_rm.message_len())) {
+          Logging::log->getLog(xtreemfs::util::LEVEL_ERROR)
+              << "Failed to serialize message" << std::endl;
+          break;
       }
-    } catch (const boost::system::system_error& e) {
-      if (e.code() != boost::asio::error::eof) {
-        if (Logging::log->loggingActive(xtreemfs::util::LEVEL_WARN)) {
-          Logging::log->getLog(xtreemfs::util::LEVEL_WARN)
-              << "Exception in thread: " << e.what() << std::endl;
-        }
+
+      response += response_rm.message_len();
+
+      if (response_data.get() != NULL) {
+        memcpy(response, response_data.get(), response_data_len);
       }
-    }
-    {
-      boost::mutex::scoped_lock lock(active_sessions_mutex_);
-      active_sessions_.erase(boost::this_thread::get_id());
-      active_sessions_socks_.erase(boost::this_thread::get_id());
+
+      std::vector<boost::asio::mutable_buffer> write_bufs;
+      write_bufs.push_back(
+          boost::asio::buffer(reinterpret_cast<void*>(response_bytes.get()),
+          response_bytes_size));
+
+      boost::asio::write(*stream, write_bufs);
     }
   }
 
@@ -571,6 +625,11 @@ template <class Derived> class TestRPCServer {
 
   boost::scoped_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
 
+#ifdef HAS_OPENSSL
+  /** Set by EnableSSL(), NULL for plain TCP connections. */
+  boost::scoped_ptr<boost::asio::ssl::context> ssl_context_;
+#endif  // HAS_OPENSSL
+
   /** Drop rules for incoming requests. */
   std::list<DropRule*> drop_rules_;
 
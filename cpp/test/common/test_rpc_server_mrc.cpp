@@ -11,6 +11,7 @@
 #include "xtreemfs/MRCServiceConstants.h"
 
 #include <ctime>
+#include <sstream>
 
 using namespace std;
 using namespace xtreemfs::pbrpc;
@@ -18,7 +19,8 @@ using namespace xtreemfs::pbrpc;
 namespace xtreemfs {
 namespace rpc {
 
-TestRPCServerMRC::TestRPCServerMRC() : file_size_(1024 * 1024) {
+TestRPCServerMRC::TestRPCServerMRC()
+    : file_size_(1024 * 1024), received_opens_(0) {
   interface_id_ = INTERFACE_ID_MRC;
   // Register available operations.
   operations_[PROC_ID_OPEN] = Op(this, &TestRPCServerMRC::OpenOperation);
@@ -39,6 +41,15 @@ google::protobuf::Message* TestRPCServerMRC::OpenOperation(
     boost::scoped_array<char>* response_data,
     uint32_t* response_data_len) {
   const openRequest* rq = reinterpret_cast<const openRequest*>(&request);
+  boost::mutex::scoped_lock lock(mutex_);
+  ++received_opens_;
+
+  map<string, uint64_t>::iterator file_id = file_ids_.find(rq->path());
+  if (file_id == file_ids_.end()) {
+    file_id = file_ids_.insert(make_pair(rq->path(), file_ids_.size())).first;
+  }
+  ostringstream global_file_id;
+  global_file_id << rq->volume_name() << ":" << file_id->second;
 
   openResponse* response = new openResponse();
 
@@ -47,7 +58,7 @@ google::protobuf::Message* TestRPCServerMRC::OpenOperation(
   xcap->set_client_identity("client_identity");
   xcap->set_expire_time_s(3600);
   xcap->set_expire_timeout_s(static_cast<uint32_t>(time(0)) + 3600);
-  xcap->set_file_id(rq->volume_name() + ":0");
+  xcap->set_file_id(global_file_id.str());
   xcap->set_replicate_on_close(false);
   xcap->set_server_signature("signature");
   xcap->set_snap_config(SNAP_CONFIG_SNAPS_DISABLED);
@@ -104,8 +115,10 @@ google::protobuf::Message* TestRPCServerMRC::UpdateFileSizeOperation(
     uint32_t data_len,
     boost::scoped_array<char>* response_data,
     uint32_t* response_data_len) {
-  //const xtreemfs_update_file_sizeRequest* rq =
-  //    reinterpret_cast<const xtreemfs_update_file_sizeRequest*>(&request);
+  const xtreemfs_update_file_sizeRequest* rq =
+      reinterpret_cast<const xtreemfs_update_file_sizeRequest*>(&request);
+  boost::mutex::scoped_lock lock(mutex_);
+  received_file_size_updates_.push_back(*rq);
 
   timestampResponse* response = new timestampResponse();
 
@@ -132,6 +145,17 @@ google::protobuf::Message* TestRPCServerMRC::FTruncate(
 }
 
 
+size_t TestRPCServerMRC::GetReceivedOpens() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return received_opens_;
+}
+
+const std::vector<xtreemfs_update_file_sizeRequest>
+    TestRPCServerMRC::GetReceivedFileSizeUpdates() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return received_file_size_updates_;
+}
+
 void TestRPCServerMRC::SetFileSize(uint64_t size) {
   boost::mutex::scoped_lock lock(mutex_);
   file_size_ = size;
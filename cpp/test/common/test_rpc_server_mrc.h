@@ -13,6 +13,11 @@
 #include <stdint.h>
 
 #include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "xtreemfs/MRC.pb.h"
 
 namespace google {
 namespace protobuf {
@@ -30,6 +35,13 @@ class TestRPCServerMRC : public TestRPCServer<TestRPCServerMRC> {
   void SetFileSize(uint64_t size);
   void RegisterOSD(std::string uuid);
 
+  /** Returns the number of received open requests. */
+  size_t GetReceivedOpens() const;
+
+  /** Returns the received xtreemfs_update_file_size requests. */
+  const std::vector<pbrpc::xtreemfs_update_file_sizeRequest>
+      GetReceivedFileSizeUpdates() const;
+
  private:
   google::protobuf::Message* OpenOperation(
       const pbrpc::Auth& auth,
@@ -68,12 +80,20 @@ class TestRPCServerMRC : public TestRPCServer<TestRPCServerMRC> {
       uint32_t* response_data_len);
 
   /** Mutex used to protect all member variables from concurrent access. */
-  boost::mutex mutex_;
+  mutable boost::mutex mutex_;
 
   /** Default file size reported by the MRC for every file requested. */
   uint64_t file_size_;
 
   std::vector<std::string> osd_uuids_;
+
+  /** File ids of the opened paths. Every path is a different file. */
+  std::map<std::string, uint64_t> file_ids_;
+
+  size_t received_opens_;
+
+  std::vector<pbrpc::xtreemfs_update_file_sizeRequest>
+      received_file_size_updates_;
 };
 
 }  // namespace rpc
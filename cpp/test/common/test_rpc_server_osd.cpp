@@ -7,6 +7,8 @@
 
 #include "common/test_rpc_server_osd.h"
 
+#include <algorithm>
+
 #include "util/logging.h"
 #include "xtreemfs/OSD.pb.h"
 #include "xtreemfs/OSDServiceConstants.h"
@@ -20,7 +22,8 @@ namespace rpc {
 
 const int kMaxFileSize = 10 * 1024 * 1024;
 
-TestRPCServerOSD::TestRPCServerOSD() : file_size_(0) {
+TestRPCServerOSD::TestRPCServerOSD()
+    : file_size_(0), received_lock_requests_(0) {
   interface_id_ = INTERFACE_ID_OSD;
   // Register available operations.
   operations_[PROC_ID_TRUNCATE]
@@ -29,6 +32,12 @@ TestRPCServerOSD::TestRPCServerOSD() : file_size_(0) {
       = Op(this, &TestRPCServerOSD::WriteOperation);
   operations_[PROC_ID_READ]
       = Op(this, &TestRPCServerOSD::ReadOperation);
+  operations_[PROC_ID_XTREEMFS_LOCK_ACQUIRE]
+      = Op(this, &TestRPCServerOSD::LockAcquireOperation);
+  operations_[PROC_ID_XTREEMFS_LOCK_CHECK]
+      = Op(this, &TestRPCServerOSD::LockCheckOperation);
+  operations_[PROC_ID_XTREEMFS_LOCK_RELEASE]
+      = Op(this, &TestRPCServerOSD::LockReleaseOperation);
   data_.reset(new char[kMaxFileSize]);
 }
 
@@ -37,6 +46,16 @@ const std::vector<WriteEntry> TestRPCServerOSD::GetReceivedWrites() const {
   return received_writes_;
 }
 
+size_t TestRPCServerOSD::GetReceivedLockRequests() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return received_lock_requests_;
+}
+
+size_t TestRPCServerOSD::GetHeldLocks() const {
+  boost::mutex::scoped_lock lock(mutex_);
+  return locks_.size();
+}
+
 google::protobuf::Message* TestRPCServerOSD::TruncateOperation(
     const pbrpc::Auth& auth,
     const pbrpc::UserCredentials& user_credentials,
@@ -130,7 +149,7 @@ google::protobuf::Message* TestRPCServerOSD::WriteOperation(
           striping_policy().stripe_size() * 1024;
   const uint64_t offset = rq->object_number() * object_size + rq->offset();
 
-  file_size_ = offset + data_len;
+  file_size_ = std::max(file_size_, static_cast<int64_t>(offset + data_len));
   assert(file_size_ <= kMaxFileSize);
 
   memcpy(&data_[offset], data, data_len);
@@ -142,5 +161,90 @@ google::protobuf::Message* TestRPCServerOSD::WriteOperation(
   return response;
 }
 
+const pbrpc::Lock* TestRPCServerOSD::FindConflictingLock(
+    const pbrpc::Lock& lock) const {
+  for (map<LockOwner, Lock>::const_iterator it = locks_.begin();
+       it != locks_.end();
+       ++it) {
+    const Lock& held = it->second;
+    if (held.client_uuid() == lock.client_uuid()
+        && held.client_pid() == lock.client_pid()) {
+      continue;
+    }
+    if (!held.exclusive() && !lock.exclusive()) {
+      continue;
+    }
+    // A length of 0 means until the end of the file.
+    const bool held_ends_before = held.length() != 0
+        && held.offset() + held.length() <= lock.offset();
+    const bool lock_ends_before = lock.length() != 0
+        && lock.offset() + lock.length() <= held.offset();
+    if (!held_ends_before && !lock_ends_before) {
+      return &held;
+    }
+  }
+  return NULL;
+}
+
+google::protobuf::Message* TestRPCServerOSD::LockAcquireOperation(
+    const pbrpc::Auth& auth,
+    const pbrpc::UserCredentials& user_credentials,
+    const google::protobuf::Message& request,
+    const char* data,
+    uint32_t data_len,
+    boost::scoped_array<char>* response_data,
+    uint32_t* response_data_len) {
+  boost::mutex::scoped_lock lock(mutex_);
+  const lockRequest* rq = static_cast<const lockRequest*>(&request);
+  ++received_lock_requests_;
+
+  if (FindConflictingLock(rq->lock_request()) != NULL) {
+    RPCHeader::ErrorResponse* error = new RPCHeader::ErrorResponse();
+    error->set_error_type(ERRNO);
+    error->set_posix_errno(POSIX_ERROR_EAGAIN);
+    error->set_error_message("conflicting lock");
+    return error;
+  }
+
+  // A new lock replaces the lock of the same process.
+  locks_[LockOwner(rq->lock_request().client_uuid(),
+                   rq->lock_request().client_pid())] = rq->lock_request();
+  return new Lock(rq->lock_request());
+}
+
+google::protobuf::Message* TestRPCServerOSD::LockCheckOperation(
+    const pbrpc::Auth& auth,
+    const pbrpc::UserCredentials& user_credentials,
+    const google::protobuf::Message& request,
+    const char* data,
+    uint32_t data_len,
+    boost::scoped_array<char>* response_data,
+    uint32_t* response_data_len) {
+  boost::mutex::scoped_lock lock(mutex_);
+  const lockRequest* rq = static_cast<const lockRequest*>(&request);
+  ++received_lock_requests_;
+
+  const Lock* conflicting_lock = FindConflictingLock(rq->lock_request());
+  return new Lock(conflicting_lock != NULL ? *conflicting_lock
+                                           : rq->lock_request());
+}
+
+google::protobuf::Message* TestRPCServerOSD::LockReleaseOperation(
+    const pbrpc::Auth& auth,
+    const pbrpc::UserCredentials& user_credentials,
+    const google::protobuf::Message& request,
+    const char* data,
+    uint32_t data_len,
+    boost::scoped_array<char>* response_data,
+    uint32_t* response_data_len) {
+  boost::mutex::scoped_lock lock(mutex_);
+  const lockRequest* rq = static_cast<const lockRequest*>(&request);
+  ++received_lock_requests_;
+
+  locks_.erase(LockOwner(rq->lock_request().client_uuid(),
+                         rq->lock_request().client_pid()));
+  return new emptyResponse();
+}
+
 }  // namespace rpc
 }  // namespace xtreemfs
@@ -13,8 +13,13 @@
 #include <stdint.h>
 
 #include <boost/thread/mutex.hpp>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "xtreemfs/OSD.pb.h"
+
 namespace google {
 namespace protobuf {
 class Message;
@@ -48,7 +53,48 @@ class TestRPCServerOSD : public TestRPCServer<TestRPCServerOSD> {
   TestRPCServerOSD();
   const std::vector<WriteEntry> GetReceivedWrites() const;
 
+  /** Returns the number of received lock acquire, check and release
+   *  requests. */
+  size_t GetReceivedLockRequests() const;
+
+  /** Returns the number of locks currently held by clients. */
+  size_t GetHeldLocks() const;
+
  private:
+  /** Client UUID and PID of the owner of a lock. */
+  typedef std::pair<std::string, uint32_t> LockOwner;
+
+  google::protobuf::Message* LockAcquireOperation(
+      const pbrpc::Auth& auth,
+      const pbrpc::UserCredentials& user_credentials,
+      const google::protobuf::Message& request,
+      const char* data,
+      uint32_t data_len,
+      boost::scoped_array<char>* response_data,
+      uint32_t* response_data_len);
+
+  google::protobuf::Message* LockCheckOperation(
+      const pbrpc::Auth& auth,
+      const pbrpc::UserCredentials& user_credentials,
+      const google::protobuf::Message& request,
+      const char* data,
+      uint32_t data_len,
+      boost::scoped_array<char>* response_data,
+      uint32_t* response_data_len);
+
+  google::protobuf::Message* LockReleaseOperation(
+      const pbrpc::Auth& auth,
+      const pbrpc::UserCredentials& user_credentials,
+      const google::protobuf::Message& request,
+      const char* data,
+      uint32_t data_len,
+      boost::scoped_array<char>* response_data,
+      uint32_t* response_data_len);
+
+  /** Returns a held lock of another owner which conflicts with "lock" or
+   *  NULL. */
+  const pbrpc::Lock* FindConflictingLock(const pbrpc::Lock& lock) const;
+
   google::protobuf::Message* TruncateOperation(
       const pbrpc::Auth& auth,
       const pbrpc::UserCredentials& user_credentials,
@@ -89,6 +135,12 @@ class TestRPCServerOSD : public TestRPCServer<TestRPCServerOSD> {
    *  expected result.
    */
   std::vector<WriteEntry> received_writes_;
+
+  /** Number of received lock requests. */
+  size_t received_lock_requests_;
+
+  /** Held locks, like the OSD at most one per client process. */
+  std::map<LockOwner, pbrpc::Lock> locks_;
 };
 
 }  // namespace rpc
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+#include "ld_preload/memory_mappings.h"
+
+using namespace std;
+
+class MemoryMappingsTest : public ::testing::Test {
+ protected:
+  static const size_t kPageSize = 16;
+
+  virtual void SetUp() {
+    memory_.assign(4 * kPageSize, 'a');
+    mapping_.address = &memory_[0];
+    mapping_.length = memory_.size();
+    mapping_.offset = 1000;
+    mapping_.file_length = memory_.size();
+    // No file handle, nothing is closed.
+    mapping_.file.reset(new MappedFile(NULL, &memory_[0], memory_.size()));
+  }
+
+  vector<char> memory_;
+  MemoryMapping mapping_;
+};
+
+const size_t MemoryMappingsTest::kPageSize;
+
+TEST_F(MemoryMappingsTest, ModifiedPages) {
+  vector<pair<size_t, size_t> > ranges;
+  mapping_.GetModifiedRanges(0, mapping_.length, kPageSize, &ranges);
+  EXPECT_TRUE(ranges.empty());
+
+  memory_[1] = 'x';
+  memory_[kPageSize + 3] = 'x';
+  memory_[3 * kPageSize] = 'x';
+  mapping_.GetModifiedRanges(0, mapping_.length, kPageSize, &ranges);
+  ASSERT_EQ(2, ranges.size());
+  // Adjacent pages are combined.
+  EXPECT_EQ(0, ranges[0].first);
+  EXPECT_EQ(2 * kPageSize, ranges[0].second);
+  EXPECT_EQ(3 * kPageSize, ranges[1].first);
+  EXPECT_EQ(kPageSize, ranges[1].second);
+
+  // Written back pages are not modified anymore.
+  mapping_.SetWrittenBack(0, 2 * kPageSize);
+  ranges.clear();
+  mapping_.GetModifiedRanges(0, mapping_.length, kPageSize, &ranges);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ(3 * kPageSize, ranges[0].first);
+}
+
+TEST_F(MemoryMappingsTest, ModifiedPagesAreClippedToTheFile) {
+  mapping_.file_length = kPageSize + 4;
+  memory_[kPageSize + 2] = 'x';
+  memory_[kPageSize + 8] = 'x';
+  memory_[2 * kPageSize] = 'x';
+  vector<pair<size_t, size_t> > ranges;
+  mapping_.GetModifiedRanges(0, mapping_.length, kPageSize, &ranges);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ(kPageSize, ranges[0].first);
+  EXPECT_EQ(4, ranges[0].second);
+}
+
+TEST_F(MemoryMappingsTest, PartialRemoveKeepsTheRest) {
+  MemoryMappings mappings;
+  mappings.Add(mapping_);
+  EXPECT_FALSE(mappings.Empty());
+
+  // Unmap the second page.
+  vector<MemoryMapping> removed;
+  mappings.Remove(&memory_[kPageSize], kPageSize, &removed);
+  ASSERT_EQ(1, removed.size());
+  EXPECT_EQ(&memory_[kPageSize], removed[0].address);
+  EXPECT_EQ(kPageSize, removed[0].length);
+  EXPECT_EQ(1000 + kPageSize, removed[0].offset);
+  EXPECT_EQ(kPageSize, removed[0].file_length);
+
+  EXPECT_TRUE(mappings.Overlaps(&memory_[0], 1));
+  EXPECT_FALSE(mappings.Overlaps(&memory_[kPageSize], kPageSize));
+  EXPECT_TRUE(mappings.Overlaps(&memory_[kPageSize], kPageSize + 1));
+
+  // The parts still compare against the content at mmap() time.
+  vector<MemoryMapping> found;
+  mappings.Find(&memory_[0], memory_.size(), &found);
+  ASSERT_EQ(2, found.size());
+  EXPECT_EQ(&memory_[0], found[0].address);
+  EXPECT_EQ(kPageSize, found[0].length);
+  EXPECT_EQ(&memory_[2 * kPageSize], found[1].address);
+  EXPECT_EQ(2 * kPageSize, found[1].length);
+  EXPECT_EQ(1000 + 2 * kPageSize, found[1].offset);
+  memory_[2 * kPageSize + 1] = 'x';
+  vector<pair<size_t, size_t> > ranges;
+  found[1].GetModifiedRanges(0, found[1].length, kPageSize, &ranges);
+  ASSERT_EQ(1, ranges.size());
+  EXPECT_EQ(0, ranges[0].first);
+  EXPECT_EQ(kPageSize, ranges[0].second);
+
+  // Unmapping a range which covers both parts removes everything.
+  removed.clear();
+  mappings.Remove(&memory_[0], memory_.size(), &removed);
+  EXPECT_EQ(2, removed.size());
+  EXPECT_TRUE(mappings.Empty());
+}
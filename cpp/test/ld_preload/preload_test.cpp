@@ -5,67 +5,223 @@
  *
  */
 
-#include <iostream>
-#include <cstdio>
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
-#include <sys/types.h>
-#include <sys/stat.h>
 #include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
 #include <unistd.h>
+#include <vector>
 
 using namespace std;
 
-int main(int argc, char* argv[]) {
+/**
+ * Runs against an XtreemFS volume through the preload library, see
+ * preload_test.sh. The file used by the tests is taken from
+ * XTREEMFS_PRELOAD_TEST_PATH. Without XTREEMFS_PRELOAD_OPTIONS, i.e. when run
+ * as part of the unit tests, the tests do nothing.
+ */
+class PreloadTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    preloaded_ = getenv("XTREEMFS_PRELOAD_OPTIONS") != NULL;
+    const char* path = getenv("XTREEMFS_PRELOAD_TEST_PATH");
+    path_ = path != NULL ? path : "/xtreemfs/temp_b.file";
+    page_size_ = sysconf(_SC_PAGESIZE);
+  }
 
-  const char default_path[] = "/xtreemfs/temp_b.file";
-  const char* path = default_path;
+  /** Replaces the content of the file with "data". */
+  void WriteFile(const string& data) {
+    int fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+    ASSERT_NE(-1, fd);
+    ASSERT_EQ(static_cast<ssize_t>(data.size()),
+              write(fd, data.data(), data.size()));
+    ASSERT_EQ(0, close(fd));
+  }
 
-  // take path from command line if specified
-  if (argc > 1) {
-    path = argv[1];
+  /** Returns the first "size" bytes of the file. */
+  string ReadFile(size_t size) {
+    vector<char> buffer(size);
+    int fd = open(path_.c_str(), O_RDONLY, 0);
+    EXPECT_NE(-1, fd);
+    ssize_t read_bytes = pread(fd, &buffer[0], size, 0);
+    EXPECT_EQ(0, close(fd));
+    return read_bytes > 0 ? string(&buffer[0], read_bytes) : string();
   }
 
-  // open() file
-  std::cout << "TEST: open()" << std::endl;
-  //FILE* file_a = std::fopen("/xtreemfs/demo/temp_a.file", "w");
-  int file_b = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0777);
-  //int file_b = open("/xtreemfs/demo/temp.file", O_WRONLY | O_CREAT); // this is wrong by open specification, mode is not set, but O_CREAT is
+  bool preloaded_;
+  string path_;
+  size_t page_size_;
+};
 
+TEST_F(PreloadTest, WriteAndRead) {
+  if (!preloaded_) {
+    return;
+  }
   const char data_to_write[] = "Hello World!";
-  char data_to_read[256] = "";
-
-  ssize_t write_ret = write(file_b, (void*)data_to_write, sizeof(data_to_write));
-
-  lseek(file_b, 0, SEEK_SET);
-
-  // close() file
-  close(file_b);
+  WriteFile(string(data_to_write, sizeof(data_to_write)));
 
-  // open() same file for reading
-  file_b = open(path, O_RDONLY, 0);
-
-  ssize_t read_ret = read(file_b, (void*)data_to_read, sizeof(data_to_write));
+  char data_to_read[256] = "";
+  int fd = open(path_.c_str(), O_RDONLY, 0);
+  ASSERT_NE(-1, fd);
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(data_to_write)),
+            read(fd, data_to_read, sizeof(data_to_write)));
+  EXPECT_EQ(0, close(fd));
+  EXPECT_STREQ(data_to_write, data_to_read);
+}
 
-  // close() file
-  std::cout << "TEST: close()" << std::endl;
-  //std::fclose(file_a);
-  close(file_b);
+/** Many small write()s and read()s (write-behind and read-ahead buffers). */
+TEST_F(PreloadTest, SmallIO) {
+  if (!preloaded_) {
+    return;
+  }
+  const char data_to_write[] = "Hello World!";
+  int fd = open(path_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+  ASSERT_NE(-1, fd);
+  for (size_t i = 0; i < sizeof(data_to_write); ++i) {
+    ASSERT_EQ(1, write(fd, &data_to_write[i], 1));
+  }
+  ASSERT_EQ(0, close(fd));
 
-  // compare written and read
-  if (0 == std::strcmp(data_to_write, data_to_read))
-    std::cout << "PASS" << std::endl;
-  else
-    std::cout << "FAIL" << std::endl;
+  char data_to_read[256] = "";
+  fd = open(path_.c_str(), O_RDONLY, 0);
+  ASSERT_NE(-1, fd);
+  EXPECT_EQ(0, posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL));
+  for (size_t i = 0; i < sizeof(data_to_write); ++i) {
+    ASSERT_EQ(1, read(fd, &data_to_read[i], 1));
+  }
+  EXPECT_EQ(0, close(fd));
+  EXPECT_STREQ(data_to_write, data_to_read);
+}
 
-  // stat(), fstat()
+/** Like kernel fds, duplicated fds share the file offset and the file stays
+ *  open until the last of them is closed. */
+TEST_F(PreloadTest, DupSharesTheFileOffset) {
+  if (!preloaded_) {
+    return;
+  }
+  WriteFile("Hello World!");
+
+  int fd = open(path_.c_str(), O_RDONLY, 0);
+  ASSERT_NE(-1, fd);
+  int dup_fd = dup(fd);
+  ASSERT_NE(-1, dup_fd);
+  EXPECT_NE(fd, dup_fd);
+  int dup2_fd = open(path_.c_str(), O_RDONLY, 0);
+  ASSERT_NE(-1, dup2_fd);
+  EXPECT_EQ(dup2_fd, dup2(fd, dup2_fd));
+
+  char buffer[6] = "";
+  EXPECT_EQ(5, read(fd, buffer, 5));
+  EXPECT_STREQ("Hello", buffer);
+  EXPECT_EQ(0, close(fd));
+  EXPECT_EQ(6, read(dup_fd, buffer, 6));
+  EXPECT_EQ(" World", string(buffer, 6));
+  EXPECT_EQ(0, close(dup_fd));
+  EXPECT_EQ(11, lseek(dup2_fd, 0, SEEK_CUR));
+  EXPECT_EQ(0, close(dup2_fd));
+}
 
-  // access()
+TEST_F(PreloadTest, PrivateMappingStaysValidAfterClose) {
+  if (!preloaded_) {
+    return;
+  }
+  const char data_to_write[] = "Hello World!";
+  WriteFile(string(data_to_write, sizeof(data_to_write)));
+
+  int fd = open(path_.c_str(), O_RDONLY, 0);
+  ASSERT_NE(-1, fd);
+  void* mapping = mmap(NULL, sizeof(data_to_write), PROT_READ, MAP_PRIVATE,
+                       fd, 0);
+  EXPECT_EQ(0, close(fd));
+  ASSERT_NE(MAP_FAILED, mapping);
+  EXPECT_STREQ(data_to_write, static_cast<char*>(mapping));
+  EXPECT_EQ(0, munmap(mapping, sizeof(data_to_write)));
+}
 
-  // ftruncate()
+TEST_F(PreloadTest, SharedWritableMappingRequiresReadWriteFd) {
+  if (!preloaded_) {
+    return;
+  }
+  WriteFile(string(page_size_, 'a'));
+
+  int fd = open(path_.c_str(), O_RDONLY, 0);
+  ASSERT_NE(-1, fd);
+  errno = 0;
+  EXPECT_EQ(MAP_FAILED, mmap(NULL, page_size_, PROT_READ | PROT_WRITE,
+                             MAP_SHARED, fd, 0));
+  EXPECT_EQ(EACCES, errno);
+  EXPECT_EQ(0, close(fd));
+}
 
-  // getcwd()
+/** Only modified pages are written back, so concurrent writes to other pages
+ *  of the file survive munmap(). */
+TEST_F(PreloadTest, SharedMappingWritesBackModifiedPages) {
+  if (!preloaded_) {
+    return;
+  }
+  WriteFile(string(2 * page_size_, 'a'));
+
+  int fd = open(path_.c_str(), O_RDWR, 0);
+  ASSERT_NE(-1, fd);
+  char* mapping = static_cast<char*>(mmap(NULL, 2 * page_size_,
+                                          PROT_READ | PROT_WRITE, MAP_SHARED,
+                                          fd, 0));
+  ASSERT_NE(MAP_FAILED, mapping);
+  ASSERT_EQ(1, pwrite(fd, "w", 1, page_size_));
+  EXPECT_EQ(0, close(fd));
+
+  mapping[0] = 'm';
+  EXPECT_EQ(0, munmap(mapping, 2 * page_size_));
+
+  const string content = ReadFile(2 * page_size_);
+  ASSERT_EQ(2 * page_size_, content.size());
+  EXPECT_EQ('m', content[0]);
+  EXPECT_EQ('a', content[1]);
+  EXPECT_EQ('w', content[page_size_]);
+}
 
-  std::cout << "TEST: done()" << std::endl;
+/** The rest of a partially unmapped mapping is still written back. */
+TEST_F(PreloadTest, PartialMunmap) {
+  if (!preloaded_) {
+    return;
+  }
+  WriteFile(string(2 * page_size_, 'a'));
+
+  int fd = open(path_.c_str(), O_RDWR, 0);
+  ASSERT_NE(-1, fd);
+  char* mapping = static_cast<char*>(mmap(NULL, 2 * page_size_,
+                                          PROT_READ | PROT_WRITE, MAP_SHARED,
+                                          fd, 0));
+  ASSERT_NE(MAP_FAILED, mapping);
+  EXPECT_EQ(0, close(fd));
+
+  mapping[0] = 'x';
+  mapping[page_size_] = 'y';
+  EXPECT_EQ(0, munmap(mapping, page_size_));
+  EXPECT_EQ('x', ReadFile(1)[0]);
+
+  EXPECT_EQ(0, msync(mapping + page_size_, page_size_, MS_SYNC));
+  EXPECT_EQ('y', ReadFile(2 * page_size_)[page_size_]);
+  EXPECT_EQ(0, munmap(mapping + page_size_, page_size_));
+}
 
-  return 0;
+TEST_F(PreloadTest, FtruncateAndFstat) {
+  if (!preloaded_) {
+    return;
+  }
+  WriteFile("Hello World!");
+
+  int fd = open(path_.c_str(), O_WRONLY, 0);
+  ASSERT_NE(-1, fd);
+  EXPECT_EQ(0, ftruncate(fd, 5));
+  struct stat stat_buf;
+  EXPECT_EQ(0, fstat(fd, &stat_buf));
+  EXPECT_EQ(0, close(fd));
+  EXPECT_EQ(5, stat_buf.st_size);
 }
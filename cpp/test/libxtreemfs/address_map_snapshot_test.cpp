@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#include "libxtreemfs/address_map_snapshot.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+
+class AddressMapSnapshotTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+    char path[] = "/tmp/xtreemfs_address_map_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_NE(-1, fd);
+    close(fd);
+    path_ = path;
+  }
+
+  virtual void TearDown() {
+    unlink(path_.c_str());
+    shutdown_logger();
+  }
+
+  static void AddService(ServiceSet* set,
+                         const string& name,
+                         const string& uuid) {
+    Service* service = set->add_services();
+    service->set_type(SERVICE_TYPE_VOLUME);
+    service->set_uuid(uuid);
+    service->set_version(1);
+    service->set_name(name);
+    service->set_last_updated_s(1);
+    service->mutable_data();
+  }
+
+  string path_;
+};
+
+TEST_F(AddressMapSnapshotTest, SaveAndLoad) {
+  AddressMapSnapshot snapshot;
+  AddressMapping* mapping
+      = snapshot.mutable_address_mappings()->add_mappings();
+  mapping->set_uuid("osd1");
+  mapping->set_version(1);
+  mapping->set_protocol("pbrpc");
+  mapping->set_address("10.0.0.1");
+  mapping->set_port(32640);
+  mapping->set_match_network("*");
+  mapping->set_ttl_s(3600);
+  mapping->set_uri("pbrpc://10.0.0.1:32640");
+
+  ServiceSet volumes;
+  AddService(&volumes, "volume", "volume-uuid");
+  snapshot.SetServicesByName("volume", volumes);
+  AddService(snapshot.mutable_osd_services(), "osd1", "osd1");
+  ASSERT_TRUE(snapshot.Save(path_));
+
+  AddressMapSnapshot loaded;
+  ASSERT_TRUE(loaded.Load(path_));
+  EXPECT_EQ(snapshot.write_time(), loaded.write_time());
+  ASSERT_EQ(1, loaded.address_mappings().mappings_size());
+  EXPECT_EQ("10.0.0.1", loaded.address_mappings().mappings(0).address());
+  EXPECT_EQ(32640u, loaded.address_mappings().mappings(0).port());
+  EXPECT_EQ(1, loaded.osd_services().services_size());
+
+  ServiceSet services;
+  ASSERT_TRUE(loaded.GetServicesByName("volume", &services));
+  ASSERT_EQ(1, services.services_size());
+  EXPECT_EQ("volume-uuid", services.services(0).uuid());
+  EXPECT_FALSE(loaded.GetServicesByName("other", &services));
+}
+
+TEST_F(AddressMapSnapshotTest, SetServicesByNameReplaces) {
+  AddressMapSnapshot snapshot;
+  ServiceSet services;
+  AddService(&services, "a", "a1");
+  AddService(&services, "a", "a2");
+  snapshot.SetServicesByName("a", services);
+  services.Clear();
+  AddService(&services, "b", "b1");
+  snapshot.SetServicesByName("b", services);
+
+  services.Clear();
+  AddService(&services, "a", "a3");
+  snapshot.SetServicesByName("a", services);
+  ASSERT_TRUE(snapshot.GetServicesByName("a", &services));
+  ASSERT_EQ(1, services.services_size());
+  EXPECT_EQ("a3", services.services(0).uuid());
+
+  // An empty set removes the services.
+  snapshot.SetServicesByName("b", ServiceSet());
+  EXPECT_FALSE(snapshot.GetServicesByName("b", &services));
+  EXPECT_TRUE(snapshot.GetServicesByName("a", &services));
+}
+
+TEST_F(AddressMapSnapshotTest, InvalidFile) {
+  {
+    ofstream file(path_.c_str(), ios_base::binary | ios_base::trunc);
+    file << "not a snapshot";
+  }
+  AddressMapSnapshot snapshot;
+  EXPECT_FALSE(snapshot.Load(path_));
+  EXPECT_EQ(0, snapshot.write_time());
+  EXPECT_EQ(0, snapshot.address_mappings().mappings_size());
+
+  EXPECT_FALSE(snapshot.Load(path_ + ".missing"));
+}
+
+}  // namespace xtreemfs
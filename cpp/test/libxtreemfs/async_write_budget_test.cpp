@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "libxtreemfs/async_write_budget.h"
+
+namespace xtreemfs {
+
+/** Blocks until "count" threads wait in budget->Acquire(). */
+static void WaitForWaitingThreads(AsyncWriteBudget* budget, int count) {
+  AsyncWriteBudget::Statistics statistics;
+  budget->GetStatistics(&statistics);
+  while (statistics.waiting_threads != count) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    budget->GetStatistics(&statistics);
+  }
+}
+
+TEST(AsyncWriteBudgetTest, Unlimited) {
+  AsyncWriteBudget budget(0);
+  const int owner = 0;
+  budget.Acquire(&owner, 1024 * 1024);
+  budget.Acquire(&owner, 1024 * 1024);
+
+  AsyncWriteBudget::Statistics statistics;
+  budget.GetStatistics(&statistics);
+  EXPECT_EQ(0u, statistics.size);
+  EXPECT_EQ(0u, statistics.used_bytes);
+}
+
+TEST(AsyncWriteBudgetTest, AcquireAndRelease) {
+  AsyncWriteBudget budget(100);
+  const int a = 0;
+  const int b = 0;
+  budget.Acquire(&a, 60);
+  budget.Acquire(&b, 40);
+
+  AsyncWriteBudget::Statistics statistics;
+  budget.GetStatistics(&statistics);
+  EXPECT_EQ(100u, statistics.used_bytes);
+  EXPECT_EQ(2, statistics.owners);
+
+  budget.Release(&a, 60);
+  budget.Release(&b, 40);
+  budget.GetStatistics(&statistics);
+  EXPECT_EQ(0u, statistics.used_bytes);
+  EXPECT_EQ(100u, statistics.peak_used_bytes);
+  EXPECT_EQ(0, statistics.owners);
+  EXPECT_EQ(0u, statistics.blocked_acquires);
+
+  // Larger than the budget, but nothing else is pending.
+  budget.Acquire(&a, 200);
+  budget.Release(&a, 200);
+}
+
+TEST(AsyncWriteBudgetTest, BlocksUntilReleased) {
+  AsyncWriteBudget budget(100);
+  const int a = 0;
+  budget.Acquire(&a, 80);
+
+  boost::thread writer(boost::bind(&AsyncWriteBudget::Acquire, &budget,
+                                   &a, 30));
+  WaitForWaitingThreads(&budget, 1);
+  budget.Release(&a, 80);
+  writer.join();
+
+  AsyncWriteBudget::Statistics statistics;
+  budget.GetStatistics(&statistics);
+  EXPECT_EQ(30u, statistics.used_bytes);
+  EXPECT_EQ(1u, statistics.blocked_acquires);
+}
+
+/** An owner which holds fewer bytes is served first. */
+TEST(AsyncWriteBudgetTest, FairSharing) {
+  AsyncWriteBudget budget(100);
+  const int a = 0;
+  const int b = 0;
+  budget.Acquire(&a, 80);
+
+  boost::thread writer_a(boost::bind(&AsyncWriteBudget::Acquire, &budget,
+                                     &a, 30));
+  WaitForWaitingThreads(&budget, 1);
+  boost::thread writer_b(boost::bind(&AsyncWriteBudget::Acquire, &budget,
+                                     &b, 30));
+  WaitForWaitingThreads(&budget, 2);
+
+  // Enough for a, but b holds nothing yet.
+  budget.Release(&a, 30);
+  writer_b.join();
+
+  AsyncWriteBudget::Statistics statistics;
+  budget.GetStatistics(&statistics);
+  EXPECT_EQ(80u, statistics.used_bytes);
+  EXPECT_EQ(1, statistics.waiting_threads);
+
+  budget.Release(&b, 30);
+  writer_a.join();
+  budget.GetStatistics(&statistics);
+  EXPECT_EQ(80u, statistics.used_bytes);
+  EXPECT_EQ(0, statistics.waiting_threads);
+}
+
+}  // namespace xtreemfs
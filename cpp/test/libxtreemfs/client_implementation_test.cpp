@@ -8,13 +8,18 @@
 #include <gtest/gtest.h>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
 #include <map>
+#include <stdlib.h>
+#include <unistd.h>
 
 #include "common/test_rpc_server_dir.h"
+#include "libxtreemfs/address_map_snapshot.h"
 #include "libxtreemfs/client.h"
 #include "libxtreemfs/helper.h"
 #include "libxtreemfs/options.h"
 #include "libxtreemfs/pbrpc_url.h"
+#include "libxtreemfs/uuid_resolver.h"
 #include "libxtreemfs/xtreemfs_exception.h"
 #include "xtreemfs/DIR.pb.h"
 
@@ -177,4 +182,61 @@ TEST_F(ClientImplementationTest, UUIDToAddressDefaultAndLocalNetwork) {
 }
 #endif  // __linux__
 
+/** The services of a loaded address map snapshot are used until the first
+ *  lookup at the DIR, which replaces them. */
+TEST_F(ClientImplementationTest, SnapshotServicesAreReplacedByLookup) {
+  char base_path[] = "/tmp/xtreemfs_client_implementation_test_XXXXXX";
+  int fd = mkstemp(base_path);
+  ASSERT_NE(-1, fd);
+  close(fd);
+  Options options = options_;
+  options.vivaldi_filename = base_path;
+  options.address_map_snapshot_max_age_s = 3600;
+  const string snapshot_path = options.vivaldi_filename + ".address_map";
+
+  // In the snapshot, the volume is still served by another MRC.
+  AddressMapSnapshot snapshot;
+  ServiceSet volumes;
+  Service* volume = volumes.add_services();
+  volume->set_type(SERVICE_TYPE_VOLUME);
+  volume->set_uuid("snapshot-mrc");
+  volume->set_version(0);
+  volume->set_name("volume");
+  volume->set_last_updated_s(0);
+  KeyValuePair* mrc = volume->mutable_data()->add_data();
+  mrc->set_key("mrc");
+  mrc->set_value("snapshot-mrc");
+  snapshot.SetServicesByName("volume", volumes);
+  ASSERT_TRUE(snapshot.Save(snapshot_path));
+  dir_->RegisterVolume("volume", "live-mrc");
+
+  boost::scoped_ptr<Client> client(Client::CreateClient(
+      dir_->GetAddress(),
+      user_credentials_,
+      NULL,  // No SSL options.
+      options));
+  client->Start();
+  UUIDResolver* resolver = client->GetUUIDResolver();
+
+  // The refresh thread revalidates the snapshot in the background.
+  string mrc_uuid;
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_NO_THROW(resolver->VolumeNameToMRCUUID("volume", &mrc_uuid));
+    if (mrc_uuid != "snapshot-mrc") {
+      break;
+    }
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  }
+  EXPECT_EQ("live-mrc", mrc_uuid);
+
+  // From now on, every lookup asks the DIR.
+  dir_->RegisterVolume("volume", "new-mrc");
+  ASSERT_NO_THROW(resolver->VolumeNameToMRCUUID("volume", &mrc_uuid));
+  EXPECT_EQ("new-mrc", mrc_uuid);
+
+  client->Shutdown();
+  unlink(snapshot_path.c_str());
+  unlink(base_path);
+}
+
 }  // namespace xtreemfs
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/drop_rules.h"
+#include "common/test_environment.h"
+#include "common/test_rpc_server_mrc.h"
+#include "libxtreemfs/client.h"
+#include "libxtreemfs/execute_sync_request.h"
+#include "libxtreemfs/helper.h"
+#include "libxtreemfs/options.h"
+#include "libxtreemfs/volume.h"
+#include "libxtreemfs/xtreemfs_exception.h"
+#include "xtreemfs/MRC.pb.h"
+#include "xtreemfs/MRCServiceConstants.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+
+/** Only a configured operation timeout sets a deadline. */
+TEST(ExecuteSyncRequestTest, DeadlineOfOperationTimeout) {
+  Options options;
+  EXPECT_TRUE(RPCOptionsFromOptions(options).deadline().is_not_a_date_time());
+  EXPECT_FALSE(RPCOptionsFromOptions(options).DeadlinePassed());
+
+  options.operation_timeout_s = 60;
+  const boost::posix_time::ptime deadline
+      = RPCOptionsFromOptions(options).deadline();
+  ASSERT_FALSE(deadline.is_not_a_date_time());
+  EXPECT_GT(deadline, boost::posix_time::microsec_clock::local_time()
+                      + boost::posix_time::seconds(50));
+}
+
+/** The deadline ends the pending request and stops further retries. */
+TEST(ExecuteSyncRequestTest, DeadlineLimitsRequestsAndRetries) {
+  initialize_logger(LEVEL_WARN);
+  TestEnvironment test_env;
+  test_env.options.request_timeout_s = 5;
+  test_env.options.retry_delay_s = 1;
+  test_env.options.max_tries = 3;
+  test_env.options.operation_timeout_s = 1;
+  ASSERT_TRUE(test_env.Start());
+  Volume* volume = test_env.client->OpenVolume(test_env.volume_name_,
+                                               NULL,  // No SSL options.
+                                               test_env.options);
+  test_env.mrc->AddDropRule(new rpc::DropByProcIDRule(PROC_ID_GETATTR));
+
+  // Without the deadline, three attempts would take at least 15 seconds.
+  const boost::posix_time::ptime start
+      = boost::posix_time::microsec_clock::local_time();
+  Stat stat;
+  EXPECT_THROW(volume->GetAttr(test_env.user_credentials, "/not_cached", &stat),
+               XtreemFSException);
+  EXPECT_LT(boost::posix_time::microsec_clock::local_time() - start,
+            boost::posix_time::seconds(3));
+
+  test_env.Stop();
+}
+
+}  // namespace xtreemfs
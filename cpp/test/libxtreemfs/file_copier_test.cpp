@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/scoped_array.hpp>
+#include <cstring>
+
+#include "common/test_environment.h"
+#include "common/test_rpc_server_osd.h"
+#include "libxtreemfs/client.h"
+#include "libxtreemfs/file_copier.h"
+#include "libxtreemfs/file_handle.h"
+#include "libxtreemfs/options.h"
+#include "libxtreemfs/volume.h"
+#include "libxtreemfs/xtreemfs_exception.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+
+class FileCopierTest : public ::testing::Test {
+ protected:
+  static const int kBlockSize = 1024 * 128;
+  static const int kBlocks = 5;
+
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+    test_env.options.connect_timeout_s = 3;
+    test_env.options.request_timeout_s = 3;
+    test_env.options.retry_delay_s = 3;
+    ASSERT_TRUE(test_env.Start());
+
+    volume = test_env.client->OpenVolume(
+        test_env.volume_name_,
+        NULL,  // No SSL options.
+        test_env.options);
+
+    file = volume->OpenFile(
+        test_env.user_credentials,
+        "/test_file",
+        static_cast<xtreemfs::pbrpc::SYSTEM_V_FCNTL>(
+            xtreemfs::pbrpc::SYSTEM_V_FCNTL_H_O_CREAT |
+            xtreemfs::pbrpc::SYSTEM_V_FCNTL_H_O_TRUNC |
+            xtreemfs::pbrpc::SYSTEM_V_FCNTL_H_O_RDWR));
+  }
+
+  virtual void TearDown() {
+    test_env.Stop();
+  }
+
+  TestEnvironment test_env;
+  Volume* volume;
+  FileHandle* file;
+};
+
+/** Copies the first kBlocks objects behind themselves with several objects in
+ *  flight and compares the result. */
+TEST_F(FileCopierTest, ParallelCopy) {
+  const size_t size = kBlockSize * kBlocks;
+  boost::scoped_array<char> data(new char[size]);
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>(i % 251);
+  }
+  ASSERT_NO_THROW(file->Write(data.get(), size, 0));
+
+  FileCopier copier(file, file, kBlockSize, 3);
+  int64_t copied = 0;
+  ASSERT_NO_THROW(copied = copier.Copy(0, size, size));
+  EXPECT_EQ(static_cast<int64_t>(size), copied);
+
+  boost::scoped_array<char> copy(new char[size]);
+  ASSERT_EQ(static_cast<int>(size), file->Read(copy.get(), size, size));
+  EXPECT_EQ(0, memcmp(data.get(), copy.get(), size));
+
+  ASSERT_NO_THROW(file->Close());
+}
+
+/** A length beyond the end of the source file stops at the end of it. The
+ *  range is copied to the front so that the file size does not change. */
+TEST_F(FileCopierTest, CopyStopsAtEndOfFile) {
+  const size_t size = kBlockSize + kBlockSize / 2;
+  boost::scoped_array<char> data(new char[size]);
+  memset(data.get(), 'x', size);
+  ASSERT_NO_THROW(file->Write(data.get(), size, 2 * kBlockSize));
+
+  FileCopier copier(file, file, kBlockSize, 4);
+  int64_t copied = 0;
+  ASSERT_NO_THROW(copied = copier.Copy(2 * kBlockSize, 0, 4 * kBlockSize));
+  EXPECT_EQ(static_cast<int64_t>(size), copied);
+
+  ASSERT_NO_THROW(file->Close());
+}
+
+}  // namespace xtreemfs
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
+#include <vector>
+
+#include "common/test_environment.h"
+#include "common/test_rpc_server_mrc.h"
+#include "libxtreemfs/client.h"
+#include "libxtreemfs/file_handle.h"
+#include "libxtreemfs/options.h"
+#include "libxtreemfs/volume.h"
+#include "libxtreemfs/xtreemfs_exception.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+
+/** Writes back file sizes through FileInfo::Flush() against the test MRC. */
+class FileInfoFlushTest : public ::testing::Test {
+ protected:
+  static const int kDataSize = 1024;
+
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+    test_env.options.connect_timeout_s = 3;
+    test_env.options.request_timeout_s = 3;
+    test_env.options.retry_delay_s = 3;
+    // Only Flush() and Close() write back file sizes.
+    test_env.options.periodic_file_size_updates_interval_s = 3600;
+    volume = NULL;
+  }
+
+  virtual void TearDown() {
+    test_env.Stop();
+  }
+
+  void Start() {
+    ASSERT_TRUE(test_env.Start());
+    volume = test_env.client->OpenVolume(test_env.volume_name_,
+                                         NULL,  // No SSL options.
+                                         test_env.options);
+  }
+
+  /** Opens "path" and writes kDataSize bytes to it. */
+  FileHandle* OpenAndWrite(const string& path) {
+    FileHandle* file = volume->OpenFile(
+        test_env.user_credentials,
+        path,
+        static_cast<SYSTEM_V_FCNTL>(SYSTEM_V_FCNTL_H_O_CREAT |
+                                    SYSTEM_V_FCNTL_H_O_RDWR));
+    const string data(kDataSize, 'x');
+    EXPECT_EQ(kDataSize, file->Write(data.data(), data.size(), 0));
+    return file;
+  }
+
+  /** Returns the number of received file size updates with close_file set
+   *  to "close_file". */
+  size_t CountFileSizeUpdates(bool close_file) {
+    const vector<xtreemfs_update_file_sizeRequest> updates =
+        test_env.mrc->GetReceivedFileSizeUpdates();
+    size_t count = 0;
+    for (size_t i = 0; i < updates.size(); ++i) {
+      if (updates[i].close_file() == close_file) {
+        EXPECT_EQ(kDataSize,
+                  updates[i].osd_write_response().size_in_bytes());
+        ++count;
+      }
+    }
+    return count;
+  }
+
+  static void CloseFile(FileHandle* file) {
+    ASSERT_NO_THROW(file->Close());
+  }
+
+  TestEnvironment test_env;
+  Volume* volume;
+};
+
+const int FileInfoFlushTest::kDataSize;
+
+TEST_F(FileInfoFlushTest, CloseWritesBackFileSize) {
+  Start();
+  FileHandle* file = OpenAndWrite("/file");
+  ASSERT_NO_THROW(file->Close());
+
+  EXPECT_EQ(1, CountFileSizeUpdates(true));
+  EXPECT_EQ(0, CountFileSizeUpdates(false));
+}
+
+TEST_F(FileInfoFlushTest, CoalescedFlushThenClose) {
+  test_env.options.file_size_update_coalescing_ms = 10;
+  Start();
+  FileHandle* file = OpenAndWrite("/file");
+  ASSERT_NO_THROW(file->Flush());
+  EXPECT_EQ(1, CountFileSizeUpdates(false));
+
+  // The file size is clean, there is nothing left to send.
+  ASSERT_NO_THROW(file->Close());
+  EXPECT_EQ(1, CountFileSizeUpdates(false));
+  EXPECT_EQ(0, CountFileSizeUpdates(true));
+}
+
+/** Files closed at the same time are closed by one batch of updates sent by
+ *  the write back thread. Close() returns after its update was sent. */
+TEST_F(FileInfoFlushTest, CoalescedClose) {
+  test_env.options.file_size_update_coalescing_ms = 100;
+  Start();
+  FileHandle* file1 = OpenAndWrite("/file1");
+  FileHandle* file2 = OpenAndWrite("/file2");
+
+  boost::thread close1(boost::bind(&FileInfoFlushTest::CloseFile, file1));
+  boost::thread close2(boost::bind(&FileInfoFlushTest::CloseFile, file2));
+  close1.join();
+  close2.join();
+
+  EXPECT_EQ(2, CountFileSizeUpdates(true));
+  EXPECT_EQ(0, CountFileSizeUpdates(false));
+}
+
+}  // namespace xtreemfs
@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "common/drop_rules.h"
+#include "common/test_environment.h"
+#include "common/test_rpc_server_osd.h"
+#include "libxtreemfs/client.h"
+#include "libxtreemfs/file_handle.h"
+#include "libxtreemfs/options.h"
+#include "libxtreemfs/volume.h"
+#include "libxtreemfs/xtreemfs_exception.h"
+#include "xtreemfs/OSD.pb.h"
+#include "xtreemfs/OSDServiceConstants.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+
+class FileLockTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+    test_env.options.connect_timeout_s = 3;
+    test_env.options.request_timeout_s = 3;
+    test_env.options.retry_delay_s = 3;
+    volume = NULL;
+    file = NULL;
+  }
+
+  virtual void TearDown() {
+    if (file) {
+      file->Close();
+    }
+    if (other_client.get()) {
+      other_client->Shutdown();
+    }
+    test_env.Stop();
+  }
+
+  /** Starts the test environment with the current options and opens "file".
+   */
+  void Start() {
+    ASSERT_TRUE(test_env.Start());
+    volume = test_env.client->OpenVolume(test_env.volume_name_,
+                                         NULL,  // No SSL options.
+                                         test_env.options);
+    file = OpenTestFile(volume);
+  }
+
+  /** Starts a second client (with its own client UUID), opens the test file
+   *  with it and returns the file handle. */
+  FileHandle* OpenFileWithOtherClient() {
+    other_client.reset(Client::CreateClient(test_env.options.service_addresses,
+                                            test_env.user_credentials,
+                                            NULL,  // No SSL options.
+                                            test_env.options));
+    other_client->Start();
+    return OpenTestFile(other_client->OpenVolume(test_env.volume_name_,
+                                                 NULL,  // No SSL options.
+                                                 test_env.options));
+  }
+
+  FileHandle* OpenTestFile(Volume* volume) {
+    return volume->OpenFile(
+        test_env.user_credentials,
+        "/test_file",
+        static_cast<SYSTEM_V_FCNTL>(SYSTEM_V_FCNTL_H_O_CREAT |
+                                    SYSTEM_V_FCNTL_H_O_RDWR));
+  }
+
+  size_t ReceivedLockRequests() {
+    return test_env.osds[0]->GetReceivedLockRequests();
+  }
+
+  TestEnvironment test_env;
+  boost::scoped_ptr<Client> other_client;
+  Volume* volume;
+  FileHandle* file;
+};
+
+/** Acquires an exclusive lock of the whole file, waits if necessary. */
+static void AcquireLockAndWait(FileHandle* file,
+                               int process_id,
+                               boost::posix_time::ptime* acquired_at) {
+  delete file->AcquireLock(process_id, 0, 0, true, true);
+  *acquired_at = boost::posix_time::microsec_clock::local_time();
+}
+
+/** The waiter polls the OSD with a short delay instead of retry_delay_s. */
+TEST_F(FileLockTest, BlockedLockIsGrantedSoonAfterRemoteRelease) {
+  Start();
+  FileHandle* other_file = OpenFileWithOtherClient();
+  delete other_file->AcquireLock(1, 0, 0, true, false);
+  EXPECT_THROW(delete file->AcquireLock(2, 0, 0, true, false),
+               PosixErrorException);
+
+  boost::posix_time::ptime acquired_at;
+  boost::thread waiter(boost::bind(&AcquireLockAndWait, file, 2,
+                                   &acquired_at));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+  const boost::posix_time::ptime released_at
+      = boost::posix_time::microsec_clock::local_time();
+  other_file->ReleaseLock(1, 0, 0, true);
+  waiter.join();
+
+  EXPECT_LT(acquired_at - released_at, boost::posix_time::milliseconds(500));
+  // The backoff keeps the number of attempts low.
+  EXPECT_LT(ReceivedLockRequests(), 15u);
+  other_file->Close();
+}
+
+/** A waiter for the lock of another process of the same client does not
+ *  poll at all, but is woken up by the release. */
+TEST_F(FileLockTest, BlockedLockIsGrantedOnLocalRelease) {
+  test_env.options.lock_wait_min_delay_ms = 5000;
+  Start();
+  delete file->AcquireLock(1, 0, 0, true, false);
+  const size_t lock_requests = ReceivedLockRequests();
+
+  boost::posix_time::ptime acquired_at;
+  boost::thread waiter(boost::bind(&AcquireLockAndWait, file, 2,
+                                   &acquired_at));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(300));
+  EXPECT_EQ(lock_requests, ReceivedLockRequests());
+  const boost::posix_time::ptime released_at
+      = boost::posix_time::microsec_clock::local_time();
+  file->ReleaseLock(1, 0, 0, true);
+  waiter.join();
+
+  EXPECT_LT(acquired_at - released_at, boost::posix_time::seconds(1));
+}
+
+/** Lock/unlock cycles of the same process send only the first request. */
+TEST_F(FileLockTest, LingeringLockIsAcquiredAgainWithoutRequest) {
+  test_env.options.lock_cache_lease_ms = 60000;
+  Start();
+
+  for (int i = 0; i < 10; ++i) {
+    delete file->AcquireLock(1, 0, 100, true, false);
+    file->ReleaseLock(1, 0, 100, true);
+  }
+  EXPECT_EQ(1u, ReceivedLockRequests());
+  EXPECT_EQ(1u, test_env.osds[0]->GetHeldLocks());
+
+  // A conflicting lock of another process releases the lingering lock first.
+  delete file->AcquireLock(2, 50, 100, true, false);
+  EXPECT_EQ(3u, ReceivedLockRequests());
+  EXPECT_EQ(1u, test_env.osds[0]->GetHeldLocks());
+
+  file->ReleaseLock(2, 50, 100, true);
+  file->Close();
+  file = NULL;
+  EXPECT_EQ(0u, test_env.osds[0]->GetHeldLocks());
+}
+
+/** Other clients get the lock after the lease of a lingering lock. */
+TEST_F(FileLockTest, LingeringLockIsReleasedAfterLease) {
+  test_env.options.lock_cache_lease_ms = 100;
+  Start();
+  delete file->AcquireLock(1, 0, 0, true, false);
+  file->ReleaseLock(1, 0, 0, true);
+  EXPECT_EQ(1u, test_env.osds[0]->GetHeldLocks());
+
+  FileHandle* other_file = OpenFileWithOtherClient();
+  delete other_file->AcquireLock(1, 0, 0, true, true);
+  EXPECT_EQ(1u, test_env.osds[0]->GetHeldLocks());
+  other_file->ReleaseLock(1, 0, 0, true);
+  other_file->Close();
+}
+
+/** Files can be opened and closed while a lingering lock is released. */
+TEST_F(FileLockTest, LingeringLockReleaseDoesNotBlockTheVolume) {
+  test_env.options.lock_cache_lease_ms = 100;
+  Start();
+  delete file->AcquireLock(1, 0, 0, true, false);
+  // The first release is not answered and times out after 3 seconds.
+  test_env.osds[0]->AddDropRule(new rpc::ProcIDFilterRule(
+      PROC_ID_XTREEMFS_LOCK_RELEASE, new rpc::DropNRule(1)));
+  file->ReleaseLock(1, 0, 0, true);
+  boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+
+  const boost::posix_time::ptime start
+      = boost::posix_time::microsec_clock::local_time();
+  FileHandle* other_file = volume->OpenFile(
+      test_env.user_credentials,
+      "/other_file",
+      static_cast<SYSTEM_V_FCNTL>(SYSTEM_V_FCNTL_H_O_CREAT |
+                                  SYSTEM_V_FCNTL_H_O_RDWR));
+  other_file->Close();
+  EXPECT_LT(boost::posix_time::microsec_clock::local_time() - start,
+            boost::posix_time::seconds(1));
+
+  // The lock stays known until the retry released it, the last close waits
+  // for it.
+  file->Close();
+  file = NULL;
+  EXPECT_EQ(0u, test_env.osds[0]->GetHeldLocks());
+}
+
+}  // namespace xtreemfs
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+#include "libxtreemfs/file_size_update_queue.h"
+
+using namespace std;
+
+namespace xtreemfs {
+
+/** Every file id is queued only once. */
+TEST(FileSizeUpdateQueueTest, Deduplication) {
+  FileSizeUpdateQueue queue;
+  EXPECT_TRUE(queue.Add(1));
+  EXPECT_FALSE(queue.Add(1));
+  EXPECT_TRUE(queue.Add(2));
+  EXPECT_TRUE(queue.AddUrgent(1));
+  EXPECT_FALSE(queue.AddUrgent(1));
+  EXPECT_EQ(2, queue.Size());
+
+  vector<uint64_t> file_ids;
+  queue.Take(true, &file_ids);
+  ASSERT_EQ(2, file_ids.size());
+  EXPECT_EQ(1, file_ids[0]);
+  EXPECT_EQ(2, file_ids[1]);
+  EXPECT_EQ(0, queue.Size());
+}
+
+/** An urgent run only takes the urgent ids, the others stay queued. */
+TEST(FileSizeUpdateQueueTest, TakeUrgent) {
+  FileSizeUpdateQueue queue;
+  queue.Add(1);
+  queue.AddUrgent(2);
+
+  vector<uint64_t> file_ids;
+  queue.Take(false, &file_ids);
+  ASSERT_EQ(1, file_ids.size());
+  EXPECT_EQ(2, file_ids[0]);
+  EXPECT_EQ(1, queue.Size());
+
+  // No urgent ids left: the wait runs into the deadline.
+  EXPECT_FALSE(queue.WaitForUrgent(boost::get_system_time()
+                                   + boost::posix_time::milliseconds(10)));
+}
+
+/** AddUrgent() wakes up a thread in WaitForUrgent(). */
+TEST(FileSizeUpdateQueueTest, WaitForUrgent) {
+  FileSizeUpdateQueue queue;
+  boost::thread adder(boost::bind(&FileSizeUpdateQueue::AddUrgent,
+                                  &queue,
+                                  static_cast<uint64_t>(42)));
+  EXPECT_TRUE(queue.WaitForUrgent(boost::get_system_time()
+                                  + boost::posix_time::seconds(10)));
+  adder.join();
+}
+
+}  // namespace xtreemfs
@@ -7,6 +7,7 @@
 
 #include <gtest/gtest.h>
 
+#include <malloc.h>
 #include <stdint.h>
 
 #include <boost/lexical_cast.hpp>
@@ -23,6 +24,40 @@ using namespace xtreemfs;
 using namespace xtreemfs::pbrpc;
 using namespace xtreemfs::util;
 
+/** Returns the number of bytes currently allocated on the heap. */
+static size_t AllocatedBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  return mallinfo2().uordblks;
+#else
+  return mallinfo().uordblks;
+#endif
+}
+
+/** Time returned by FakeClock(). */
+static time_t fake_now = 1000;
+
+static time_t FakeClock() {
+  return fake_now;
+}
+
+static Stat MakeFileStat(uint64_t ino) {
+  Stat stat;
+  stat.set_dev(1);
+  stat.set_ino(ino);
+  stat.set_mode(0100644);
+  stat.set_nlink(1);
+  stat.set_user_id("someuser");
+  stat.set_group_id("somegroup");
+  stat.set_size(4096);
+  stat.set_atime_ns(ino);
+  stat.set_mtime_ns(ino);
+  stat.set_ctime_ns(ino);
+  stat.set_blksize(131072);
+  stat.set_etag(ino);
+  stat.set_truncate_epoch(0);
+  return stat;
+}
+
 class MetadataCacheTestSize2 : public ::testing::Test {
  protected:
   virtual void SetUp() {
@@ -61,6 +96,26 @@ class MetadataCacheTestSize1024 : public ::testing::Test {
   MetadataCache* metadata_cache_;
 };
 
+class MetadataCacheTestNegative : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+
+    // Max 1k entries and 2 non-existent paths, 1 hour.
+    metadata_cache_ = new MetadataCache(1024, 3600, 2, 3600);
+  }
+
+  virtual void TearDown() {
+    delete metadata_cache_;
+
+    google::protobuf::ShutdownProtobufLibrary();
+
+    shutdown_logger();
+  }
+
+  MetadataCache* metadata_cache_;
+};
+
 /** If a Stat entry gets updated through UpdateStatTime(), the new timeout must
  *  be respected in case of an eviction. */
 TEST_F(MetadataCacheTestSize2, UpdateStatTimeKeepsSequentialTimeoutOrder) {
@@ -176,6 +231,36 @@ TEST_F(MetadataCacheTestSize2, UpdateAndGetDirEntries) {
   }
 }
 
+/** Pages of a listing whose entries differ in size, also after an entry was
+ *  removed from it. */
+TEST_F(MetadataCacheTestSize2, GetDirEntriesPages) {
+  DirectoryEntries dir_entries;
+  for (int i = 0; i < 10; i++) {
+    DirectoryEntry* entry = dir_entries.add_entries();
+    // Names of up to 900 bytes need two bytes to encode the entry length.
+    entry->set_name(string(i * 100, 'a') + boost::lexical_cast<string>(i));
+    entry->mutable_stbuf()->set_ino(i);
+  }
+  metadata_cache_->UpdateDirEntries("/dir", dir_entries);
+  metadata_cache_->InvalidateDirEntry("/dir", dir_entries.entries(4).name());
+
+  boost::scoped_ptr<DirectoryEntries> dir_entries_read;
+  dir_entries_read.reset(metadata_cache_->GetDirEntries("/dir", 3, 3));
+  ASSERT_EQ(3, dir_entries_read->entries_size());
+  EXPECT_EQ(3, dir_entries_read->entries(0).stbuf().ino());
+  EXPECT_EQ(5, dir_entries_read->entries(1).stbuf().ino());
+  EXPECT_EQ(dir_entries.entries(6).name(), dir_entries_read->entries(2).name());
+
+  // The last page is cut off at the end of the listing.
+  dir_entries_read.reset(metadata_cache_->GetDirEntries("/dir", 7, 5));
+  ASSERT_EQ(2, dir_entries_read->entries_size());
+  EXPECT_EQ(8, dir_entries_read->entries(0).stbuf().ino());
+  EXPECT_EQ(9, dir_entries_read->entries(1).stbuf().ino());
+
+  dir_entries_read.reset(metadata_cache_->GetDirEntries("/dir", 9, 5));
+  EXPECT_EQ(0, dir_entries_read->entries_size());
+}
+
 /** If a Stat entry gets updated through UpdateStat(), the new timeout must be
  *  respected in case of an eviction. */
 TEST_F(MetadataCacheTestSize1024, InvalidatePrefix) {
@@ -252,6 +337,151 @@ TEST_F(MetadataCacheTestSize1024, RenamePrefix) {
   EXPECT_EQ(3, d.ino());
 }
 
+/** A renamed entry replaces the cached entry of the target path. */
+TEST_F(MetadataCacheTestSize1024, RenamePrefixReplacesTarget) {
+  Stat stat = MakeFileStat(1);
+  metadata_cache_->UpdateStat("/dir/file", stat);
+  metadata_cache_->UpdateStat("/target/file", MakeFileStat(2));
+  metadata_cache_->UpdateStat("/target", MakeFileStat(3));
+
+  // "/dir" itself is not cached, but the old "/target" is gone nevertheless.
+  metadata_cache_->RenamePrefix("/dir", "/target");
+  EXPECT_EQ(1, metadata_cache_->Size());
+  ASSERT_EQ(MetadataCache::kStatCached,
+            metadata_cache_->GetStat("/target/file", &stat));
+  EXPECT_EQ(1, stat.ino());
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache_->GetStat("/target", &stat));
+}
+
+/** Large directories are invalidated and renamed without touching every entry
+ *  below them. */
+TEST(MetadataCacheLargeDirectory, InvalidateAndRenamePrefixLazily) {
+  initialize_logger(LEVEL_WARN);
+  const int kFiles = 2000;
+  MetadataCache metadata_cache(2 * kFiles, 3600);
+  Stat stat;
+  for (int i = 0; i < kFiles; i++) {
+    metadata_cache.UpdateStat("/dir/file" + boost::lexical_cast<string>(i),
+                              MakeFileStat(i));
+  }
+  metadata_cache.UpdateStat("/dir.txt", MakeFileStat(kFiles));
+  EXPECT_EQ(kFiles + 1, metadata_cache.Size());
+
+  metadata_cache.InvalidatePrefix("/dir");
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/dir/file0", &stat));
+  EXPECT_EQ(MetadataCache::kStatCached,
+            metadata_cache.GetStat("/dir.txt", &stat));
+  // Entries added afterwards are valid.
+  metadata_cache.UpdateStat("/dir/file1", MakeFileStat(1));
+  EXPECT_EQ(MetadataCache::kStatCached,
+            metadata_cache.GetStat("/dir/file1", &stat));
+
+  // The invalidated entries are removed by later updates.
+  for (int i = 0; i < kFiles; i++) {
+    metadata_cache.UpdateStat("/other" + boost::lexical_cast<string>(i % 10),
+                              MakeFileStat(i));
+  }
+  EXPECT_EQ(12, metadata_cache.Size());
+  EXPECT_EQ(MetadataCache::kStatCached,
+            metadata_cache.GetStat("/dir/file1", &stat));
+
+  // A rename of a large directory drops the entries below it.
+  for (int i = 0; i < kFiles; i++) {
+    metadata_cache.UpdateStat("/dir/file" + boost::lexical_cast<string>(i),
+                              MakeFileStat(i));
+  }
+  metadata_cache.UpdateStat("/dir", MakeFileStat(kFiles));
+  metadata_cache.RenamePrefix("/dir", "/newdir");
+  EXPECT_EQ(MetadataCache::kStatCached,
+            metadata_cache.GetStat("/newdir", &stat));
+  EXPECT_EQ(kFiles, stat.ino());
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/dir/file5", &stat));
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/newdir/file5", &stat));
+  shutdown_logger();
+}
+
+/** Lookups check the invalidated prefixes of the path and its parents. */
+TEST(MetadataCacheLargeDirectory, ManyInvalidatedPrefixes) {
+  initialize_logger(LEVEL_WARN);
+  const int kDirectories = 8;
+  const int kFiles = 1100;
+  MetadataCache metadata_cache(2 * kDirectories * kFiles, 3600);
+  Stat stat;
+  for (int d = 0; d < kDirectories + 1; d++) {
+    const string directory = "/d" + boost::lexical_cast<string>(d);
+    metadata_cache.UpdateStat(directory, MakeFileStat(d));
+    for (int i = 0; i < kFiles; i++) {
+      metadata_cache.UpdateStat(
+          directory + "/file" + boost::lexical_cast<string>(i),
+          MakeFileStat(i));
+    }
+  }
+  metadata_cache.UpdateStat("/d0/sub/deep", MakeFileStat(kFiles));
+
+  for (int d = 0; d < kDirectories; d++) {
+    metadata_cache.InvalidatePrefix("/d" + boost::lexical_cast<string>(d));
+  }
+  metadata_cache.UpdateStat("/d0/new", MakeFileStat(kFiles));
+  // Invalidating "/d0" again also covers the entries added in between.
+  metadata_cache.InvalidatePrefix("/d0");
+  metadata_cache.UpdateStat("/d0/newer", MakeFileStat(kFiles));
+
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/d3/file5", &stat));
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/d1", &stat));
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/d0/sub/deep", &stat));
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/d0/new", &stat));
+  EXPECT_EQ(MetadataCache::kStatCached,
+            metadata_cache.GetStat("/d0/newer", &stat));
+  const string last = "/d" + boost::lexical_cast<string>(kDirectories);
+  EXPECT_EQ(MetadataCache::kStatCached,
+            metadata_cache.GetStat(last + "/file5", &stat));
+  EXPECT_EQ(MetadataCache::kStatCached, metadata_cache.GetStat(last, &stat));
+
+  // Once the prefixes are collected, only the newer entries are left.
+  for (int i = 0; i < kDirectories * kFiles; i++) {
+    metadata_cache.UpdateStat(last + "/file" + boost::lexical_cast<string>(
+                                  i % kFiles),
+                              MakeFileStat(i));
+  }
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/d0/new", &stat));
+  EXPECT_EQ(MetadataCache::kStatCached,
+            metadata_cache.GetStat("/d0/newer", &stat));
+  shutdown_logger();
+}
+
+/** Lazily invalidated entries do not become valid again by renaming them out
+ *  of the invalidated directory. */
+TEST(MetadataCacheLargeDirectory, RenameLazilyInvalidatedEntries) {
+  initialize_logger(LEVEL_WARN);
+  const int kFiles = 2000;
+  MetadataCache metadata_cache(2 * kFiles, 3600);
+  Stat stat;
+  for (int i = 0; i < kFiles; i++) {
+    metadata_cache.UpdateStat("/dir/file" + boost::lexical_cast<string>(i),
+                              MakeFileStat(i));
+  }
+  metadata_cache.UpdateStat("/dir/sub", MakeFileStat(kFiles));
+  metadata_cache.UpdateStat("/dir/sub/file", MakeFileStat(kFiles + 1));
+
+  metadata_cache.InvalidatePrefix("/dir");
+  // "/dir/sub" is small enough to be renamed entry by entry.
+  metadata_cache.RenamePrefix("/dir/sub", "/newdir");
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/newdir", &stat));
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache.GetStat("/newdir/file", &stat));
+  shutdown_logger();
+}
+
 /** Are large nanoseconds values correctly updated by
  *  UpdateStatAttributes? */
 TEST_F(MetadataCacheTestSize1024, UpdateStatAttributes) {
@@ -325,6 +555,151 @@ TEST_F(MetadataCacheTestSize1024, UpdateStatAttributesPreservesModeBits) {
   EXPECT_EQ(262655, cached_stat.mode());  // Octal: 1000777.
 }
 
+/** Non-existent paths are remembered until they are created. */
+TEST_F(MetadataCacheTestNegative, NonExistentPaths) {
+  Stat stat;
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache_->GetStat("/dir/file", &stat));
+
+  metadata_cache_->UpdateNonExistent("/dir/file");
+  EXPECT_EQ(1, metadata_cache_->NonExistentSize());
+  EXPECT_EQ(MetadataCache::kPathDoesntExist,
+            metadata_cache_->GetStat("/dir/file", &stat));
+
+  // A new stat entry replaces the negative one.
+  stat.set_ino(1);
+  stat.set_nlink(1);
+  metadata_cache_->UpdateStat("/dir/file", stat);
+  EXPECT_EQ(0, metadata_cache_->NonExistentSize());
+  EXPECT_EQ(MetadataCache::kStatCached,
+            metadata_cache_->GetStat("/dir/file", &stat));
+
+  // And vice versa.
+  metadata_cache_->UpdateNonExistent("/dir/file");
+  EXPECT_EQ(0, metadata_cache_->Size());
+  EXPECT_EQ(MetadataCache::kPathDoesntExist,
+            metadata_cache_->GetStat("/dir/file", &stat));
+
+  // Only the oldest entries are evicted.
+  metadata_cache_->UpdateNonExistent("/dir/a");
+  metadata_cache_->UpdateNonExistent("/dir/b");
+  EXPECT_EQ(2, metadata_cache_->NonExistentSize());
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache_->GetStat("/dir/file", &stat));
+  EXPECT_EQ(MetadataCache::kPathDoesntExist,
+            metadata_cache_->GetStat("/dir/b", &stat));
+}
+
+/** InvalidateNonExistent() also removes the paths below a created one. */
+TEST_F(MetadataCacheTestNegative, InvalidateNonExistent) {
+  Stat stat;
+  metadata_cache_->UpdateNonExistent("/dir/sub");
+  metadata_cache_->UpdateNonExistent("/dir.txt");
+  metadata_cache_->InvalidateNonExistent("/dir");
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache_->GetStat("/dir/sub", &stat));
+  EXPECT_EQ(MetadataCache::kPathDoesntExist,
+            metadata_cache_->GetStat("/dir.txt", &stat));
+}
+
+/** Lookups of names missing in a cached listing are answered with ENOENT and
+ *  listed names are not reported as non-existent. */
+TEST_F(MetadataCacheTestNegative, NonExistentFromDirEntries) {
+  Stat stat;
+  metadata_cache_->UpdateNonExistent("/dir/file");
+
+  DirectoryEntries dir_entries;
+  dir_entries.add_entries()->set_name("file");
+  metadata_cache_->UpdateDirEntries("/dir", dir_entries);
+  EXPECT_EQ(0, metadata_cache_->NonExistentSize());
+  EXPECT_EQ(MetadataCache::kStatNotCached,
+            metadata_cache_->GetStat("/dir/file", &stat));
+
+  EXPECT_EQ(MetadataCache::kPathDoesntExist,
+            metadata_cache_->GetStat("/dir/missing", &stat));
+  EXPECT_EQ(1, metadata_cache_->NonExistentSize());
+  EXPECT_EQ(MetadataCache::kPathDoesntExist,
+            metadata_cache_->GetStat("/dir/missing", &stat));
+}
+
+/** Expired xattr lists still answer that "security.*" and
+ *  "system.posix_acl_*" attributes are missing. */
+TEST(MetadataCacheXAttrs, NegativeXAttrs) {
+  initialize_logger(LEVEL_WARN);
+  MetadataCache metadata_cache(10, 60);
+  metadata_cache.SetXAttrNegativeTtl(3600);
+  metadata_cache.SetClock(&FakeClock);
+
+  listxattrResponse xattrs;
+  XAttr* xattr = xattrs.add_xattrs();
+  xattr->set_name("security.existing");
+  xattr->set_value("value");
+  metadata_cache.UpdateXAttrs("/a", xattrs);
+  metadata_cache.UpdateXAttrs("/b", xattrs);
+  // Let the lists expire.
+  fake_now += 61;
+  EXPECT_FALSE(metadata_cache.HasXAttrs("/a"));
+
+  string value;
+  int size;
+  bool xattrs_cached = false;
+  EXPECT_FALSE(metadata_cache.GetXAttr("/a", "security.selinux", &value,
+                                       &xattrs_cached));
+  EXPECT_TRUE(xattrs_cached);
+  EXPECT_FALSE(metadata_cache.GetXAttrSize("/a", "system.posix_acl_access",
+                                           &size, &xattrs_cached));
+  EXPECT_TRUE(xattrs_cached);
+
+  // Other names and existing values are not answered by expired lists.
+  EXPECT_FALSE(metadata_cache.GetXAttr("/a", "user.a", &value,
+                                       &xattrs_cached));
+  EXPECT_FALSE(xattrs_cached);
+  EXPECT_FALSE(metadata_cache.GetXAttr("/a", "security.existing", &value,
+                                       &xattrs_cached));
+  EXPECT_FALSE(xattrs_cached);
+
+  // Setting an attribute drops the expired list.
+  metadata_cache.UpdateXAttr("/b", "security.selinux", "label");
+  EXPECT_FALSE(metadata_cache.GetXAttr("/b", "security.selinux", &value,
+                                       &xattrs_cached));
+  EXPECT_FALSE(xattrs_cached);
+
+  shutdown_logger();
+}
+
+/** Prints the heap memory per cached stat and per cached directory entry.
+ *  Not part of the unit tests, run it with --gtest_also_run_disabled_tests. */
+TEST(MetadataCacheBenchmark, DISABLED_MemoryPerEntry) {
+  initialize_logger(LEVEL_WARN);
+  const int kEntries = 100000;
+  const int kDirEntries = 1000;
+  {
+    MetadataCache metadata_cache(kEntries + 1, 3600);
+    size_t before = AllocatedBytes();
+    for (int i = 0; i < kEntries; i++) {
+      metadata_cache.UpdateStat(
+          "/benchmark/dir/file" + boost::lexical_cast<string>(i),
+          MakeFileStat(i));
+    }
+    const size_t per_stat = (AllocatedBytes() - before) / kEntries;
+
+    DirectoryEntries dir_entries;
+    for (int i = 0; i < kDirEntries; i++) {
+      DirectoryEntry* entry = dir_entries.add_entries();
+      entry->set_name("file" + boost::lexical_cast<string>(i));
+      entry->mutable_stbuf()->CopyFrom(MakeFileStat(i));
+    }
+    before = AllocatedBytes();
+    metadata_cache.UpdateDirEntries("/benchmark/dir", dir_entries);
+    const size_t per_dir_entry = (AllocatedBytes() - before) / kDirEntries;
+
+    cout << "MetadataCache bytes per cached stat: " << per_stat
+         << ", per cached directory entry: " << per_dir_entry << endl;
+    EXPECT_EQ(kEntries + 1, metadata_cache.Size());
+  }
+  shutdown_logger();
+}
+
 /** Ideas:
  *
  * test TTL expiration.
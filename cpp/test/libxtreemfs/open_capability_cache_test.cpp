@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "common/test_environment.h"
+#include "common/test_rpc_server_mrc.h"
+#include "libxtreemfs/client.h"
+#include "libxtreemfs/file_handle.h"
+#include "libxtreemfs/open_capability_cache.h"
+#include "libxtreemfs/options.h"
+#include "libxtreemfs/volume.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+
+class OpenCapabilityCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    user_credentials_.set_username("user");
+    user_credentials_.add_groups("group");
+
+    XCap* xcap = file_credentials_.mutable_xcap();
+    xcap->set_access_mode(SYSTEM_V_FCNTL_H_O_RDONLY);
+    xcap->set_client_identity("client");
+    xcap->set_expire_time_s(0);
+    xcap->set_expire_timeout_s(600);
+    xcap->set_file_id("volume:1");
+    xcap->set_replicate_on_close(false);
+    xcap->set_server_signature("signature");
+    xcap->set_truncate_epoch(0);
+    xcap->set_snap_config(SNAP_CONFIG_SNAPS_DISABLED);
+    xcap->set_snap_timestamp(0);
+    XLocSet* xlocs = file_credentials_.mutable_xlocs();
+    xlocs->set_read_only_file_size(0);
+    xlocs->set_replica_update_policy("");
+    xlocs->set_version(1);
+  }
+
+  UserCredentials user_credentials_;
+  FileCredentials file_credentials_;
+};
+
+TEST_F(OpenCapabilityCacheTest, PutAndGet) {
+  OpenCapabilityCache cache(10, 60);
+  cache.Put("/a", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+            file_credentials_);
+
+  FileCredentials result;
+  ASSERT_TRUE(cache.Get("/a", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+                        &result));
+  EXPECT_EQ("volume:1", result.xcap().file_id());
+
+  // Other flags or credentials need their own XCap.
+  EXPECT_FALSE(cache.Get("/a", SYSTEM_V_FCNTL_H_O_RDWR, user_credentials_,
+                         &result));
+  UserCredentials other_user(user_credentials_);
+  other_user.set_username("other");
+  EXPECT_FALSE(cache.Get("/a", SYSTEM_V_FCNTL_H_O_RDONLY, other_user,
+                         &result));
+  UserCredentials other_groups(user_credentials_);
+  other_groups.add_groups("wheel");
+  EXPECT_FALSE(cache.Get("/a", SYSTEM_V_FCNTL_H_O_RDONLY, other_groups,
+                         &result));
+}
+
+TEST_F(OpenCapabilityCacheTest, NotCacheable) {
+  OpenCapabilityCache cache(10, 60);
+  const SYSTEM_V_FCNTL trunc = static_cast<SYSTEM_V_FCNTL>(
+      SYSTEM_V_FCNTL_H_O_WRONLY | SYSTEM_V_FCNTL_H_O_TRUNC);
+  const SYSTEM_V_FCNTL excl = static_cast<SYSTEM_V_FCNTL>(
+      SYSTEM_V_FCNTL_H_O_WRONLY | SYSTEM_V_FCNTL_H_O_CREAT
+      | SYSTEM_V_FCNTL_H_O_EXCL);
+  cache.Put("/a", trunc, user_credentials_, file_credentials_);
+  cache.Put("/a", excl, user_credentials_, file_credentials_);
+  EXPECT_EQ(0u, cache.Size());
+
+  file_credentials_.mutable_xcap()->set_replicate_on_close(true);
+  cache.Put("/a", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+            file_credentials_);
+  EXPECT_EQ(0u, cache.Size());
+
+  // Disabled cache.
+  file_credentials_.mutable_xcap()->set_replicate_on_close(false);
+  OpenCapabilityCache disabled(10, 0);
+  disabled.Put("/a", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+               file_credentials_);
+  EXPECT_EQ(0u, disabled.Size());
+}
+
+TEST_F(OpenCapabilityCacheTest, ShortXCapLifetime) {
+  OpenCapabilityCache cache(10, 60);
+  // Half of the XCap's lifetime is less than a second.
+  file_credentials_.mutable_xcap()->set_expire_timeout_s(1);
+  cache.Put("/a", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+            file_credentials_);
+  EXPECT_EQ(0u, cache.Size());
+}
+
+TEST_F(OpenCapabilityCacheTest, InvalidateBelowPath) {
+  OpenCapabilityCache cache(10, 60);
+  const char* paths[] = { "/dir", "/dir/a", "/dir/sub/b", "/dir.txt", "/dirx",
+                          "/other" };
+  for (size_t i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i) {
+    cache.Put(paths[i], SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+              file_credentials_);
+  }
+  ASSERT_EQ(6u, cache.Size());
+
+  cache.Invalidate("/dir");
+
+  FileCredentials result;
+  EXPECT_FALSE(cache.Get("/dir", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+                         &result));
+  EXPECT_FALSE(cache.Get("/dir/a", SYSTEM_V_FCNTL_H_O_RDONLY,
+                         user_credentials_, &result));
+  EXPECT_FALSE(cache.Get("/dir/sub/b", SYSTEM_V_FCNTL_H_O_RDONLY,
+                         user_credentials_, &result));
+  EXPECT_TRUE(cache.Get("/dir.txt", SYSTEM_V_FCNTL_H_O_RDONLY,
+                        user_credentials_, &result));
+  EXPECT_TRUE(cache.Get("/dirx", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+                        &result));
+  EXPECT_TRUE(cache.Get("/other", SYSTEM_V_FCNTL_H_O_RDONLY,
+                        user_credentials_, &result));
+  EXPECT_EQ(3u, cache.Size());
+}
+
+TEST_F(OpenCapabilityCacheTest, EvictsOldestEntry) {
+  OpenCapabilityCache cache(2, 60);
+  cache.Put("/a", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+            file_credentials_);
+  cache.Put("/b", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+            file_credentials_);
+  cache.Put("/c", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+            file_credentials_);
+  EXPECT_EQ(2u, cache.Size());
+
+  FileCredentials result;
+  EXPECT_FALSE(cache.Get("/a", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+                         &result));
+  EXPECT_TRUE(cache.Get("/c", SYSTEM_V_FCNTL_H_O_RDONLY, user_credentials_,
+                        &result));
+}
+
+/** Re-opens through a volume against the test MRC. */
+class OpenCapabilityCacheVolumeTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+    test_env.options.connect_timeout_s = 3;
+    test_env.options.request_timeout_s = 3;
+    test_env.options.retry_delay_s = 3;
+    test_env.options.open_capability_cache_ttl_s = 3600;
+    ASSERT_TRUE(test_env.Start());
+    volume = test_env.client->OpenVolume(test_env.volume_name_,
+                                         NULL,  // No SSL options.
+                                         test_env.options);
+  }
+
+  virtual void TearDown() {
+    test_env.Stop();
+  }
+
+  FileHandle* Open() {
+    return volume->OpenFile(test_env.user_credentials,
+                            "/file",
+                            SYSTEM_V_FCNTL_H_O_RDWR);
+  }
+
+  TestEnvironment test_env;
+  Volume* volume;
+};
+
+/** FileHandle::Truncate() outdates the truncate epoch of cached XCaps. */
+TEST_F(OpenCapabilityCacheVolumeTest, FileHandleTruncateInvalidates) {
+  FileHandle* file = Open();
+  file->Close();
+  file = Open();
+  EXPECT_EQ(1, test_env.mrc->GetReceivedOpens());
+
+  ASSERT_NO_THROW(file->Truncate(test_env.user_credentials, 0));
+  file->Close();
+  file = Open();
+  EXPECT_EQ(2, test_env.mrc->GetReceivedOpens());
+  file->Close();
+}
+
+}  // namespace xtreemfs
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+
+#include "libxtreemfs/metadata_cache.h"
+#include "libxtreemfs/persistent_metadata_cache.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+
+class PersistentMetadataCacheTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+    // The directory has to be private, /tmp itself is refused.
+    char directory[] = "/tmp/xtreemfs_persistent_metadata_cache_XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory) != NULL);
+    directory_ = directory;
+    // Open() has to create the file itself.
+    path_ = directory_ + "/snapshot.metadata_cache";
+  }
+
+  virtual void TearDown() {
+    unlink(path_.c_str());
+    rmdir(directory_.c_str());
+    shutdown_logger();
+  }
+
+  static Stat MakeStat(uint64_t ino) {
+    Stat stat;
+    stat.set_dev(0);
+    stat.set_ino(ino);
+    stat.set_mode(0644);
+    stat.set_nlink(1);
+    stat.set_user_id("user");
+    stat.set_group_id("group");
+    stat.set_size(ino * 10);
+    stat.set_atime_ns(0);
+    stat.set_mtime_ns(0);
+    stat.set_ctime_ns(0);
+    stat.set_blksize(4096);
+    stat.set_truncate_epoch(0);
+    return stat;
+  }
+
+  string directory_;
+  string path_;
+};
+
+TEST_F(PersistentMetadataCacheTest, PutAndReopen) {
+  {
+    PersistentMetadataCache cache;
+    ASSERT_TRUE(cache.Open(path_, "token"));
+    cache.PutStat("/a", MakeStat(1));
+    // Existing records are never replaced.
+    cache.PutStat("/a", MakeStat(2));
+    DirectoryEntries dir_entries;
+    dir_entries.add_entries()->set_name("a");
+    cache.PutDirEntries("/", dir_entries);
+    listxattrResponse xattrs;
+    XAttr* xattr = xattrs.add_xattrs();
+    xattr->set_name("user.a");
+    xattr->set_value("value");
+    cache.PutXAttrs("/a", xattrs);
+    EXPECT_EQ(3u, cache.Size());
+
+    // Records appended after Open() are readable as well.
+    Stat stat;
+    ASSERT_TRUE(cache.GetStat("/a", &stat));
+    EXPECT_EQ(1u, stat.ino());
+  }
+
+  PersistentMetadataCache cache;
+  ASSERT_TRUE(cache.Open(path_, "token"));
+  EXPECT_EQ(3u, cache.Size());
+
+  Stat stat;
+  ASSERT_TRUE(cache.GetStat("/a", &stat));
+  EXPECT_EQ(1u, stat.ino());
+  EXPECT_EQ(10u, stat.size());
+  EXPECT_FALSE(cache.GetStat("/", &stat));
+
+  DirectoryEntries dir_entries;
+  ASSERT_TRUE(cache.GetDirEntries("/", &dir_entries));
+  ASSERT_EQ(1, dir_entries.entries_size());
+  EXPECT_EQ("a", dir_entries.entries(0).name());
+
+  listxattrResponse xattrs;
+  ASSERT_TRUE(cache.GetXAttrs("/a", &xattrs));
+  ASSERT_EQ(1, xattrs.xattrs_size());
+  EXPECT_EQ("value", xattrs.xattrs(0).value());
+}
+
+TEST_F(PersistentMetadataCacheTest, FileIsPrivate) {
+  {
+    PersistentMetadataCache cache;
+    ASSERT_TRUE(cache.Open(path_, "token"));
+    struct stat file_stat;
+    ASSERT_EQ(0, stat(path_.c_str(), &file_stat));
+    EXPECT_EQ(0600, file_stat.st_mode & 0777);
+  }
+
+  // Files of older clients are made private, too.
+  ASSERT_EQ(0, chmod(path_.c_str(), 0644));
+  PersistentMetadataCache cache;
+  ASSERT_TRUE(cache.Open(path_, "token"));
+  struct stat file_stat;
+  ASSERT_EQ(0, stat(path_.c_str(), &file_stat));
+  EXPECT_EQ(0600, file_stat.st_mode & 0777);
+}
+
+TEST_F(PersistentMetadataCacheTest, SharedDirectoryIsRefused) {
+  ASSERT_EQ(0, chmod(directory_.c_str(), 0777));
+  PersistentMetadataCache cache;
+  EXPECT_FALSE(cache.Open(path_, "token"));
+  struct stat file_stat;
+  EXPECT_NE(0, stat(path_.c_str(), &file_stat));
+}
+
+TEST_F(PersistentMetadataCacheTest, OtherValidityTokenClearsFile) {
+  {
+    PersistentMetadataCache cache;
+    ASSERT_TRUE(cache.Open(path_, "token"));
+    cache.PutStat("/a", MakeStat(1));
+  }
+
+  PersistentMetadataCache cache;
+  ASSERT_TRUE(cache.Open(path_, "other token"));
+  EXPECT_EQ(0u, cache.Size());
+  Stat stat;
+  EXPECT_FALSE(cache.GetStat("/a", &stat));
+}
+
+TEST_F(PersistentMetadataCacheTest, IncompleteRecordIsRemoved) {
+  struct stat file_stat;
+  {
+    PersistentMetadataCache cache;
+    ASSERT_TRUE(cache.Open(path_, "token"));
+    cache.PutStat("/a", MakeStat(1));
+    ASSERT_EQ(0, stat(path_.c_str(), &file_stat));
+    cache.PutStat("/b", MakeStat(2));
+  }
+  // Cut the second record.
+  struct stat complete_stat;
+  ASSERT_EQ(0, stat(path_.c_str(), &complete_stat));
+  ASSERT_EQ(0, truncate(path_.c_str(), complete_stat.st_size - 2));
+
+  {
+    PersistentMetadataCache cache;
+    ASSERT_TRUE(cache.Open(path_, "token"));
+    EXPECT_EQ(1u, cache.Size());
+    struct stat truncated_stat;
+    ASSERT_EQ(0, stat(path_.c_str(), &truncated_stat));
+    EXPECT_EQ(file_stat.st_size, truncated_stat.st_size);
+
+    cache.PutStat("/b", MakeStat(2));
+  }
+
+  PersistentMetadataCache cache;
+  ASSERT_TRUE(cache.Open(path_, "token"));
+  EXPECT_EQ(2u, cache.Size());
+  Stat stat;
+  ASSERT_TRUE(cache.GetStat("/b", &stat));
+  EXPECT_EQ(2u, stat.ino());
+}
+
+TEST_F(PersistentMetadataCacheTest, MetadataCacheWarmsUp) {
+  PersistentMetadataCache persistent_cache;
+  ASSERT_TRUE(persistent_cache.Open(path_, "token"));
+  {
+    MetadataCache metadata_cache(10, 60);
+    metadata_cache.SetPersistentCache(&persistent_cache);
+    metadata_cache.UpdateStat("/a", MakeStat(1));
+    DirectoryEntries dir_entries;
+    dir_entries.add_entries()->set_name("a");
+    metadata_cache.UpdateDirEntries("/", dir_entries);
+  }
+  EXPECT_EQ(2u, persistent_cache.Size());
+
+  // A new MetadataCache, e.g., of the next mount.
+  MetadataCache metadata_cache(10, 60);
+  metadata_cache.SetPersistentCache(&persistent_cache);
+  Stat stat;
+  ASSERT_EQ(MetadataCache::kStatCached, metadata_cache.GetStat("/a", &stat));
+  EXPECT_EQ(1u, stat.ino());
+  EXPECT_EQ(1u, metadata_cache.Size());
+
+  DirectoryEntries* dir_entries = metadata_cache.GetDirEntries("/", 0, 1024);
+  ASSERT_TRUE(dir_entries != NULL);
+  EXPECT_EQ(1, dir_entries->entries_size());
+  delete dir_entries;
+
+  bool xattrs_cached = true;
+  string value;
+  EXPECT_FALSE(metadata_cache.GetXAttr("/a", "user.a", &value,
+                                       &xattrs_cached));
+  EXPECT_FALSE(xattrs_cached);
+}
+
+}  // namespace xtreemfs
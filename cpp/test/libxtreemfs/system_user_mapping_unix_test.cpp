@@ -203,4 +203,46 @@ TEST_F(UserMappingUnixTest, GetGroupnamesReturnsPrimaryGroupAtFirst) {
             (*groupnames.begin()));
 }
 
+// Cache tests.
+
+/** Cached lookups return the same results and are counted as hits. */
+TEST_F(UserMappingUnixTest, CachedLookupsAreCountedAsHits) {
+  user_mapping_.SetCacheLimits(16, 60);
+  string username = user_mapping_.UIDToUsername(0);
+  string groupname = user_mapping_.GIDToGroupname(0);
+  EXPECT_EQ(0, user_mapping_.cache_hits());
+  EXPECT_EQ(2, user_mapping_.cache_misses());
+
+  EXPECT_EQ(username, user_mapping_.UIDToUsername(0));
+  EXPECT_EQ(groupname, user_mapping_.GIDToGroupname(0));
+  EXPECT_EQ(0, user_mapping_.UsernameToUID(username));
+  EXPECT_EQ(0, user_mapping_.UsernameToUID(username));
+  EXPECT_EQ(3, user_mapping_.cache_hits());
+  EXPECT_EQ(3, user_mapping_.cache_misses());
+}
+
+/** The cache does not grow beyond its limit, the oldest entry is evicted. */
+TEST_F(UserMappingUnixTest, CacheEvictsOldestEntry) {
+  TTLCache<int, int> cache;
+  cache.SetLimits(2, 60);
+  cache.Put(1, 10);
+  cache.Put(2, 20);
+  cache.Put(3, 30);
+  EXPECT_EQ(2, cache.Size());
+
+  int value = 0;
+  EXPECT_FALSE(cache.Get(1, &value));
+  EXPECT_TRUE(cache.Get(3, &value));
+  EXPECT_EQ(30, value);
+}
+
+/** The start time of the own process is known and stays the same. */
+TEST_F(UserMappingUnixTest, ProcessStartTime) {
+#ifdef __linux__
+  uint64_t start_time = SystemUserMappingUnix::GetProcessStartTime(getpid());
+  EXPECT_NE(0, start_time);
+  EXPECT_EQ(start_time, SystemUserMappingUnix::GetProcessStartTime(getpid()));
+#endif
+}
+
 #endif // !WIN32
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <string>
+
+#include "libxtreemfs/uuid_cache.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+
+/** Resolves "uuid" like DIRUUIDResolver, but without a DIR: the lookup of
+ *  the test thread has to provide the entry. */
+static void WaitForLookup(UUIDCache* cache,
+                          const string& uuid,
+                          string* address) {
+  if (cache->BeginLookup(uuid)) {
+    // The test thread did finish its lookup already.
+    cache->EndLookup(uuid);
+  }
+  *address = cache->get(uuid);
+}
+
+/** Time returned by FakeClock(). */
+static time_t fake_now = 1000;
+
+static time_t FakeClock() {
+  return fake_now;
+}
+
+class UUIDCacheTest : public ::testing::Test {
+ protected:
+  UUIDCacheTest() : cache_(&FakeClock) {}
+
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+    fake_now = 1000;
+  }
+
+  virtual void TearDown() {
+    shutdown_logger();
+  }
+
+  UUIDCache cache_;
+};
+
+/** A refresh is requested once in the last quarter of the lifetime. */
+TEST_F(UUIDCacheTest, RefreshAhead) {
+  cache_.update("osd1", "localhost", 32640, 4);
+
+  bool refresh = true;
+  EXPECT_EQ("localhost:32640", cache_.get("osd1", &refresh));
+  EXPECT_FALSE(refresh);
+
+  fake_now += 3;
+  EXPECT_EQ("localhost:32640", cache_.get("osd1", &refresh));
+  EXPECT_TRUE(refresh);
+  // The refresh is pending, do not ask again.
+  EXPECT_EQ("localhost:32640", cache_.get("osd1", &refresh));
+  EXPECT_FALSE(refresh);
+
+  // A failed refresh is requested again.
+  cache_.CancelRefresh("osd1");
+  EXPECT_EQ("localhost:32640", cache_.get("osd1", &refresh));
+  EXPECT_TRUE(refresh);
+
+  // Expired entries are removed.
+  fake_now += 1;
+  EXPECT_EQ("", cache_.get("osd1", &refresh));
+  EXPECT_FALSE(refresh);
+}
+
+/** Concurrent misses of the same UUID wait for the first lookup. */
+TEST_F(UUIDCacheTest, SingleFlightLookup) {
+  EXPECT_EQ("", cache_.get("osd1"));
+  ASSERT_TRUE(cache_.BeginLookup("osd1"));
+  // Lookups of other UUIDs are not blocked.
+  ASSERT_TRUE(cache_.BeginLookup("osd2"));
+  cache_.EndLookup("osd2");
+
+  string address;
+  boost::thread waiter(boost::bind(&WaitForLookup,
+                                   &cache_,
+                                   string("osd1"),
+                                   &address));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  cache_.update("osd1", "localhost", 32640, 3600);
+  cache_.EndLookup("osd1");
+  waiter.join();
+
+  EXPECT_EQ("localhost:32640", address);
+}
+
+}  // namespace xtreemfs
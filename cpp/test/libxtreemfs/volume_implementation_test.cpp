@@ -1041,4 +1041,62 @@ TEST_F(VolumeImplementationTestFastPeriodicFileSizeUpdate, Truncate) {
   });
 }
 
+/** CopyFile() copies the content and refuses to copy a file onto itself, also
+ *  if the destination is a hard link of the source. */
+TEST_F(VolumeImplementationTest, CopyFile) {
+  const string path = "copy_source";
+  const string new_path = "copy_destination";
+  const string link_path = "copy_link";
+  const string data = "Hello World!";
+
+  ASSERT_NO_THROW({
+    FileHandle* file_handle = volume_->OpenFile(
+        user_credentials_,
+        path,
+        static_cast<SYSTEM_V_FCNTL>(
+            SYSTEM_V_FCNTL_H_O_CREAT | SYSTEM_V_FCNTL_H_O_RDWR),
+        0640);
+    EXPECT_EQ(static_cast<int>(data.size()),
+              file_handle->Write(data.data(), data.size(), 0));
+    file_handle->Close();
+    volume_->Link(user_credentials_, path, link_path);
+
+    volume_->CopyFile(user_credentials_, path, new_path);
+    CheckFileSize(new_path, data.size());
+    Stat stat;
+    volume_->GetAttr(user_credentials_, new_path, &stat);
+    EXPECT_EQ(0640, stat.mode() & 07777);
+
+    char buf[64] = "";
+    file_handle = volume_->OpenFile(user_credentials_,
+                                    new_path,
+                                    SYSTEM_V_FCNTL_H_O_RDONLY);
+    EXPECT_EQ(static_cast<int>(data.size()),
+              file_handle->Read(buf, sizeof(buf), 0));
+    file_handle->Close();
+    EXPECT_EQ(data, string(buf, data.size()));
+  });
+
+  try {
+    volume_->CopyFile(user_credentials_, path, path);
+    ADD_FAILURE() << "Copying a file onto itself did not fail.";
+  } catch (const PosixErrorException& e) {
+    EXPECT_EQ(POSIX_ERROR_EINVAL, e.posix_errno());
+  }
+  try {
+    volume_->CopyFile(user_credentials_, link_path, path);
+    ADD_FAILURE() << "Copying a file onto a hard link of it did not fail.";
+  } catch (const PosixErrorException& e) {
+    EXPECT_EQ(POSIX_ERROR_EINVAL, e.posix_errno());
+  }
+  // The source was not truncated.
+  CheckFileSize(path, data.size());
+
+  ASSERT_NO_THROW({
+    volume_->Unlink(user_credentials_, path);
+    volume_->Unlink(user_credentials_, link_path);
+    volume_->Unlink(user_credentials_, new_path);
+  });
+}
+
 }  // namespace xtreemfs
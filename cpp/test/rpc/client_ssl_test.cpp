@@ -11,6 +11,8 @@
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/asio.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 #include <cerrno>
@@ -20,13 +22,21 @@
 #include <stdio.h>
 #include <stdexcept>
 #include <string>
+#include <vector>
 #include <openssl/opensslv.h>
 
+#include "common/test_environment.h"
+#include "common/test_rpc_server_dir.h"
+#include "common/test_rpc_server_mrc.h"
+#include "common/test_rpc_server_osd.h"
 #include "libxtreemfs/client.h"
 #include "libxtreemfs/client_implementation.h"
+#include "libxtreemfs/file_handle.h"
 #include "libxtreemfs/options.h"
+#include "libxtreemfs/volume.h"
 #include "libxtreemfs/xtreemfs_exception.h"
 #include "pbrpc/RPC.pb.h"
+#include "rpc/transport_profile.h"
 #include "util/logging.h"
 
 /** 
@@ -1140,6 +1150,122 @@ class ClientSSLTestSSLVersionPKCS12_TLSv11_SSLTLS : public ClientSSLTestSSLVersi
 class ClientSSLTestSSLVersionPKCS12_TLSv12_SSLTLS : public ClientSSLTestSSLVersion<
     g_ssl_tls_version_tlsv12, g_ssl_tls_version_ssltls> {};
 
+/** Writes and reads a file over SSL with and without kernel TLS and logs
+ *  the throughput. Unlike the tests above, the local test servers terminate
+ *  the SSL connections, so only the client side is measured. TLS 1.2 is
+ *  enforced because kernel TLS does not take over TLS 1.3 connections.
+ *  Kernel TLS silently falls back to OpenSSL if the kernel does not support
+ *  it, which the test only logs. */
+template<bool kernel_tls>
+class ClientSSLTestThroughput : public ::testing::Test {
+protected:
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+
+    test_env_.dir->EnableSSL(cert_path("DIR_Root.pem"),
+                             cert_path("DIR_Root.key"));
+    test_env_.mrc->EnableSSL(cert_path("MRC_Root.pem"),
+                             cert_path("MRC_Root.key"));
+    test_env_.osds[0]->EnableSSL(cert_path("OSD_Root.pem"),
+                                 cert_path("OSD_Root.key"));
+
+    test_env_.options.ssl_pem_cert_path = cert_path("Client_Root.pem");
+    test_env_.options.ssl_pem_key_path = cert_path("Client_Root.key");
+    test_env_.options.ssl_pem_trusted_certs_path = cert_path("CA_Root.pem");
+    test_env_.options.ssl_verify_certificates = true;
+    test_env_.options.ssl_method_string = "tlsv12";
+    test_env_.options.ssl_kernel_tls = kernel_tls;
+    ASSERT_TRUE(test_env_.Start());
+  }
+
+  virtual void TearDown() {
+    test_env_.Stop();
+  }
+
+  std::string cert_path(std::string cert) {
+    return "../../tests/certs/client_ssl_test/" + cert;
+  }
+
+  void DoTest() {
+    // The test OSD holds at most 10 MB, the file is written several times.
+    const int kBlockSize = 1024 * 1024;
+    const int kBlocks = 8;
+    const int kRounds = 8;
+
+    Volume* volume = test_env_.client->OpenVolume(
+        test_env_.volume_name_,
+        test_env_.options.GenerateSSLOptions(),
+        test_env_.options);
+    FileHandle* file = volume->OpenFile(
+        test_env_.user_credentials,
+        "/throughput",
+        static_cast<xtreemfs::pbrpc::SYSTEM_V_FCNTL>(
+            xtreemfs::pbrpc::SYSTEM_V_FCNTL_H_O_CREAT |
+            xtreemfs::pbrpc::SYSTEM_V_FCNTL_H_O_RDWR),
+        0644);
+
+    boost::scoped_array<char> write_buf(new char[kBlockSize]);
+    for (int i = 0; i < kBlockSize; ++i) {
+      write_buf[i] = static_cast<char>(i);
+    }
+    boost::scoped_array<char> read_buf(new char[kBlockSize]);
+
+    boost::posix_time::ptime start
+        = boost::posix_time::microsec_clock::local_time();
+    for (int round = 0; round < kRounds; ++round) {
+      for (int i = 0; i < kBlocks; ++i) {
+        ASSERT_EQ(kBlockSize, file->Write(write_buf.get(), kBlockSize,
+            static_cast<int64_t>(i) * kBlockSize));
+      }
+      file->Flush();
+    }
+    const int64_t write_us = (boost::posix_time::microsec_clock::local_time()
+        - start).total_microseconds();
+
+    start = boost::posix_time::microsec_clock::local_time();
+    for (int round = 0; round < kRounds; ++round) {
+      for (int i = 0; i < kBlocks; ++i) {
+        ASSERT_EQ(kBlockSize, file->Read(read_buf.get(), kBlockSize,
+            static_cast<int64_t>(i) * kBlockSize));
+        ASSERT_EQ(0, memcmp(write_buf.get(), read_buf.get(), kBlockSize));
+      }
+    }
+    const int64_t read_us = (boost::posix_time::microsec_clock::local_time()
+        - start).total_microseconds();
+    file->Close();
+
+    if (Logging::log->loggingActive(LEVEL_INFO)) {
+      Logging::log->getLog(LEVEL_INFO) << (kernel_tls ? "kernel TLS"
+          : "OpenSSL") << ": write "
+          << kRounds * kBlocks * 1000000.0 / write_us << " MB/s, read "
+          << kRounds * kBlocks * 1000000.0 / read_us << " MB/s" << std::endl;
+    }
+
+    // Every SSL connection reports whether the kernel took over; the
+    // channel without kernel TLS never does.
+    ASSERT_TRUE(TransportProfiles::transport_profiles != NULL);
+    const std::vector<AppliedTransportProfile> applied
+        = TransportProfiles::transport_profiles->applied();
+    for (size_t i = 0; i < applied.size(); ++i) {
+      if (kernel_tls) {
+        EXPECT_NE(-1, applied[i].kernel_tls_tx) << applied[i].address;
+        if (Logging::log->loggingActive(LEVEL_INFO)) {
+          Logging::log->getLog(LEVEL_INFO) << applied[i].address
+              << ": kernel TLS tx " << applied[i].kernel_tls_tx << ", rx "
+              << applied[i].kernel_tls_rx << std::endl;
+        }
+      } else {
+        EXPECT_EQ(-1, applied[i].kernel_tls_tx) << applied[i].address;
+      }
+    }
+  }
+
+  TestEnvironment test_env_;
+};
+
+class ClientSSLTestThroughputOpenSSL : public ClientSSLTestThroughput<false> {};
+class ClientSSLTestThroughputKernelTLS : public ClientSSLTestThroughput<true> {};
+
 TEST_F(ClientNoSSLTest, TestNoSSL) {
   CreateOpenDeleteVolume("test_no_ssl");
   ASSERT_EQ(0, count_occurrences_in_file(options_.log_file_path, "SSL"));
@@ -1207,6 +1333,10 @@ TEST_F(ClientSSLTestSSLVersionPKCS12_TLSv1_SSLTLS, TestSSLVersion) { DoTest(); }
 TEST_F(ClientSSLTestSSLVersionPKCS12_TLSv11_SSLTLS, TestSSLVersion) { DoTest(); }
 TEST_F(ClientSSLTestSSLVersionPKCS12_TLSv12_SSLTLS, TestSSLVersion) { DoTest(); }
 
+
+TEST_F(ClientSSLTestThroughputOpenSSL, TestThroughput) { DoTest(); }
+TEST_F(ClientSSLTestThroughputKernelTLS, TestThroughput) { DoTest(); }
+
 }  // namespace rpc
 }  // namespace xtreemfs
 
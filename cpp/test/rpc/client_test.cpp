@@ -7,7 +7,10 @@
 
 #include <gtest/gtest.h>
 
+#include <boost/bind.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
 
 #include "common/test_environment.h"
 #include "common/test_rpc_server_dir.h"
@@ -20,6 +23,10 @@
 #include "libxtreemfs/volume.h"
 #include "libxtreemfs/xtreemfs_exception.h"
 #include "rpc/client.h"
+#include "rpc/sync_callback.h"
+#include "rpc/transport_profile.h"
+#include "xtreemfs/DIRServiceClient.h"
+#include "xtreemfs/DIRServiceConstants.h"
 
 using namespace std;
 using namespace xtreemfs::pbrpc;
@@ -163,5 +170,175 @@ TEST_F(ClientTestFastLingerTimeoutConnectTimeout, LingerTests) {
   EXPECT_EQ(0, impl->network_client_->connections_.size());
 }
 
+/** A burst of requests is sent with a few writes and every request gets its
+ *  response. */
+TEST_F(ClientTest, BurstOfRequestsIsCoalesced) {
+  const int kRequests = 500;
+  Client client(1, 5, 60, 1000, false, NULL);
+  boost::thread client_thread(boost::bind(&Client::run, &client));
+  DIRServiceClient dir_service_client(&client);
+
+  Auth auth;
+  auth.set_auth_type(AUTH_NONE);
+  serviceGetByNameRequest request;
+  request.set_name("test");
+
+  vector<SyncCallback<ServiceSet>*> responses;
+  for (int i = 0; i < kRequests; ++i) {
+    responses.push_back(dir_service_client.xtreemfs_service_get_by_name_sync(
+        test_env.dir->GetAddress(), auth, test_env.user_credentials,
+        &request));
+  }
+  for (int i = 0; i < kRequests; ++i) {
+    EXPECT_FALSE(responses[i]->HasFailed());
+    responses[i]->DeleteBuffers();
+    delete responses[i];
+  }
+
+  client.shutdown();
+  client_thread.join();
+}
+
+/** Requests and responses are transferred through io_uring, or regular
+ *  sockets if it is not available. */
+TEST_F(ClientTest, BurstOfRequestsOverIOUring) {
+  const int kRequests = 500;
+  Client client(1, 5, 60, 0, true, NULL);
+  boost::thread client_thread(boost::bind(&Client::run, &client));
+  DIRServiceClient dir_service_client(&client);
+
+  Auth auth;
+  auth.set_auth_type(AUTH_NONE);
+  serviceGetByNameRequest request;
+  request.set_name("test");
+
+  vector<SyncCallback<ServiceSet>*> responses;
+  for (int i = 0; i < kRequests; ++i) {
+    responses.push_back(dir_service_client.xtreemfs_service_get_by_name_sync(
+        test_env.dir->GetAddress(), auth, test_env.user_credentials,
+        &request));
+  }
+  for (int i = 0; i < kRequests; ++i) {
+    EXPECT_FALSE(responses[i]->HasFailed());
+    responses[i]->DeleteBuffers();
+    delete responses[i];
+  }
+
+  client.shutdown();
+  client_thread.join();
+}
+
+/** A request times out after the timeout of its operation instead of the
+ *  client's request timeout. */
+TEST_F(ClientTest, RequestTimeoutPerProc) {
+  Client client(1, 60, 60, 0, false, NULL);
+  client.SetRequestTimeout(INTERFACE_ID_DIR,
+                           PROC_ID_XTREEMFS_SERVICE_GET_BY_NAME,
+                           300);
+  boost::thread client_thread(boost::bind(&Client::run, &client));
+  DIRServiceClient dir_service_client(&client);
+
+  Auth auth;
+  auth.set_auth_type(AUTH_NONE);
+  serviceGetByNameRequest request;
+  request.set_name("test");
+
+  test_env.dir->AddDropRule(new DropNRule(1));
+  SyncCallback<ServiceSet>* response
+      = dir_service_client.xtreemfs_service_get_by_name_sync(
+          test_env.dir->GetAddress(), auth, test_env.user_credentials,
+          &request);
+  ASSERT_TRUE(response->HasFailed());
+  EXPECT_TRUE(response->error()->error_message().find("Request timed out")
+              != string::npos);
+  response->DeleteBuffers();
+  delete response;
+
+  client.shutdown();
+  client_thread.join();
+}
+
+/** A request times out at the deadline of the thread which sent it. */
+TEST_F(ClientTest, RequestDeadlineOfThread) {
+  Client client(1, 60, 60, 0, false, NULL);
+  boost::thread client_thread(boost::bind(&Client::run, &client));
+  DIRServiceClient dir_service_client(&client);
+
+  Auth auth;
+  auth.set_auth_type(AUTH_NONE);
+  serviceGetByNameRequest request;
+  request.set_name("test");
+
+  test_env.dir->AddDropRule(new DropNRule(1));
+  SyncCallback<ServiceSet>* response;
+  {
+    ScopedRequestDeadline deadline(
+        boost::posix_time::microsec_clock::local_time()
+        + boost::posix_time::milliseconds(300));
+    response = dir_service_client.xtreemfs_service_get_by_name_sync(
+        test_env.dir->GetAddress(), auth, test_env.user_credentials,
+        &request);
+  }
+  EXPECT_TRUE(ScopedRequestDeadline::Current().is_not_a_date_time());
+  ASSERT_TRUE(response->HasFailed());
+  EXPECT_TRUE(response->error()->error_message().find("Request timed out")
+              != string::npos);
+  response->DeleteBuffers();
+  delete response;
+
+  client.shutdown();
+  client_thread.join();
+}
+
+/** Returns the number of connections to "address" opened by all clients. */
+static int CountConnections(const string& address) {
+  const vector<AppliedTransportProfile> applied
+      = TransportProfiles::transport_profiles->applied();
+  for (size_t i = 0; i < applied.size(); ++i) {
+    if (applied[i].address == address) {
+      return applied[i].connections;
+    }
+  }
+  return 0;
+}
+
+/** A prewarmed connection is opened without a request and used by the next
+ *  one. */
+TEST_F(ClientTest, PrewarmedConnectionIsReused) {
+  // Created by the libxtreemfs client of the test environment.
+  ASSERT_TRUE(TransportProfiles::transport_profiles != NULL);
+  Client client(1, 5, 60, 0, false, NULL);
+  boost::thread client_thread(boost::bind(&Client::run, &client));
+  DIRServiceClient dir_service_client(&client);
+  const string address = test_env.dir->GetAddress();
+  const int connections = CountConnections(address);
+
+  client.Prewarm(address);
+  for (int i = 0; i < 100 && CountConnections(address) == connections; ++i) {
+    boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+  }
+  ASSERT_EQ(connections + 1, CountConnections(address));
+
+  Auth auth;
+  auth.set_auth_type(AUTH_NONE);
+  serviceGetByNameRequest request;
+  request.set_name("test");
+  SyncCallback<ServiceSet>* response
+      = dir_service_client.xtreemfs_service_get_by_name_sync(
+          address, auth, test_env.user_credentials, &request);
+  EXPECT_FALSE(response->HasFailed());
+  response->DeleteBuffers();
+  delete response;
+  EXPECT_EQ(connections + 1, CountConnections(address));
+
+  // A second prewarm does not open another connection.
+  client.Prewarm(address);
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  EXPECT_EQ(connections + 1, CountConnections(address));
+
+  client.shutdown();
+  client_thread.join();
+}
+
 }  // namespace rpc
 }  // namespace xtreemfs
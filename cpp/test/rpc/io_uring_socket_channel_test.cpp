@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#ifdef HAS_IO_URING
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "rpc/io_uring.h"
+#include "rpc/io_uring_socket_channel.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Connects an IOUringSocketChannel to a boost::asio socket of the same
+ *  io_service. */
+class IOUringSocketChannelTest : public ::testing::Test {
+ public:
+  IOUringSocketChannelTest()
+      : acceptor_(service_,
+                  boost::asio::ip::tcp::endpoint(
+                      boost::asio::ip::address_v4::loopback(), 0)),
+        server_(service_),
+        deadline_(service_) {}
+
+  void OnDeadline(const boost::system::error_code& error) {
+    if (!error) {
+      ADD_FAILURE() << "timed out";
+      service_.stop();
+    }
+  }
+
+  static void SetFlag(bool* flag) {
+    *flag = true;
+  }
+
+  static void SetError(boost::system::error_code* target,
+                       const boost::system::error_code& error) {
+    *target = error;
+  }
+
+  /** Stores the result of a read or write and cancels the deadline if
+   *  "close" is set. */
+  void OnTransfer(boost::system::error_code* target,
+                  size_t* bytes,
+                  bool close,
+                  const boost::system::error_code& error,
+                  size_t bytes_transferred) {
+    *target = error;
+    *bytes = bytes_transferred;
+    if (close) {
+      channel_->close();
+      server_.close();
+      deadline_.cancel();
+    }
+  }
+
+ protected:
+  virtual void SetUp() {
+    initialize_logger(LEVEL_WARN);
+    string error;
+    io_uring_.reset(IOUring::Create(service_, &error));
+    if (io_uring_.get() == NULL) {
+      cout << "io_uring is not available (" << error << "), skipping." << endl;
+      return;
+    }
+    channel_.reset(new IOUringSocketChannel(service_, io_uring_.get()));
+
+    bool accepted = false;
+    boost::system::error_code connect_error = boost::asio::error::timed_out;
+    acceptor_.async_accept(server_, boost::bind(&SetFlag, &accepted));
+    channel_->async_connect(acceptor_.local_endpoint(),
+                            boost::bind(&SetError, &connect_error, _1));
+    while ((!accepted || connect_error == boost::asio::error::timed_out)
+           && service_.run_one() > 0) {}
+    service_.reset();
+    ASSERT_TRUE(accepted);
+    ASSERT_FALSE(connect_error);
+  }
+
+  virtual void TearDown() {
+    channel_.reset();
+    io_uring_.reset();
+    shutdown_logger();
+  }
+
+  /** Runs service_ until "result" was set by a handler. */
+  void RunUntil(const boost::system::error_code& result) {
+    while (result == boost::asio::error::timed_out
+           && service_.run_one() > 0) {}
+    service_.reset();
+  }
+
+  /** Runs service_ until no work is left, for at most 10 seconds. */
+  void Run() {
+    deadline_.expires_from_now(boost::posix_time::seconds(10));
+    deadline_.async_wait(boost::bind(&IOUringSocketChannelTest::OnDeadline,
+                                     this,
+                                     boost::asio::placeholders::error));
+    service_.reset();
+    service_.run();
+  }
+
+  boost::asio::io_service service_;
+  boost::scoped_ptr<IOUring> io_uring_;
+  boost::scoped_ptr<IOUringSocketChannel> channel_;
+  boost::asio::ip::tcp::acceptor acceptor_;
+  boost::asio::ip::tcp::socket server_;
+  boost::asio::deadline_timer deadline_;
+};
+
+/** Several buffers are written and read back like a record marker and the
+ *  message. */
+TEST_F(IOUringSocketChannelTest, EchoScatteredBuffers) {
+  if (io_uring_.get() == NULL) {
+    return;
+  }
+  const size_t kHeaderSize = 12;
+  const size_t kDataSize = 6 * 1024 * 1024 + 17;
+  vector<char> header(kHeaderSize, 'h');
+  vector<char> data(kDataSize);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<char>(i * 7);
+  }
+
+  // The server echoes everything.
+  vector<char> echo(kHeaderSize + kDataSize);
+  boost::system::error_code server_error = boost::asio::error::timed_out;
+  size_t server_bytes = 0;
+  boost::asio::async_read(server_, boost::asio::buffer(echo),
+                          boost::bind(&SetError, &server_error, _1));
+
+  vector<boost::asio::const_buffer> write_buffers;
+  write_buffers.push_back(boost::asio::buffer(header));
+  write_buffers.push_back(boost::asio::buffer(data));
+  boost::system::error_code write_error = boost::asio::error::timed_out;
+  size_t bytes_written = 0;
+  channel_->async_write(
+      write_buffers,
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &write_error, &bytes_written, false, _1, _2));
+  RunUntil(write_error);
+  RunUntil(server_error);
+  ASSERT_FALSE(write_error) << write_error.message();
+  ASSERT_EQ(kHeaderSize + kDataSize, bytes_written);
+  ASSERT_FALSE(server_error);
+
+  boost::asio::async_write(
+      server_, boost::asio::buffer(echo),
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &server_error, &server_bytes, false, _1, _2));
+  vector<char> read_header(kHeaderSize);
+  boost::system::error_code read_error = boost::asio::error::timed_out;
+  size_t bytes_read = 0;
+  channel_->async_read(
+      boost::asio::buffer(read_header),
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &read_error, &bytes_read, false, _1, _2));
+  // The multishot receive keeps service_ busy until the channel is closed.
+  RunUntil(read_error);
+  ASSERT_FALSE(read_error) << read_error.message();
+  ASSERT_EQ(kHeaderSize, bytes_read);
+  EXPECT_TRUE(header == read_header);
+
+  vector<char> read_data(kDataSize);
+  vector<boost::asio::mutable_buffer> read_buffers;
+  read_buffers.push_back(boost::asio::buffer(&read_data[0], 1000));
+  read_buffers.push_back(boost::asio::buffer(&read_data[1000], 0));
+  read_buffers.push_back(boost::asio::buffer(&read_data[1000],
+                                             kDataSize - 1000));
+  read_error = boost::asio::error::timed_out;
+  channel_->async_read(
+      read_buffers,
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &read_error, &bytes_read, true, _1, _2));
+  Run();
+  ASSERT_FALSE(read_error) << read_error.message();
+  ASSERT_EQ(kDataSize, bytes_read);
+  EXPECT_TRUE(data == read_data);
+}
+
+/** Data which arrives while no read is pending fills the receive buffers.
+ *  The receive continues once they are read. */
+TEST_F(IOUringSocketChannelTest, ReceiveMoreThanTheBuffersHold) {
+  if (io_uring_.get() == NULL) {
+    return;
+  }
+  const size_t kDataSize = 16 * 1024 * 1024;
+  vector<char> data(kDataSize);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<char>(i * 13);
+  }
+
+  // Start the receive with a first read.
+  vector<char> read_data(kDataSize);
+  boost::system::error_code read_error = boost::asio::error::timed_out;
+  size_t bytes_read = 0;
+  channel_->async_read(
+      boost::asio::buffer(&read_data[0], 1),
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &read_error, &bytes_read, false, _1, _2));
+  boost::system::error_code server_error = boost::asio::error::timed_out;
+  size_t server_bytes = 0;
+  boost::asio::async_write(
+      server_, boost::asio::buffer(data),
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &server_error, &server_bytes, false, _1, _2));
+  RunUntil(read_error);
+  ASSERT_FALSE(read_error) << read_error.message();
+
+  // Let the server write as much as the socket buffers take.
+  for (int i = 0; i < 100 && server_error == boost::asio::error::timed_out;
+       ++i) {
+    service_.poll();
+    service_.reset();
+    boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+  }
+
+  read_error = boost::asio::error::timed_out;
+  channel_->async_read(
+      boost::asio::buffer(&read_data[1], kDataSize - 1),
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &read_error, &bytes_read, true, _1, _2));
+  Run();
+  ASSERT_FALSE(server_error);
+  ASSERT_FALSE(read_error) << read_error.message();
+  ASSERT_EQ(kDataSize - 1, bytes_read);
+  EXPECT_TRUE(data == read_data);
+}
+
+/** Closing the channel aborts a pending read and lets the io_service return
+ *  once the kernel cancelled the receive. */
+TEST_F(IOUringSocketChannelTest, CloseAbortsRead) {
+  if (io_uring_.get() == NULL) {
+    return;
+  }
+  char buffer[4];
+  boost::system::error_code read_error = boost::asio::error::timed_out;
+  size_t bytes_read = 0;
+  channel_->async_read(
+      boost::asio::buffer(buffer),
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &read_error, &bytes_read, true, _1, _2));
+  service_.poll();
+  service_.reset();
+  channel_->close();
+  server_.close();
+  Run();
+  EXPECT_EQ(boost::asio::error::operation_aborted, read_error);
+}
+
+/** A read after the server closed the connection fails with eof. */
+TEST_F(IOUringSocketChannelTest, ServerCloses) {
+  if (io_uring_.get() == NULL) {
+    return;
+  }
+  char buffer[4];
+  boost::system::error_code read_error = boost::asio::error::timed_out;
+  size_t bytes_read = 0;
+  channel_->async_read(
+      boost::asio::buffer(buffer),
+      boost::bind(&IOUringSocketChannelTest::OnTransfer, this,
+                  &read_error, &bytes_read, true, _1, _2));
+  boost::asio::write(server_, boost::asio::buffer("ab", 2));
+  server_.close();
+  Run();
+  EXPECT_EQ(boost::asio::error::eof, read_error);
+  EXPECT_EQ(2u, bytes_read);
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
+
+#endif  // HAS_IO_URING
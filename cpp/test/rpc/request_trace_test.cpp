@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "rpc/request_trace.h"
+
+using namespace std;
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Only the last max_events events are kept, oldest first. */
+TEST(RequestTraceTest, RingBufferKeepsLatestEvents) {
+  RequestTrace trace(3);
+  for (uint32_t call_id = 1; call_id <= 5; ++call_id) {
+    trace.Record(kTraceEnqueued, call_id, 42, "localhost:32638");
+  }
+
+  vector<RequestTraceEvent> events = trace.events();
+  ASSERT_EQ(3, events.size());
+  EXPECT_EQ(3, events[0].call_id);
+  EXPECT_EQ(4, events[1].call_id);
+  EXPECT_EQ(5, events[2].call_id);
+  EXPECT_EQ(42, events[2].proc_id);
+  EXPECT_LE(events[0].timestamp_us, events[2].timestamp_us);
+}
+
+TEST(RequestTraceTest, DumpFormats) {
+  RequestTrace trace(10);
+  trace.Record(kTraceWriteStart, 7, 3, "osd\"1\":32640");
+  RequestTraceEvent delay;
+  delay.timestamp_us = RequestTrace::Now();
+  delay.type = kTraceRetryDelay;
+  delay.call_id = 7;
+  delay.duration_us = 1500000;
+  delay.server = "osd1:32640";
+  trace.Record(delay);
+
+  ostringstream lines;
+  trace.DumpAsJSONLines(&lines);
+  string jsonl = lines.str();
+  EXPECT_NE(string::npos, jsonl.find("\"event\":\"write_start\""));
+  EXPECT_NE(string::npos, jsonl.find("\"server\":\"osd\\\"1\\\":32640\""));
+  EXPECT_NE(string::npos, jsonl.find("\"duration_us\":1500000"));
+  // Two events, two lines.
+  EXPECT_EQ(2, count(jsonl.begin(), jsonl.end(), '\n'));
+
+  ostringstream chrome;
+  trace.DumpAsChromeTrace(&chrome);
+  string json = chrome.str();
+  EXPECT_EQ(0, json.find("{\"traceEvents\":["));
+  EXPECT_NE(string::npos, json.find("\"ph\":\"X\""));
+  EXPECT_NE(string::npos, json.find("\"dur\":1500000"));
+  EXPECT_NE(string::npos, json.find("\"tid\":7"));
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <iostream>
+#include <queue>
+#include <vector>
+
+#include "include/Common.pb.h"
+#include "rpc/client_request.h"
+#include "rpc/client_request_callback_interface.h"
+#include "rpc/submission_queue.h"
+
+using namespace std;
+using namespace xtreemfs::pbrpc;
+
+namespace xtreemfs {
+namespace rpc {
+
+class NoOpCallback : public ClientRequestCallbackInterface {
+ public:
+  virtual void RequestCompleted(ClientRequest* request) {}
+};
+
+static NoOpCallback no_op_callback;
+
+static ClientRequest* NewRequest(uint32_t call_id) {
+  UserCredentials user_credentials;
+  user_credentials.set_username("user");
+  user_credentials.add_groups("group");
+  Auth auth;
+  auth.set_auth_type(AUTH_NONE);
+  return new ClientRequest("localhost:32638", call_id, 1, 1, user_credentials,
+                           auth, NULL, NULL, 0, NULL, NULL, &no_op_callback);
+}
+
+/** Pushes every "threads"-th request starting at "first". */
+static void PushRequests(SubmissionQueue* queue,
+                         const vector<ClientRequest*>* requests,
+                         size_t first,
+                         size_t threads) {
+  for (size_t i = first; i < requests->size(); i += threads) {
+    bool was_empty;
+    ASSERT_TRUE(queue->Push((*requests)[i], &was_empty));
+  }
+}
+
+class SubmissionQueueTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    for (size_t i = 0; i < requests_.size(); ++i) {
+      delete requests_[i];
+    }
+  }
+
+  /** Creates "count" requests with the call ids 0 to count - 1. */
+  void CreateRequests(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      requests_.push_back(NewRequest(i));
+    }
+  }
+
+  vector<ClientRequest*> requests_;
+};
+
+TEST_F(SubmissionQueueTest, PopAllReturnsPushOrder) {
+  CreateRequests(3);
+  SubmissionQueue queue;
+
+  bool was_empty = false;
+  ASSERT_TRUE(queue.Push(requests_[0], &was_empty));
+  EXPECT_TRUE(was_empty);
+  ASSERT_TRUE(queue.Push(requests_[1], &was_empty));
+  EXPECT_FALSE(was_empty);
+
+  vector<ClientRequest*> popped;
+  queue.PopAll(&popped);
+  ASSERT_EQ(2u, popped.size());
+  EXPECT_EQ(requests_[0], popped[0]);
+  EXPECT_EQ(requests_[1], popped[1]);
+  EXPECT_EQ(NULL, popped[1]->next_submitted());
+
+  // Empty again.
+  ASSERT_TRUE(queue.Push(requests_[2], &was_empty));
+  EXPECT_TRUE(was_empty);
+  queue.PopAll(&popped);
+  ASSERT_EQ(3u, popped.size());
+  EXPECT_EQ(requests_[2], popped[2]);
+}
+
+TEST_F(SubmissionQueueTest, PushFailsAfterClose) {
+  CreateRequests(2);
+  SubmissionQueue queue;
+
+  bool was_empty;
+  ASSERT_TRUE(queue.Push(requests_[0], &was_empty));
+  vector<ClientRequest*> popped;
+  queue.Close(&popped);
+  ASSERT_EQ(1u, popped.size());
+  EXPECT_EQ(requests_[0], popped[0]);
+
+  EXPECT_FALSE(queue.Push(requests_[1], &was_empty));
+  popped.clear();
+  queue.PopAll(&popped);
+  queue.Close(&popped);
+  EXPECT_TRUE(popped.empty());
+}
+
+/** Concurrent producers: every request arrives exactly once and the requests
+ *  of every producer arrive in order. */
+TEST_F(SubmissionQueueTest, ConcurrentProducers) {
+  const size_t kThreads = 8;
+  CreateRequests(kThreads * 10000);
+  SubmissionQueue queue;
+
+  boost::thread_group producers;
+  for (size_t i = 0; i < kThreads; ++i) {
+    producers.create_thread(boost::bind(&PushRequests,
+                                        &queue, &requests_, i, kThreads));
+  }
+
+  vector<uint32_t> last_call_id(kThreads, 0);
+  vector<bool> seen(requests_.size(), false);
+  size_t popped_requests = 0;
+  vector<ClientRequest*> popped;
+  while (popped_requests < requests_.size()) {
+    popped.clear();
+    queue.PopAll(&popped);
+    for (size_t i = 0; i < popped.size(); ++i) {
+      const uint32_t call_id = popped[i]->call_id();
+      ASSERT_FALSE(seen[call_id]);
+      seen[call_id] = true;
+      if (call_id >= kThreads) {
+        EXPECT_EQ(call_id - kThreads, last_call_id[call_id % kThreads]);
+      }
+      last_call_id[call_id % kThreads] = call_id;
+    }
+    popped_requests += popped.size();
+  }
+  producers.join_all();
+}
+
+/** The previous implementation of Client::sendRequest(): a mutex protected
+ *  queue. */
+class MutexSubmissionQueue {
+ public:
+  bool Push(ClientRequest* request, bool* was_empty) {
+    boost::mutex::scoped_lock lock(mutex_);
+    *was_empty = requests_.empty();
+    requests_.push(request);
+    return true;
+  }
+
+  void PopAll(vector<ClientRequest*>* requests) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (!requests_.empty()) {
+      requests->push_back(requests_.front());
+      requests_.pop();
+    }
+  }
+
+ private:
+  boost::mutex mutex_;
+  queue<ClientRequest*> requests_;
+};
+
+/** Network thread of the benchmark: sleeps until woken up by a producer
+ *  and takes all submitted requests. Like Client::sendInternalRequest(), it
+ *  reads every request, and then deletes it. */
+template<class Queue>
+class Consumer {
+ public:
+  Consumer(Queue* queue, size_t expected)
+      : queue_(queue),
+        expected_(expected),
+        wake_ups_(0),
+        call_id_sum_(0),
+        pending_(false) {}
+
+  void WakeUp() {
+    boost::mutex::scoped_lock lock(mutex_);
+    pending_ = true;
+    doorbell_.notify_one();
+  }
+
+  void Run() {
+    size_t consumed = 0;
+    vector<ClientRequest*> popped;
+    while (consumed < expected_) {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (!pending_) {
+          doorbell_.wait(lock);
+        }
+        pending_ = false;
+      }
+      ++wake_ups_;
+      popped.clear();
+      queue_->PopAll(&popped);
+      for (size_t i = 0; i < popped.size(); ++i) {
+        call_id_sum_ += popped[i]->call_id();
+        delete popped[i];
+      }
+      consumed += popped.size();
+    }
+  }
+
+  size_t wake_ups() const {
+    return wake_ups_;
+  }
+
+  uint64_t call_id_sum() const {
+    return call_id_sum_;
+  }
+
+ private:
+  Queue* queue_;
+  const size_t expected_;
+  size_t wake_ups_;
+  uint64_t call_id_sum_;
+  boost::mutex mutex_;
+  boost::condition doorbell_;
+  bool pending_;
+};
+
+/** Creates and submits the requests "first", "first" + "threads", ... up to
+ *  "requests". */
+template<class Queue>
+static void Produce(Queue* queue,
+                    Consumer<Queue>* consumer,
+                    size_t requests,
+                    size_t first,
+                    size_t threads) {
+  for (size_t i = first; i < requests; i += threads) {
+    bool was_empty;
+    queue->Push(NewRequest(i), &was_empty);
+    if (was_empty) {
+      consumer->WakeUp();
+    }
+  }
+}
+
+/** Returns the time 64 threads need to create and submit "requests"
+ *  requests. */
+template<class Queue>
+static boost::posix_time::time_duration RunSubmissionBenchmark(
+    size_t requests,
+    size_t* wake_ups) {
+  const size_t kThreads = 64;
+  Queue queue;
+  Consumer<Queue> consumer(&queue, requests);
+
+  boost::posix_time::ptime start
+      = boost::posix_time::microsec_clock::local_time();
+  boost::thread consumer_thread(boost::bind(&Consumer<Queue>::Run,
+                                            &consumer));
+  boost::thread_group producers;
+  for (size_t i = 0; i < kThreads; ++i) {
+    producers.create_thread(boost::bind(&Produce<Queue>, &queue, &consumer,
+                                        requests, i, kThreads));
+  }
+  producers.join_all();
+  consumer_thread.join();
+
+  EXPECT_EQ(static_cast<uint64_t>(requests) * (requests - 1) / 2,
+            consumer.call_id_sum());
+  *wake_ups = consumer.wake_ups();
+  return boost::posix_time::microsec_clock::local_time() - start;
+}
+
+/** Microbenchmark: 64 threads submit requests to one consumer. Prints the
+ *  best of three runs of both queues. Disabled in the unit tests, run it with
+ *  --gtest_also_run_disabled_tests. */
+TEST_F(SubmissionQueueTest, DISABLED_MultiThreadedSubmissionBenchmark) {
+  const int kRuns = 3;
+  const size_t kRequests = 64 * 5000;
+
+  boost::posix_time::time_duration lock_free_time(boost::posix_time::pos_infin);
+  boost::posix_time::time_duration mutex_time(boost::posix_time::pos_infin);
+  size_t lock_free_wake_ups = 0;
+  size_t mutex_wake_ups = 0;
+  // The first run only warms up the caches.
+  for (int run = 0; run <= kRuns; ++run) {
+    size_t wake_ups;
+    boost::posix_time::time_duration time
+        = RunSubmissionBenchmark<SubmissionQueue>(kRequests, &wake_ups);
+    if (run > 0 && time < lock_free_time) {
+      lock_free_time = time;
+      lock_free_wake_ups = wake_ups;
+    }
+    time = RunSubmissionBenchmark<MutexSubmissionQueue>(kRequests, &wake_ups);
+    if (run > 0 && time < mutex_time) {
+      mutex_time = time;
+      mutex_wake_ups = wake_ups;
+    }
+  }
+
+  cout << kRequests << " requests from 64 threads:" << endl
+       << "  lock-free queue: " << lock_free_time.total_milliseconds()
+       << " ms, " << lock_free_wake_ups << " wake-ups" << endl
+       << "  mutex queue:     " << mutex_time.total_milliseconds()
+       << " ms, " << mutex_wake_ups << " wake-ups" << endl;
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "rpc/timer_wheel.h"
+
+using namespace std;
+
+namespace xtreemfs {
+namespace rpc {
+
+/** Every timer expires at the tick it was scheduled for, also if it was
+ *  placed in an upper level. */
+TEST(TimerWheelTest, ExpiresAtScheduledTick) {
+  const uint64_t kStart = 1000;
+  const uint64_t kTicks[] = { 1, 2, 63, 64, 65, 127, 4095, 4096, 4097, 70000 };
+  const size_t kTimers = sizeof(kTicks) / sizeof(kTicks[0]);
+
+  TimerWheel wheel(kStart);
+  vector<TimerWheel::Timer*> timers;
+  for (size_t i = 0; i < kTimers; ++i) {
+    timers.push_back(new TimerWheel::Timer(&timers));
+    wheel.Schedule(timers[i], kStart + kTicks[i]);
+  }
+  EXPECT_EQ(kTimers, wheel.size());
+
+  size_t expired_timers = 0;
+  for (uint64_t tick = kStart + 1; tick <= kStart + kTicks[kTimers - 1];
+       ++tick) {
+    vector<TimerWheel::Timer*> expired;
+    wheel.Advance(tick, &expired);
+    for (size_t i = 0; i < expired.size(); ++i) {
+      EXPECT_EQ(tick, expired[i]->expires_at_tick());
+      EXPECT_FALSE(expired[i]->IsScheduled());
+      EXPECT_EQ(&timers, expired[i]->context());
+    }
+    expired_timers += expired.size();
+  }
+  EXPECT_EQ(kTimers, expired_timers);
+  EXPECT_EQ(0u, wheel.size());
+
+  for (size_t i = 0; i < kTimers; ++i) {
+    delete timers[i];
+  }
+}
+
+TEST(TimerWheelTest, CancelAndReschedule) {
+  TimerWheel wheel(0);
+  TimerWheel::Timer a;
+  TimerWheel::Timer b;
+  wheel.Schedule(&a, 10);
+  wheel.Schedule(&b, 5000);
+  EXPECT_EQ(2u, wheel.size());
+
+  wheel.Cancel(&b);
+  EXPECT_FALSE(b.IsScheduled());
+  EXPECT_EQ(1u, wheel.size());
+  // Cancelling twice does nothing.
+  wheel.Cancel(&b);
+  EXPECT_EQ(1u, wheel.size());
+
+  // Moves a.
+  wheel.Schedule(&a, 20);
+  EXPECT_EQ(1u, wheel.size());
+
+  vector<TimerWheel::Timer*> expired;
+  wheel.Advance(19, &expired);
+  EXPECT_TRUE(expired.empty());
+  wheel.Advance(10000, &expired);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(&a, expired[0]);
+  EXPECT_EQ(0u, wheel.size());
+}
+
+TEST(TimerWheelTest, PastTickExpiresAtNextAdvance) {
+  TimerWheel wheel(100);
+  TimerWheel::Timer timer;
+  wheel.Schedule(&timer, 50);
+
+  vector<TimerWheel::Timer*> expired;
+  wheel.Advance(101, &expired);
+  ASSERT_EQ(1u, expired.size());
+  EXPECT_EQ(&timer, expired[0]);
+}
+
+/** Timers beyond the end of the wheel are moved until they are due. */
+TEST(TimerWheelTest, BeyondEndOfWheel) {
+  const uint64_t kWheelTicks = static_cast<uint64_t>(1)
+      << (TimerWheel::kSlotBits * TimerWheel::kLevels);
+  TimerWheel wheel(0);
+  TimerWheel::Timer timer;
+  wheel.Schedule(&timer, 3 * kWheelTicks + 7);
+
+  vector<TimerWheel::Timer*> expired;
+  wheel.Advance(3 * kWheelTicks + 6, &expired);
+  EXPECT_TRUE(expired.empty());
+  EXPECT_TRUE(timer.IsScheduled());
+  wheel.Advance(3 * kWheelTicks + 7, &expired);
+  ASSERT_EQ(1u, expired.size());
+}
+
+/** Random ticks, cancellations and jumps of the current tick. */
+TEST(TimerWheelTest, Random) {
+  const int kTimers = 2000;
+  srand(42);
+
+  TimerWheel wheel(0);
+  vector<TimerWheel::Timer*> timers;
+  vector<bool> cancelled;
+  for (int i = 0; i < kTimers; ++i) {
+    timers.push_back(new TimerWheel::Timer());
+    wheel.Schedule(timers[i], 1 + rand() % 300000);
+    cancelled.push_back(rand() % 10 == 0);
+    if (cancelled[i]) {
+      wheel.Cancel(timers[i]);
+    }
+  }
+
+  uint64_t tick = 0;
+  int expired_timers = 0;
+  while (wheel.size() > 0) {
+    const uint64_t previous_tick = tick;
+    tick += 1 + rand() % 5000;
+    vector<TimerWheel::Timer*> expired;
+    wheel.Advance(tick, &expired);
+    for (size_t i = 0; i < expired.size(); ++i) {
+      EXPECT_GT(expired[i]->expires_at_tick(), previous_tick);
+      EXPECT_LE(expired[i]->expires_at_tick(), tick);
+    }
+    expired_timers += expired.size();
+  }
+
+  for (int i = 0; i < kTimers; ++i) {
+    EXPECT_FALSE(timers[i]->IsScheduled());
+    if (!cancelled[i]) {
+      --expired_timers;
+    }
+    delete timers[i];
+  }
+  EXPECT_EQ(0, expired_timers);
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/asio.hpp>
+#include <string>
+#include <vector>
+
+#include "rpc/transport_profile.h"
+#include "util/logging.h"
+
+using namespace std;
+using namespace xtreemfs::util;
+
+namespace xtreemfs {
+namespace rpc {
+
+TEST(TransportProfileTest, ParseProfile) {
+  TransportProfile base;
+  base.tcp_no_delay = true;
+  base.keep_alive_idle_s = 60;
+
+  string address;
+  TransportProfile profile;
+  string error;
+  ASSERT_TRUE(TransportProfiles::ParseProfile(
+      "osd1:32640,nodelay=0,buffer-kb=512,bandwidth-mbit=40000",
+      base, &address, &profile, &error));
+  EXPECT_EQ("osd1:32640", address);
+  EXPECT_FALSE(profile.tcp_no_delay);
+  EXPECT_EQ(60, profile.keep_alive_idle_s);
+  EXPECT_EQ(512 * 1024, profile.buffer_bytes);
+  EXPECT_EQ(40000, profile.link_bandwidth_mbit);
+
+  ASSERT_TRUE(TransportProfiles::ParseProfile("osd2", base, &address,
+                                              &profile, &error));
+  EXPECT_EQ("osd2", address);
+  EXPECT_TRUE(profile.tcp_no_delay);
+
+  EXPECT_FALSE(TransportProfiles::ParseProfile(",nodelay=1", base, &address,
+                                               &profile, &error));
+  EXPECT_FALSE(TransportProfiles::ParseProfile("osd1,nodelay", base, &address,
+                                               &profile, &error));
+  EXPECT_FALSE(TransportProfiles::ParseProfile("osd1,speed=1", base, &address,
+                                               &profile, &error));
+  EXPECT_FALSE(TransportProfiles::ParseProfile("osd1,buffer-kb=-1", base,
+                                               &address, &profile, &error));
+  EXPECT_FALSE(TransportProfiles::ParseProfile("osd1,buffer-kb=x", base,
+                                               &address, &profile, &error));
+}
+
+TEST(TransportProfileTest, ProfileOfHostAndPortBeforeHost) {
+  TransportProfile default_profile;
+  default_profile.busy_poll_us = 1;
+  TransportProfiles profiles(default_profile);
+  TransportProfile host_profile;
+  host_profile.busy_poll_us = 2;
+  profiles.SetProfile("osd1", host_profile);
+  TransportProfile port_profile;
+  port_profile.busy_poll_us = 3;
+  profiles.SetProfile("osd1:32641", port_profile);
+
+  int64_t rtt_us;
+  EXPECT_EQ(1, profiles.GetProfile("osd2:32640", &rtt_us).busy_poll_us);
+  EXPECT_EQ(2, profiles.GetProfile("osd1:32640", &rtt_us).busy_poll_us);
+  EXPECT_EQ(3, profiles.GetProfile("osd1:32641", &rtt_us).busy_poll_us);
+  EXPECT_EQ(0, rtt_us);
+}
+
+TEST(TransportProfileTest, BuffersAreSizedFromRTT) {
+  TransportProfile default_profile;
+  default_profile.link_bandwidth_mbit = 40000;
+  TransportProfiles profiles(default_profile);
+
+  // Unknown RTT: left to the OS.
+  int64_t rtt_us;
+  EXPECT_EQ(0, profiles.GetProfile("osd1:32640", &rtt_us).buffer_bytes);
+
+  // 40 Gbit/s * 200 us = 1 MB in flight.
+  profiles.UpdateRTT("osd1:32640", 200);
+  EXPECT_EQ(2 * 1000 * 1000,
+            profiles.GetProfile("osd1:32640", &rtt_us).buffer_bytes);
+  EXPECT_EQ(200, rtt_us);
+
+  // Smoothed like TCP's SRTT.
+  profiles.UpdateRTT("osd1:32640", 1000);
+  profiles.GetProfile("osd1:32640", &rtt_us);
+  EXPECT_EQ(300, rtt_us);
+
+  // Bounded by the minimum and maximum size.
+  profiles.UpdateRTT("osd2:32640", 1);
+  EXPECT_EQ(64 * 1024,
+            profiles.GetProfile("osd2:32640", &rtt_us).buffer_bytes);
+  profiles.UpdateRTT("osd3:32640", 1000 * 1000);
+  EXPECT_EQ(32 * 1024 * 1024,
+            profiles.GetProfile("osd3:32640", &rtt_us).buffer_bytes);
+
+  // A fixed size wins.
+  TransportProfile fixed_profile = default_profile;
+  fixed_profile.buffer_bytes = 128 * 1024;
+  profiles.SetProfile("osd1", fixed_profile);
+  EXPECT_EQ(128 * 1024,
+            profiles.GetProfile("osd1:32640", &rtt_us).buffer_bytes);
+}
+
+TEST(TransportProfileTest, ApplyToConnectedSocket) {
+  initialize_logger(LEVEL_WARN);
+  boost::asio::io_service service;
+  boost::asio::ip::tcp::acceptor acceptor(
+      service,
+      boost::asio::ip::tcp::endpoint(
+          boost::asio::ip::address_v4::loopback(), 0));
+  boost::asio::ip::tcp::socket client(service);
+  client.connect(acceptor.local_endpoint());
+  boost::asio::ip::tcp::socket server(service);
+  acceptor.accept(server);
+
+  TransportProfile default_profile;
+  default_profile.tcp_no_delay = true;
+  default_profile.keep_alive_idle_s = 30;
+  default_profile.buffer_bytes = 256 * 1024;
+  TransportProfiles profiles(default_profile);
+  profiles.Apply("localhost:1", client.lowest_layer());
+  profiles.Apply("localhost:1", client.lowest_layer());
+
+  const vector<AppliedTransportProfile> applied = profiles.applied();
+  ASSERT_EQ(1u, applied.size());
+  EXPECT_EQ("localhost:1", applied[0].address);
+  EXPECT_EQ(2, applied[0].connections);
+  EXPECT_EQ("", applied[0].failed_options);
+  EXPECT_EQ(1, applied[0].tcp_no_delay);
+  EXPECT_EQ(1, applied[0].keep_alive);
+  // The OS may round up (Linux doubles the value) or cap the size.
+  EXPECT_GT(applied[0].send_buffer_bytes, 0);
+  EXPECT_GT(applied[0].receive_buffer_bytes, 0);
+  shutdown_logger();
+}
+
+TEST(TransportProfileTest, TLSHandshakesSurviveApply) {
+  initialize_logger(LEVEL_WARN);
+  boost::asio::io_service service;
+  boost::asio::ip::tcp::acceptor acceptor(
+      service,
+      boost::asio::ip::tcp::endpoint(
+          boost::asio::ip::address_v4::loopback(), 0));
+  boost::asio::ip::tcp::socket client(service);
+  client.connect(acceptor.local_endpoint());
+
+  TransportProfiles profiles((TransportProfile()));
+  // The handshake is recorded before the profile is applied.
+  profiles.RecordTLSHandshake("localhost:1", 3000, false);
+  profiles.Apply("localhost:1", client.lowest_layer());
+  profiles.RecordTLSHandshake("localhost:1", 1000, true);
+  profiles.Apply("localhost:1", client.lowest_layer());
+
+  const vector<AppliedTransportProfile> applied = profiles.applied();
+  ASSERT_EQ(1u, applied.size());
+  EXPECT_EQ(2, applied[0].connections);
+  EXPECT_EQ(2, applied[0].tls_handshakes);
+  EXPECT_EQ(1, applied[0].tls_resumed_handshakes);
+  EXPECT_EQ(1000, applied[0].tls_handshake_us);
+  EXPECT_EQ(4000, applied[0].tls_handshake_total_us);
+  shutdown_logger();
+}
+
+}  // namespace rpc
+}  // namespace xtreemfs
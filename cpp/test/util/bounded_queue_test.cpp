@@ -0,0 +1,267 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <iostream>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "util/bounded_queue.h"
+
+using namespace std;
+
+namespace xtreemfs {
+namespace util {
+
+TEST(BoundedQueueTest, TryEnqueueFailsIfFull) {
+  BoundedQueue<int> queue(3, 0);
+  ASSERT_EQ(4u, queue.capacity());
+
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.TryEnqueue(i));
+  }
+  EXPECT_FALSE(queue.TryEnqueue(4));
+  EXPECT_EQ(4u, queue.size());
+
+  // Wraps around the ring buffer several times.
+  for (int i = 0; i < 20; ++i) {
+    int data;
+    ASSERT_TRUE(queue.TryDequeue(&data));
+    EXPECT_EQ(i, data);
+    EXPECT_TRUE(queue.TryEnqueue(i + 4));
+  }
+  vector<int> batch;
+  EXPECT_EQ(3u, queue.DequeueBatch(3, &batch));
+  EXPECT_EQ(20, batch[0]);
+  EXPECT_EQ(22, batch[2]);
+  EXPECT_EQ(1u, queue.DequeueBatch(3, &batch));
+  EXPECT_EQ(23, batch[3]);
+
+  int data;
+  EXPECT_FALSE(queue.TryDequeue(&data));
+  EXPECT_EQ(0u, queue.size());
+}
+
+static void EnqueueString(BoundedQueue<string>* queue, const string& data) {
+  queue->Enqueue(data);
+}
+
+/** A producer sleeps while the queue is full. */
+TEST(BoundedQueueTest, EnqueueBlocksWhileFull) {
+  BoundedQueue<string> queue(2, 0);
+  queue.Enqueue("a");
+  queue.Enqueue("b");
+
+  boost::thread producer(boost::bind(&EnqueueString, &queue, "c"));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+  EXPECT_EQ(2u, queue.size());
+
+  EXPECT_EQ("a", queue.Dequeue());
+  producer.join();
+  EXPECT_EQ("b", queue.Dequeue());
+  EXPECT_EQ("c", queue.Dequeue());
+}
+
+static void DequeueOne(BoundedQueue<int>* queue) {
+  queue->Dequeue();
+}
+
+TEST(BoundedQueueTest, InterruptWaitingConsumer) {
+  BoundedQueue<int> queue(2, 10);
+  boost::thread consumer(boost::bind(&DequeueOne, &queue));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  consumer.interrupt();
+  consumer.join();
+
+  // The interrupted consumer does not keep the next one from waking up.
+  boost::thread next_consumer(boost::bind(&DequeueOne, &queue));
+  queue.Enqueue(1);
+  next_consumer.join();
+}
+
+/** Enqueues "elements" elements which carry the number of the producer in
+ *  the upper 32 bits and a sequence number in the lower ones. */
+template<class Queue>
+static void Produce(Queue* queue, size_t elements, uint64_t producer) {
+  for (uint64_t i = 0; i < elements; ++i) {
+    queue->Enqueue((producer << 32) | i);
+  }
+}
+
+static const uint64_t kEndOfData = static_cast<uint64_t>(-1);
+
+/** Dequeues batches of up to "batch_size" elements until it receives
+ *  kEndOfData, checks that the elements of every producer arrive in order
+ *  and stores the number of received elements in "received". */
+template<class Queue>
+static void Consume(Queue* queue,
+                    size_t batch_size,
+                    size_t producers,
+                    size_t* received,
+                    bool* in_order) {
+  vector<int64_t> last_element(producers, -1);
+  vector<uint64_t> elements;
+  *received = 0;
+  *in_order = true;
+  while (true) {
+    elements.clear();
+    queue->DequeueBatch(batch_size, &elements);
+    for (size_t i = 0; i < elements.size(); ++i) {
+      if (elements[i] == kEndOfData) {
+        // Leave it for the other consumers.
+        queue->Enqueue(kEndOfData);
+        return;
+      }
+      const size_t producer = elements[i] >> 32;
+      const int64_t element = elements[i] & 0xffffffff;
+      if (element <= last_element[producer]) {
+        *in_order = false;
+      }
+      last_element[producer] = element;
+      ++*received;
+    }
+  }
+}
+
+/** Runs "producers" and "consumers" threads and returns the time they need to
+ *  pass "elements_per_producer" elements per producer. Checks that every
+ *  element arrives once. */
+template<class Queue>
+static boost::posix_time::time_duration RunQueue(Queue* queue,
+                                                 size_t producers,
+                                                 size_t consumers,
+                                                 size_t elements_per_producer,
+                                                 size_t batch_size) {
+  vector<size_t> received(consumers);
+  // vector<bool> is not addressable.
+  boost::scoped_array<bool> in_order(new bool[consumers]);
+
+  const boost::posix_time::ptime start
+      = boost::posix_time::microsec_clock::local_time();
+  boost::thread_group consumer_threads;
+  for (size_t i = 0; i < consumers; ++i) {
+    consumer_threads.create_thread(boost::bind(&Consume<Queue>,
+                                               queue,
+                                               batch_size,
+                                               producers,
+                                               &received[i],
+                                               &in_order[i]));
+  }
+  boost::thread_group producer_threads;
+  for (size_t i = 0; i < producers; ++i) {
+    producer_threads.create_thread(boost::bind(&Produce<Queue>,
+                                               queue,
+                                               elements_per_producer,
+                                               i));
+  }
+  producer_threads.join_all();
+  queue->Enqueue(kEndOfData);
+  consumer_threads.join_all();
+  const boost::posix_time::time_duration duration
+      = boost::posix_time::microsec_clock::local_time() - start;
+
+  size_t total = 0;
+  for (size_t i = 0; i < consumers; ++i) {
+    total += received[i];
+    EXPECT_TRUE(in_order[i]);
+  }
+  EXPECT_EQ(producers * elements_per_producer, total);
+  return duration;
+}
+
+TEST(BoundedQueueTest, MultipleProducersAndConsumers) {
+  BoundedQueue<uint64_t> queue(16, 0);
+  RunQueue(&queue, 4, 3, 20000, 8);
+}
+
+/** The previous implementation of the async write callback queue
+ *  (util::SynchronizedQueue) with the same interface. */
+class SynchronizedQueue {
+ public:
+  void Enqueue(const uint64_t& data) {
+    boost::mutex::scoped_lock lock(mutex_);
+    queue_.push(data);
+    queue_not_empty_cond_.notify_one();
+  }
+
+  /** Only returns one element, like Dequeue() did. */
+  size_t DequeueBatch(size_t max_elements, vector<uint64_t>* elements) {
+    boost::mutex::scoped_lock lock(mutex_);
+    while (queue_.size() == 0) {
+      queue_not_empty_cond_.wait(lock);
+    }
+    elements->push_back(queue_.front());
+    queue_.pop();
+    return 1;
+  }
+
+ private:
+  queue<uint64_t> queue_;
+  boost::mutex mutex_;
+  boost::condition_variable queue_not_empty_cond_;
+};
+
+/** Microbenchmark: 8 producers and 2 consumers. Prints the best of three
+ *  runs of the bounded queue (with and without spinning) and the previous
+ *  queue. Disabled in the unit tests, run it with
+ *  --gtest_also_run_disabled_tests. */
+TEST(BoundedQueueTest, DISABLED_Benchmark) {
+  const int kRuns = 3;
+  const size_t kProducers = 8;
+  const size_t kConsumers = 2;
+  const size_t kElementsPerProducer = 50000;
+
+  boost::posix_time::time_duration bounded_time(boost::posix_time::pos_infin);
+  boost::posix_time::time_duration spinning_time(boost::posix_time::pos_infin);
+  boost::posix_time::time_duration synchronized_time(
+      boost::posix_time::pos_infin);
+  // The first run only warms up the caches.
+  for (int run = 0; run <= kRuns; ++run) {
+    BoundedQueue<uint64_t> bounded_queue(1024, 0);
+    boost::posix_time::time_duration time = RunQueue(
+        &bounded_queue, kProducers, kConsumers, kElementsPerProducer, 32);
+    if (run > 0 && time < bounded_time) {
+      bounded_time = time;
+    }
+
+    BoundedQueue<uint64_t> spinning_queue(1024, 100);
+    time = RunQueue(
+        &spinning_queue, kProducers, kConsumers, kElementsPerProducer, 32);
+    if (run > 0 && time < spinning_time) {
+      spinning_time = time;
+    }
+
+    SynchronizedQueue synchronized_queue;
+    time = RunQueue(
+        &synchronized_queue, kProducers, kConsumers, kElementsPerProducer, 1);
+    if (run > 0 && time < synchronized_time) {
+      synchronized_time = time;
+    }
+  }
+
+  cout << kProducers * kElementsPerProducer << " elements from "
+       << kProducers << " to " << kConsumers << " threads:" << endl
+       << "  bounded queue:            " << bounded_time.total_milliseconds()
+       << " ms" << endl
+       << "  bounded queue, spinning:  " << spinning_time.total_milliseconds()
+       << " ms" << endl
+       << "  synchronized queue:       "
+       << synchronized_time.total_milliseconds() << " ms" << endl;
+}
+
+}  // namespace util
+}  // namespace xtreemfs
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2014 by Zuse Institute Berlin
+ *
+ * Licensed under the BSD License, see LICENSE file for details.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <vector>
+
+#include "util/sharded_queue.h"
+
+using namespace std;
+
+namespace xtreemfs {
+namespace util {
+
+struct Entry {
+  Entry() : key(0), sequence_number(0) {}
+  Entry(uint64_t key, uint64_t sequence_number)
+      : key(key), sequence_number(sequence_number) {}
+
+  uint64_t key;
+  uint64_t sequence_number;
+};
+
+TEST(ShardedQueueTest, KeysStayInTheirShard) {
+  ShardedQueue<Entry> queue(3, 16, 0);
+  for (uint64_t i = 0; i < 9; ++i) {
+    queue.Enqueue(i, Entry(i, i));
+  }
+
+  for (size_t shard = 0; shard < 3; ++shard) {
+    ShardedQueue<Entry>::Statistics statistics;
+    queue.GetStatistics(shard, &statistics);
+    EXPECT_EQ(3, statistics.depth);
+    EXPECT_EQ(3, statistics.peak_depth);
+    EXPECT_EQ(3u, statistics.enqueued);
+
+    for (uint64_t i = shard; i < 9; i += 3) {
+      EXPECT_EQ(i, queue.Dequeue(shard).key);
+    }
+    queue.GetStatistics(shard, &statistics);
+    EXPECT_EQ(0, statistics.depth);
+    EXPECT_EQ(3, statistics.peak_depth);
+  }
+}
+
+/** Dequeues "count" entries of "shard" in batches and checks that the entries of every
+ *  key arrive in order. */
+static void Consume(ShardedQueue<Entry>* queue,
+                    size_t shard,
+                    size_t count,
+                    size_t keys,
+                    bool* in_order) {
+  vector<uint64_t> next_sequence_number(keys, 0);
+  *in_order = true;
+  vector<Entry> entries;
+  for (size_t consumed = 0; consumed < count; consumed += entries.size()) {
+    entries.clear();
+    queue->DequeueBatch(shard, 16, &entries);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      const Entry& entry = entries[i];
+      if (entry.key % queue->shards() != shard
+          || entry.sequence_number != next_sequence_number[entry.key]) {
+        *in_order = false;
+      }
+      ++next_sequence_number[entry.key];
+    }
+  }
+}
+
+/** The consumers sleep while their shard is empty and are woken up by the
+ *  producer. */
+TEST(ShardedQueueTest, ConsumersPerShard) {
+  const size_t kShards = 4;
+  const size_t kKeys = 16;
+  const uint64_t kEntriesPerKey = 5000;
+  // Small shards, so that the producer also waits for full shards.
+  ShardedQueue<Entry> queue(kShards, 64, 0);
+
+  bool in_order[kShards];
+  boost::thread_group consumers;
+  for (size_t shard = 0; shard < kShards; ++shard) {
+    consumers.create_thread(boost::bind(&Consume,
+                                        &queue,
+                                        shard,
+                                        kKeys / kShards * kEntriesPerKey,
+                                        kKeys,
+                                        &in_order[shard]));
+  }
+
+  for (uint64_t sequence_number = 0; sequence_number < kEntriesPerKey;
+       ++sequence_number) {
+    for (uint64_t key = 0; key < kKeys; ++key) {
+      queue.Enqueue(key, Entry(key, sequence_number));
+    }
+    if (sequence_number % 1000 == 0) {
+      // Let the consumers run dry.
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+  }
+  consumers.join_all();
+
+  for (size_t shard = 0; shard < kShards; ++shard) {
+    EXPECT_TRUE(in_order[shard]);
+    ShardedQueue<Entry>::Statistics statistics;
+    queue.GetStatistics(shard, &statistics);
+    EXPECT_EQ(0, statistics.depth);
+    EXPECT_EQ(kKeys / kShards * kEntriesPerKey, statistics.enqueued);
+  }
+}
+
+/** A full shard does not block the producer, the overflowed entries are
+ *  dequeued after the queued ones. */
+TEST(ShardedQueueTest, EnqueueWithoutBlockingOverflows) {
+  ShardedQueue<Entry> queue(1, 4, 0);
+  for (uint64_t i = 0; i < 10; ++i) {
+    queue.EnqueueWithoutBlocking(0, Entry(0, i));
+  }
+  ShardedQueue<Entry>::Statistics statistics;
+  queue.GetStatistics(0, &statistics);
+  EXPECT_EQ(10, statistics.depth);
+  EXPECT_EQ(10, statistics.peak_depth);
+  EXPECT_EQ(6u, statistics.overflowed);
+
+  bool in_order;
+  Consume(&queue, 0, 10, 1, &in_order);
+  EXPECT_TRUE(in_order);
+  queue.GetStatistics(0, &statistics);
+  EXPECT_EQ(0, statistics.depth);
+}
+
+/** Entries stay in order while the producer switches between the queue and
+ *  the overflow list. */
+TEST(ShardedQueueTest, EnqueueWithoutBlockingWithConsumers) {
+  const size_t kShards = 2;
+  const size_t kKeys = 8;
+  const uint64_t kEntriesPerKey = 5000;
+  ShardedQueue<Entry> queue(kShards, 16, 0);
+
+  bool in_order[kShards];
+  boost::thread_group consumers;
+  for (size_t shard = 0; shard < kShards; ++shard) {
+    consumers.create_thread(boost::bind(&Consume,
+                                        &queue,
+                                        shard,
+                                        kKeys / kShards * kEntriesPerKey,
+                                        kKeys,
+                                        &in_order[shard]));
+  }
+
+  for (uint64_t sequence_number = 0; sequence_number < kEntriesPerKey;
+       ++sequence_number) {
+    for (uint64_t key = 0; key < kKeys; ++key) {
+      queue.EnqueueWithoutBlocking(key, Entry(key, sequence_number));
+    }
+    if (sequence_number % 1000 == 0) {
+      // Let the consumers run dry.
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+  }
+  consumers.join_all();
+
+  for (size_t shard = 0; shard < kShards; ++shard) {
+    EXPECT_TRUE(in_order[shard]);
+    ShardedQueue<Entry>::Statistics statistics;
+    queue.GetStatistics(shard, &statistics);
+    EXPECT_EQ(0, statistics.depth);
+  }
+}
+
+/** A sleeping consumer is interrupted, e.g., by Client::Shutdown(). */
+TEST(ShardedQueueTest, InterruptWaitingConsumer) {
+  ShardedQueue<Entry> queue(1, 16, 0);
+  bool in_order;
+  boost::thread consumer(boost::bind(&Consume, &queue, 0, 1, 1, &in_order));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+  consumer.interrupt();
+  consumer.join();
+}
+
+}  // namespace util
+}  // namespace xtreemfs